@@ -1,8 +1,290 @@
 #include "ast.h"
 #include "type.h"
+#include "layout.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <inttypes.h>
+#include <stdint.h>
+
+// Open-addressing set of pointers, kept at most half full. Removed
+// entries leave a tombstone so later probes still find their keys.
+typedef struct {
+    void** slots;
+    size_t capacity;        // Power of two
+    size_t used;            // Live entries plus tombstones
+} PointerSet;
+
+static char tombstone_slot;
+#define TOMBSTONE ((void*)&tombstone_slot)
+#define INITIAL_POOL_CAPACITY 256
+
+struct AstPool {
+    PointerSet nodes;
+    PointerSet types;
+};
+
+// Pool the calling thread's compilation records into, or NULL
+static _Thread_local AstPool* current_pool;
+
+/**
+ * Finds the slot holding a pointer, or the empty slot where it would go.
+ * 
+ * @param set The set to search
+ * @param pointer The pointer to look for
+ * @return The matching or first empty slot
+ */
+static void** pointer_set_slot(PointerSet* set, void* pointer) {
+    size_t mask = set->capacity - 1;
+    size_t index = (size_t)(((uintptr_t)pointer >> 4) * 0x9E3779B97F4A7C15ULL) & mask;
+    while (set->slots[index] && set->slots[index] != pointer) {
+        index = (index + 1) & mask;
+    }
+    return &set->slots[index];
+}
+
+/**
+ * Adds a pointer to a set, rehashing without tombstones when it fills up.
+ * 
+ * @param set The set
+ * @param pointer The pointer to add
+ */
+static void pointer_set_add(PointerSet* set, void* pointer) {
+    if ((set->used + 1) * 2 > set->capacity) {
+        PointerSet grown = { NULL, set->capacity ? set->capacity : INITIAL_POOL_CAPACITY, 0 };
+        for (size_t i = 0; i < set->capacity; i++) {
+            if (set->slots[i] && set->slots[i] != TOMBSTONE) grown.used++;
+        }
+        while ((grown.used + 1) * 2 > grown.capacity) grown.capacity *= 2;
+        grown.slots = calloc(grown.capacity, sizeof(void*));
+        for (size_t i = 0; i < set->capacity; i++) {
+            if (set->slots[i] && set->slots[i] != TOMBSTONE) {
+                *pointer_set_slot(&grown, set->slots[i]) = set->slots[i];
+            }
+        }
+        free(set->slots);
+        *set = grown;
+    }
+    *pointer_set_slot(set, pointer) = pointer;
+    set->used++;
+}
+
+/**
+ * Removes a pointer from a set if present.
+ * 
+ * @param set The set
+ * @param pointer The pointer to remove
+ */
+static void pointer_set_remove(PointerSet* set, void* pointer) {
+    if (!set->capacity) return;
+    void** slot = pointer_set_slot(set, pointer);
+    if (*slot) *slot = TOMBSTONE;
+}
+
+/**
+ * Creates an empty pool. Between ast_pool_enter() and ast_pool_leave(),
+ * every node and type created on the calling thread is recorded in it, so
+ * the whole tree of a compilation - including nodes and types the passes
+ * create and drop on the way - can be freed at once.
+ * 
+ * @return Newly allocated pool
+ */
+AstPool* ast_pool_create(void) {
+    return calloc(1, sizeof(AstPool));
+}
+
+/**
+ * Makes a pool the calling thread's current pool.
+ * 
+ * @param pool The pool to record into
+ */
+void ast_pool_enter(AstPool* pool) {
+    current_pool = pool;
+}
+
+/**
+ * Stops recording on the calling thread.
+ */
+void ast_pool_leave(void) {
+    current_pool = NULL;
+}
+
+/**
+ * Records a newly created type in the current pool, if any.
+ * 
+ * @param type The type
+ */
+void ast_pool_add_type(Type* type) {
+    if (current_pool) pointer_set_add(&current_pool->types, type);
+}
+
+/**
+ * Drops a type destroyed early from the current pool, if any.
+ * 
+ * @param type The type
+ */
+void ast_pool_remove_type(Type* type) {
+    if (current_pool) pointer_set_remove(&current_pool->types, type);
+}
+
+/**
+ * Frees the memory a node owns: its names, its arrays of children and
+ * parameters, and its attributes. The child nodes themselves are not freed.
+ * 
+ * @param node The AST node
+ */
+static void free_node(AstNode* node) {
+    for (size_t i = 0; i < node->attribute_count; i++) {
+        free(node->attributes[i].name);
+        for (size_t j = 0; j < node->attributes[i].arg_count; j++) {
+            free(node->attributes[i].args[j]);
+        }
+        free(node->attributes[i].args);
+    }
+    free(node->attributes);
+    
+    switch (node->type) {
+        case AST_PROGRAM:
+            free(node->data.program.items);
+            free(node->data.program.struct_index);
+            free(node->data.program.struct_positions);
+            free(node->data.program.function_index);
+            break;
+        case AST_FUNCTION:
+            free(node->data.function.name);
+            for (size_t i = 0; i < node->data.function.param_count; i++) {
+                free(node->data.function.params[i].name);
+            }
+            free(node->data.function.params);
+            break;
+        case AST_STRUCT: {
+            free(node->data.struct_def.name);
+            for (size_t i = 0; i < node->data.struct_def.field_count; i++) {
+                Field* field = &node->data.struct_def.fields[i];
+                free(field->name);
+                for (size_t j = 0; j < field->attribute_count; j++) {
+                    free(field->attributes[j].name);
+                    for (size_t k = 0; k < field->attributes[j].arg_count; k++) {
+                        free(field->attributes[j].args[k]);
+                    }
+                    free(field->attributes[j].args);
+                }
+                free(field->attributes);
+            }
+            free(node->data.struct_def.fields);
+            const StructLayout* layout = node->data.struct_def.layout;
+            if (layout) {
+                free(layout->order);
+                free(layout->offsets);
+                free((StructLayout*)layout);
+            }
+            break;
+        }
+        case AST_IMPL:
+            free(node->data.impl_block.struct_name);
+            free(node->data.impl_block.functions);
+            break;
+        case AST_BLOCK:
+            free(node->data.block.statements);
+            break;
+        case AST_FOR:
+            free(node->data.for_loop.iterator);
+            free(node->data.for_loop.index_name);
+            free(node->data.for_loop.zip_name);
+            break;
+        case AST_LET:
+            free(node->data.let_stmt.name);
+            break;
+        case AST_CALL:
+            free(node->data.call.arguments);
+            break;
+        case AST_FIELD:
+            free(node->data.field.field_name);
+            break;
+        case AST_LITERAL:
+            free(node->data.literal.string_value);
+            break;
+        case AST_IDENTIFIER:
+            free(node->data.identifier.name);
+            break;
+        case AST_STRUCT_LITERAL:
+            free(node->data.struct_literal.struct_name);
+            for (size_t i = 0; i < node->data.struct_literal.field_count; i++) {
+                free(node->data.struct_literal.field_names[i]);
+            }
+            free(node->data.struct_literal.field_names);
+            free(node->data.struct_literal.field_values);
+            break;
+        case AST_ARRAY_LITERAL:
+            free(node->data.array_literal.elements);
+            break;
+        case AST_INCLUDE:
+            free(node->data.include.path);
+            break;
+        case AST_EXTERN_FUNCTION:
+            free(node->data.extern_function.name);
+            for (size_t i = 0; i < node->data.extern_function.param_count; i++) {
+                free(node->data.extern_function.params[i].name);
+            }
+            free(node->data.extern_function.params);
+            break;
+        case AST_CLOSURE:
+            for (size_t i = 0; i < node->data.closure.param_count; i++) {
+                free(node->data.closure.params[i].name);
+            }
+            free(node->data.closure.params);
+            for (size_t i = 0; i < node->data.closure.capture_count; i++) {
+                free(node->data.closure.captures[i]);
+            }
+            free(node->data.closure.captures);
+            free(node->data.closure.capture_types);
+            free(node->data.closure.capture_params);
+            break;
+        case AST_ASM:
+            for (size_t i = 0; i < node->data.asm_stmt.template_count; i++) {
+                free(node->data.asm_stmt.template_parts[i]);
+            }
+            free(node->data.asm_stmt.template_parts);
+            for (size_t i = 0; i < node->data.asm_stmt.operand_count; i++) {
+                free(node->data.asm_stmt.constraints[i]);
+                free(node->data.asm_stmt.names[i]);
+            }
+            free(node->data.asm_stmt.operands);
+            free(node->data.asm_stmt.constraints);
+            free(node->data.asm_stmt.names);
+            for (size_t i = 0; i < node->data.asm_stmt.clobber_count; i++) {
+                free(node->data.asm_stmt.clobbers[i]);
+            }
+            free(node->data.asm_stmt.clobbers);
+            break;
+        default:
+            break;
+    }
+    free(node);
+}
+
+/**
+ * Destroys a pool with every node and type recorded in it.
+ * 
+ * @param pool The pool to destroy
+ */
+void ast_pool_destroy(AstPool* pool) {
+    if (!pool) return;
+    if (current_pool == pool) current_pool = NULL;
+    for (size_t i = 0; i < pool->nodes.capacity; i++) {
+        if (pool->nodes.slots[i] && pool->nodes.slots[i] != TOMBSTONE) {
+            free_node(pool->nodes.slots[i]);
+        }
+    }
+    for (size_t i = 0; i < pool->types.capacity; i++) {
+        if (pool->types.slots[i] && pool->types.slots[i] != TOMBSTONE) {
+            type_destroy(pool->types.slots[i]);
+        }
+    }
+    free(pool->nodes.slots);
+    free(pool->types.slots);
+    free(pool);
+}
 
 /**
  * Creates a new AST node of the specified type.
@@ -13,18 +295,259 @@
 AstNode* ast_create_node(AstNodeType type) {
     AstNode* node = calloc(1, sizeof(AstNode));
     node->type = type;
+    if (current_pool) pointer_set_add(&current_pool->nodes, node);
     return node;
 }
 
 /**
- * Destroys an AST node and frees its memory.
- * Note: This is a shallow destroy - child nodes are not recursively freed.
+ * Destroys an AST node and the memory it owns (names, child arrays,
+ * attributes). Note: This is a shallow destroy - child nodes are not
+ * recursively freed; free a whole tree with an AstPool.
  * 
  * @param node The AST node to destroy
  */
 void ast_destroy(AstNode* node) {
     if (!node) return;
-    free(node);
+    if (current_pool) pointer_set_remove(&current_pool->nodes, node);
+    free_node(node);
+}
+
+/**
+ * Finds an attribute by name in an attribute list.
+ * 
+ * @param attributes The attributes attached to a node or field
+ * @param count Number of attributes
+ * @param name The attribute name to look for (e.g. "repr")
+ * @return The matching attribute, or NULL if not present
+ */
+Attribute* ast_find_attribute(Attribute* attributes, size_t count, const char* name) {
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(attributes[i].name, name) == 0) {
+            return &attributes[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Computes the function index slot a name hashes to (djb2 over the impl
+ * name, "::" and the function name).
+ * 
+ * @param impl_name Struct of the impl block, or NULL for a free function
+ * @param impl_len Length of impl_name
+ * @param name The function name
+ * @param size Number of slots (a power of two)
+ * @return The first slot to probe
+ */
+static size_t function_index_hash(const char* impl_name, size_t impl_len, const char* name, size_t size) {
+    size_t hash = 5381;
+    for (size_t i = 0; impl_name && i < impl_len; i++) {
+        hash = ((hash << 5) + hash) + (unsigned char)impl_name[i];
+    }
+    if (impl_name) hash = ((hash << 5) + hash) + ':';
+    for (const char* c = name; *c; c++) {
+        hash = ((hash << 5) + hash) + (unsigned char)*c;
+    }
+    return hash & (size - 1);
+}
+
+/**
+ * Finds the function index slot of a function, or the empty slot where it
+ * belongs.
+ * 
+ * @param program The program AST node
+ * @param impl_name Struct of the impl block, or NULL for a free function
+ * @param impl_len Length of impl_name
+ * @param name The function name
+ * @return The slot
+ */
+static FunctionIndexEntry* function_index_slot(AstNode* program, const char* impl_name, size_t impl_len, const char* name) {
+    FunctionIndexEntry* index = program->data.program.function_index;
+    size_t size = program->data.program.function_index_size;
+    size_t slot = function_index_hash(impl_name, impl_len, name, size);
+    while (index[slot].function) {
+        const char* entry_impl = index[slot].impl_name;
+        if (strcmp(index[slot].function->data.function.name, name) == 0 &&
+            (entry_impl ? impl_name && strlen(entry_impl) == impl_len && strncmp(entry_impl, impl_name, impl_len) == 0
+                        : !impl_name)) {
+            break;
+        }
+        slot = (slot + 1) & (size - 1);
+    }
+    return &index[slot];
+}
+
+/**
+ * Brings a program's function index up to date with its items. Like the
+ * struct index (see layout_find_struct), it is an open-addressed table
+ * kept at most half full, and the first definition of a name wins.
+ * 
+ * @param program The program AST node
+ */
+static void update_function_index(AstNode* program) {
+    size_t count = program->data.program.count;
+    if (program->data.program.function_indexed_count == count && program->data.program.function_index) return;
+    
+    size_t functions = 0;
+    for (size_t i = 0; i < count; i++) {
+        AstNode* item = program->data.program.items[i];
+        if (item->type == AST_FUNCTION) functions++;
+        if (item->type == AST_IMPL) functions += item->data.impl_block.function_count;
+    }
+    
+    size_t size = 16;
+    while (size < functions * 2 + 2) size *= 2;
+    free(program->data.program.function_index);
+    program->data.program.function_index = calloc(size, sizeof(FunctionIndexEntry));
+    program->data.program.function_index_size = size;
+    
+    for (size_t i = 0; i < count; i++) {
+        AstNode* item = program->data.program.items[i];
+        if (item->type == AST_FUNCTION && item->data.function.name) {
+            FunctionIndexEntry* entry = function_index_slot(program, NULL, 0, item->data.function.name);
+            if (!entry->function) entry->function = item;
+        } else if (item->type == AST_IMPL && item->data.impl_block.struct_name) {
+            const char* impl_name = item->data.impl_block.struct_name;
+            for (size_t j = 0; j < item->data.impl_block.function_count; j++) {
+                AstNode* method = item->data.impl_block.functions[j];
+                if (!method->data.function.name) continue;
+                FunctionIndexEntry* entry = function_index_slot(program, impl_name, strlen(impl_name), method->data.function.name);
+                if (!entry->function) {
+                    entry->impl_name = impl_name;
+                    entry->function = method;
+                }
+            }
+        }
+    }
+    program->data.program.function_indexed_count = count;
+}
+
+/**
+ * Finds a top-level function, or a method of an impl block, by name.
+ * 
+ * @param program The program AST node
+ * @param impl_name Struct of the impl block (need not be NUL-terminated),
+ *                  or NULL for a free function
+ * @param impl_len Length of impl_name
+ * @param name The function name
+ * @return The function AST node, or NULL if not found
+ */
+AstNode* ast_find_function(AstNode* program, const char* impl_name, size_t impl_len, const char* name) {
+    if (!program || !name) return NULL;
+    
+    update_function_index(program);
+    return function_index_slot(program, impl_name, impl_len, name)->function;
+}
+
+/**
+ * Calls a function on every direct child node (statements, expressions and
+ * function bodies) of a node. NULL children are skipped.
+ * 
+ * @param node The parent node
+ * @param callback Function called for each child
+ * @param context Passed through to the callback
+ */
+void ast_for_each_child(AstNode* node, void (*callback)(AstNode* child, void* context), void* context) {
+    if (!node) return;
+    
+    AstNode* children[6] = { NULL, NULL, NULL, NULL, NULL, NULL };
+    AstNode** list = NULL;
+    size_t list_count = 0;
+    
+    switch (node->type) {
+        case AST_PROGRAM:
+            list = node->data.program.items;
+            list_count = node->data.program.count;
+            break;
+        case AST_FUNCTION:
+            children[0] = node->data.function.body;
+            break;
+        case AST_IMPL:
+            list = node->data.impl_block.functions;
+            list_count = node->data.impl_block.function_count;
+            break;
+        case AST_BLOCK:
+            list = node->data.block.statements;
+            list_count = node->data.block.statement_count;
+            children[0] = node->data.block.final_expr;
+            break;
+        case AST_IF:
+            children[0] = node->data.if_stmt.condition;
+            children[1] = node->data.if_stmt.then_branch;
+            children[2] = node->data.if_stmt.else_branch;
+            break;
+        case AST_WHILE:
+            children[0] = node->data.while_loop.condition;
+            children[1] = node->data.while_loop.body;
+            break;
+        case AST_FOR:
+            children[0] = node->data.for_loop.start;
+            children[1] = node->data.for_loop.end;
+            children[2] = node->data.for_loop.body;
+            children[3] = node->data.for_loop.step;
+            children[4] = node->data.for_loop.iterable;
+            children[5] = node->data.for_loop.zip_with;
+            break;
+        case AST_LOOP:
+            children[0] = node->data.loop_stmt.body;
+            break;
+        case AST_RETURN:
+            children[0] = node->data.return_stmt.value;
+            break;
+        case AST_LET:
+            children[0] = node->data.let_stmt.value;
+            break;
+        case AST_BINARY_OP:
+            children[0] = node->data.binary.left;
+            children[1] = node->data.binary.right;
+            break;
+        case AST_UNARY_OP:
+            children[0] = node->data.unary.operand;
+            break;
+        case AST_ASSIGNMENT:
+            children[0] = node->data.assignment.target;
+            children[1] = node->data.assignment.value;
+            break;
+        case AST_CALL:
+            children[0] = node->data.call.function;
+            list = node->data.call.arguments;
+            list_count = node->data.call.argument_count;
+            break;
+        case AST_FIELD:
+            children[0] = node->data.field.object;
+            break;
+        case AST_INDEX:
+            children[0] = node->data.index.array;
+            children[1] = node->data.index.index;
+            break;
+        case AST_STRUCT_LITERAL:
+            list = node->data.struct_literal.field_values;
+            list_count = node->data.struct_literal.field_count;
+            break;
+        case AST_ARRAY_LITERAL:
+            list = node->data.array_literal.elements;
+            list_count = node->data.array_literal.element_count;
+            break;
+        case AST_CAST:
+            children[0] = node->data.cast.expression;
+            break;
+        case AST_CLOSURE:
+            children[0] = node->data.closure.body;
+            break;
+        case AST_ASM:
+            list = node->data.asm_stmt.operands;
+            list_count = node->data.asm_stmt.operand_count;
+            break;
+        default:
+            break;
+    }
+    
+    for (size_t i = 0; i < list_count; i++) {
+        if (list[i]) callback(list[i], context);
+    }
+    for (size_t i = 0; i < sizeof(children) / sizeof(children[0]); i++) {
+        if (children[i]) callback(children[i], context);
+    }
 }
 
 /**
@@ -62,6 +585,8 @@ static const char* ast_type_to_string(AstNodeType type) {
         case AST_INCLUDE: return "Include";
         case AST_EXTERN_FUNCTION: return "ExternFunction";
         case AST_CAST: return "Cast";
+        case AST_CLOSURE: return "Closure";
+        case AST_ASM: return "Asm";
         default: return "Unknown";
     }
 }
@@ -212,13 +737,34 @@ void ast_print(AstNode* node, int indent) {
             break;
             
         case AST_FOR:
-            printf(" '%s' in range\n", node->data.for_loop.iterator);
-            print_indent(indent + 1);
-            printf("Start:\n");
-            ast_print(node->data.for_loop.start, indent + 2);
-            print_indent(indent + 1);
-            printf("End:\n");
-            ast_print(node->data.for_loop.end, indent + 2);
+            if (node->data.for_loop.iterable) {
+                printf(" '%s' in array%s%s\n", node->data.for_loop.iterator,
+                       node->data.for_loop.index_name ? " (enumerated)" : "",
+                       node->data.for_loop.reverse ? " (reversed)" : "");
+                print_indent(indent + 1);
+                printf("Array:\n");
+                ast_print(node->data.for_loop.iterable, indent + 2);
+                if (node->data.for_loop.zip_with) {
+                    print_indent(indent + 1);
+                    printf("Zipped with '%s':\n", node->data.for_loop.zip_name);
+                    ast_print(node->data.for_loop.zip_with, indent + 2);
+                }
+            } else {
+                printf(" '%s' in %srange%s\n", node->data.for_loop.iterator,
+                       node->data.for_loop.inclusive ? "inclusive " : "",
+                       node->data.for_loop.reverse ? " (reversed)" : "");
+                print_indent(indent + 1);
+                printf("Start:\n");
+                ast_print(node->data.for_loop.start, indent + 2);
+                print_indent(indent + 1);
+                printf("End:\n");
+                ast_print(node->data.for_loop.end, indent + 2);
+                if (node->data.for_loop.step) {
+                    print_indent(indent + 1);
+                    printf("Step:\n");
+                    ast_print(node->data.for_loop.step, indent + 2);
+                }
+            }
             print_indent(indent + 1);
             printf("Body:\n");
             ast_print(node->data.for_loop.body, indent + 2);
@@ -277,6 +823,26 @@ void ast_print(AstNode* node, int indent) {
             ast_print(node->data.unary.operand, indent + 1);
             break;
             
+        case AST_CLOSURE:
+            printf(" (");
+            for (size_t i = 0; i < node->data.closure.param_count; i++) {
+                printf("%s%s", i > 0 ? ", " : "", node->data.closure.params[i].name);
+            }
+            printf(")\n");
+            ast_print(node->data.closure.body, indent + 1);
+            break;
+            
+        case AST_ASM:
+            printf(" (%zu outputs, %zu inputs, %zu clobbers)\n", node->data.asm_stmt.output_count,
+                   node->data.asm_stmt.operand_count - node->data.asm_stmt.output_count,
+                   node->data.asm_stmt.clobber_count);
+            for (size_t i = 0; i < node->data.asm_stmt.operand_count; i++) {
+                print_indent(indent + 1);
+                printf("\"%s\":\n", node->data.asm_stmt.constraints[i] ? node->data.asm_stmt.constraints[i] : "");
+                ast_print(node->data.asm_stmt.operands[i], indent + 2);
+            }
+            break;
+            
         case AST_CAST:
             printf(" as ");
             if (node->data.cast.target_type) {
@@ -325,7 +891,7 @@ void ast_print(AstNode* node, int indent) {
                 switch (node->data_type->kind) {
                     case TYPE_I32:
                     case TYPE_I64:
-                        printf(" %"PRId64"\n", node->data.literal.int_value);
+                        printf(" %llu\n", node->data.literal.int_value);
                         break;
                     case TYPE_F32:
                     case TYPE_F64:
@@ -353,7 +919,11 @@ void ast_print(AstNode* node, int indent) {
             break;
             
         case AST_ARRAY_LITERAL:
-            printf(" (%lu elements)\n", (unsigned long)node->data.array_literal.element_count);
+            if (node->data.array_literal.repeat) {
+                printf(" (repeated %lu times)\n", (unsigned long)node->data.array_literal.repeat);
+            } else {
+                printf(" (%lu elements)\n", (unsigned long)node->data.array_literal.element_count);
+            }
             for (size_t i = 0; i < node->data.array_literal.element_count; i++) {
                 ast_print(node->data.array_literal.elements[i], indent + 1);
             }
@@ -31,14 +31,29 @@ typedef enum {
     AST_INCLUDE,
     AST_EXTERN_FUNCTION,
     AST_CAST,
+    AST_CLOSURE,
+    AST_ASM,
 } AstNodeType;
 
 typedef struct Type Type;
 typedef struct AstNode AstNode;
+typedef struct StructLayout StructLayout;
+
+// Attribute such as #[repr(C)]; arguments are kept as written
+typedef struct {
+    char* name;
+    char** args;
+    size_t arg_count;
+    size_t line;
+    size_t column;
+    bool ignored;       // Loop hint the semantic pass warned cannot apply here
+} Attribute;
 
 typedef struct {
     char* name;
     Type* type;
+    Attribute* attributes;
+    size_t attribute_count;
 } Field;
 
 typedef struct {
@@ -51,15 +66,32 @@ typedef struct {
     size_t column;
 } Location;
 
+// Slot of a program's function index (see ast_find_function)
+typedef struct {
+    const char* impl_name;   // Struct of the impl block, NULL for free functions
+    AstNode* function;       // NULL for an empty slot
+} FunctionIndexEntry;
+
 struct AstNode {
     AstNodeType type;
     Location location;
     Type* data_type;
+    Attribute* attributes;
+    size_t attribute_count;
     
     union {
         struct {
             AstNode** items;
             size_t count;
+            // Structs by name, built on first lookup (see layout_find_struct)
+            AstNode** struct_index;
+            size_t* struct_positions;  // Item index of each struct_index slot
+            size_t struct_index_size;
+            size_t indexed_count;
+            // Functions and methods by name, built on first lookup (see ast_find_function)
+            FunctionIndexEntry* function_index;
+            size_t function_index_size;
+            size_t function_indexed_count;
         } program;
         
         struct {
@@ -68,6 +100,7 @@ struct AstNode {
             size_t param_count;
             AstNode* body;
             Type* return_type;
+            bool is_pub;               // Exported from library builds (--emit)
         } function;
         
         struct {
@@ -75,6 +108,8 @@ struct AstNode {
             Field* fields;
             size_t field_count;
             bool is_extern;
+            bool is_pub;                 // Declared in the generated header (--emit=header)
+            const StructLayout* layout;  // Computed on demand by layout.c
         } struct_def;
         
         struct {
@@ -101,10 +136,19 @@ struct AstNode {
         } while_loop;
         
         struct {
-            char* iterator;
+            char* iterator;          // Loop variable, or the element binding over an array
             AstNode* start;
             AstNode* end;
             AstNode* body;
+            AstNode* step;           // (a..b).step_by(step), NULL for 1
+            bool inclusive;          // a..=b
+            bool reverse;            // .rev()
+            AstNode* iterable;       // Array of `for x in arr`, NULL for ranges
+            AstNode* zip_with;       // Second array of a.zip(b)
+            char* index_name;        // i in `for (i, x) in arr.enumerate()`
+            char* zip_name;          // y in `for (x, y) in a.zip(b)`
+            bool iterator_mut;       // for &mut x in arr
+            bool zip_mut;            // for (x, &mut y) in a.zip(b)
         } for_loop;
         
         struct {
@@ -157,7 +201,8 @@ struct AstNode {
         } index;
         
         struct {
-            long long int_value;
+            unsigned long long int_value;   // Low 64 bits; literals are never negative
+            unsigned long long int_high;    // High 64 bits, for u128 / i128 literals
             double float_value;
             char* string_value;
             char char_value;
@@ -166,6 +211,8 @@ struct AstNode {
         
         struct {
             char* name;
+            AstNode* function_value;   // Function or closure a fn-typed name is known to hold
+            size_t param_number;       // 1-based index of the fn-typed parameter it names, or 0
         } identifier;
         
         struct {
@@ -178,6 +225,7 @@ struct AstNode {
         struct {
             AstNode** elements;
             size_t element_count;
+            size_t repeat;           // N of [value; N], whose one element stands for N (0: a list)
         } array_literal;
         
         struct {
@@ -197,11 +245,53 @@ struct AstNode {
             AstNode* expression;
             Type* target_type;
         } cast;
+        
+        // |a: i32, b: i32| a < b, lowered to a static C function taking an
+        // environment of pointers to the captured variables
+        struct {
+            Param* params;
+            size_t param_count;
+            Type* return_type;       // Declared, or inferred from an expression body
+            AstNode* body;           // Block; an expression body is wrapped in a return
+            bool expression_body;
+            char** captures;         // Enclosing variables the body uses, captured by reference
+            Type** capture_types;
+            size_t* capture_params;  // 1-based number of a captured fn parameter, or 0
+            size_t capture_count;
+            size_t scope_level;      // Scope its environment lives in when it captures, else 0
+            size_t id;               // Number of the lifted C function, 0 until emitted
+        } closure;
+        
+        // asm!("template" : "=r"(out) : "r"(in) : "cc"), emitted as GCC extended asm
+        struct {
+            char** template_parts;   // Adjacent string literals, concatenated by the C compiler
+            size_t template_count;
+            AstNode** operands;      // Outputs first, then inputs
+            char** constraints;
+            char** names;            // Symbolic [name] of each operand, or NULL
+            size_t output_count;
+            size_t operand_count;
+            char** clobbers;
+            size_t clobber_count;
+        } asm_stmt;
     } data;
 };
 
 AstNode* ast_create_node(AstNodeType type);
 void ast_destroy(AstNode* node);
+
+// Records the nodes and types a compilation creates so they can be freed
+// together (see ast_pool_create); each thread has its own current pool
+typedef struct AstPool AstPool;
+AstPool* ast_pool_create(void);
+void ast_pool_enter(AstPool* pool);
+void ast_pool_leave(void);
+void ast_pool_destroy(AstPool* pool);
+void ast_pool_add_type(Type* type);
+void ast_pool_remove_type(Type* type);
 void ast_print(AstNode* node, int indent);
+Attribute* ast_find_attribute(Attribute* attributes, size_t count, const char* name);
+AstNode* ast_find_function(AstNode* program, const char* impl_name, size_t impl_len, const char* name);
+void ast_for_each_child(AstNode* node, void (*callback)(AstNode* child, void* context), void* context);
 
 #endif
\ No newline at end of file
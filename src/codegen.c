@@ -1,14 +1,23 @@
 #include "codegen.h"
+#include "layout.h"
 #include "type.h"
 #include "semantic.h"
+#include "utils.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <limits.h>
+#include <stdint.h>
+
+// Indentation stops growing past this depth, so the C for deeply nested
+// blocks stays proportional to the JFM source rather than its depth squared
+#define MAX_INDENT_LEVEL 32
 
 static void generate_node(CodeGenerator* gen, AstNode* node);
 static void generate_expression(CodeGenerator* gen, AstNode* expr);
 static void generate_statement(CodeGenerator* gen, AstNode* stmt);
 static void generate_type(CodeGenerator* gen, Type* type);
+static void generate_converted(CodeGenerator* gen, Type* target, AstNode* value);
 static const char* get_c_type(TypeKind kind);
 
 /**
@@ -32,17 +41,51 @@ CodeGenerator* codegen_create(FILE* output) {
  */
 void codegen_destroy(CodeGenerator* gen) {
     if (gen) {
+        for (size_t i = 0; i < gen->specialisation_count; i++) {
+            free(gen->specialisations[i]->targets);
+            free(gen->specialisations[i]);
+        }
+        free(gen->specialisations);
+        free(gen->thunks);
+        free(gen->wrapper_types);
+        free(gen->wrapper_index);
         free(gen);
     }
 }
 
 /**
- * Writes appropriate indentation based on current indent level.
+ * Switches the generator to hot-reload output. Functions are wrapped in
+ * JFM_HOT_LIB so they can be built as a shared object, and main() calls
+ * them through function pointers rebound from the file named by the manifest.
+ * 
+ * @param gen The code generator instance
+ * @param manifest_path File that holds the path of the current shared object
+ */
+void codegen_enable_hot_reload(CodeGenerator* gen, const char* manifest_path) {
+    gen->hot_reload = true;
+    gen->hot_manifest = manifest_path;
+}
+
+/**
+ * Switches the generator to library output: functions and methods not
+ * declared pub are emitted static, so only the pub ones are exported from
+ * the object file. main() is optional in a library and left as it is.
+ * 
+ * @param gen The code generator instance
+ */
+void codegen_enable_library(CodeGenerator* gen) {
+    gen->library = true;
+}
+
+/**
+ * Writes appropriate indentation based on current indent level,
+ * capped at MAX_INDENT_LEVEL.
  * 
  * @param gen The code generator instance
  */
 void codegen_indent(CodeGenerator* gen) {
-    for (int i = 0; i < gen->indent_level; i++) {
+    int level = gen->indent_level < MAX_INDENT_LEVEL ? gen->indent_level : MAX_INDENT_LEVEL;
+    for (int i = 0; i < level; i++) {
         fprintf(gen->output, "    ");
     }
 }
@@ -89,10 +132,14 @@ static const char* get_c_type(TypeKind kind) {
         case TYPE_I16: return "int16_t";
         case TYPE_I32: return "int32_t";
         case TYPE_I64: return "int64_t";
+        case TYPE_I128: return "jfm_i128";
         case TYPE_U8:  return "uint8_t";
         case TYPE_U16: return "uint16_t";
         case TYPE_U32: return "uint32_t";
         case TYPE_U64: return "uint64_t";
+        case TYPE_U128: return "jfm_u128";
+        case TYPE_F16: return "jfm_f16";
+        case TYPE_BF16: return "jfm_bf16";
         case TYPE_F32: return "float";
         case TYPE_F64: return "double";
         case TYPE_BOOL: return "_Bool";
@@ -103,6 +150,45 @@ static const char* get_c_type(TypeKind kind) {
     }
 }
 
+/**
+ * Writes the part of a C type name that spells out a JFM type, so each
+ * Option / Result instantiation gets a typedef of its own:
+ * Result<&Point, i32> becomes jfm_result_ref_Point_i32.
+ * 
+ * @param gen The code generator instance
+ * @param type The type to spell
+ */
+static void generate_type_suffix(CodeGenerator* gen, Type* type) {
+    switch (type->kind) {
+        case TYPE_ARRAY:
+            codegen_write(gen, "arr%zu_", type->data.array.size);
+            generate_type_suffix(gen, type->data.array.element_type);
+            break;
+        case TYPE_POINTER:
+            codegen_write(gen, "ptr_");
+            generate_type_suffix(gen, type->data.pointer.pointed_type);
+            break;
+        case TYPE_REFERENCE:
+            codegen_write(gen, type->data.reference.is_mutable ? "refmut_" : "ref_");
+            generate_type_suffix(gen, type->data.reference.referenced_type);
+            break;
+        case TYPE_OPTION:
+            codegen_write(gen, "option_");
+            generate_type_suffix(gen, type->data.option.value_type);
+            break;
+        case TYPE_RESULT:
+            codegen_write(gen, "result_");
+            generate_type_suffix(gen, type->data.result.ok_type);
+            codegen_write(gen, "_");
+            generate_type_suffix(gen, type->data.result.err_type);
+            break;
+        default:
+            // Primitive names, struct names and fn
+            codegen_write(gen, "%s", type_to_string(type));
+            break;
+    }
+}
+
 /**
  * Generates C type declaration for any JFM type.
  * Handles arrays, pointers, references, and structs.
@@ -118,6 +204,11 @@ static void generate_type(CodeGenerator* gen, Type* type) {
     
     switch (type->kind) {
         case TYPE_ARRAY:
+            if (layout_soa_struct(gen->program, type)) {
+                codegen_write(gen, "%s_soa_%zu", type->data.array.element_type->data.struct_type.name,
+                             type->data.array.size);
+                break;
+            }
             generate_type(gen, type->data.array.element_type);
             break;
             
@@ -141,6 +232,27 @@ static void generate_type(CodeGenerator* gen, Type* type) {
             codegen_write(gen, "%s", type->data.struct_type.name);
             break;
             
+        case TYPE_FUNCTION:
+            codegen_write(gen, "jfm_fn");
+            break;
+            
+        case TYPE_OPTION:
+            // Payloads with a niche need no is_some flag (see layout_option_niche())
+            if (layout_option_niche(type) == NICHE_NULL) {
+                generate_type(gen, type->data.option.value_type);
+            } else if (layout_option_niche(type) == NICHE_BOOL) {
+                codegen_write(gen, "uint8_t");
+            } else {
+                codegen_write(gen, "jfm_");
+                generate_type_suffix(gen, type);
+            }
+            break;
+            
+        case TYPE_RESULT:
+            codegen_write(gen, "jfm_");
+            generate_type_suffix(gen, type);
+            break;
+            
         default:
             codegen_write(gen, "%s", get_c_type(type->kind));
             break;
@@ -148,224 +260,1504 @@ static void generate_type(CodeGenerator* gen, Type* type) {
 }
 
 /**
- * Generates C code for binary operations.
- * Wraps expressions in parentheses to preserve precedence.
+ * Checks whether a type is an array emitted as a plain C array, i.e. not
+ * an array of a #[soa] struct. References to arrays are looked through.
  * 
  * @param gen The code generator instance
- * @param expr The binary operation AST node
+ * @param type The type to check (may be NULL)
+ * @return true if the type is a plain array
  */
-static void generate_binary_op(CodeGenerator* gen, AstNode* expr) {
-    codegen_write(gen, "(");
-    generate_expression(gen, expr->data.binary.left);
+static bool is_plain_array(CodeGenerator* gen, Type* type) {
+    if (type && type->kind == TYPE_REFERENCE) type = type->data.reference.referenced_type;
+    return type && type->kind == TYPE_ARRAY && !layout_soa_struct(gen->program, type);
+}
+
+/**
+ * Counts the elements of a plain array once nested arrays are flattened:
+ * [[f32; 4]; 3] is emitted as float[12], so rows are contiguous and the
+ * whole matrix is one affine block of memory.
+ * 
+ * @param gen The code generator instance
+ * @param type The array type (references are looked through)
+ * @return Number of innermost elements, or 1 for a non-array type
+ */
+static size_t flat_array_length(CodeGenerator* gen, Type* type) {
+    if (type && type->kind == TYPE_REFERENCE) type = type->data.reference.referenced_type;
     
-    switch (expr->data.binary.op) {
-        case TOKEN_PLUS:          codegen_write(gen, " + "); break;
-        case TOKEN_MINUS:         codegen_write(gen, " - "); break;
-        case TOKEN_STAR:          codegen_write(gen, " * "); break;
-        case TOKEN_SLASH:         codegen_write(gen, " / "); break;
-        case TOKEN_PERCENT:       codegen_write(gen, " %% "); break;
-        case TOKEN_EQ_EQ:         codegen_write(gen, " == "); break;
-        case TOKEN_NOT_EQ:        codegen_write(gen, " != "); break;
-        case TOKEN_LT:            codegen_write(gen, " < "); break;
-        case TOKEN_LT_EQ:         codegen_write(gen, " <= "); break;
-        case TOKEN_GT:            codegen_write(gen, " > "); break;
-        case TOKEN_GT_EQ:         codegen_write(gen, " >= "); break;
-        case TOKEN_AND_AND:       codegen_write(gen, " && "); break;
-        case TOKEN_OR_OR:         codegen_write(gen, " || "); break;
-        case TOKEN_AND:           codegen_write(gen, " & "); break;
-        case TOKEN_OR:            codegen_write(gen, " | "); break;
-        case TOKEN_XOR:           codegen_write(gen, " ^ "); break;
-        case TOKEN_LT_LT:         codegen_write(gen, " << "); break;
-        case TOKEN_GT_GT:         codegen_write(gen, " >> "); break;
-        default:
-            codegen_write(gen, " ? ");
-            break;
+    size_t length = 1;
+    while (is_plain_array(gen, type)) {
+        length *= type->data.array.size;
+        type = type->data.array.element_type;
+    }
+    return length;
+}
+
+/**
+ * Checks whether an index expression selects a row of a flattened
+ * multi-dimensional array rather than a single element.
+ * 
+ * @param gen The code generator instance
+ * @param expr The expression to check
+ * @return true if expr is m[i] with m[i] itself a plain array
+ */
+static bool is_row_index(CodeGenerator* gen, AstNode* expr) {
+    return expr->type == AST_INDEX && is_plain_array(gen, expr->data_type);
+}
+
+/**
+ * Writes the linear offset of an index chain m[i][j]...[k] into the
+ * flattened array: (i) * stride_i + (j) * stride_j + ... + (k).
+ * 
+ * @param gen The code generator instance
+ * @param expr The outermost AST_INDEX node of the chain
+ */
+static void generate_linear_offset(CodeGenerator* gen, AstNode* expr) {
+    AstNode* array = expr->data.index.array;
+    if (is_row_index(gen, array)) {
+        generate_linear_offset(gen, array);
+        codegen_write(gen, " + ");
     }
     
-    generate_expression(gen, expr->data.binary.right);
-    codegen_write(gen, ")");
+    size_t stride = is_plain_array(gen, expr->data_type) ? flat_array_length(gen, expr->data_type) : 1;
+    codegen_write(gen, "(");
+    generate_expression(gen, expr->data.index.index);
+    codegen_write(gen, stride > 1 ? ") * %zu" : ")", stride);
 }
 
 /**
- * Generates C code for unary operations (-, !, &, *).
- * Handles special case where &array becomes just array in C.
+ * Generates an index expression. A chain of indices into a nested array is
+ * lowered to one access into the flattened storage, m[(i) * 4 + (j)], so
+ * the C compiler sees a single affine subscript it can vectorise.
+ * Indexing only the outer dimensions yields a pointer to the row.
  * 
  * @param gen The code generator instance
- * @param expr The unary operation AST node
+ * @param expr The AST_INDEX node
  */
-static void generate_unary_op(CodeGenerator* gen, AstNode* expr) {
-    switch (expr->data.unary.op) {
-        case TOKEN_MINUS:
-            codegen_write(gen, "-");
-            generate_expression(gen, expr->data.unary.operand);
-            break;
-        case TOKEN_NOT:
-            codegen_write(gen, "!");
-            generate_expression(gen, expr->data.unary.operand);
-            break;
-        case TOKEN_AND:
-            if (expr->data.unary.operand->data_type && 
-                expr->data.unary.operand->data_type->kind == TYPE_ARRAY) {
-                generate_expression(gen, expr->data.unary.operand);
-            } else {
-                codegen_write(gen, "&");
-                generate_expression(gen, expr->data.unary.operand);
-            }
-            break;
-        case TOKEN_STAR:
-            codegen_write(gen, "*");
-            generate_expression(gen, expr->data.unary.operand);
-            break;
-        default:
-            generate_expression(gen, expr->data.unary.operand);
-            break;
+static void generate_index(CodeGenerator* gen, AstNode* expr) {
+    AstNode* base = expr;
+    while (is_row_index(gen, base->data.index.array)) {
+        base = base->data.index.array;
+    }
+    
+    bool row = is_row_index(gen, expr);
+    if (base == expr && !row) {
+        generate_expression(gen, expr->data.index.array);
+        codegen_write(gen, "[");
+        generate_expression(gen, expr->data.index.index);
+        codegen_write(gen, "]");
+        return;
     }
+    
+    if (row) codegen_write(gen, "(&");
+    generate_expression(gen, base->data.index.array);
+    codegen_write(gen, "[");
+    generate_linear_offset(gen, expr);
+    codegen_write(gen, "]");
+    if (row) codegen_write(gen, ")");
 }
 
 /**
- * Generates C code for function and method calls.
- * Handles built-in functions (print, println, sqrt) and struct methods.
- * Methods are translated to C-style functions with struct name prefix.
+ * Checks whether an array literal only holds zeros, so that C's {0}
+ * initialises it without writing out every element of a [0; N].
+ * 
+ * @param literal An array literal or one of its elements
+ * @return true if every element is a zero literal
+ */
+static bool is_zero_array(AstNode* literal) {
+    if (literal->type == AST_LITERAL) {
+        Type* type = literal->data_type;
+        if (!type) return false;
+        if (type_is_integral(type)) return literal->data.literal.int_value == 0 && literal->data.literal.int_high == 0;
+        if (type_is_float(type)) return literal->data.literal.float_value == 0.0;
+        if (type->kind == TYPE_BOOL) return !literal->data.literal.bool_value;
+        return false;
+    }
+    if (literal->type != AST_ARRAY_LITERAL) return false;
+    
+    for (size_t i = 0; i < literal->data.array_literal.element_count; i++) {
+        if (!is_zero_array(literal->data.array_literal.elements[i])) return false;
+    }
+    return true;
+}
+
+/**
+ * Writes the elements of an array literal, flattening nested literals so
+ * [[1.0, 2.0], [3.0, 4.0]] initialises the flat storage of a matrix.
  * 
  * @param gen The code generator instance
- * @param expr The call expression AST node
+ * @param literal The AST_ARRAY_LITERAL node
+ * @param element_type Scalar type the elements are stored as, or NULL to keep their own
+ * @param first Whether no element has been written yet
+ * @return Whether no element has been written yet after this literal
  */
-static void generate_call(CodeGenerator* gen, AstNode* expr) {
-    if (expr->data.call.function->type == AST_FIELD) {
-        AstNode* field = expr->data.call.function;
-        Type* obj_type = field->data.field.object->data_type;
-        
-        const char* struct_name = NULL;
-        if (obj_type && obj_type->kind == TYPE_STRUCT) {
-            struct_name = obj_type->data.struct_type.name;
-        }
-        
-        if (struct_name) {
-            codegen_write(gen, "%s_%s(", struct_name, field->data.field.field_name);
-            generate_expression(gen, field->data.field.object);
-            if (expr->data.call.argument_count > 0) {
-                codegen_write(gen, ", ");
-            }
-        } else {
-            codegen_write(gen, "/* ERROR: method call on non-struct */");
-            return;
-        }
-    } else if (expr->data.call.function->type == AST_IDENTIFIER) {
-        const char* func_name = expr->data.call.function->data.identifier.name;
-        
-        if (strcmp(func_name, "println") == 0) {
-            if (expr->data.call.argument_count > 0) {
-                Type* arg_type = expr->data.call.arguments[0]->data_type;
-                if (arg_type) {
-                    if (arg_type->kind == TYPE_STR) {
-                        codegen_write(gen, "printf(\"%%s\\n\", ");
-                    } else if (type_is_integral(arg_type)) {
-                        if (type_is_signed(arg_type)) {
-                            codegen_write(gen, "printf(\"%%lld\\n\", (long long)");
-                        } else {
-                            codegen_write(gen, "printf(\"%%llu\\n\", (unsigned long long)");
-                        }
-                    } else if (arg_type->kind == TYPE_F32 || arg_type->kind == TYPE_F64) {
-                        codegen_write(gen, "printf(\"%%f\\n\", ");
-                    } else if (arg_type->kind == TYPE_BOOL) {
-                        codegen_write(gen, "printf(\"%%s\\n\", ");
-                        generate_expression(gen, expr->data.call.arguments[0]);
-                        codegen_write(gen, " ? \"true\" : \"false\"");
-                        codegen_write(gen, ")");
-                        return;
-                    } else if (arg_type->kind == TYPE_CHAR) {
-                        codegen_write(gen, "printf(\"%%c\\n\", ");
-                    } else {
-                        codegen_write(gen, "printf(\"<unknown>\\n\")");
-                        return;
-                    }
-                    generate_expression(gen, expr->data.call.arguments[0]);
-                    codegen_write(gen, ")");
-                } else {
-                    codegen_write(gen, "printf(\"\\n\")");
-                }
-            } else {
-                codegen_write(gen, "printf(\"\\n\")");
-            }
-            return;
-        } else if (strcmp(func_name, "print") == 0) {
-            if (expr->data.call.argument_count > 0) {
-                Type* arg_type = expr->data.call.arguments[0]->data_type;
-                if (arg_type) {
-                    if (arg_type->kind == TYPE_STR) {
-                        codegen_write(gen, "printf(\"%%s\", ");
-                    } else if (type_is_integral(arg_type)) {
-                        if (type_is_signed(arg_type)) {
-                            codegen_write(gen, "printf(\"%%lld\", (long long)");
-                        } else {
-                            codegen_write(gen, "printf(\"%%llu\", (unsigned long long)");
-                        }
-                    } else if (arg_type->kind == TYPE_F32 || arg_type->kind == TYPE_F64) {
-                        codegen_write(gen, "printf(\"%%f\", ");
-                    } else if (arg_type->kind == TYPE_BOOL) {
-                        codegen_write(gen, "printf(\"%%s\", ");
-                        generate_expression(gen, expr->data.call.arguments[0]);
-                        codegen_write(gen, " ? \"true\" : \"false\"");
-                        codegen_write(gen, ")");
-                        return;
-                    } else if (arg_type->kind == TYPE_CHAR) {
-                        codegen_write(gen, "printf(\"%%c\", ");
-                    } else {
-                        codegen_write(gen, "printf(\"<unknown>\")");
-                        return;
-                    }
-                    generate_expression(gen, expr->data.call.arguments[0]);
-                    codegen_write(gen, ")");
-                }
-            }
-            return;
-        } else if (strcmp(func_name, "sqrt") == 0) {
-            codegen_write(gen, "sqrt(");
-            if (expr->data.call.argument_count > 0) {
-                generate_expression(gen, expr->data.call.arguments[0]);
-            }
-            codegen_write(gen, ")");
-            return;
+static bool generate_array_elements(CodeGenerator* gen, AstNode* literal, Type* element_type, bool first) {
+    size_t repeat = literal->data.array_literal.repeat;
+    size_t count = repeat ? repeat : literal->data.array_literal.element_count;
+    for (size_t i = 0; i < count; i++) {
+        AstNode* element = literal->data.array_literal.elements[repeat ? 0 : i];
+        if (element->type == AST_ARRAY_LITERAL) {
+            first = generate_array_elements(gen, element, element_type, first);
+            continue;
         }
-        
-        generate_expression(gen, expr->data.call.function);
-        codegen_write(gen, "(");
-    } else {
-        generate_expression(gen, expr->data.call.function);
-        codegen_write(gen, "(");
+        if (!first) codegen_write(gen, ", ");
+        generate_converted(gen, element_type, element);
+        first = false;
     }
-    
-    for (size_t i = 0; i < expr->data.call.argument_count; i++) {
-        if (i > 0) codegen_write(gen, ", ");
-        generate_expression(gen, expr->data.call.arguments[i]);
+    return first;
+}
+
+/**
+ * Generates an operand of an arithmetic operation, comparison, cast or
+ * print. f16 and bf16 are storage formats: their values are widened to
+ * the f32 they are computed in.
+ * 
+ * @param gen The code generator instance
+ * @param expr The operand expression
+ */
+static void generate_operand(CodeGenerator* gen, AstNode* expr) {
+    if (!type_is_half(expr->data_type)) {
+        generate_expression(gen, expr);
+        return;
     }
     
+    codegen_write(gen, "jfm_%s_to_f32(", type_to_string(expr->data_type));
+    generate_expression(gen, expr);
     codegen_write(gen, ")");
 }
 
 /**
- * Main expression generation dispatcher.
- * Routes to appropriate generator based on expression type.
+ * Writes an Option holding None. Payloads with a niche encode it in the
+ * payload itself (see layout_option_niche()).
  * 
  * @param gen The code generator instance
- * @param expr The expression AST node
+ * @param type The Option type
  */
-static void generate_expression(CodeGenerator* gen, AstNode* expr) {
-    if (!expr) return;
-    
-    switch (expr->type) {
-        case AST_LITERAL:
-            if (expr->data_type) {
-                switch (expr->data_type->kind) {
-                    case TYPE_I8:
-                    case TYPE_I16:
-                    case TYPE_I32:
-                    case TYPE_I64:
-                    case TYPE_U8:
-                    case TYPE_U16:
-                    case TYPE_U32:
+static void generate_none(CodeGenerator* gen, Type* type) {
+    switch (layout_option_niche(type)) {
+        case NICHE_NULL:
+            codegen_write(gen, "NULL");
+            break;
+        case NICHE_BOOL:
+            codegen_write(gen, "(uint8_t)2");
+            break;
+        default:
+            codegen_write(gen, "(");
+            generate_type(gen, type);
+            codegen_write(gen, "){ .is_some = 0 }");
+            break;
+    }
+}
+
+/**
+ * Writes the start of Some(v), Ok(v) or Err(e) for an Option or Result
+ * type; the payload follows and generate_wrapper_close() ends it.
+ * 
+ * @param gen The code generator instance
+ * @param type The Option or Result type
+ * @param is_err Whether the Result holds an Err
+ */
+static void generate_wrapper_open(CodeGenerator* gen, Type* type, bool is_err) {
+    if (type->kind == TYPE_OPTION && layout_option_niche(type) != NICHE_NONE) {
+        codegen_write(gen, layout_option_niche(type) == NICHE_BOOL ? "(uint8_t)(" : "(");
+        return;
+    }
+    
+    codegen_write(gen, "(");
+    generate_type(gen, type);
+    codegen_write(gen, type->kind == TYPE_OPTION ? "){ .value = " : is_err ? "){ .err = " : "){ .ok = ");
+}
+
+/**
+ * Writes the end of a value started by generate_wrapper_open().
+ * 
+ * @param gen The code generator instance
+ * @param type The Option or Result type
+ * @param is_err Whether the Result holds an Err
+ */
+static void generate_wrapper_close(CodeGenerator* gen, Type* type, bool is_err) {
+    if (type->kind == TYPE_RESULT) {
+        codegen_write(gen, is_err ? ", .is_ok = 0 }" : ", .is_ok = 1 }");
+    } else if (layout_option_niche(type) == NICHE_NONE) {
+        codegen_write(gen, ", .is_some = 1 }");
+    } else {
+        codegen_write(gen, ")");
+    }
+}
+
+/**
+ * Writes the test of whether the Option or Result held in a C variable
+ * is Some / Ok.
+ * 
+ * @param gen The code generator instance
+ * @param type The Option or Result type
+ * @param name The C variable
+ */
+static void generate_wrapper_test(CodeGenerator* gen, Type* type, const char* name) {
+    if (type->kind == TYPE_RESULT) {
+        codegen_write(gen, "%s.is_ok", name);
+        return;
+    }
+    
+    switch (layout_option_niche(type)) {
+        case NICHE_NULL:
+            codegen_write(gen, "(%s != NULL)", name);
+            break;
+        case NICHE_BOOL:
+            codegen_write(gen, "(%s != 2)", name);
+            break;
+        default:
+            codegen_write(gen, "%s.is_some", name);
+            break;
+    }
+}
+
+/**
+ * Writes the payload of the Option or Result held in a C variable.
+ * 
+ * @param gen The code generator instance
+ * @param type The Option or Result type
+ * @param name The C variable
+ * @param is_err Whether to read the Err of a Result rather than its Ok
+ */
+static void generate_wrapper_payload(CodeGenerator* gen, Type* type, const char* name, bool is_err) {
+    if (type->kind == TYPE_RESULT) {
+        codegen_write(gen, "%s.%s", name, is_err ? "err" : "ok");
+        return;
+    }
+    
+    switch (layout_option_niche(type)) {
+        case NICHE_NULL:
+            codegen_write(gen, "%s", name);
+            break;
+        case NICHE_BOOL:
+            codegen_write(gen, "(_Bool)%s", name);
+            break;
+        default:
+            codegen_write(gen, "%s.value", name);
+            break;
+    }
+}
+
+/**
+ * Opens a statement expression holding an Option or Result in a fresh
+ * temporary, so methods and `?` evaluate it once. The caller writes the
+ * rest and closes it with "; })".
+ * 
+ * @param gen The code generator instance
+ * @param type The Option or Result type
+ * @param value The expression to hold
+ * @param dereference Whether value is a reference or pointer to it
+ * @param name Receives the name of the temporary
+ * @param size Size of the name buffer
+ */
+static void generate_wrapper_temp(CodeGenerator* gen, Type* type, AstNode* value, bool dereference,
+                                  char* name, size_t size) {
+    snprintf(name, size, "jfm_wrap%zu", gen->wrapper_temp_count++);
+    codegen_write(gen, "__extension__ ({ ");
+    generate_type(gen, type);
+    codegen_write(gen, " %s = %s", name, dereference ? "*(" : "");
+    generate_expression(gen, value);
+    codegen_write(gen, "%s; ", dereference ? ")" : "");
+}
+
+/**
+ * Recognises a call to the Some, Ok or Err constructors.
+ * 
+ * @param expr The expression to check
+ * @return The constructor name, or NULL if expr is not one
+ */
+static const char* wrapper_constructor(AstNode* expr) {
+    if (expr->type != AST_CALL || expr->data.call.function->type != AST_IDENTIFIER || !expr->data_type ||
+        (expr->data_type->kind != TYPE_OPTION && expr->data_type->kind != TYPE_RESULT)) {
+        return NULL;
+    }
+    
+    const char* name = expr->data.call.function->data.identifier.name;
+    bool constructor = strcmp(name, "Some") == 0 || strcmp(name, "Ok") == 0 || strcmp(name, "Err") == 0;
+    return constructor ? name : NULL;
+}
+
+/**
+ * Checks whether an expression is None.
+ * 
+ * @param expr The expression to check
+ * @return true for the None literal
+ */
+static bool is_none(AstNode* expr) {
+    return expr->type == AST_IDENTIFIER && strcmp(expr->data.identifier.name, "None") == 0 &&
+           expr->data_type && expr->data_type->kind == TYPE_OPTION && !expr->data_type->data.option.value_type;
+}
+
+/**
+ * Checks whether the payload types of an Option or Result are all known,
+ * i.e. it is not the type of None, Ok(v) or Err(e) on their own.
+ * 
+ * @param type The Option or Result type
+ * @return true if the type can be emitted
+ */
+static bool wrapper_is_complete(Type* type) {
+    if (type->kind == TYPE_OPTION) return type->data.option.value_type != NULL;
+    return type->data.result.ok_type && type->data.result.err_type;
+}
+
+/**
+ * Generates a value stored into an Option or Result location. Some(v),
+ * Ok(v), Err(e) and None take their layout from the destination, whose
+ * payload types they may leave open; values of another instantiation,
+ * e.g. an Option<i32> stored as an Option<i64>, are rebuilt.
+ * 
+ * @param gen The code generator instance
+ * @param target The Option or Result type of the destination
+ * @param value The stored expression
+ */
+static void generate_wrapped(CodeGenerator* gen, Type* target, AstNode* value) {
+    const char* constructor = wrapper_constructor(value);
+    if (constructor) {
+        bool is_err = constructor[0] == 'E';
+        Type* payload_type = target->kind == TYPE_OPTION ? target->data.option.value_type :
+                             is_err ? target->data.result.err_type : target->data.result.ok_type;
+        generate_wrapper_open(gen, target, is_err);
+        generate_converted(gen, payload_type, value->data.call.arguments[0]);
+        generate_wrapper_close(gen, target, is_err);
+        return;
+    }
+    if (is_none(value)) {
+        generate_none(gen, target);
+        return;
+    }
+    
+    Type* source = value->data_type;
+    if (!source || types_equal(target, source)) {
+        generate_expression(gen, value);
+        return;
+    }
+    
+    char name[32];
+    generate_wrapper_temp(gen, source, value, false, name, sizeof(name));
+    generate_wrapper_test(gen, source, name);
+    codegen_write(gen, " ? ");
+    generate_wrapper_open(gen, target, false);
+    generate_wrapper_payload(gen, source, name, false);
+    generate_wrapper_close(gen, target, false);
+    codegen_write(gen, " : ");
+    if (target->kind == TYPE_OPTION) {
+        generate_none(gen, target);
+    } else {
+        generate_wrapper_open(gen, target, true);
+        generate_wrapper_payload(gen, source, name, true);
+        generate_wrapper_close(gen, target, true);
+    }
+    codegen_write(gen, "; })");
+}
+
+/**
+ * Generates the built-in methods of Option and Result. unwrap() and
+ * unwrap_err() abort the program when the value holds the other variant.
+ * 
+ * @param gen The code generator instance
+ * @param expr The method call expression
+ * @param type The Option or Result type of the receiver
+ */
+static void generate_wrapper_method(CodeGenerator* gen, AstNode* expr, Type* type) {
+    AstNode* receiver = expr->data.call.function->data.field.object;
+    const char* method = expr->data.call.function->data.field.field_name;
+    char name[32];
+    
+    generate_wrapper_temp(gen, type, receiver, receiver->data_type != type, name, sizeof(name));
+    if (strncmp(method, "is_", 3) == 0) {
+        if (strcmp(method, "is_none") == 0 || strcmp(method, "is_err") == 0) codegen_write(gen, "!");
+        generate_wrapper_test(gen, type, name);
+    } else if (strcmp(method, "unwrap_or") == 0) {
+        Type* value_type = type->kind == TYPE_OPTION ? type->data.option.value_type : type->data.result.ok_type;
+        generate_wrapper_test(gen, type, name);
+        codegen_write(gen, " ? ");
+        generate_wrapper_payload(gen, type, name, false);
+        codegen_write(gen, " : ");
+        generate_converted(gen, value_type, expr->data.call.arguments[0]);
+    } else {
+        bool is_err = strcmp(method, "unwrap_err") == 0;
+        codegen_write(gen, "if (%s", is_err ? "" : "!");
+        generate_wrapper_test(gen, type, name);
+        codegen_write(gen, ") jfm_unwrap_failed(\"%s() called on %s\"); ", method,
+                      is_err ? "Ok" : type->kind == TYPE_OPTION ? "None" : "Err");
+        generate_wrapper_payload(gen, type, name, is_err);
+    }
+    codegen_write(gen, "; })");
+}
+
+/**
+ * Generates the `?` operator: the payload of an Some / Ok, or an early
+ * return of None / the Err converted to the function's return type.
+ * 
+ * @param gen The code generator instance
+ * @param expr The `?` unary operation node
+ */
+static void generate_try(CodeGenerator* gen, AstNode* expr) {
+    Type* type = expr->data.unary.operand->data_type;
+    char name[32];
+    
+    generate_wrapper_temp(gen, type, expr->data.unary.operand, false, name, sizeof(name));
+    codegen_write(gen, "if (!");
+    generate_wrapper_test(gen, type, name);
+    codegen_write(gen, ") return ");
+    if (type->kind == TYPE_OPTION) {
+        generate_none(gen, gen->return_type);
+    } else {
+        generate_wrapper_open(gen, gen->return_type, true);
+        generate_wrapper_payload(gen, type, name, true);
+        generate_wrapper_close(gen, gen->return_type, true);
+    }
+    codegen_write(gen, "; ");
+    generate_wrapper_payload(gen, type, name, false);
+    codegen_write(gen, "; })");
+}
+
+/**
+ * Generates a value stored into a location of the given type, narrowing
+ * floats into f16 / bf16 storage and widening them back out of it.
+ * Array literals convert element by element, and Option / Result values
+ * take the destination's layout.
+ * 
+ * @param gen The code generator instance
+ * @param target Type of the destination, or NULL to keep the value's own
+ * @param value The stored expression
+ */
+static void generate_converted(CodeGenerator* gen, Type* target, AstNode* value) {
+    if (target && target->kind == TYPE_ARRAY && value->type == AST_ARRAY_LITERAL) {
+        Type* element_type = target;
+        while (element_type->kind == TYPE_ARRAY) element_type = element_type->data.array.element_type;
+        if (is_zero_array(value)) {
+            codegen_write(gen, "{0}");
+            return;
+        }
+        codegen_write(gen, "{");
+        generate_array_elements(gen, value, element_type, true);
+        codegen_write(gen, "}");
+        return;
+    }
+    if (target && (target->kind == TYPE_OPTION || target->kind == TYPE_RESULT)) {
+        generate_wrapped(gen, target, value);
+        return;
+    }
+    
+    Type* source = value->data_type;
+    if (!target || !source || target->kind == source->kind ||
+        (!type_is_half(target) && !type_is_half(source))) {
+        generate_expression(gen, value);
+        return;
+    }
+    
+    if (type_is_half(target)) {
+        codegen_write(gen, "jfm_f32_to_%s(", type_to_string(target));
+        generate_operand(gen, value);
+        codegen_write(gen, ")");
+    } else {
+        generate_operand(gen, value);
+    }
+}
+
+/**
+ * Finds the declared type of a struct field.
+ * 
+ * @param gen The code generator instance
+ * @param struct_name Name of the struct
+ * @param field_name Name of the field
+ * @return The field type, or NULL if the struct or field is unknown
+ */
+static Type* struct_field_type(CodeGenerator* gen, const char* struct_name, const char* field_name) {
+    AstNode* struct_def = layout_find_struct(gen->program, struct_name);
+    if (!struct_def) return NULL;
+    
+    for (size_t i = 0; i < struct_def->data.struct_def.field_count; i++) {
+        if (strcmp(struct_def->data.struct_def.fields[i].name, field_name) == 0) {
+            return struct_def->data.struct_def.fields[i].type;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Checks whether a C function name refers to a JFM function that lives in
+ * the hot-reloadable shared object (any function or method except main).
+ * 
+ * @param gen The code generator instance
+ * @param c_name The C-level function name (StructName_method for methods)
+ * @return true if calls from main() must go through the hot-reload table
+ */
+static bool is_hot_function(CodeGenerator* gen, const char* c_name) {
+    if (!gen->program || strcmp(c_name, "main") == 0) return false;
+    
+    for (size_t i = 0; i < gen->program->data.program.count; i++) {
+        AstNode* item = gen->program->data.program.items[i];
+        if (item->type == AST_FUNCTION) {
+            if (strcmp(item->data.function.name, c_name) == 0) return true;
+        } else if (item->type == AST_IMPL) {
+            size_t prefix_len = strlen(item->data.impl_block.struct_name);
+            if (strncmp(c_name, item->data.impl_block.struct_name, prefix_len) != 0 ||
+                c_name[prefix_len] != '_') {
+                continue;
+            }
+            for (size_t j = 0; j < item->data.impl_block.function_count; j++) {
+                if (strcmp(item->data.impl_block.functions[j]->data.function.name, c_name + prefix_len + 1) == 0) {
+                    return true;
+                }
+            }
+        }
+    }
+    
+    return false;
+}
+
+/**
+ * Writes the callee name of a direct call, translating Type::method to
+ * Type_method and routing calls made from main() in hot-reload mode
+ * through the jfm_hot_ function pointer table.
+ * 
+ * @param gen The code generator instance
+ * @param name The JFM-level function name
+ */
+static void generate_function_name(CodeGenerator* gen, const char* name) {
+    char* c_name = malloc(strlen(name) + 1);
+    const char* coloncolon = strstr(name, "::");
+    if (coloncolon) {
+        size_t prefix_len = coloncolon - name;
+        memcpy(c_name, name, prefix_len);
+        c_name[prefix_len] = '_';
+        strcpy(c_name + prefix_len + 1, coloncolon + 2);
+    } else {
+        strcpy(c_name, name);
+    }
+    
+    if (gen->in_hot_host && is_hot_function(gen, c_name)) {
+        codegen_write(gen, "jfm_hot_%s", c_name);
+    } else {
+        codegen_write(gen, "%s", c_name);
+    }
+    free(c_name);
+}
+
+/**
+ * Generates C code for binary operations.
+ * Wraps expressions in parentheses to preserve precedence.
+ * 
+ * @param gen The code generator instance
+ * @param expr The binary operation AST node
+ */
+static void generate_binary_op(CodeGenerator* gen, AstNode* expr) {
+    codegen_write(gen, "(");
+    generate_operand(gen, expr->data.binary.left);
+    
+    switch (expr->data.binary.op) {
+        case TOKEN_PLUS:          codegen_write(gen, " + "); break;
+        case TOKEN_MINUS:         codegen_write(gen, " - "); break;
+        case TOKEN_STAR:          codegen_write(gen, " * "); break;
+        case TOKEN_SLASH:         codegen_write(gen, " / "); break;
+        case TOKEN_PERCENT:       codegen_write(gen, " %% "); break;
+        case TOKEN_EQ_EQ:         codegen_write(gen, " == "); break;
+        case TOKEN_NOT_EQ:        codegen_write(gen, " != "); break;
+        case TOKEN_LT:            codegen_write(gen, " < "); break;
+        case TOKEN_LT_EQ:         codegen_write(gen, " <= "); break;
+        case TOKEN_GT:            codegen_write(gen, " > "); break;
+        case TOKEN_GT_EQ:         codegen_write(gen, " >= "); break;
+        case TOKEN_AND_AND:       codegen_write(gen, " && "); break;
+        case TOKEN_OR_OR:         codegen_write(gen, " || "); break;
+        case TOKEN_AND:           codegen_write(gen, " & "); break;
+        case TOKEN_OR:            codegen_write(gen, " | "); break;
+        case TOKEN_XOR:           codegen_write(gen, " ^ "); break;
+        case TOKEN_LT_LT:         codegen_write(gen, " << "); break;
+        case TOKEN_GT_GT:         codegen_write(gen, " >> "); break;
+        default:
+            codegen_write(gen, " ? ");
+            break;
+    }
+    
+    generate_operand(gen, expr->data.binary.right);
+    codegen_write(gen, ")");
+}
+
+/**
+ * Generates C code for unary operations (-, !, &, *).
+ * Handles special case where &array becomes just array in C.
+ * 
+ * @param gen The code generator instance
+ * @param expr The unary operation AST node
+ */
+static void generate_unary_op(CodeGenerator* gen, AstNode* expr) {
+    switch (expr->data.unary.op) {
+        case TOKEN_MINUS:
+            codegen_write(gen, "-");
+            generate_operand(gen, expr->data.unary.operand);
+            break;
+        case TOKEN_NOT:
+            codegen_write(gen, "!");
+            generate_expression(gen, expr->data.unary.operand);
+            break;
+        case TOKEN_AND:
+            if (expr->data.unary.operand->data_type && 
+                expr->data.unary.operand->data_type->kind == TYPE_ARRAY &&
+                !layout_soa_struct(gen->program, expr->data.unary.operand->data_type)) {
+                generate_expression(gen, expr->data.unary.operand);
+            } else {
+                codegen_write(gen, "&");
+                generate_expression(gen, expr->data.unary.operand);
+            }
+            break;
+        case TOKEN_STAR:
+            codegen_write(gen, "*");
+            generate_expression(gen, expr->data.unary.operand);
+            break;
+        case TOKEN_QUESTION:
+            generate_try(gen, expr);
+            break;
+        default:
+            generate_expression(gen, expr->data.unary.operand);
+            break;
+    }
+}
+
+/**
+ * Finds the function a fn-typed parameter of the clone being generated is
+ * bound to.
+ * 
+ * @param gen The code generator instance
+ * @param func The function the parameter belongs to
+ * @param index Parameter index
+ * @return The bound function, or NULL if the parameter is a run-time value
+ */
+static StaticFunction* bound_parameter(CodeGenerator* gen, AstNode* func, size_t index) {
+    Specialisation* spec = gen->current_specialisation;
+    if (!spec || spec->function != func) return NULL;
+    
+    StaticFunction* target = &spec->targets[index];
+    return target->function || target->closure ? target : NULL;
+}
+
+/**
+ * Checks whether a known function needs an environment pointer at run
+ * time, i.e. whether it is a closure that captures variables.
+ * 
+ * @param target The known function
+ * @return true if calls must pass an environment
+ */
+static bool needs_environment(StaticFunction* target) {
+    return target->closure && target->closure->data.closure.capture_count > 0;
+}
+
+/**
+ * Resolves a fn-typed expression to the function it is known to hold: a
+ * closure written in place, a function named directly or through an
+ * immutable variable, or a parameter bound in the clone being generated.
+ * 
+ * @param gen The code generator instance
+ * @param expr The expression
+ * @param target Output: the known function
+ * @return true if the function is known at compile time
+ */
+static bool resolve_static_function(CodeGenerator* gen, AstNode* expr, StaticFunction* target) {
+    memset(target, 0, sizeof(*target));
+    if (!expr) return false;
+    
+    if (expr->type == AST_CLOSURE) {
+        target->closure = expr;
+        target->source = expr;
+        return true;
+    }
+    if (expr->type != AST_IDENTIFIER) return false;
+    
+    size_t number = expr->data.identifier.param_number;
+    if (number > 0) {
+        Specialisation* spec = gen->current_specialisation;
+        StaticFunction* bound = spec ? bound_parameter(gen, spec->function, number - 1) : NULL;
+        if (!bound) return false;
+        target->function = bound->function;
+        target->closure = bound->closure;
+        target->env_param = spec->function->data.function.params[number - 1].name;
+        return true;
+    }
+    
+    AstNode* value = expr->data.identifier.function_value;
+    if (!value) return false;
+    if (value->type == AST_FUNCTION) {
+        target->function = value;
+    } else {
+        target->closure = value;
+        target->source = expr;
+    }
+    return true;
+}
+
+/**
+ * Checks whether an identifier in value position is emitted as a constant
+ * fn value: a function named directly, or a bound parameter of a clone.
+ * 
+ * @param gen The code generator instance
+ * @param ident The identifier
+ * @param target Output: the function it stands for
+ * @return true if the identifier does not name a C variable
+ */
+static bool static_value_of(CodeGenerator* gen, AstNode* ident, StaticFunction* target) {
+    if (!ident->data_type || ident->data_type->kind != TYPE_FUNCTION) return false;
+    
+    if (ident->data.identifier.param_number > 0) {
+        return gen->current_specialisation && resolve_static_function(gen, ident, target);
+    }
+    
+    AstNode* func = ident->data.identifier.function_value;
+    if (!func || func->type != AST_FUNCTION || strcmp(func->data.function.name, ident->data.identifier.name) != 0) {
+        return false;
+    }
+    memset(target, 0, sizeof(*target));
+    target->function = func;
+    return true;
+}
+
+/**
+ * Finds the JFM function or method a call resolves to. Extern functions
+ * and builtins have no definition and keep the C calling convention.
+ * 
+ * @param gen The code generator instance
+ * @param call The call expression AST node
+ * @return The function AST node, or NULL
+ */
+static AstNode* find_callee(CodeGenerator* gen, AstNode* call) {
+    AstNode* callee = call->data.call.function;
+    const char* struct_name = NULL;
+    const char* name = NULL;
+    size_t struct_len = 0;
+    
+    if (callee->type == AST_FIELD) {
+        Type* object_type = callee->data.field.object->data_type;
+        if (!object_type || object_type->kind != TYPE_STRUCT) return NULL;
+        struct_name = object_type->data.struct_type.name;
+        struct_len = strlen(struct_name);
+        name = callee->data.field.field_name;
+    } else if (callee->type == AST_IDENTIFIER) {
+        // A call through a fn value has a JFM callee only when it is known
+        if (callee->data_type && callee->data_type->kind == TYPE_FUNCTION) {
+            StaticFunction target;
+            return resolve_static_function(gen, callee, &target) ? target.function : NULL;
+        }
+        name = callee->data.identifier.name;
+        const char* coloncolon = strstr(name, "::");
+        if (coloncolon) {
+            struct_name = name;
+            struct_len = coloncolon - name;
+            name = coloncolon + 2;
+        }
+    } else {
+        return NULL;
+    }
+    
+    return ast_find_function(gen->program, struct_name, struct_len, name);
+}
+
+/**
+ * Generates one call argument. A struct parameter passed by hidden
+ * reference receives the address of an lvalue argument, or of a
+ * compound-literal copy of any other value.
+ * 
+ * @param gen The code generator instance
+ * @param callee The called function, or NULL for extern functions
+ * @param index Parameter index in the callee
+ * @param arg The argument expression
+ */
+static void generate_argument(CodeGenerator* gen, AstNode* callee, size_t index, AstNode* arg) {
+    if (!callee || index >= callee->data.function.param_count) {
+        generate_expression(gen, arg);
+        return;
+    }
+    if (!layout_passes_by_reference(gen->program, callee, index)) {
+        generate_converted(gen, callee->data.function.params[index].type, arg);
+        return;
+    }
+    
+    bool lvalue = arg->type == AST_IDENTIFIER || arg->type == AST_FIELD || arg->type == AST_INDEX ||
+                  (arg->type == AST_UNARY_OP && arg->data.unary.op == TOKEN_STAR);
+    if (lvalue) {
+        codegen_write(gen, "&");
+        generate_expression(gen, arg);
+    } else {
+        codegen_write(gen, "(const ");
+        generate_type(gen, callee->data.function.params[index].type);
+        codegen_write(gen, "[]){");
+        generate_expression(gen, arg);
+        codegen_write(gen, "}");
+    }
+}
+
+/**
+ * Writes the C type of a parameter in the closure calling convention,
+ * where plain arrays are passed as a const pointer to their first element.
+ * 
+ * @param gen The code generator instance
+ * @param type The parameter type
+ */
+static void generate_parameter_type(CodeGenerator* gen, Type* type) {
+    bool array = type && type->kind == TYPE_ARRAY && is_plain_array(gen, type);
+    if (array) codegen_write(gen, "const ");
+    generate_type(gen, type);
+    if (array) codegen_write(gen, "*");
+}
+
+/**
+ * Writes the environment of a closure value: a compound literal holding
+ * the address of every captured variable, or NULL if it captures nothing.
+ * The literal lives until the end of the enclosing block, which is why a
+ * capturing closure may not be returned.
+ * 
+ * @param gen The code generator instance
+ * @param closure The closure AST node
+ */
+static void generate_closure_environment(CodeGenerator* gen, AstNode* closure) {
+    if (closure->data.closure.capture_count == 0) {
+        codegen_write(gen, "NULL");
+        return;
+    }
+    
+    codegen_write(gen, "&(jfm_env%zu){ ", closure->data.closure.id);
+    for (size_t i = 0; i < closure->data.closure.capture_count; i++) {
+        Type* type = closure->data.closure.capture_types[i];
+        AstNode variable = { .type = AST_IDENTIFIER, .data_type = type };
+        variable.data.identifier.name = closure->data.closure.captures[i];
+        variable.data.identifier.param_number = closure->data.closure.capture_params[i];
+        
+        if (i > 0) codegen_write(gen, ", ");
+        codegen_write(gen, "(");
+        generate_type(gen, type);
+        codegen_write(gen, type->kind == TYPE_ARRAY && is_plain_array(gen, type) ? "*)" : "*)&");
+        generate_expression(gen, &variable);
+    }
+    codegen_write(gen, " }");
+}
+
+/**
+ * Writes the environment pointer to pass to a known closure.
+ * 
+ * @param gen The code generator instance
+ * @param target The known function
+ */
+static void generate_static_environment(CodeGenerator* gen, StaticFunction* target) {
+    if (!needs_environment(target)) {
+        codegen_write(gen, "NULL");
+    } else if (target->env_param) {
+        codegen_write(gen, "jfm_env_%s", target->env_param);
+    } else if (target->source->type == AST_CLOSURE) {
+        generate_closure_environment(gen, target->closure);
+    } else {
+        codegen_write(gen, "(");
+        generate_expression(gen, target->source);
+        codegen_write(gen, ").env");
+    }
+}
+
+/**
+ * Writes a jfm_fn value for a function known at compile time. Named
+ * functions are reached through their thunk.
+ * 
+ * @param gen The code generator instance
+ * @param target The known function
+ */
+static void generate_static_value(CodeGenerator* gen, StaticFunction* target) {
+    if (target->function) {
+        codegen_write(gen, "(jfm_fn){ (void (*)(void))jfm_fn_%s, NULL }", target->function->data.function.name);
+        return;
+    }
+    
+    codegen_write(gen, "(jfm_fn){ (void (*)(void))jfm_closure%zu, ", target->closure->data.closure.id);
+    generate_static_environment(gen, target);
+    codegen_write(gen, " }");
+}
+
+/**
+ * Generates a call through a fn value that is only known at run time:
+ * the code pointer is cast to the closure calling convention and called
+ * with the environment first.
+ * 
+ * @param gen The code generator instance
+ * @param expr The call expression AST node
+ */
+static void generate_dynamic_call(CodeGenerator* gen, AstNode* expr) {
+    AstNode* callee = expr->data.call.function;
+    Type* fn_type = callee->data_type;
+    
+    codegen_write(gen, "((");
+    generate_type(gen, fn_type->data.function.return_type);
+    codegen_write(gen, " (*)(void*");
+    for (size_t i = 0; i < fn_type->data.function.param_count; i++) {
+        codegen_write(gen, ", ");
+        generate_parameter_type(gen, fn_type->data.function.param_types[i]);
+    }
+    codegen_write(gen, "))(");
+    generate_expression(gen, callee);
+    codegen_write(gen, ").code)((");
+    generate_expression(gen, callee);
+    codegen_write(gen, ").env");
+    
+    for (size_t i = 0; i < expr->data.call.argument_count; i++) {
+        codegen_write(gen, ", ");
+        generate_converted(gen, i < fn_type->data.function.param_count ? fn_type->data.function.param_types[i] : NULL,
+                           expr->data.call.arguments[i]);
+    }
+    codegen_write(gen, ")");
+}
+
+/**
+ * Generates a direct call to a known closure's lifted C function.
+ * 
+ * @param gen The code generator instance
+ * @param expr The call expression AST node
+ * @param target The known closure
+ */
+static void generate_closure_call(CodeGenerator* gen, AstNode* expr, StaticFunction* target) {
+    codegen_write(gen, "jfm_closure%zu(", target->closure->data.closure.id);
+    generate_static_environment(gen, target);
+    
+    AstNode* closure = target->closure;
+    for (size_t i = 0; i < expr->data.call.argument_count; i++) {
+        codegen_write(gen, ", ");
+        generate_converted(gen, i < closure->data.closure.param_count ? closure->data.closure.params[i].type : NULL,
+                           expr->data.call.arguments[i]);
+    }
+    codegen_write(gen, ")");
+}
+
+/**
+ * Finds the JFM function a call may be specialised for: a plain call by
+ * name. Calls from the hot-reload host go through the pointer table and
+ * are never specialised.
+ * 
+ * @param gen The code generator instance
+ * @param call The call expression AST node
+ * @return The called function, or NULL
+ */
+static AstNode* specialisable_callee(CodeGenerator* gen, AstNode* call) {
+    AstNode* callee = call->data.call.function;
+    if (gen->in_hot_host || callee->type != AST_IDENTIFIER || callee->data_type ||
+        strstr(callee->data.identifier.name, "::")) {
+        return NULL;
+    }
+    
+    AstNode* func = find_callee(gen, call);
+    if (!func || func->data.function.param_count != call->data.call.argument_count) return NULL;
+    return func;
+}
+
+/**
+ * Works out which fn parameters of a call receive functions known at
+ * compile time.
+ * 
+ * @param gen The code generator instance
+ * @param func The called function
+ * @param call The call expression AST node
+ * @param targets Output: one entry per parameter, all NULL if unbound
+ * @return true if at least one parameter is bound
+ */
+static bool bind_call_targets(CodeGenerator* gen, AstNode* func, AstNode* call, StaticFunction* targets) {
+    bool bound = false;
+    for (size_t i = 0; i < func->data.function.param_count; i++) {
+        Type* type = func->data.function.params[i].type;
+        if (type && type->kind == TYPE_FUNCTION &&
+            resolve_static_function(gen, call->data.call.arguments[i], &targets[i])) {
+            bound = true;
+        } else {
+            memset(&targets[i], 0, sizeof(targets[i]));
+        }
+    }
+    return bound;
+}
+
+/**
+ * Looks up the clone of a function for a set of bound parameters.
+ * 
+ * @param gen The code generator instance
+ * @param func The function
+ * @param targets Bound functions, one entry per parameter
+ * @return The clone, or NULL if none has been generated
+ */
+static Specialisation* find_specialisation(CodeGenerator* gen, AstNode* func, StaticFunction* targets) {
+    for (size_t i = 0; i < gen->specialisation_count; i++) {
+        Specialisation* spec = gen->specialisations[i];
+        if (spec->function != func) continue;
+        
+        bool same = true;
+        for (size_t j = 0; j < func->data.function.param_count && same; j++) {
+            same = spec->targets[j].function == targets[j].function &&
+                   spec->targets[j].closure == targets[j].closure;
+        }
+        if (same) return spec;
+    }
+    return NULL;
+}
+
+/**
+ * Generates a call to a clone. Bound parameters are dropped, except that
+ * a capturing closure still passes its environment.
+ * 
+ * @param gen The code generator instance
+ * @param expr The call expression AST node
+ * @param spec The clone
+ * @param targets Functions bound at this call site
+ * @param slot Destination pointer for a slot-returning call, or NULL
+ */
+static void generate_specialised_call(CodeGenerator* gen, AstNode* expr, Specialisation* spec,
+                                      StaticFunction* targets, const char* slot) {
+    AstNode* func = spec->function;
+    bool first = true;
+    
+    codegen_write(gen, "%s__spec%zu(", func->data.function.name, spec->id);
+    if (slot) {
+        codegen_write(gen, "%s", slot);
+        first = false;
+    }
+    
+    for (size_t i = 0; i < func->data.function.param_count; i++) {
+        bool bound = targets[i].function || targets[i].closure;
+        if (bound && !needs_environment(&targets[i])) continue;
+        
+        if (!first) codegen_write(gen, ", ");
+        first = false;
+        if (bound) {
+            generate_static_environment(gen, &targets[i]);
+        } else {
+            generate_argument(gen, func, i, expr->data.call.arguments[i]);
+        }
+    }
+    codegen_write(gen, ")");
+}
+
+/**
+ * Checks whether a call targets a JFM function or method that returns
+ * through a slot. Extern functions keep the C calling convention.
+ * 
+ * @param gen The code generator instance
+ * @param expr The expression to inspect
+ * @return true if the call needs a destination pointer
+ */
+static bool call_uses_return_slot(CodeGenerator* gen, AstNode* expr) {
+    if (!expr || expr->type != AST_CALL) {
+        return false;
+    }
+    AstNode* callee = find_callee(gen, expr);
+    return callee && layout_returns_via_slot(gen->program, callee);
+}
+
+/**
+ * Generates a byte access builtin as a memcpy of the bytes, swapped when
+ * the requested byte order differs from the host's. GCC and Clang fold
+ * the pair into a single mov (or movbe) with no alignment or aliasing UB.
+ * 
+ * @param gen The code generator instance
+ * @param expr The call expression AST node
+ * @param access The builtin being called
+ */
+static void generate_byte_access(CodeGenerator* gen, AstNode* expr, ByteAccess* access) {
+    Type value_type = { .kind = access->kind };
+    size_t bits = 8 * layout_size_of(gen->program, &value_type);
+    bool is_float = access->kind == TYPE_F32 || access->kind == TYPE_F64;
+    const char* swap = access->order == 'l' ? "JFM_SWAP_LE" : access->order == 'b' ? "JFM_SWAP_BE" : "JFM_SWAP_NE";
+    
+    if (access->is_store) {
+        codegen_write(gen, "jfm_store_u%zu(", bits);
+        generate_expression(gen, expr->data.call.arguments[0]);
+        codegen_write(gen, ", %s(%zu, ", swap, bits);
+        if (is_float) {
+            codegen_write(gen, "jfm_f%zu_bits(", bits);
+        } else {
+            codegen_write(gen, "(uint%zu_t)(", bits);
+        }
+        generate_operand(gen, expr->data.call.arguments[1]);
+        codegen_write(gen, ")))");
+        return;
+    }
+    
+    if (is_float) {
+        codegen_write(gen, "jfm_f%zu_from_bits(", bits);
+    } else {
+        codegen_write(gen, "(%s)(", get_c_type(access->kind));
+    }
+    codegen_write(gen, "%s(%zu, jfm_load_u%zu(", swap, bits, bits);
+    generate_expression(gen, expr->data.call.arguments[0]);
+    codegen_write(gen, ")))");
+}
+
+/**
+ * Generates a call to a method of #[derive(Encode, Decode)]. The value
+ * being encoded is passed by address; temporaries go through a compound
+ * literal.
+ * 
+ * @param gen The code generator instance
+ * @param expr The call expression
+ * @param method The generated method
+ * @param struct_def The struct it belongs to
+ */
+static void generate_serial_call(CodeGenerator* gen, AstNode* expr, SerialMethod method, AstNode* struct_def) {
+    static const char* const names[] = { "", "encoded_size", "encode", "decode", "view" };
+    codegen_write(gen, "jfm_%s_%s(", names[method], struct_def->data.struct_def.name);
+    
+    if (method == SERIAL_ENCODED_SIZE || method == SERIAL_ENCODE) {
+        AstNode* receiver = expr->data.call.function->data.field.object;
+        bool lvalue = receiver->type == AST_IDENTIFIER || receiver->type == AST_FIELD || receiver->type == AST_INDEX ||
+                      (receiver->type == AST_UNARY_OP && receiver->data.unary.op == TOKEN_STAR);
+        if (type_is_reference(receiver->data_type) || type_is_pointer(receiver->data_type)) {
+            generate_expression(gen, receiver);
+        } else if (lvalue) {
+            codegen_write(gen, "&");
+            generate_expression(gen, receiver);
+        } else {
+            codegen_write(gen, "(const %s[]){", struct_def->data.struct_def.name);
+            generate_expression(gen, receiver);
+            codegen_write(gen, "}");
+        }
+        if (method == SERIAL_ENCODED_SIZE) {
+            codegen_write(gen, ")");
+            return;
+        }
+        // Immutable *u8 bindings are emitted as const uint8_t*, yet the bytes they point at are writable
+        codegen_write(gen, ", (uint8_t*)");
+    }
+    
+    generate_expression(gen, expr->data.call.arguments[0]);
+    codegen_write(gen, ", ");
+    generate_expression(gen, expr->data.call.arguments[1]);
+    codegen_write(gen, ")");
+}
+
+/**
+ * Generates C code for function and method calls.
+ * Handles built-in functions (print, println, sqrt) and struct methods.
+ * Methods are translated to C-style functions with struct name prefix.
+ * 
+ * @param gen The code generator instance
+ * @param expr The call expression AST node
+ * @param slot Destination pointer passed first to slot-returning calls, or NULL
+ */
+static void generate_call_to(CodeGenerator* gen, AstNode* expr, const char* slot) {
+    AstNode* callee = find_callee(gen, expr);
+    size_t first_param = 0;
+    
+    if (expr->data.call.function->type == AST_FIELD) {
+        AstNode* field = expr->data.call.function;
+        Type* obj_type = field->data.field.object->data_type;
+        
+        Type* receiver_type = obj_type;
+        if (receiver_type && receiver_type->kind == TYPE_REFERENCE) {
+            receiver_type = receiver_type->data.reference.referenced_type;
+        } else if (receiver_type && receiver_type->kind == TYPE_POINTER) {
+            receiver_type = receiver_type->data.pointer.pointed_type;
+        }
+        if (receiver_type && (receiver_type->kind == TYPE_OPTION || receiver_type->kind == TYPE_RESULT)) {
+            generate_wrapper_method(gen, expr, receiver_type);
+            return;
+        }
+        
+        AstNode* struct_def;
+        SerialMethod serial = semantic_serial_call(gen->program, expr, &struct_def);
+        if (serial != SERIAL_NONE) {
+            generate_serial_call(gen, expr, serial, struct_def);
+            return;
+        }
+        
+        const char* struct_name = NULL;
+        if (obj_type && obj_type->kind == TYPE_STRUCT) {
+            struct_name = obj_type->data.struct_type.name;
+        }
+        
+        if (struct_name) {
+            size_t len = strlen(struct_name) + strlen(field->data.field.field_name) + 3;
+            char* method_name = malloc(len);
+            snprintf(method_name, len, "%s::%s", struct_name, field->data.field.field_name);
+            generate_function_name(gen, method_name);
+            free(method_name);
+            codegen_write(gen, "(");
+            if (slot) codegen_write(gen, "%s, ", slot);
+            generate_argument(gen, callee, 0, field->data.field.object);
+            first_param = 1;
+            if (expr->data.call.argument_count > 0) {
+                codegen_write(gen, ", ");
+            }
+        } else {
+            codegen_write(gen, "/* ERROR: method call on non-struct */");
+            return;
+        }
+    } else if (expr->data.call.function->type == AST_IDENTIFIER) {
+        const char* func_name = expr->data.call.function->data.identifier.name;
+        ByteAccess access;
+        
+        // Without a destination type Some(v), Ok(v) and Err(e) take the argument's type
+        if (wrapper_constructor(expr)) {
+            if (!wrapper_is_complete(expr->data_type)) {
+                codegen_write(gen, "/* ERROR: cannot infer the type of %s(...) */", func_name);
+                return;
+            }
+            generate_wrapped(gen, expr->data_type, expr);
+            return;
+        }
+        
+        AstNode* struct_def;
+        SerialMethod serial = semantic_serial_call(gen->program, expr, &struct_def);
+        if (serial != SERIAL_NONE) {
+            generate_serial_call(gen, expr, serial, struct_def);
+            return;
+        }
+        
+        // A call through a fn value becomes a direct call when its target is known
+        Type* callee_type = expr->data.call.function->data_type;
+        if (callee_type && callee_type->kind == TYPE_FUNCTION) {
+            StaticFunction target;
+            if (!resolve_static_function(gen, expr->data.call.function, &target)) {
+                generate_dynamic_call(gen, expr);
+                return;
+            }
+            if (target.closure) {
+                generate_closure_call(gen, expr, &target);
+                return;
+            }
+            func_name = target.function->data.function.name;
+        }
+        
+        if (strcmp(func_name, "println") == 0) {
+            if (expr->data.call.argument_count > 0) {
+                Type* arg_type = expr->data.call.arguments[0]->data_type;
+                if (arg_type) {
+                    if (arg_type->kind == TYPE_STR) {
+                        codegen_write(gen, "printf(\"%%s\\n\", ");
+                    } else if (arg_type->kind == TYPE_I128 || arg_type->kind == TYPE_U128) {
+                        codegen_write(gen, "jfm_print_%s(", type_to_string(arg_type));
+                        generate_expression(gen, expr->data.call.arguments[0]);
+                        codegen_write(gen, ", \"\\n\")");
+                        return;
+                    } else if (type_is_integral(arg_type)) {
+                        if (type_is_signed(arg_type)) {
+                            codegen_write(gen, "printf(\"%%lld\\n\", (long long)");
+                        } else {
+                            codegen_write(gen, "printf(\"%%llu\\n\", (unsigned long long)");
+                        }
+                    } else if (type_is_float(arg_type)) {
+                        codegen_write(gen, "printf(\"%%f\\n\", ");
+                    } else if (arg_type->kind == TYPE_BOOL) {
+                        codegen_write(gen, "printf(\"%%s\\n\", ");
+                        generate_expression(gen, expr->data.call.arguments[0]);
+                        codegen_write(gen, " ? \"true\" : \"false\"");
+                        codegen_write(gen, ")");
+                        return;
+                    } else if (arg_type->kind == TYPE_CHAR) {
+                        codegen_write(gen, "printf(\"%%c\\n\", ");
+                    } else {
+                        codegen_write(gen, "printf(\"<unknown>\\n\")");
+                        return;
+                    }
+                    generate_operand(gen, expr->data.call.arguments[0]);
+                    codegen_write(gen, ")");
+                } else {
+                    codegen_write(gen, "printf(\"\\n\")");
+                }
+            } else {
+                codegen_write(gen, "printf(\"\\n\")");
+            }
+            return;
+        } else if (strcmp(func_name, "print") == 0) {
+            if (expr->data.call.argument_count > 0) {
+                Type* arg_type = expr->data.call.arguments[0]->data_type;
+                if (arg_type) {
+                    if (arg_type->kind == TYPE_STR) {
+                        codegen_write(gen, "printf(\"%%s\", ");
+                    } else if (arg_type->kind == TYPE_I128 || arg_type->kind == TYPE_U128) {
+                        codegen_write(gen, "jfm_print_%s(", type_to_string(arg_type));
+                        generate_expression(gen, expr->data.call.arguments[0]);
+                        codegen_write(gen, ", \"\")");
+                        return;
+                    } else if (type_is_integral(arg_type)) {
+                        if (type_is_signed(arg_type)) {
+                            codegen_write(gen, "printf(\"%%lld\", (long long)");
+                        } else {
+                            codegen_write(gen, "printf(\"%%llu\", (unsigned long long)");
+                        }
+                    } else if (type_is_float(arg_type)) {
+                        codegen_write(gen, "printf(\"%%f\", ");
+                    } else if (arg_type->kind == TYPE_BOOL) {
+                        codegen_write(gen, "printf(\"%%s\", ");
+                        generate_expression(gen, expr->data.call.arguments[0]);
+                        codegen_write(gen, " ? \"true\" : \"false\"");
+                        codegen_write(gen, ")");
+                        return;
+                    } else if (arg_type->kind == TYPE_CHAR) {
+                        codegen_write(gen, "printf(\"%%c\", ");
+                    } else {
+                        codegen_write(gen, "printf(\"<unknown>\")");
+                        return;
+                    }
+                    generate_operand(gen, expr->data.call.arguments[0]);
+                    codegen_write(gen, ")");
+                }
+            }
+            return;
+        } else if (semantic_byte_access(func_name, &access)) {
+            generate_byte_access(gen, expr, &access);
+            return;
+        } else if (strcmp(func_name, "sqrt") == 0) {
+            codegen_write(gen, "sqrt(");
+            if (expr->data.call.argument_count > 0) {
+                generate_operand(gen, expr->data.call.arguments[0]);
+            }
+            codegen_write(gen, ")");
+            return;
+        }
+        
+        AstNode* func = specialisable_callee(gen, expr);
+        if (func) {
+            StaticFunction* targets = malloc(sizeof(StaticFunction) * (func->data.function.param_count + 1));
+            Specialisation* spec = bind_call_targets(gen, func, expr, targets) ?
+                                   find_specialisation(gen, func, targets) : NULL;
+            if (spec) generate_specialised_call(gen, expr, spec, targets, slot);
+            free(targets);
+            if (spec) return;
+        }
+        
+        generate_function_name(gen, func_name);
+        codegen_write(gen, "(");
+        if (slot) {
+            codegen_write(gen, "%s", slot);
+            if (expr->data.call.argument_count > 0) codegen_write(gen, ", ");
+        }
+    } else {
+        generate_expression(gen, expr->data.call.function);
+        codegen_write(gen, "(");
+    }
+    
+    for (size_t i = 0; i < expr->data.call.argument_count; i++) {
+        if (i > 0) codegen_write(gen, ", ");
+        generate_argument(gen, callee, first_param + i, expr->data.call.arguments[i]);
+    }
+    
+    codegen_write(gen, ")");
+}
+
+/**
+ * Generates a call expression. A call returning a large struct writes into
+ * gen->call_slot when the caller set one (let initialisers, returns);
+ * anywhere else the result goes through a temporary in a statement
+ * expression.
+ * 
+ * @param gen The code generator instance
+ * @param expr The call expression AST node
+ */
+static void generate_call(CodeGenerator* gen, AstNode* expr) {
+    const char* slot = gen->call_slot;
+    gen->call_slot = NULL;
+    
+    if (!call_uses_return_slot(gen, expr)) {
+        generate_call_to(gen, expr, NULL);
+        return;
+    }
+    if (slot) {
+        generate_call_to(gen, expr, slot);
+        return;
+    }
+    
+    char temp[48];
+    char address[64];
+    snprintf(temp, sizeof(temp), "jfm_ret%zu", gen->slot_temp_count++);
+    snprintf(address, sizeof(address), "&%s", temp);
+    
+    codegen_write(gen, "({ ");
+    generate_type(gen, expr->data_type);
+    codegen_write(gen, " %s; ", temp);
+    generate_call_to(gen, expr, address);
+    codegen_write(gen, "; %s; })", temp);
+}
+
+/**
+ * Looks up a visible struct parameter of the current function that is
+ * passed by hidden reference.
+ * 
+ * @param gen The code generator instance
+ * @param name The identifier
+ * @return The parameter entry, or NULL
+ */
+static ReferenceParam* find_reference_param(CodeGenerator* gen, const char* name) {
+    for (size_t i = 0; i < gen->ref_param_count; i++) {
+        if (gen->ref_params[i].shadowed_at == 0 && strcmp(gen->ref_params[i].name, name) == 0) {
+            return &gen->ref_params[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Records that a local declared at the given block depth hides a
+ * by-reference parameter of the same name until that block ends.
+ * 
+ * @param gen The code generator instance
+ * @param name The declared name
+ * @param depth Block depth of the declaration
+ */
+static void shadow_reference_param(CodeGenerator* gen, const char* name, size_t depth) {
+    ReferenceParam* param = find_reference_param(gen, name);
+    if (param) param->shadowed_at = depth;
+}
+
+/**
+ * Makes a name refer to an object through a pointer of the same name, so
+ * identifiers naming it are emitted as (*name) until the entry is dropped.
+ * 
+ * @param gen The code generator instance
+ * @param name The bound name
+ */
+static void add_reference_binding(CodeGenerator* gen, const char* name) {
+    if (gen->ref_param_count >= gen->ref_param_capacity) {
+        gen->ref_param_capacity *= 2;
+        gen->ref_params = realloc(gen->ref_params, sizeof(ReferenceParam) * gen->ref_param_capacity);
+    }
+    gen->ref_params[gen->ref_param_count].name = name;
+    gen->ref_params[gen->ref_param_count].shadowed_at = 0;
+    gen->ref_param_count++;
+}
+
+/**
+ * Writes an integer literal. Values above INT64_MAX take a ULL suffix, and
+ * values above UINT64_MAX, which no C literal can hold, are assembled from
+ * their 64-bit halves.
+ * 
+ * @param gen The code generator instance
+ * @param expr The integer literal AST node
+ */
+static void generate_int_literal(CodeGenerator* gen, AstNode* expr) {
+    unsigned long long low = expr->data.literal.int_value;
+    unsigned long long high = expr->data.literal.int_high;
+    if (high) {
+        codegen_write(gen, "(__extension__ ((unsigned __int128)0x%llxULL << 64 | 0x%llxULL))", high, low);
+    } else if (low > LLONG_MAX) {
+        codegen_write(gen, "%lluULL", low);
+    } else {
+        codegen_write(gen, "%llu", low);
+    }
+}
+
+/**
+ * Main expression generation dispatcher.
+ * Routes to appropriate generator based on expression type.
+ * 
+ * @param gen The code generator instance
+ * @param expr The expression AST node
+ */
+static void generate_expression(CodeGenerator* gen, AstNode* expr) {
+    if (!expr) return;
+    
+    switch (expr->type) {
+        case AST_LITERAL:
+            if (expr->data_type) {
+                switch (expr->data_type->kind) {
+                    case TYPE_I8:
+                    case TYPE_I16:
+                    case TYPE_I32:
+                    case TYPE_I64:
+                    case TYPE_I128:
+                    case TYPE_U8:
+                    case TYPE_U16:
+                    case TYPE_U32:
                     case TYPE_U64:
-                        codegen_write(gen, "%lld", expr->data.literal.int_value);
+                    case TYPE_U128:
+                        generate_int_literal(gen, expr);
                         break;
                     case TYPE_F32:
                     case TYPE_F64:
@@ -385,363 +1777,2345 @@ static void generate_expression(CodeGenerator* gen, AstNode* expr) {
                         break;
                 }
             } else {
-                codegen_write(gen, "/* untyped literal */");
+                codegen_write(gen, "/* untyped literal */");
+            }
+            break;
+            
+        case AST_IDENTIFIER: {
+            StaticFunction target;
+            if (static_value_of(gen, expr, &target)) {
+                generate_static_value(gen, &target);
+                break;
+            }
+            if (is_none(expr)) {
+                codegen_write(gen, "/* ERROR: cannot infer the type of None */");
+                break;
+            }
+            
+            const char* name = expr->data.identifier.name;
+            const char* coloncolon = strstr(name, "::");
+            if (find_reference_param(gen, name)) {
+                codegen_write(gen, "(*%s)", name);
+            } else if (coloncolon) {
+                size_t prefix_len = coloncolon - name;
+                codegen_write(gen, "%.*s_%s", (int)prefix_len, name, coloncolon + 2);
+            } else {
+                codegen_write(gen, "%s", name);
+            }
+            break;
+        }
+            
+        case AST_BINARY_OP:
+            generate_binary_op(gen, expr);
+            break;
+            
+        case AST_UNARY_OP:
+            generate_unary_op(gen, expr);
+            break;
+            
+        case AST_CAST:
+            if (type_is_half(expr->data.cast.target_type)) {
+                codegen_write(gen, "jfm_f32_to_%s((float)", type_to_string(expr->data.cast.target_type));
+                generate_operand(gen, expr->data.cast.expression);
+                codegen_write(gen, ")");
+                break;
+            }
+            codegen_write(gen, "(");
+            generate_type(gen, expr->data.cast.target_type);
+            codegen_write(gen, ")");
+            generate_operand(gen, expr->data.cast.expression);
+            break;
+            
+        case AST_CALL:
+            generate_call(gen, expr);
+            break;
+            
+        case AST_INDEX:
+            generate_index(gen, expr);
+            break;
+            
+        case AST_FIELD: {
+            // arr[i].x on an array of a #[soa] struct becomes arr.x[i]
+            AstNode* object = expr->data.field.object;
+            if (object->type == AST_INDEX && object->data.index.array->data_type) {
+                Type* array_type = object->data.index.array->data_type;
+                bool by_reference = array_type->kind == TYPE_REFERENCE;
+                if (by_reference) array_type = array_type->data.reference.referenced_type;
+                
+                if (layout_soa_struct(gen->program, array_type)) {
+                    codegen_write(gen, "(");
+                    generate_expression(gen, object->data.index.array);
+                    codegen_write(gen, ")%s%s[", by_reference ? "->" : ".", expr->data.field.field_name);
+                    generate_expression(gen, object->data.index.index);
+                    codegen_write(gen, "]");
+                    break;
+                }
+            }
+            
+            // Field access auto-dereferences pointers and references
+            Type* object_type = object->data_type;
+            bool indirect = object_type && (object_type->kind == TYPE_POINTER || object_type->kind == TYPE_REFERENCE);
+            generate_expression(gen, object);
+            codegen_write(gen, "%s%s", indirect ? "->" : ".", expr->data.field.field_name);
+            break;
+        }
+            
+        case AST_ASSIGNMENT:
+            generate_expression(gen, expr->data.assignment.target);
+            codegen_write(gen, " = ");
+            generate_converted(gen, expr->data.assignment.target->data_type, expr->data.assignment.value);
+            break;
+            
+        case AST_ARRAY_LITERAL:
+            if (is_zero_array(expr)) {
+                codegen_write(gen, "{0}");
+                break;
+            }
+            codegen_write(gen, "{");
+            generate_array_elements(gen, expr, NULL, true);
+            codegen_write(gen, "}");
+            break;
+            
+        case AST_CLOSURE: {
+            StaticFunction target = { .closure = expr, .source = expr };
+            generate_static_value(gen, &target);
+            break;
+        }
+            
+        case AST_STRUCT_LITERAL:
+            if (gen->in_struct_init) {
+                codegen_write(gen, "{");
+            } else {
+                codegen_write(gen, "(%s){", expr->data.struct_literal.struct_name);
+            }
+            
+            gen->in_struct_init = true;
+            for (size_t i = 0; i < expr->data.struct_literal.field_count; i++) {
+                if (i > 0) codegen_write(gen, ", ");
+                codegen_write(gen, ".%s = ", expr->data.struct_literal.field_names[i]);
+                generate_converted(gen, struct_field_type(gen, expr->data.struct_literal.struct_name,
+                                                          expr->data.struct_literal.field_names[i]),
+                                   expr->data.struct_literal.field_values[i]);
+            }
+            gen->in_struct_init = false;
+            
+            codegen_write(gen, "}");
+            break;
+            
+        default:
+            codegen_write(gen, "/* unsupported expression */");
+            break;
+    }
+}
+
+/**
+ * Generates C code for variable declarations (let statements).
+ * Handles const qualification for immutable variables, type inference,
+ * #[align(N)] / #[cache_aligned] and special array declaration syntax.
+ * 
+ * @param gen The code generator instance
+ * @param stmt The let statement AST node
+ */
+static void generate_let(CodeGenerator* gen, AstNode* stmt) {
+    Type* type = stmt->data.let_stmt.type;
+    if (!type && stmt->data.let_stmt.value) {
+        type = stmt->data.let_stmt.value->data_type;
+    }
+    
+    // _Alignas may not weaken alignment, so only emit it when it raises it
+    size_t align = layout_requested_align(stmt->attributes, stmt->attribute_count);
+    if (type && align > layout_align_of(gen->program, type)) {
+        codegen_write(gen, "_Alignas(%zu) ", align);
+    }
+    
+    // A large struct returned by a call is written straight into the
+    // variable, which therefore cannot be const
+    AstNode* value = stmt->data.let_stmt.value;
+    if (call_uses_return_slot(gen, value)) {
+        char* address = string_format("&%s", stmt->data.let_stmt.name);
+        generate_type(gen, type);
+        codegen_write(gen, " %s; ", stmt->data.let_stmt.name);
+        gen->call_slot = address;
+        generate_expression(gen, value);
+        codegen_write(gen, ";");
+        free(address);
+        shadow_reference_param(gen, stmt->data.let_stmt.name, gen->block_depth);
+        return;
+    }
+    
+    if (!stmt->data.let_stmt.is_mutable) {
+        codegen_write(gen, "const ");
+    }
+    
+    if (!type) {
+        codegen_write(gen, "/* ERROR: missing type */ void");
+        codegen_write(gen, " %s", stmt->data.let_stmt.name);
+        if (stmt->data.let_stmt.value) {
+            codegen_write(gen, " = ");
+            generate_expression(gen, stmt->data.let_stmt.value);
+        }
+        codegen_write(gen, ";");
+        return;
+    }
+    
+    if (type->kind == TYPE_ARRAY && !layout_soa_struct(gen->program, type)) {
+        generate_type(gen, type->data.array.element_type);
+        codegen_write(gen, " %s[%zu]", 
+                     stmt->data.let_stmt.name,
+                     flat_array_length(gen, type));
+    } else {
+        generate_type(gen, type);
+        codegen_write(gen, " %s", stmt->data.let_stmt.name);
+    }
+    
+    if (value) {
+        // A struct literal becomes a plain initializer, built in place
+        // rather than copied from a compound literal
+        codegen_write(gen, " = ");
+        gen->in_struct_init = value->type == AST_STRUCT_LITERAL;
+        generate_converted(gen, type, value);
+        gen->in_struct_init = false;
+    }
+    
+    codegen_write(gen, ";");
+    shadow_reference_param(gen, stmt->data.let_stmt.name, gen->block_depth);
+}
+
+/**
+ * Generates C code for if statements with optional else branches.
+ * 
+ * @param gen The code generator instance
+ * @param stmt The if statement AST node
+ */
+static void generate_if(CodeGenerator* gen, AstNode* stmt) {
+    codegen_write(gen, "if (");
+    generate_expression(gen, stmt->data.if_stmt.condition);
+    codegen_write(gen, ") ");
+    
+    generate_statement(gen, stmt->data.if_stmt.then_branch);
+    
+    if (stmt->data.if_stmt.else_branch) {
+        codegen_indent(gen);
+        codegen_write(gen, "else ");
+        generate_statement(gen, stmt->data.if_stmt.else_branch);
+    }
+}
+
+/**
+ * Writes the pragmas for the loop hints attached to a loop statement:
+ * #[unroll(N)] and #[no_unroll] become `#pragma GCC unroll`, #[ivdep]
+ * `#pragma GCC ivdep` and #[vectorize] `#pragma omp simd`, which takes
+ * effect when the C compiler runs with -fopenmp-simd. `omp simd` must be
+ * followed by the loop itself, so when other hints are present it gives
+ * way to them.
+ * 
+ * @param gen The code generator instance
+ * @param stmt The loop statement AST node
+ */
+static void generate_loop_hints(CodeGenerator* gen, AstNode* stmt) {
+    bool gcc_hints = false;
+    Attribute* vectorize = NULL;
+    
+    for (size_t i = 0; i < stmt->attribute_count; i++) {
+        Attribute* attr = &stmt->attributes[i];
+        if (attr->ignored) continue;
+        
+        if (strcmp(attr->name, "unroll") == 0 && attr->arg_count == 1) {
+            codegen_write(gen, "#pragma GCC unroll %s\n", attr->args[0]);
+        } else if (strcmp(attr->name, "no_unroll") == 0) {
+            codegen_write(gen, "#pragma GCC unroll 1\n");
+        } else if (strcmp(attr->name, "ivdep") == 0) {
+            codegen_write(gen, "#pragma GCC ivdep\n");
+        } else {
+            if (strcmp(attr->name, "vectorize") == 0) vectorize = attr;
+            continue;
+        }
+        codegen_indent(gen);
+        gcc_hints = true;
+    }
+    
+    if (vectorize && !gcc_hints) {
+        codegen_write(gen, "#pragma omp simd\n");
+        codegen_indent(gen);
+    }
+}
+
+/**
+ * Generates C code for while loops.
+ * 
+ * @param gen The code generator instance
+ * @param stmt The while loop AST node
+ */
+static void generate_while(CodeGenerator* gen, AstNode* stmt) {
+    generate_loop_hints(gen, stmt);
+    codegen_write(gen, "while (");
+    generate_expression(gen, stmt->data.while_loop.condition);
+    codegen_write(gen, ") ");
+    if (gen->in_hot_host) gen->block_prologue = "jfm_hot_poll();";
+    generate_statement(gen, stmt->data.while_loop.body);
+}
+
+/**
+ * Writes the header of a loop over a range: for i in a..b becomes
+ * for (int i = a; i < b; i++), and ..=, .rev() and .step_by(k) adjust the
+ * bound, direction and increment.
+ * 
+ * @param gen The code generator instance
+ * @param stmt The for loop AST node
+ */
+static void generate_range_for(CodeGenerator* gen, AstNode* stmt) {
+    const char* i = stmt->data.for_loop.iterator;
+    AstNode* step = stmt->data.for_loop.step;
+    
+    codegen_write(gen, "for (int %s = ", i);
+    if (stmt->data.for_loop.reverse) {
+        codegen_write(gen, "(");
+        generate_expression(gen, stmt->data.for_loop.end);
+        codegen_write(gen, stmt->data.for_loop.inclusive ? "); %s >= " : ") - 1; %s >= ", i);
+        generate_expression(gen, stmt->data.for_loop.start);
+    } else {
+        generate_expression(gen, stmt->data.for_loop.start);
+        codegen_write(gen, stmt->data.for_loop.inclusive ? "; %s <= " : "; %s < ", i);
+        generate_expression(gen, stmt->data.for_loop.end);
+    }
+    
+    if (step) {
+        codegen_write(gen, "; %s %s ", i, stmt->data.for_loop.reverse ? "-=" : "+=");
+        generate_expression(gen, step);
+        codegen_write(gen, ") ");
+    } else {
+        codegen_write(gen, "; %s%s) ", i, stmt->data.for_loop.reverse ? "--" : "++");
+    }
+}
+
+/**
+ * Returns the number of elements of an array iterated by a for loop.
+ * 
+ * @param array The iterated expression (its type may be a reference)
+ * @return The compile-time length
+ */
+static size_t iterated_length(AstNode* array) {
+    Type* type = array->data_type;
+    if (type && type->kind == TYPE_REFERENCE) type = type->data.reference.referenced_type;
+    return type && type->kind == TYPE_ARRAY ? type->data.array.size : 0;
+}
+
+/**
+ * Writes the name of the index variable of a loop over an array: the
+ * enumerate() binding, or a hidden counter named after the block depth.
+ * 
+ * @param stmt The for loop AST node
+ * @param depth Block depth of the loop statement
+ * @param buffer Output buffer for a generated name
+ * @param size Size of the buffer
+ * @return The counter name
+ */
+static const char* loop_counter_name(AstNode* stmt, size_t depth, char* buffer, size_t size) {
+    if (stmt->data.for_loop.index_name) return stmt->data.for_loop.index_name;
+    snprintf(buffer, size, "jfm_i%zu", depth);
+    return buffer;
+}
+
+/**
+ * Writes the header of a loop over an array as a counted C loop whose
+ * bound is the array length known at compile time; zip() stops at the
+ * shorter array. The element bindings are emitted when the body opens.
+ * 
+ * @param gen The code generator instance
+ * @param stmt The for loop AST node
+ */
+static void generate_array_for(CodeGenerator* gen, AstNode* stmt) {
+    size_t length = iterated_length(stmt->data.for_loop.iterable);
+    if (stmt->data.for_loop.zip_with) {
+        size_t other = iterated_length(stmt->data.for_loop.zip_with);
+        if (other < length) length = other;
+    }
+    
+    char buffer[32];
+    const char* i = loop_counter_name(stmt, gen->block_depth, buffer, sizeof(buffer));
+    if (stmt->data.for_loop.reverse) {
+        codegen_write(gen, "for (int %s = %d; %s >= 0; %s--) ", i, (int)length - 1, i, i);
+    } else {
+        codegen_write(gen, "for (int %s = 0; %s < %zu; %s++) ", i, i, length, i);
+    }
+}
+
+/**
+ * Declares one element binding at the top of a loop body. Scalars are
+ * copied into a const local; structs and &mut bindings become a pointer
+ * to the element, read as (*name); rows of a nested array become a pointer
+ * to the row's first element.
+ * 
+ * @param gen The code generator instance
+ * @param array The iterated expression
+ * @param name The bound name
+ * @param is_mut Whether the element is bound with &mut
+ * @param counter The index variable of the loop
+ */
+static void generate_element_binding(CodeGenerator* gen, AstNode* array, const char* name, bool is_mut,
+                                     const char* counter) {
+    Type* array_type = array->data_type;
+    if (array_type->kind == TYPE_REFERENCE) array_type = array_type->data.reference.referenced_type;
+    Type* element = array_type->data.array.element_type;
+    
+    AstNode index_node = { .type = AST_IDENTIFIER };
+    index_node.data.identifier.name = (char*)counter;
+    AstNode element_node = { .type = AST_INDEX, .data_type = element };
+    element_node.data.index.array = array;
+    element_node.data.index.index = &index_node;
+    
+    codegen_indent(gen);
+    if (!is_mut) codegen_write(gen, "const ");
+    generate_type(gen, element);
+    if (is_plain_array(gen, element)) {
+        codegen_write(gen, "* %s = ", name);
+    } else if (is_mut || element->kind == TYPE_STRUCT) {
+        codegen_write(gen, "* %s = &", name);
+        add_reference_binding(gen, name);
+    } else {
+        codegen_write(gen, " %s = ", name);
+    }
+    generate_expression(gen, &element_node);
+    codegen_write(gen, ";\n");
+}
+
+/**
+ * Declares the element bindings of a loop over an array at the top of its
+ * body.
+ * 
+ * @param gen The code generator instance
+ * @param stmt The for loop AST node
+ */
+static void generate_loop_bindings(CodeGenerator* gen, AstNode* stmt) {
+    char buffer[32];
+    const char* counter = loop_counter_name(stmt, gen->block_depth - 1, buffer, sizeof(buffer));
+    
+    generate_element_binding(gen, stmt->data.for_loop.iterable, stmt->data.for_loop.iterator,
+                             stmt->data.for_loop.iterator_mut, counter);
+    if (stmt->data.for_loop.zip_with) {
+        generate_element_binding(gen, stmt->data.for_loop.zip_with, stmt->data.for_loop.zip_name,
+                                 stmt->data.for_loop.zip_mut, counter);
+    }
+}
+
+/**
+ * Declares the captured variables at the top of a lifted closure. Each is
+ * read through its pointer in the environment, so the body uses and
+ * updates the enclosing function's variable; plain arrays keep their
+ * element pointer and index it directly.
+ * 
+ * @param gen The code generator instance
+ * @param closure The closure AST node
+ */
+static void generate_capture_bindings(CodeGenerator* gen, AstNode* closure) {
+    if (closure->data.closure.capture_count == 0) {
+        codegen_writeln(gen, "(void)jfm_env;");
+        return;
+    }
+    
+    for (size_t i = 0; i < closure->data.closure.capture_count; i++) {
+        const char* name = closure->data.closure.captures[i];
+        Type* type = closure->data.closure.capture_types[i];
+        
+        codegen_indent(gen);
+        generate_type(gen, type);
+        codegen_write(gen, "* %s = ((jfm_env%zu*)jfm_env)->%s;\n", name, closure->data.closure.id, name);
+        if (type->kind != TYPE_ARRAY || !is_plain_array(gen, type)) {
+            add_reference_binding(gen, name);
+        }
+    }
+}
+
+/**
+ * Generates C code for for loops over a range or an array. Every form
+ * lowers to a plain counted C loop with no iterator objects.
+ * 
+ * @param gen The code generator instance
+ * @param stmt The for loop AST node
+ */
+static void generate_for(CodeGenerator* gen, AstNode* stmt) {
+    generate_loop_hints(gen, stmt);
+    if (stmt->data.for_loop.iterable) {
+        generate_array_for(gen, stmt);
+    } else {
+        generate_range_for(gen, stmt);
+    }
+    
+    if (gen->in_hot_host) gen->block_prologue = "jfm_hot_poll();";
+    shadow_reference_param(gen, stmt->data.for_loop.iterator, gen->block_depth + 1);
+    if (stmt->data.for_loop.index_name) {
+        shadow_reference_param(gen, stmt->data.for_loop.index_name, gen->block_depth + 1);
+    }
+    if (stmt->data.for_loop.zip_name) {
+        shadow_reference_param(gen, stmt->data.for_loop.zip_name, gen->block_depth + 1);
+    }
+    
+    // &mut element bindings are only visible inside the loop body
+    size_t ref_param_count = gen->ref_param_count;
+    gen->block_bindings = stmt->data.for_loop.iterable ? stmt : NULL;
+    generate_statement(gen, stmt->data.for_loop.body);
+    gen->ref_param_count = ref_param_count;
+}
+
+/**
+ * Generates C code for infinite loops.
+ * Converts JFM 'loop' to C 'while(1)'. Loop hints are not emitted: an
+ * infinite loop has no trip count, and `#pragma omp simd` needs a C for.
+ * 
+ * @param gen The code generator instance
+ * @param stmt The loop statement AST node
+ */
+static void generate_loop(CodeGenerator* gen, AstNode* stmt) {
+    codegen_write(gen, "while (1) ");
+    if (gen->in_hot_host) gen->block_prologue = "jfm_hot_poll();";
+    generate_statement(gen, stmt->data.loop_stmt.body);
+}
+
+/**
+ * Checks whether a struct literal assigns every field of its struct and
+ * none of them is an array, so it can be stored field by field.
+ * 
+ * @param gen The code generator instance
+ * @param literal The struct literal AST node
+ * @return true if the literal can be constructed with member stores
+ */
+static bool literal_sets_every_field(CodeGenerator* gen, AstNode* literal) {
+    AstNode* struct_def = layout_find_struct(gen->program, literal->data.struct_literal.struct_name);
+    if (!struct_def || struct_def->data.struct_def.field_count != literal->data.struct_literal.field_count) {
+        return false;
+    }
+    
+    for (size_t i = 0; i < struct_def->data.struct_def.field_count; i++) {
+        Field* field = &struct_def->data.struct_def.fields[i];
+        if (field->type && field->type->kind == TYPE_ARRAY) return false;
+        
+        bool found = false;
+        for (size_t j = 0; j < literal->data.struct_literal.field_count && !found; j++) {
+            found = strcmp(literal->data.struct_literal.field_names[j], field->name) == 0;
+        }
+        if (!found) return false;
+    }
+    return true;
+}
+
+/**
+ * Writes one operand list of an asm! statement.
+ * 
+ * @param gen The code generator instance
+ * @param stmt The asm statement AST node
+ * @param from Index of the first operand in the list
+ * @param to Index one past the last operand
+ */
+static void generate_asm_operands(CodeGenerator* gen, AstNode* stmt, size_t from, size_t to) {
+    for (size_t i = from; i < to; i++) {
+        if (i > from) codegen_write(gen, ", ");
+        if (stmt->data.asm_stmt.names[i]) {
+            codegen_write(gen, "[%s] ", stmt->data.asm_stmt.names[i]);
+        }
+        codegen_write(gen, "\"%s\" (", stmt->data.asm_stmt.constraints[i]);
+        generate_expression(gen, stmt->data.asm_stmt.operands[i]);
+        codegen_write(gen, ")");
+    }
+}
+
+/**
+ * Generates an asm! statement as GCC extended asm. It is always volatile,
+ * so the C compiler neither drops nor hoists hand-written sequences.
+ * 
+ * @param gen The code generator instance
+ * @param stmt The asm statement AST node
+ */
+static void generate_asm(CodeGenerator* gen, AstNode* stmt) {
+    codegen_write(gen, "__asm__ volatile (");
+    for (size_t i = 0; i < stmt->data.asm_stmt.template_count; i++) {
+        codegen_write(gen, "%s\"%s\"", i > 0 ? " " : "", stmt->data.asm_stmt.template_parts[i]);
+    }
+    
+    if (stmt->data.asm_stmt.operand_count > 0 || stmt->data.asm_stmt.clobber_count > 0) {
+        codegen_write(gen, " : ");
+        generate_asm_operands(gen, stmt, 0, stmt->data.asm_stmt.output_count);
+        codegen_write(gen, " : ");
+        generate_asm_operands(gen, stmt, stmt->data.asm_stmt.output_count, stmt->data.asm_stmt.operand_count);
+    }
+    if (stmt->data.asm_stmt.clobber_count > 0) {
+        codegen_write(gen, " : ");
+        for (size_t i = 0; i < stmt->data.asm_stmt.clobber_count; i++) {
+            codegen_write(gen, "%s\"%s\"", i > 0 ? ", " : "", stmt->data.asm_stmt.clobbers[i]);
+        }
+    }
+    codegen_write(gen, ");");
+}
+
+/**
+ * Generates a return from a function that returns through jfm_ret. A call
+ * returning the same struct forwards the slot, a complete struct literal
+ * is constructed directly in it, and anything else is copied once.
+ * 
+ * @param gen The code generator instance
+ * @param value The returned expression
+ */
+static void generate_slot_return(CodeGenerator* gen, AstNode* value) {
+    codegen_write(gen, "{ ");
+    
+    if (call_uses_return_slot(gen, value)) {
+        gen->call_slot = "jfm_ret";
+        generate_expression(gen, value);
+        codegen_write(gen, "; ");
+    } else if (value->type == AST_STRUCT_LITERAL && literal_sets_every_field(gen, value)) {
+        for (size_t i = 0; i < value->data.struct_literal.field_count; i++) {
+            codegen_write(gen, "jfm_ret->%s = ", value->data.struct_literal.field_names[i]);
+            generate_converted(gen, struct_field_type(gen, value->data.struct_literal.struct_name,
+                                                      value->data.struct_literal.field_names[i]),
+                               value->data.struct_literal.field_values[i]);
+            codegen_write(gen, "; ");
+        }
+    } else {
+        codegen_write(gen, "*jfm_ret = ");
+        generate_expression(gen, value);
+        codegen_write(gen, "; ");
+    }
+    
+    codegen_write(gen, "return; }");
+}
+
+/**
+ * Main statement generation dispatcher.
+ * Routes different statement types to their specific generators.
+ * 
+ * @param gen The code generator instance
+ * @param stmt The statement AST node
+ */
+static void generate_statement(CodeGenerator* gen, AstNode* stmt) {
+    if (!stmt) return;
+    
+    switch (stmt->type) {
+        case AST_BLOCK:
+            codegen_writeln(gen, "{");
+            gen->indent_level++;
+            gen->block_depth++;
+            
+            if (gen->block_prologue) {
+                codegen_writeln(gen, "%s", gen->block_prologue);
+                gen->block_prologue = NULL;
+            }
+            if (gen->block_bindings) {
+                AstNode* owner = gen->block_bindings;
+                gen->block_bindings = NULL;
+                if (owner->type == AST_CLOSURE) {
+                    generate_capture_bindings(gen, owner);
+                } else {
+                    generate_loop_bindings(gen, owner);
+                }
+            }
+            
+            for (size_t i = 0; i < stmt->data.block.statement_count; i++) {
+                codegen_indent(gen);
+                generate_statement(gen, stmt->data.block.statements[i]);
+                if (stmt->data.block.statements[i]->type != AST_IF &&
+                    stmt->data.block.statements[i]->type != AST_WHILE &&
+                    stmt->data.block.statements[i]->type != AST_FOR &&
+                    stmt->data.block.statements[i]->type != AST_LOOP &&
+                    stmt->data.block.statements[i]->type != AST_BLOCK) {
+                }
+                codegen_write(gen, "\n");
+            }
+            
+            for (size_t i = 0; i < gen->ref_param_count; i++) {
+                if (gen->ref_params[i].shadowed_at >= gen->block_depth) gen->ref_params[i].shadowed_at = 0;
+            }
+            gen->block_depth--;
+            gen->indent_level--;
+            codegen_indent(gen);
+            codegen_write(gen, "}");
+            break;
+            
+        case AST_LET:
+            generate_let(gen, stmt);
+            break;
+            
+        case AST_IF:
+            generate_if(gen, stmt);
+            break;
+            
+        case AST_WHILE:
+            generate_while(gen, stmt);
+            break;
+            
+        case AST_FOR:
+            generate_for(gen, stmt);
+            break;
+            
+        case AST_LOOP:
+            generate_loop(gen, stmt);
+            break;
+            
+        case AST_RETURN:
+            if (gen->return_slot && stmt->data.return_stmt.value) {
+                generate_slot_return(gen, stmt->data.return_stmt.value);
+                break;
+            }
+            codegen_write(gen, "return");
+            if (stmt->data.return_stmt.value) {
+                codegen_write(gen, " ");
+                generate_converted(gen, gen->return_type, stmt->data.return_stmt.value);
+            }
+            codegen_write(gen, ";");
+            break;
+            
+        case AST_BREAK:
+            codegen_write(gen, "break;");
+            break;
+            
+        case AST_CONTINUE:
+            codegen_write(gen, "continue;");
+            break;
+            
+        case AST_ASM:
+            generate_asm(gen, stmt);
+            break;
+            
+        default:
+            generate_expression(gen, stmt);
+            codegen_write(gen, ";");
+            break;
+    }
+}
+
+/**
+ * Writes the C return type of a JFM function: void when a large struct is
+ * returned through jfm_ret.
+ * 
+ * @param gen The code generator instance
+ * @param func The function AST node
+ */
+static void generate_return_type(CodeGenerator* gen, AstNode* func) {
+    if (layout_returns_via_slot(gen->program, func)) {
+        codegen_write(gen, "void");
+    } else {
+        generate_type(gen, func->data.function.return_type);
+    }
+}
+
+/**
+ * Writes a parenthesised C parameter list, starting with the jfm_ret slot
+ * for functions returning a large struct.
+ * 
+ * @param gen The code generator instance
+ * @param func The function AST node
+ * @param with_names Whether to include parameter names (false for pointer types)
+ */
+static void generate_parameters(CodeGenerator* gen, AstNode* func, bool with_names) {
+    bool slot = layout_returns_via_slot(gen->program, func);
+    size_t written = 0;
+    codegen_write(gen, "(");
+    
+    if (slot) {
+        generate_type(gen, func->data.function.return_type);
+        // restrict is not C++; on a prototype it does not change the type
+        if (gen->in_header) {
+            codegen_write(gen, "* jfm_ret");
+        } else {
+            codegen_write(gen, with_names ? "* restrict jfm_ret" : "* restrict");
+        }
+        written++;
+    }
+    
+    for (size_t i = 0; i < func->data.function.param_count; i++) {
+        // In a clone, a bound parameter is gone or only carries its environment
+        StaticFunction* bound = bound_parameter(gen, func, i);
+        if (bound && !needs_environment(bound)) continue;
+        
+        if (written++ > 0) codegen_write(gen, ", ");
+        if (bound) {
+            codegen_write(gen, with_names ? "void* jfm_env_%s" : "void*", func->data.function.params[i].name);
+            continue;
+        }
+        Type* param_type = func->data.function.params[i].type;
+        if (layout_passes_by_reference(gen->program, func, i)) {
+            codegen_write(gen, "const ");
+            generate_type(gen, param_type);
+            codegen_write(gen, "*");
+        } else {
+            // Array parameters are immutable, and const accepts const arguments
+            if (param_type && param_type->kind == TYPE_ARRAY && is_plain_array(gen, param_type)) {
+                codegen_write(gen, "const ");
+            }
+            generate_type(gen, param_type);
+        }
+        if (with_names) codegen_write(gen, " %s", func->data.function.params[i].name);
+        if (is_plain_array(gen, func->data.function.params[i].type) &&
+            func->data.function.params[i].type->kind == TYPE_ARRAY) {
+            codegen_write(gen, "[%zu]", flat_array_length(gen, func->data.function.params[i].type));
+        }
+    }
+    
+    if (written == 0) codegen_write(gen, "void");
+    codegen_write(gen, ")");
+}
+
+/**
+ * Generates a function body, with the state for returning through jfm_ret
+ * and for reading struct parameters passed by hidden reference.
+ * 
+ * @param gen The code generator instance
+ * @param func The function or method AST node
+ */
+static void generate_function_body(CodeGenerator* gen, AstNode* func) {
+    gen->return_slot = layout_returns_via_slot(gen->program, func);
+    gen->return_type = func->data.function.return_type;
+    gen->ref_param_capacity = func->data.function.param_count + 1;
+    gen->ref_params = malloc(sizeof(ReferenceParam) * gen->ref_param_capacity);
+    gen->ref_param_count = 0;
+    for (size_t i = 0; i < func->data.function.param_count; i++) {
+        if (layout_passes_by_reference(gen->program, func, i)) {
+            gen->ref_params[gen->ref_param_count].name = func->data.function.params[i].name;
+            gen->ref_params[gen->ref_param_count].shadowed_at = 0;
+            gen->ref_param_count++;
+        }
+    }
+    
+    generate_statement(gen, func->data.function.body);
+    
+    free(gen->ref_params);
+    gen->ref_params = NULL;
+    gen->ref_param_count = 0;
+    gen->return_slot = false;
+    gen->return_type = NULL;
+}
+
+static void prepare_function_values(AstNode* node, void* context);
+
+/**
+ * Emits the thunk giving a named function the closure calling convention,
+ * once per function: static R jfm_fn_f(void* jfm_env, params).
+ * 
+ * @param gen The code generator instance
+ * @param func The function AST node
+ */
+static void ensure_thunk(CodeGenerator* gen, AstNode* func) {
+    for (size_t i = 0; i < gen->thunk_count; i++) {
+        if (gen->thunks[i] == func) return;
+    }
+    if (gen->thunk_count >= gen->thunk_capacity) {
+        gen->thunk_capacity = gen->thunk_capacity ? gen->thunk_capacity * 2 : 8;
+        gen->thunks = realloc(gen->thunks, sizeof(AstNode*) * gen->thunk_capacity);
+    }
+    gen->thunks[gen->thunk_count++] = func;
+    
+    Type* return_type = func->data.function.return_type;
+    bool slot = layout_returns_via_slot(gen->program, func);
+    size_t param_count = func->data.function.param_count;
+    
+    codegen_write(gen, "static ");
+    generate_type(gen, return_type);
+    codegen_write(gen, " jfm_fn_%s(void* jfm_env", func->data.function.name);
+    for (size_t i = 0; i < param_count; i++) {
+        codegen_write(gen, ", ");
+        generate_parameter_type(gen, func->data.function.params[i].type);
+        codegen_write(gen, " jfm_a%zu", i);
+    }
+    codegen_write(gen, ") {\n");
+    gen->indent_level++;
+    codegen_writeln(gen, "(void)jfm_env;");
+    
+    codegen_indent(gen);
+    if (slot) {
+        generate_type(gen, return_type);
+        codegen_write(gen, " jfm_r;\n");
+        codegen_indent(gen);
+    } else if (return_type && return_type->kind != TYPE_VOID) {
+        codegen_write(gen, "return ");
+    }
+    generate_function_name(gen, func->data.function.name);
+    codegen_write(gen, slot ? "(&jfm_r" : "(");
+    for (size_t i = 0; i < param_count; i++) {
+        if (i > 0 || slot) codegen_write(gen, ", ");
+        codegen_write(gen, layout_passes_by_reference(gen->program, func, i) ? "&jfm_a%zu" : "jfm_a%zu", i);
+    }
+    codegen_write(gen, ");\n");
+    if (slot) codegen_writeln(gen, "return jfm_r;");
+    
+    gen->indent_level--;
+    codegen_writeln(gen, "}");
+    codegen_writeln(gen, "");
+}
+
+/**
+ * Emits a closure as a static C function taking its environment first,
+ * preceded by the struct of pointers that makes up the environment.
+ * 
+ * @param gen The code generator instance
+ * @param closure The closure AST node
+ */
+static void lift_closure(CodeGenerator* gen, AstNode* closure) {
+    size_t id = ++gen->closure_count;
+    closure->data.closure.id = id;
+    
+    // The body is a function of its own, generated before the enclosing one
+    Specialisation* spec = gen->current_specialisation;
+    const char* prologue = gen->block_prologue;
+    gen->current_specialisation = NULL;
+    gen->block_prologue = NULL;
+    ast_for_each_child(closure, prepare_function_values, gen);
+    
+    if (closure->data.closure.capture_count > 0) {
+        codegen_writeln(gen, "typedef struct {");
+        for (size_t i = 0; i < closure->data.closure.capture_count; i++) {
+            codegen_write(gen, "    ");
+            generate_type(gen, closure->data.closure.capture_types[i]);
+            codegen_write(gen, "* %s;\n", closure->data.closure.captures[i]);
+        }
+        codegen_writeln(gen, "} jfm_env%zu;", id);
+        codegen_writeln(gen, "");
+    }
+    
+    codegen_write(gen, "static ");
+    generate_type(gen, closure->data.closure.return_type);
+    codegen_write(gen, " jfm_closure%zu(void* jfm_env", id);
+    for (size_t i = 0; i < closure->data.closure.param_count; i++) {
+        codegen_write(gen, ", ");
+        generate_parameter_type(gen, closure->data.closure.params[i].type);
+        codegen_write(gen, " %s", closure->data.closure.params[i].name);
+    }
+    codegen_write(gen, ") ");
+    
+    gen->ref_param_capacity = closure->data.closure.capture_count + 1;
+    gen->ref_params = malloc(sizeof(ReferenceParam) * gen->ref_param_capacity);
+    gen->ref_param_count = 0;
+    gen->block_bindings = closure;
+    Type* return_type = gen->return_type;
+    gen->return_type = closure->data.closure.return_type;
+    generate_statement(gen, closure->data.closure.body);
+    gen->return_type = return_type;
+    free(gen->ref_params);
+    gen->ref_params = NULL;
+    gen->ref_param_count = 0;
+    codegen_write(gen, "\n\n");
+    
+    gen->current_specialisation = spec;
+    gen->block_prologue = prologue;
+}
+
+/**
+ * Emits the clone of a function for a set of bound parameters unless it
+ * already exists. Inside the clone, calls through a bound parameter are
+ * direct calls, and functions it passes on are specialised in turn.
+ * 
+ * @param gen The code generator instance
+ * @param func The function AST node
+ * @param targets Bound functions, one entry per parameter
+ */
+static void ensure_specialisation(CodeGenerator* gen, AstNode* func, StaticFunction* targets) {
+    if (find_specialisation(gen, func, targets)) return;
+    
+    size_t param_count = func->data.function.param_count;
+    Specialisation* spec = malloc(sizeof(Specialisation));
+    spec->function = func;
+    spec->targets = calloc(param_count + 1, sizeof(StaticFunction));
+    for (size_t i = 0; i < param_count; i++) {
+        spec->targets[i].function = targets[i].function;
+        spec->targets[i].closure = targets[i].closure;
+    }
+    
+    if (gen->specialisation_count >= gen->specialisation_capacity) {
+        gen->specialisation_capacity = gen->specialisation_capacity ? gen->specialisation_capacity * 2 : 8;
+        gen->specialisations = realloc(gen->specialisations, sizeof(Specialisation*) * gen->specialisation_capacity);
+    }
+    gen->specialisations[gen->specialisation_count++] = spec;
+    spec->id = gen->specialisation_count;
+    
+    Specialisation* outer = gen->current_specialisation;
+    const char* prologue = gen->block_prologue;
+    gen->current_specialisation = spec;
+    gen->block_prologue = NULL;
+    
+    // Declared first so that recursive calls reach the clone
+    codegen_write(gen, "static ");
+    generate_return_type(gen, func);
+    codegen_write(gen, " %s__spec%zu", func->data.function.name, spec->id);
+    generate_parameters(gen, func, true);
+    codegen_write(gen, ";\n\n");
+    
+    prepare_function_values(func->data.function.body, gen);
+    
+    codegen_write(gen, "static ");
+    generate_return_type(gen, func);
+    codegen_write(gen, " %s__spec%zu", func->data.function.name, spec->id);
+    generate_parameters(gen, func, true);
+    codegen_write(gen, " ");
+    generate_function_body(gen, func);
+    codegen_write(gen, "\n\n");
+    
+    gen->current_specialisation = outer;
+    gen->block_prologue = prologue;
+}
+
+/**
+ * Prepares the function values a call uses: known functions passed to a
+ * JFM function select a clone instead of being materialised as values.
+ * 
+ * @param gen The code generator instance
+ * @param call The call expression AST node
+ */
+static void prepare_call(CodeGenerator* gen, AstNode* call) {
+    AstNode* func = specialisable_callee(gen, call);
+    StaticFunction* targets = NULL;
+    bool specialise = false;
+    if (func) {
+        targets = malloc(sizeof(StaticFunction) * (func->data.function.param_count + 1));
+        specialise = bind_call_targets(gen, func, call, targets);
+    }
+    
+    if (call->data.call.function->type == AST_FIELD) {
+        prepare_function_values(call->data.call.function->data.field.object, gen);
+    }
+    
+    for (size_t i = 0; i < call->data.call.argument_count; i++) {
+        AstNode* arg = call->data.call.arguments[i];
+        bool bound = specialise && (targets[i].function || targets[i].closure);
+        if (!bound || arg->type == AST_CLOSURE) {
+            prepare_function_values(arg, gen);
+        }
+    }
+    
+    if (specialise) ensure_specialisation(gen, func, targets);
+    free(targets);
+}
+
+/**
+ * Walks a body before it is generated and emits what its function values
+ * need at file scope: lifted closures, thunks for named functions used as
+ * values, and clones for calls that pass known functions.
+ * 
+ * @param node The AST node to walk
+ * @param context The code generator instance
+ */
+static void prepare_function_values(AstNode* node, void* context) {
+    CodeGenerator* gen = context;
+    if (!node) return;
+    
+    switch (node->type) {
+        case AST_CLOSURE: {
+            if (node->data.closure.id == 0) lift_closure(gen, node);
+            
+            // Bound fn parameters the closure captures are materialised as values
+            for (size_t i = 0; i < node->data.closure.capture_count; i++) {
+                AstNode variable = { .type = AST_IDENTIFIER, .data_type = node->data.closure.capture_types[i] };
+                variable.data.identifier.name = node->data.closure.captures[i];
+                variable.data.identifier.param_number = node->data.closure.capture_params[i];
+                prepare_function_values(&variable, gen);
+            }
+            break;
+        }
+        
+        case AST_IDENTIFIER: {
+            StaticFunction target;
+            if (static_value_of(gen, node, &target) && target.function) {
+                ensure_thunk(gen, target.function);
+            }
+            break;
+        }
+        
+        case AST_CALL:
+            prepare_call(gen, node);
+            break;
+        
+        default:
+            ast_for_each_child(node, prepare_function_values, gen);
+            break;
+    }
+}
+
+/**
+ * Makes a function that is not pub static in library output.
+ * 
+ * @param gen The code generator instance
+ * @param func The function or method AST node
+ */
+static void generate_linkage(CodeGenerator* gen, AstNode* func) {
+    if (gen->library && !func->data.function.is_pub && strcmp(func->data.function.name, "main") != 0) {
+        codegen_write(gen, "static ");
+    }
+}
+
+/**
+ * Generates C code for function definitions.
+ * Includes return type, parameters, and function body.
+ * 
+ * @param gen The code generator instance
+ * @param func The function AST node
+ */
+static void generate_function(CodeGenerator* gen, AstNode* func) {
+    if (gen->uses_function_values) {
+        prepare_function_values(func->data.function.body, gen);
+    }
+    
+    generate_linkage(gen, func);
+    generate_return_type(gen, func);
+    codegen_write(gen, " %s", func->data.function.name);
+    generate_parameters(gen, func, true);
+    codegen_write(gen, " ");
+    
+    generate_function_body(gen, func);
+    codegen_write(gen, "\n\n");
+}
+
+/**
+ * Emits the GCC attribute for #[packed], #[align(N)] and #[cache_aligned]
+ * on a struct or field. aligned() is used rather than _Alignas because in
+ * a packed struct it may request less than the type's natural alignment.
+ * 
+ * @param gen The code generator instance
+ * @param attributes The attributes of the struct or field
+ * @param count Number of attributes
+ */
+static void generate_layout_attributes(CodeGenerator* gen, Attribute* attributes, size_t count) {
+    bool packed = layout_is_packed(attributes, count);
+    size_t align = layout_requested_align(attributes, count);
+    
+    if (packed && align) {
+        codegen_write(gen, " __attribute__((packed, aligned(%zu)))", align);
+    } else if (packed) {
+        codegen_write(gen, " __attribute__((packed))");
+    } else if (align) {
+        codegen_write(gen, " __attribute__((aligned(%zu)))", align);
+    }
+}
+
+typedef struct {
+    size_t* items;
+    size_t count;
+    size_t capacity;
+} LengthList;
+
+/**
+ * Records the length of every array of the named struct found in a type.
+ * 
+ * @param type The type to scan
+ * @param name The struct name
+ * @param lengths Distinct array lengths found so far
+ */
+static void collect_array_lengths(Type* type, const char* name, LengthList* lengths) {
+    if (!type) return;
+    
+    switch (type->kind) {
+        case TYPE_ARRAY: {
+            Type* element = type->data.array.element_type;
+            if (element && element->kind == TYPE_STRUCT && strcmp(element->data.struct_type.name, name) == 0) {
+                for (size_t i = 0; i < lengths->count; i++) {
+                    if (lengths->items[i] == type->data.array.size) return;
+                }
+                if (lengths->count >= lengths->capacity) {
+                    lengths->capacity = lengths->capacity == 0 ? 4 : lengths->capacity * 2;
+                    lengths->items = realloc(lengths->items, sizeof(size_t) * lengths->capacity);
+                }
+                lengths->items[lengths->count++] = type->data.array.size;
+            } else {
+                collect_array_lengths(element, name, lengths);
+            }
+            break;
+        }
+        case TYPE_POINTER:
+            collect_array_lengths(type->data.pointer.pointed_type, name, lengths);
+            break;
+        case TYPE_REFERENCE:
+            collect_array_lengths(type->data.reference.referenced_type, name, lengths);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Walks declarations and statements, recording the lengths of all arrays
+ * of the named struct (lets, parameters, return types and fields).
+ * 
+ * @param node The node to scan
+ * @param name The struct name
+ * @param lengths Distinct array lengths found so far
+ */
+static void collect_struct_arrays(AstNode* node, const char* name, LengthList* lengths) {
+    if (!node) return;
+    
+    switch (node->type) {
+        case AST_PROGRAM:
+            for (size_t i = 0; i < node->data.program.count; i++) {
+                collect_struct_arrays(node->data.program.items[i], name, lengths);
+            }
+            break;
+        case AST_LET:
+            collect_array_lengths(node->data.let_stmt.type, name, lengths);
+            break;
+        case AST_BLOCK:
+            for (size_t i = 0; i < node->data.block.statement_count; i++) {
+                collect_struct_arrays(node->data.block.statements[i], name, lengths);
+            }
+            break;
+        case AST_IF:
+            collect_struct_arrays(node->data.if_stmt.then_branch, name, lengths);
+            collect_struct_arrays(node->data.if_stmt.else_branch, name, lengths);
+            break;
+        case AST_WHILE:
+            collect_struct_arrays(node->data.while_loop.body, name, lengths);
+            break;
+        case AST_FOR:
+            collect_struct_arrays(node->data.for_loop.body, name, lengths);
+            break;
+        case AST_LOOP:
+            collect_struct_arrays(node->data.loop_stmt.body, name, lengths);
+            break;
+        case AST_FUNCTION:
+            for (size_t i = 0; i < node->data.function.param_count; i++) {
+                collect_array_lengths(node->data.function.params[i].type, name, lengths);
+            }
+            collect_array_lengths(node->data.function.return_type, name, lengths);
+            collect_struct_arrays(node->data.function.body, name, lengths);
+            break;
+        case AST_IMPL:
+            for (size_t i = 0; i < node->data.impl_block.function_count; i++) {
+                collect_struct_arrays(node->data.impl_block.functions[i], name, lengths);
+            }
+            break;
+        case AST_STRUCT:
+            for (size_t i = 0; i < node->data.struct_def.field_count; i++) {
+                collect_array_lengths(node->data.struct_def.fields[i].type, name, lengths);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Emits the struct-of-arrays type for every array length of a #[soa]
+ * struct used in the program: [Particle; 100] becomes Particle_soa_100
+ * with one 100-element array per field.
+ * 
+ * @param gen The code generator instance
+ * @param struct_def The #[soa] struct definition
+ */
+static void generate_soa_arrays(CodeGenerator* gen, AstNode* struct_def) {
+    const char* name = struct_def->data.struct_def.name;
+    LengthList lengths = { NULL, 0, 0 };
+    collect_struct_arrays(gen->program, name, &lengths);
+    
+    for (size_t i = 0; i < lengths.count; i++) {
+        size_t length = lengths.items[i];
+        codegen_writeln(gen, "typedef struct %s_soa_%zu {", name, length);
+        gen->indent_level++;
+        
+        for (size_t j = 0; j < struct_def->data.struct_def.field_count; j++) {
+            Field* field = &struct_def->data.struct_def.fields[j];
+            codegen_indent(gen);
+            if (field->type && field->type->kind == TYPE_ARRAY && !layout_soa_struct(gen->program, field->type)) {
+                generate_type(gen, field->type->data.array.element_type);
+                codegen_write(gen, " %s[%zu][%zu];\n", field->name, length, flat_array_length(gen, field->type));
+            } else {
+                generate_type(gen, field->type);
+                codegen_write(gen, " %s[%zu];\n", field->name, length);
+            }
+        }
+        
+        gen->indent_level--;
+        codegen_writeln(gen, "} %s_soa_%zu;\n", name, length);
+    }
+    
+    free(lengths.items);
+}
+
+/**
+ * Generates C code for struct definitions.
+ * Creates typedef struct with all fields. Skips extern structs.
+ * Fields are emitted in the order chosen by layout_of_struct(), which
+ * minimises padding unless the struct is #[repr(C)]. A #[soa] struct is
+ * followed by its struct-of-arrays types.
+ * 
+ * @param gen The code generator instance
+ * @param struct_def The struct definition AST node
+ */
+static void generate_struct(CodeGenerator* gen, AstNode* struct_def) {
+    if (struct_def->data.struct_def.is_extern) {
+        return;
+    }
+    
+    codegen_writeln(gen, "typedef struct %s {", struct_def->data.struct_def.name);
+    gen->indent_level++;
+    
+    const StructLayout* layout = layout_of_struct(gen->program, struct_def);
+    
+    for (size_t i = 0; i < struct_def->data.struct_def.field_count; i++) {
+        Field* field = &struct_def->data.struct_def.fields[layout->order[i]];
+        codegen_indent(gen);
+        if (field->type && field->type->kind == TYPE_ARRAY && !layout_soa_struct(gen->program, field->type)) {
+            generate_type(gen, field->type->data.array.element_type);
+            codegen_write(gen, " %s[%zu]", field->name, flat_array_length(gen, field->type));
+        } else {
+            generate_type(gen, field->type);
+            codegen_write(gen, " %s", field->name);
+        }
+        generate_layout_attributes(gen, field->attributes, field->attribute_count);
+        codegen_write(gen, ";\n");
+    }
+    
+    gen->indent_level--;
+    codegen_indent(gen);
+    codegen_write(gen, "}");
+    generate_layout_attributes(gen, struct_def->attributes, struct_def->attribute_count);
+    codegen_write(gen, " %s;\n\n", struct_def->data.struct_def.name);
+    
+    if (ast_find_attribute(struct_def->attributes, struct_def->attribute_count, "soa")) {
+        generate_soa_arrays(gen, struct_def);
+    }
+}
+
+/**
+ * Generates C code for impl blocks.
+ * Converts methods to regular C functions with StructName_methodName naming.
+ * 
+ * @param gen The code generator instance
+ * @param impl The impl block AST node
+ */
+static void generate_impl(CodeGenerator* gen, AstNode* impl) {
+    for (size_t i = 0; i < impl->data.impl_block.function_count; i++) {
+        AstNode* method = impl->data.impl_block.functions[i];
+        if (gen->uses_function_values) {
+            prepare_function_values(method->data.function.body, gen);
+        }
+        
+        generate_linkage(gen, method);
+        generate_return_type(gen, method);
+        codegen_write(gen, " %s_%s", 
+                     impl->data.impl_block.struct_name,
+                     method->data.function.name);
+        generate_parameters(gen, method, true);
+        codegen_write(gen, " ");
+        
+        generate_function_body(gen, method);
+        codegen_write(gen, "\n\n");
+    }
+}
+
+/**
+ * Writes a function pointer declaration for the hot-reload table,
+ * e.g. static i32 (*jfm_hot_add)(i32, i32);
+ * 
+ * @param gen The code generator instance
+ * @param c_name The C-level function name
+ * @param func The function AST node providing the signature
+ */
+static void generate_hot_pointer(CodeGenerator* gen, const char* c_name, AstNode* func) {
+    codegen_write(gen, "static ");
+    generate_return_type(gen, func);
+    codegen_write(gen, " (*jfm_hot_%s)", c_name);
+    generate_parameters(gen, func, false);
+    codegen_write(gen, ";\n");
+}
+
+/**
+ * Generates the host-side runtime for hot reloading: the function pointer
+ * table, a loader that rebinds every pointer from a freshly built shared
+ * object, and a rate-limited poll that watches the manifest file.
+ * 
+ * @param gen The code generator instance
+ * @param program The program AST node
+ */
+static void generate_hot_runtime(CodeGenerator* gen, AstNode* program) {
+    size_t symbol_count = 0;
+    
+    codegen_writeln(gen, "#include <string.h>");
+    codegen_writeln(gen, "#include <time.h>");
+    codegen_writeln(gen, "#include <dlfcn.h>");
+    codegen_writeln(gen, "");
+    
+    codegen_write(gen, "#define JFM_HOT_MANIFEST \"");
+    for (const char* c = gen->hot_manifest; *c; c++) {
+        if (*c == '"' || *c == '\\') codegen_write(gen, "\\");
+        codegen_write(gen, "%c", *c);
+    }
+    codegen_write(gen, "\"\n\n");
+    
+    for (size_t i = 0; i < program->data.program.count; i++) {
+        AstNode* item = program->data.program.items[i];
+        if (item->type == AST_FUNCTION && strcmp(item->data.function.name, "main") != 0) {
+            generate_hot_pointer(gen, item->data.function.name, item);
+            symbol_count++;
+        } else if (item->type == AST_IMPL) {
+            for (size_t j = 0; j < item->data.impl_block.function_count; j++) {
+                AstNode* method = item->data.impl_block.functions[j];
+                size_t len = strlen(item->data.impl_block.struct_name) + strlen(method->data.function.name) + 2;
+                char* c_name = malloc(len);
+                snprintf(c_name, len, "%s_%s", item->data.impl_block.struct_name, method->data.function.name);
+                generate_hot_pointer(gen, c_name, method);
+                free(c_name);
+                symbol_count++;
             }
-            break;
-            
-        case AST_IDENTIFIER: {
-            const char* name = expr->data.identifier.name;
-            const char* coloncolon = strstr(name, "::");
-            if (coloncolon) {
-                size_t prefix_len = coloncolon - name;
-                codegen_write(gen, "%.*s_%s", (int)prefix_len, name, coloncolon + 2);
-            } else {
-                codegen_write(gen, "%s", name);
+        }
+    }
+    
+    codegen_writeln(gen, "");
+    codegen_writeln(gen, "static void* jfm_hot_handle = NULL;");
+    codegen_writeln(gen, "static char jfm_hot_path[4096];");
+    codegen_writeln(gen, "static struct timespec jfm_hot_last_poll;");
+    codegen_writeln(gen, "");
+    
+    codegen_writeln(gen, "static int jfm_hot_load(const char* path) {");
+    gen->indent_level++;
+    codegen_writeln(gen, "static const char* const names[] = {");
+    gen->indent_level++;
+    for (size_t i = 0; i < program->data.program.count; i++) {
+        AstNode* item = program->data.program.items[i];
+        if (item->type == AST_FUNCTION && strcmp(item->data.function.name, "main") != 0) {
+            codegen_writeln(gen, "\"%s\",", item->data.function.name);
+        } else if (item->type == AST_IMPL) {
+            for (size_t j = 0; j < item->data.impl_block.function_count; j++) {
+                codegen_writeln(gen, "\"%s_%s\",", item->data.impl_block.struct_name,
+                               item->data.impl_block.functions[j]->data.function.name);
             }
-            break;
         }
-            
-        case AST_BINARY_OP:
-            generate_binary_op(gen, expr);
+    }
+    codegen_writeln(gen, "NULL");
+    gen->indent_level--;
+    codegen_writeln(gen, "};");
+    codegen_writeln(gen, "void* syms[%lu];", (unsigned long)symbol_count + 1);
+    codegen_writeln(gen, "void* handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);");
+    codegen_writeln(gen, "if (!handle) {");
+    codegen_writeln(gen, "    fprintf(stderr, \"hot-reload: %%s\\n\", dlerror());");
+    codegen_writeln(gen, "    return 0;");
+    codegen_writeln(gen, "}");
+    codegen_writeln(gen, "for (int i = 0; names[i]; i++) {");
+    codegen_writeln(gen, "    syms[i] = dlsym(handle, names[i]);");
+    codegen_writeln(gen, "    if (!syms[i]) {");
+    codegen_writeln(gen, "        fprintf(stderr, \"hot-reload: missing symbol '%%s'\\n\", names[i]);");
+    codegen_writeln(gen, "        dlclose(handle);");
+    codegen_writeln(gen, "        return 0;");
+    codegen_writeln(gen, "    }");
+    codegen_writeln(gen, "}");
+    
+    size_t slot = 0;
+    for (size_t i = 0; i < program->data.program.count; i++) {
+        AstNode* item = program->data.program.items[i];
+        if (item->type == AST_FUNCTION && strcmp(item->data.function.name, "main") != 0) {
+            codegen_writeln(gen, "*(void**)(&jfm_hot_%s) = syms[%lu];", item->data.function.name, (unsigned long)slot++);
+        } else if (item->type == AST_IMPL) {
+            for (size_t j = 0; j < item->data.impl_block.function_count; j++) {
+                codegen_writeln(gen, "*(void**)(&jfm_hot_%s_%s) = syms[%lu];", item->data.impl_block.struct_name,
+                               item->data.impl_block.functions[j]->data.function.name, (unsigned long)slot++);
+            }
+        }
+    }
+    
+    codegen_writeln(gen, "if (jfm_hot_handle) dlclose(jfm_hot_handle);");
+    codegen_writeln(gen, "jfm_hot_handle = handle;");
+    codegen_writeln(gen, "return 1;");
+    gen->indent_level--;
+    codegen_writeln(gen, "}");
+    codegen_writeln(gen, "");
+    
+    codegen_writeln(gen, "static void jfm_hot_poll(void) {");
+    gen->indent_level++;
+    codegen_writeln(gen, "struct timespec now;");
+    codegen_writeln(gen, "clock_gettime(CLOCK_MONOTONIC, &now);");
+    codegen_writeln(gen, "long elapsed_ms = (long)(now.tv_sec - jfm_hot_last_poll.tv_sec) * 1000 +");
+    codegen_writeln(gen, "                   (now.tv_nsec - jfm_hot_last_poll.tv_nsec) / 1000000;");
+    codegen_writeln(gen, "if (jfm_hot_handle && elapsed_ms < 100) return;");
+    codegen_writeln(gen, "jfm_hot_last_poll = now;");
+    codegen_writeln(gen, "FILE* manifest = fopen(JFM_HOT_MANIFEST, \"r\");");
+    codegen_writeln(gen, "if (!manifest) return;");
+    codegen_writeln(gen, "char path[sizeof(jfm_hot_path)];");
+    codegen_writeln(gen, "if (fgets(path, sizeof(path), manifest)) {");
+    codegen_writeln(gen, "    path[strcspn(path, \"\\n\")] = '\\0';");
+    codegen_writeln(gen, "    if (strcmp(path, jfm_hot_path) != 0 && jfm_hot_load(path)) {");
+    codegen_writeln(gen, "        strcpy(jfm_hot_path, path);");
+    codegen_writeln(gen, "    }");
+    codegen_writeln(gen, "}");
+    codegen_writeln(gen, "fclose(manifest);");
+    gen->indent_level--;
+    codegen_writeln(gen, "}");
+    codegen_writeln(gen, "");
+    
+    codegen_writeln(gen, "static void jfm_hot_start(void) {");
+    gen->indent_level++;
+    codegen_writeln(gen, "jfm_hot_poll();");
+    codegen_writeln(gen, "if (!jfm_hot_handle) {");
+    codegen_writeln(gen, "    fprintf(stderr, \"hot-reload: could not load code from '%%s'\\n\", JFM_HOT_MANIFEST);");
+    codegen_writeln(gen, "    exit(1);");
+    codegen_writeln(gen, "}");
+    gen->indent_level--;
+    codegen_writeln(gen, "}");
+    codegen_writeln(gen, "");
+}
+
+/**
+ * Generates the body of a program in hot-reload mode. Everything except
+ * main() is compiled only with JFM_HOT_LIB defined (the shared object);
+ * otherwise the host runtime and main() are emitted, and main() reaches
+ * every other function through the reloadable pointer table.
+ * 
+ * @param gen The code generator instance
+ * @param program The program AST node
+ */
+static void generate_hot_program(CodeGenerator* gen, AstNode* program) {
+    AstNode* main_func = NULL;
+    
+    codegen_writeln(gen, "#ifdef JFM_HOT_LIB");
+    for (size_t i = 0; i < program->data.program.count; i++) {
+        if (program->data.program.items[i]->type == AST_IMPL) {
+            generate_impl(gen, program->data.program.items[i]);
+        }
+    }
+    
+    for (size_t i = 0; i < program->data.program.count; i++) {
+        AstNode* item = program->data.program.items[i];
+        if (item->type != AST_FUNCTION) continue;
+        if (strcmp(item->data.function.name, "main") == 0) {
+            main_func = item;
+        } else {
+            generate_function(gen, item);
+        }
+    }
+    
+    codegen_writeln(gen, "#else");
+    gen->thunk_count = 0;   // Thunks in the host call through the pointer table
+    generate_hot_runtime(gen, program);
+    
+    if (main_func) {
+        gen->in_hot_host = true;
+        gen->block_prologue = "jfm_hot_start();";
+        generate_function(gen, main_func);
+        gen->in_hot_host = false;
+    }
+    codegen_writeln(gen, "#endif");
+}
+
+/**
+ * Checks whether a type is or contains a fn type.
+ * 
+ * @param type The type to check (may be NULL)
+ * @return true if values of the type hold jfm_fn
+ */
+static bool type_mentions_function(Type* type) {
+    if (!type) return false;
+    
+    switch (type->kind) {
+        case TYPE_FUNCTION:
+            return true;
+        case TYPE_ARRAY:
+            return type_mentions_function(type->data.array.element_type);
+        case TYPE_POINTER:
+            return type_mentions_function(type->data.pointer.pointed_type);
+        case TYPE_REFERENCE:
+            return type_mentions_function(type->data.reference.referenced_type);
+        default:
+            return false;
+    }
+}
+
+/**
+ * Finds whether a program uses closures or fn types, so the jfm_fn
+ * typedef and the preparation pass are only emitted when needed.
+ * 
+ * @param node The AST node to search
+ * @param context Pointer to the bool set when a function value is found
+ */
+static void find_function_values(AstNode* node, void* context) {
+    bool* found = context;
+    if (*found) return;
+    
+    if (node->type == AST_CLOSURE || type_mentions_function(node->data_type) ||
+        (node->type == AST_LET && type_mentions_function(node->data.let_stmt.type))) {
+        *found = true;
+        return;
+    }
+    if (node->type == AST_FUNCTION) {
+        for (size_t i = 0; i < node->data.function.param_count; i++) {
+            if (type_mentions_function(node->data.function.params[i].type)) *found = true;
+        }
+        if (type_mentions_function(node->data.function.return_type)) *found = true;
+    }
+    if (node->type == AST_STRUCT) {
+        for (size_t i = 0; i < node->data.struct_def.field_count; i++) {
+            if (type_mentions_function(node->data.struct_def.fields[i].type)) *found = true;
+        }
+    }
+    
+    ast_for_each_child(node, find_function_values, context);
+}
+
+/**
+ * Hashes a type consistently with types_equal: equal types hash alike.
+ * 
+ * @param type The type to hash (may be NULL)
+ * @return The hash value
+ */
+static size_t type_hash(Type* type) {
+    if (!type) return 0;
+    
+    size_t hash = (size_t)type->kind * 31 + 7;
+    switch (type->kind) {
+        case TYPE_ARRAY:
+            return hash * 33 + type_hash(type->data.array.element_type) * 17 + type->data.array.size;
+        case TYPE_POINTER:
+            return hash * 33 + type_hash(type->data.pointer.pointed_type);
+        case TYPE_REFERENCE:
+            return hash * 33 + type_hash(type->data.reference.referenced_type) * 2 + type->data.reference.is_mutable;
+        case TYPE_STRUCT:
+            for (const char* c = type->data.struct_type.name; *c; c++) {
+                hash = hash * 33 + (unsigned char)*c;
+            }
+            return hash;
+        case TYPE_OPTION:
+            return hash * 33 + type_hash(type->data.option.value_type);
+        case TYPE_RESULT:
+            return (hash * 33 + type_hash(type->data.result.ok_type)) * 33 + type_hash(type->data.result.err_type);
+        case TYPE_FUNCTION: {
+            for (size_t i = 0; i < type->data.function.param_count; i++) {
+                hash = hash * 33 + type_hash(type->data.function.param_types[i]);
+            }
+            // A missing return type and void are the same
+            Type* return_type = type->data.function.return_type;
+            return hash * 33 + (return_type && return_type->kind != TYPE_VOID ? type_hash(return_type) : 0);
+        }
+        default:
+            return hash;
+    }
+}
+
+/**
+ * Rebuilds the wrapper hash from wrapper_types.
+ * 
+ * @param gen The code generator instance
+ * @param size Number of slots (a power of two, over twice the wrapper count)
+ */
+static void index_wrappers(CodeGenerator* gen, size_t size) {
+    free(gen->wrapper_index);
+    gen->wrapper_index = calloc(size, sizeof(size_t));
+    gen->wrapper_index_size = size;
+    
+    for (size_t i = 0; i < gen->wrapper_count; i++) {
+        size_t slot = type_hash(gen->wrapper_types[i].type) & (size - 1);
+        while (gen->wrapper_index[slot]) slot = (slot + 1) & (size - 1);
+        gen->wrapper_index[slot] = i + 1;
+    }
+}
+
+/**
+ * Adds an Option or Result instantiation to the typedefs the prelude
+ * emits, unless an equal one is already listed.
+ * 
+ * @param gen The code generator instance
+ * @param type The Option or Result type
+ */
+static void add_wrapper_type(CodeGenerator* gen, Type* type) {
+    if ((gen->wrapper_count + 1) * 2 > gen->wrapper_index_size) {
+        index_wrappers(gen, gen->wrapper_index_size ? gen->wrapper_index_size * 2 : 16);
+    }
+    
+    size_t mask = gen->wrapper_index_size - 1;
+    size_t slot = type_hash(type) & mask;
+    while (gen->wrapper_index[slot]) {
+        if (types_equal(gen->wrapper_types[gen->wrapper_index[slot] - 1].type, type)) return;
+        slot = (slot + 1) & mask;
+    }
+    
+    if (gen->wrapper_count >= gen->wrapper_capacity) {
+        gen->wrapper_capacity = gen->wrapper_capacity ? gen->wrapper_capacity * 2 : 8;
+        gen->wrapper_types = realloc(gen->wrapper_types, gen->wrapper_capacity * sizeof(WrapperType));
+    }
+    gen->wrapper_types[gen->wrapper_count].type = type;
+    gen->wrapper_types[gen->wrapper_count].order = gen->wrapper_count;
+    gen->wrapper_types[gen->wrapper_count].ready_after = 0;
+    gen->wrapper_count++;
+    gen->wrapper_index[slot] = gen->wrapper_count;
+}
+
+/**
+ * Records the numeric types and Option / Result instantiations of a type
+ * that need prelude definitions, looking through arrays, pointers,
+ * references, fn signatures and payloads. Payloads are recorded before
+ * the types wrapping them, so typedefs come out in dependency order.
+ * 
+ * @param gen The code generator instance
+ * @param type The type to check (may be NULL)
+ */
+static void note_prelude_type(CodeGenerator* gen, Type* type) {
+    if (!type) return;
+    
+    switch (type->kind) {
+        case TYPE_I128:
+        case TYPE_U128:
+            gen->uses_wide_integers = true;
             break;
-            
-        case AST_UNARY_OP:
-            generate_unary_op(gen, expr);
+        case TYPE_F16:
+            gen->uses_f16 = true;
             break;
-            
-        case AST_CAST:
-            codegen_write(gen, "(");
-            generate_type(gen, expr->data.cast.target_type);
-            codegen_write(gen, ")");
-            generate_expression(gen, expr->data.cast.expression);
+        case TYPE_BF16:
+            gen->uses_bf16 = true;
             break;
-            
-        case AST_CALL:
-            generate_call(gen, expr);
+        case TYPE_ARRAY:
+            note_prelude_type(gen, type->data.array.element_type);
             break;
-            
-        case AST_INDEX:
-            generate_expression(gen, expr->data.index.array);
-            codegen_write(gen, "[");
-            generate_expression(gen, expr->data.index.index);
-            codegen_write(gen, "]");
+        case TYPE_POINTER:
+            note_prelude_type(gen, type->data.pointer.pointed_type);
             break;
-            
-        case AST_FIELD:
-            generate_expression(gen, expr->data.field.object);
-            codegen_write(gen, ".%s", expr->data.field.field_name);
+        case TYPE_REFERENCE:
+            note_prelude_type(gen, type->data.reference.referenced_type);
             break;
-            
-        case AST_ASSIGNMENT:
-            generate_expression(gen, expr->data.assignment.target);
-            codegen_write(gen, " = ");
-            generate_expression(gen, expr->data.assignment.value);
+        case TYPE_FUNCTION:
+            for (size_t i = 0; i < type->data.function.param_count; i++) {
+                note_prelude_type(gen, type->data.function.param_types[i]);
+            }
+            note_prelude_type(gen, type->data.function.return_type);
             break;
-            
-        case AST_ARRAY_LITERAL:
-            codegen_write(gen, "{");
-            for (size_t i = 0; i < expr->data.array_literal.element_count; i++) {
-                if (i > 0) codegen_write(gen, ", ");
-                generate_expression(gen, expr->data.array_literal.elements[i]);
+        case TYPE_OPTION:
+            if (!type->data.option.value_type) break;
+            gen->uses_wrappers = true;
+            note_prelude_type(gen, type->data.option.value_type);
+            if (layout_option_niche(type) == NICHE_NONE) add_wrapper_type(gen, type);
+            break;
+        case TYPE_RESULT:
+            if (!type->data.result.ok_type || !type->data.result.err_type) break;
+            gen->uses_wrappers = true;
+            note_prelude_type(gen, type->data.result.ok_type);
+            note_prelude_type(gen, type->data.result.err_type);
+            add_wrapper_type(gen, type);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Finds whether a program uses i128/u128, f16, bf16, Option / Result,
+ * the byte access builtins or serialisers, so their typedefs and helpers
+ * are only emitted when needed.
+ * 
+ * @param node The AST node to search
+ * @param context The code generator instance
+ */
+static void find_prelude_uses(AstNode* node, void* context) {
+    CodeGenerator* gen = context;
+    
+    note_prelude_type(gen, node->data_type);
+    switch (node->type) {
+        case AST_LET:
+            note_prelude_type(gen, node->data.let_stmt.type);
+            break;
+        case AST_CAST:
+            note_prelude_type(gen, node->data.cast.target_type);
+            break;
+        case AST_FUNCTION:
+            for (size_t i = 0; i < node->data.function.param_count; i++) {
+                note_prelude_type(gen, node->data.function.params[i].type);
             }
-            codegen_write(gen, "}");
+            note_prelude_type(gen, node->data.function.return_type);
             break;
-            
-        case AST_STRUCT_LITERAL:
-            if (gen->in_struct_init) {
-                codegen_write(gen, "{");
-            } else {
-                codegen_write(gen, "(%s){", expr->data.struct_literal.struct_name);
+        case AST_EXTERN_FUNCTION:
+            for (size_t i = 0; i < node->data.extern_function.param_count; i++) {
+                note_prelude_type(gen, node->data.extern_function.params[i].type);
             }
-            
-            gen->in_struct_init = true;
-            for (size_t i = 0; i < expr->data.struct_literal.field_count; i++) {
-                if (i > 0) codegen_write(gen, ", ");
-                codegen_write(gen, ".%s = ", expr->data.struct_literal.field_names[i]);
-                generate_expression(gen, expr->data.struct_literal.field_values[i]);
+            note_prelude_type(gen, node->data.extern_function.return_type);
+            break;
+        case AST_STRUCT:
+            for (size_t i = 0; i < node->data.struct_def.field_count; i++) {
+                note_prelude_type(gen, node->data.struct_def.fields[i].type);
             }
-            gen->in_struct_init = false;
             
-            codegen_write(gen, "}");
+            // encode and decode return Option<u64> and Option<Struct>
+            if (semantic_derives(node, "Encode")) {
+                Type* result_type = type_create(TYPE_OPTION);
+                result_type->data.option.value_type = type_create(TYPE_U64);
+                note_prelude_type(gen, result_type);
+                gen->uses_serialisers = true;
+            }
+            if (semantic_derives(node, "Decode")) {
+                Type* struct_type = type_create(TYPE_STRUCT);
+                struct_type->data.struct_type.name = string_duplicate(node->data.struct_def.name);
+                Type* result_type = type_create(TYPE_OPTION);
+                result_type->data.option.value_type = struct_type;
+                note_prelude_type(gen, result_type);
+                gen->uses_serialisers = true;
+            }
             break;
-            
+        case AST_CALL: {
+            ByteAccess access;
+            AstNode* callee = node->data.call.function;
+            if (callee->type == AST_IDENTIFIER && semantic_byte_access(callee->data.identifier.name, &access)) {
+                gen->uses_byte_access = true;
+            }
+            break;
+        }
         default:
-            codegen_write(gen, "/* unsupported expression */");
             break;
     }
+    
+    ast_for_each_child(node, find_prelude_uses, context);
 }
 
 /**
- * Generates C code for variable declarations (let statements).
- * Handles const qualification for immutable variables, type inference,
- * and special array declaration syntax.
+ * Emits the C spelling of the extended numeric types a program uses.
+ * 128-bit integers map to the compiler's __int128, f16 to _Float16, and
+ * bf16 is emulated as its bit pattern with round-to-nearest-even
+ * conversions, since C compilers only started shipping __bf16 recently.
+ * 
+ * @param gen The code generator instance
+ */
+static void generate_numeric_prelude(CodeGenerator* gen) {
+    if (gen->uses_wide_integers) {
+        codegen_writeln(gen, "__extension__ typedef __int128 jfm_i128;");
+        codegen_writeln(gen, "__extension__ typedef unsigned __int128 jfm_u128;");
+        codegen_writeln(gen, "static inline void jfm_print_u128(jfm_u128 value, const char* end) {");
+        codegen_writeln(gen, "    char digits[40];");
+        codegen_writeln(gen, "    size_t i = sizeof(digits) - 1;");
+        codegen_writeln(gen, "    digits[i] = '\\0';");
+        codegen_writeln(gen, "    do { digits[--i] = (char)('0' + (int)(value %% 10)); value /= 10; } while (value);");
+        codegen_writeln(gen, "    printf(\"%%s%%s\", digits + i, end);");
+        codegen_writeln(gen, "}");
+        codegen_writeln(gen, "static inline void jfm_print_i128(jfm_i128 value, const char* end) {");
+        codegen_writeln(gen, "    if (value < 0) putchar('-');");
+        codegen_writeln(gen, "    jfm_print_u128(value < 0 ? -(jfm_u128)value : (jfm_u128)value, end);");
+        codegen_writeln(gen, "}");
+        codegen_writeln(gen, "");
+    }
+    
+    if (gen->uses_f16) {
+        codegen_writeln(gen, "__extension__ typedef _Float16 jfm_f16;");
+        codegen_writeln(gen, "#define jfm_f16_to_f32(value) ((float)(value))");
+        codegen_writeln(gen, "#define jfm_f32_to_f16(value) ((jfm_f16)(value))");
+        codegen_writeln(gen, "");
+    }
+    
+    if (gen->uses_bf16) {
+        codegen_writeln(gen, "typedef struct { uint16_t bits; } jfm_bf16;");
+        codegen_writeln(gen, "static inline float jfm_bf16_to_f32(jfm_bf16 value) {");
+        codegen_writeln(gen, "    union { uint32_t bits; float value; } u = { (uint32_t)value.bits << 16 };");
+        codegen_writeln(gen, "    return u.value;");
+        codegen_writeln(gen, "}");
+        codegen_writeln(gen, "static inline jfm_bf16 jfm_f32_to_bf16(float value) {");
+        codegen_writeln(gen, "    union { float value; uint32_t bits; } u = { value };");
+        codegen_writeln(gen, "    if ((u.bits & 0x7fffffffu) > 0x7f800000u) return (jfm_bf16){ (uint16_t)((u.bits >> 16) | 0x40u) };");
+        codegen_writeln(gen, "    u.bits += 0x7fffu + ((u.bits >> 16) & 1u);");
+        codegen_writeln(gen, "    return (jfm_bf16){ (uint16_t)(u.bits >> 16) };");
+        codegen_writeln(gen, "}");
+        codegen_writeln(gen, "");
+    }
+}
+
+/**
+ * Finds how many program items must be emitted before a type is
+ * complete: one past the last struct it contains, looking through every
+ * type it contains.
+ * 
+ * @param gen The code generator instance
+ * @param type The type to check
+ * @return The item count, or SIZE_MAX if it names an unknown struct
+ */
+static size_t wrapper_ready_after(CodeGenerator* gen, Type* type) {
+    switch (type->kind) {
+        case TYPE_STRUCT: {
+            size_t position = layout_struct_position(gen->program, type->data.struct_type.name);
+            return position == SIZE_MAX ? SIZE_MAX : position + 1;
+        }
+        case TYPE_ARRAY:
+            return wrapper_ready_after(gen, type->data.array.element_type);
+        case TYPE_POINTER:
+            return wrapper_ready_after(gen, type->data.pointer.pointed_type);
+        case TYPE_REFERENCE:
+            return wrapper_ready_after(gen, type->data.reference.referenced_type);
+        case TYPE_OPTION:
+            return wrapper_ready_after(gen, type->data.option.value_type);
+        case TYPE_RESULT: {
+            size_t ok = wrapper_ready_after(gen, type->data.result.ok_type);
+            size_t err = wrapper_ready_after(gen, type->data.result.err_type);
+            return ok > err ? ok : err;
+        }
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Orders wrappers by the point they become complete, then by the order
+ * they were recorded in so payloads still come before their wrappers.
+ */
+static int compare_wrappers(const void* a, const void* b) {
+    const WrapperType* left = a;
+    const WrapperType* right = b;
+    if (left->ready_after != right->ready_after) return left->ready_after < right->ready_after ? -1 : 1;
+    return left->order < right->order ? -1 : left->order > right->order;
+}
+
+/**
+ * Emits the typedefs of the Option and Result instantiations whose
+ * payloads are complete once the first program items are emitted. They
+ * are called before the struct definitions and after each one, so a
+ * struct can hold an Option of an earlier struct and vice versa. The
+ * first call sorts the wrappers by the struct each one waits for, so
+ * every later call only looks at the wrappers it emits.
  * 
  * @param gen The code generator instance
- * @param stmt The let statement AST node
+ * @param defined Number of program items emitted so far
  */
-static void generate_let(CodeGenerator* gen, AstNode* stmt) {
-    if (!stmt->data.let_stmt.is_mutable) {
-        codegen_write(gen, "const ");
-    }
-    
-    Type* type = stmt->data.let_stmt.type;
-    if (!type && stmt->data.let_stmt.value) {
-        type = stmt->data.let_stmt.value->data_type;
-    }
-    
-    if (!type) {
-        codegen_write(gen, "/* ERROR: missing type */ void");
-        codegen_write(gen, " %s", stmt->data.let_stmt.name);
-        if (stmt->data.let_stmt.value) {
-            codegen_write(gen, " = ");
-            generate_expression(gen, stmt->data.let_stmt.value);
+static void generate_wrapper_typedefs(CodeGenerator* gen, size_t defined) {
+    if (defined == 0) {
+        for (size_t i = 0; i < gen->wrapper_count; i++) {
+            gen->wrapper_types[i].ready_after = wrapper_ready_after(gen, gen->wrapper_types[i].type);
         }
-        codegen_write(gen, ";");
-        return;
+        qsort(gen->wrapper_types, gen->wrapper_count, sizeof(WrapperType), compare_wrappers);
+        if (gen->wrapper_index) index_wrappers(gen, gen->wrapper_index_size);
+        gen->wrappers_emitted = 0;
     }
     
-    if (type->kind == TYPE_ARRAY) {
-        generate_type(gen, type->data.array.element_type);
-        codegen_write(gen, " %s[%zu]", 
-                     stmt->data.let_stmt.name,
-                     type->data.array.size);
-    } else {
+    while (gen->wrappers_emitted < gen->wrapper_count &&
+           gen->wrapper_types[gen->wrappers_emitted].ready_after <= defined) {
+        Type* type = gen->wrapper_types[gen->wrappers_emitted++].type;
+        
+        codegen_write(gen, "typedef struct { ");
+        if (type->kind == TYPE_OPTION) {
+            generate_type(gen, type->data.option.value_type);
+            codegen_write(gen, " value; _Bool is_some; } ");
+        } else {
+            codegen_write(gen, "union { ");
+            generate_type(gen, type->data.result.ok_type);
+            codegen_write(gen, " ok; ");
+            generate_type(gen, type->data.result.err_type);
+            codegen_write(gen, " err; }; _Bool is_ok; } ");
+        }
         generate_type(gen, type);
-        codegen_write(gen, " %s", stmt->data.let_stmt.name);
+        codegen_write(gen, ";\n");
     }
+}
+
+/**
+ * Emits the helpers behind the byte access builtins: memcpy loads and
+ * stores of each width, float bit casts, and byte swaps selected by the
+ * host byte order.
+ * 
+ * @param gen The code generator instance
+ */
+static void generate_byte_access_prelude(CodeGenerator* gen) {
+    if (!gen->uses_byte_access) return;
     
-    if (stmt->data.let_stmt.value) {
-        codegen_write(gen, " = ");
-        generate_expression(gen, stmt->data.let_stmt.value);
+    codegen_writeln(gen, "#include <string.h>");
+    codegen_writeln(gen, "#define JFM_SWAP_NE(bits, value) (value)");
+    codegen_writeln(gen, "#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__");
+    codegen_writeln(gen, "#define JFM_SWAP_LE(bits, value) __builtin_bswap##bits(value)");
+    codegen_writeln(gen, "#define JFM_SWAP_BE(bits, value) (value)");
+    codegen_writeln(gen, "#else");
+    codegen_writeln(gen, "#define JFM_SWAP_LE(bits, value) (value)");
+    codegen_writeln(gen, "#define JFM_SWAP_BE(bits, value) __builtin_bswap##bits(value)");
+    codegen_writeln(gen, "#endif");
+    for (int bits = 16; bits <= 64; bits *= 2) {
+        codegen_writeln(gen, "static inline uint%d_t jfm_load_u%d(const void* p) { uint%d_t v; memcpy(&v, p, sizeof(v)); return v; }",
+                        bits, bits, bits);
+        codegen_writeln(gen, "static inline void jfm_store_u%d(void* p, uint%d_t v) { memcpy(p, &v, sizeof(v)); }",
+                        bits, bits);
     }
-    
-    codegen_write(gen, ";");
+    codegen_writeln(gen, "static inline uint32_t jfm_f32_bits(float f) { uint32_t v; memcpy(&v, &f, sizeof(v)); return v; }");
+    codegen_writeln(gen, "static inline float jfm_f32_from_bits(uint32_t v) { float f; memcpy(&f, &v, sizeof(f)); return f; }");
+    codegen_writeln(gen, "static inline uint64_t jfm_f64_bits(double f) { uint64_t v; memcpy(&v, &f, sizeof(v)); return v; }");
+    codegen_writeln(gen, "static inline double jfm_f64_from_bits(uint64_t v) { double f; memcpy(&f, &v, sizeof(f)); return f; }");
+    codegen_writeln(gen, "");
 }
 
 /**
- * Generates C code for if statements with optional else branches.
+ * Emits the helpers shared by the #[derive(Encode, Decode)] serialisers:
+ * a byte swap for big-endian hosts (the wire format is little-endian)
+ * and LEB128 varints with zigzag encoding for signed values. A varint
+ * whose tenth byte holds bits past the 64th does not decode.
  * 
  * @param gen The code generator instance
- * @param stmt The if statement AST node
  */
-static void generate_if(CodeGenerator* gen, AstNode* stmt) {
-    codegen_write(gen, "if (");
-    generate_expression(gen, stmt->data.if_stmt.condition);
-    codegen_write(gen, ") ");
-    
-    generate_statement(gen, stmt->data.if_stmt.then_branch);
+static void generate_serial_prelude(CodeGenerator* gen) {
+    if (!gen->uses_serialisers) return;
     
-    if (stmt->data.if_stmt.else_branch) {
-        codegen_indent(gen);
-        codegen_write(gen, "else ");
-        generate_statement(gen, stmt->data.if_stmt.else_branch);
-    }
+    codegen_writeln(gen, "#include <string.h>");
+    codegen_writeln(gen, "#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__");
+    codegen_writeln(gen, "#define JFM_WIRE_BIG_ENDIAN 1");
+    codegen_writeln(gen, "#else");
+    codegen_writeln(gen, "#define JFM_WIRE_BIG_ENDIAN 0");
+    codegen_writeln(gen, "#endif");
+    codegen_writeln(gen, "static inline void jfm_wire_swap(uint8_t* p, size_t size, size_t count) {");
+    codegen_writeln(gen, "    for (size_t i = 0; i < count; i++, p += size) {");
+    codegen_writeln(gen, "        for (size_t j = 0; j < size / 2; j++) { uint8_t t = p[j]; p[j] = p[size - 1 - j]; p[size - 1 - j] = t; }");
+    codegen_writeln(gen, "    }");
+    codegen_writeln(gen, "}");
+    codegen_writeln(gen, "static inline uint64_t jfm_zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }");
+    codegen_writeln(gen, "static inline int64_t jfm_unzigzag(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }");
+    codegen_writeln(gen, "static inline size_t jfm_varint_size(uint64_t v) { size_t n = 1; while (v >= 0x80) { v >>= 7; n++; } return n; }");
+    codegen_writeln(gen, "static inline size_t jfm_varint_put(uint8_t* out, uint64_t v) {");
+    codegen_writeln(gen, "    size_t n = 0;");
+    codegen_writeln(gen, "    while (v >= 0x80) { out[n++] = (uint8_t)(v | 0x80); v >>= 7; }");
+    codegen_writeln(gen, "    out[n++] = (uint8_t)v;");
+    codegen_writeln(gen, "    return n;");
+    codegen_writeln(gen, "}");
+    codegen_writeln(gen, "static inline bool jfm_varint_get(const uint8_t* in, size_t length, size_t* pos, uint64_t* v) {");
+    codegen_writeln(gen, "    uint64_t result = 0;");
+    codegen_writeln(gen, "    for (unsigned shift = 0; shift < 64 && *pos < length; shift += 7) {");
+    codegen_writeln(gen, "        uint8_t byte = in[(*pos)++];");
+    codegen_writeln(gen, "        if (shift == 63 && byte > 1) return false;");
+    codegen_writeln(gen, "        result |= (uint64_t)(byte & 0x7f) << shift;");
+    codegen_writeln(gen, "        if (!(byte & 0x80)) { *v = result; return true; }");
+    codegen_writeln(gen, "    }");
+    codegen_writeln(gen, "    return false;");
+    codegen_writeln(gen, "}");
+    codegen_writeln(gen, "");
 }
 
 /**
- * Generates C code for while loops.
+ * Finds the innermost element type of a serialised field and how many
+ * of them it holds once nested arrays are flattened.
  * 
  * @param gen The code generator instance
- * @param stmt The while loop AST node
+ * @param field The struct field
+ * @param count Receives the number of elements (1 for a scalar)
+ * @return The element type
  */
-static void generate_while(CodeGenerator* gen, AstNode* stmt) {
-    codegen_write(gen, "while (");
-    generate_expression(gen, stmt->data.while_loop.condition);
-    codegen_write(gen, ") ");
-    generate_statement(gen, stmt->data.while_loop.body);
+static Type* wire_element(CodeGenerator* gen, Field* field, size_t* count) {
+    Type* type = field->type;
+    *count = flat_array_length(gen, type);
+    while (type->kind == TYPE_ARRAY) type = type->data.array.element_type;
+    return type;
 }
 
 /**
- * Generates C code for range-based for loops.
- * Converts JFM 'for i in start..end' to C-style for loop.
+ * Checks whether a serialised field is stored as fixed-width little-endian
+ * bytes, the kind that contiguous runs are copied in bulk from.
  * 
  * @param gen The code generator instance
- * @param stmt The for loop AST node
+ * @param field The struct field
+ * @return false for #[varint] fields and nested structs
  */
-static void generate_for(CodeGenerator* gen, AstNode* stmt) {
-    // JFM for loops are range-based: for i in start..end
-    // Convert to C: for (int i = start; i < end; i++)
-    
-    codegen_write(gen, "for (int %s = ", stmt->data.for_loop.iterator);
-    generate_expression(gen, stmt->data.for_loop.start);
-    codegen_write(gen, "; %s < ", stmt->data.for_loop.iterator);
-    generate_expression(gen, stmt->data.for_loop.end);
-    codegen_write(gen, "; %s++) ", stmt->data.for_loop.iterator);
-    
-    generate_statement(gen, stmt->data.for_loop.body);
+static bool is_fixed_wire_field(CodeGenerator* gen, Field* field) {
+    size_t count;
+    return wire_element(gen, field, &count)->kind != TYPE_STRUCT &&
+           !ast_find_attribute(field->attributes, field->attribute_count, "varint");
 }
 
 /**
- * Generates C code for infinite loops.
- * Converts JFM 'loop' to C 'while(1)'.
+ * Finds the run of fixed-width fields that starts at a position of the
+ * emitted field order and lies contiguously in memory, so it is encoded
+ * and decoded with a single memcpy.
  * 
  * @param gen The code generator instance
- * @param stmt The loop statement AST node
+ * @param struct_def The struct definition
+ * @param first Position of the run's first field in emitted order
+ * @param bytes Receives the size of the run in bytes
+ * @return Position just after the run's last field
  */
-static void generate_loop(CodeGenerator* gen, AstNode* stmt) {
-    codegen_write(gen, "while (1) ");
-    generate_statement(gen, stmt->data.loop_stmt.body);
+static size_t wire_run_end(CodeGenerator* gen, AstNode* struct_def, size_t first, size_t* bytes) {
+    const StructLayout* layout = layout_of_struct(gen->program, struct_def);
+    Field* fields = struct_def->data.struct_def.fields;
+    size_t start = layout->offsets[layout->order[first]];
+    size_t end = first;
+    
+    *bytes = 0;
+    while (end < struct_def->data.struct_def.field_count) {
+        size_t index = layout->order[end];
+        if (!is_fixed_wire_field(gen, &fields[index]) || layout->offsets[index] != start + *bytes) break;
+        *bytes += layout_size_of(gen->program, fields[index].type);
+        end++;
+    }
+    return end;
 }
 
 /**
- * Main statement generation dispatcher.
- * Routes different statement types to their specific generators.
+ * Emits the byte swaps that convert the multi-byte numbers of a run
+ * between memory and the little-endian wire format on big-endian hosts.
+ * Adjacent numbers of the same width share one swap.
  * 
  * @param gen The code generator instance
- * @param stmt The statement AST node
+ * @param struct_def The struct definition
+ * @param first Position of the run's first field
+ * @param end Position after its last field
+ * @param base C expression of the address offsets are relative to
+ * @param bias Struct offset that base points at
  */
-static void generate_statement(CodeGenerator* gen, AstNode* stmt) {
-    if (!stmt) return;
+static void generate_wire_swaps(CodeGenerator* gen, AstNode* struct_def, size_t first, size_t end,
+                                const char* base, size_t bias) {
+    const StructLayout* layout = layout_of_struct(gen->program, struct_def);
+    size_t offset = 0, size = 0, count = 0;
     
-    switch (stmt->type) {
-        case AST_BLOCK:
-            codegen_writeln(gen, "{");
-            gen->indent_level++;
-            
-            for (size_t i = 0; i < stmt->data.block.statement_count; i++) {
-                codegen_indent(gen);
-                generate_statement(gen, stmt->data.block.statements[i]);
-                if (stmt->data.block.statements[i]->type != AST_IF &&
-                    stmt->data.block.statements[i]->type != AST_WHILE &&
-                    stmt->data.block.statements[i]->type != AST_FOR &&
-                    stmt->data.block.statements[i]->type != AST_LOOP &&
-                    stmt->data.block.statements[i]->type != AST_BLOCK) {
-                }
-                codegen_write(gen, "\n");
-            }
-            
-            gen->indent_level--;
-            codegen_indent(gen);
-            codegen_write(gen, "}");
-            break;
-            
-        case AST_LET:
-            generate_let(gen, stmt);
-            break;
-            
-        case AST_IF:
-            generate_if(gen, stmt);
-            break;
-            
-        case AST_WHILE:
-            generate_while(gen, stmt);
-            break;
-            
-        case AST_FOR:
-            generate_for(gen, stmt);
-            break;
-            
-        case AST_LOOP:
-            generate_loop(gen, stmt);
-            break;
-            
-        case AST_RETURN:
-            codegen_write(gen, "return");
-            if (stmt->data.return_stmt.value) {
-                codegen_write(gen, " ");
-                generate_expression(gen, stmt->data.return_stmt.value);
+    for (size_t k = first; k <= end; k++) {
+        size_t field_offset = 0, field_size = 0, field_count = 0;
+        if (k < end) {
+            size_t index = layout->order[k];
+            Type* element = wire_element(gen, &struct_def->data.struct_def.fields[index], &field_count);
+            field_offset = layout->offsets[index] - bias;
+            field_size = layout_size_of(gen->program, element);
+            if (field_size == size && field_offset == offset + size * count) {
+                count += field_count;
+                continue;
             }
-            codegen_write(gen, ";");
-            break;
-            
-        case AST_BREAK:
-            codegen_write(gen, "break;");
-            break;
-            
-        case AST_CONTINUE:
-            codegen_write(gen, "continue;");
-            break;
-            
-        default:
-            generate_expression(gen, stmt);
-            codegen_write(gen, ";");
-            break;
+        }
+        
+        if (size > 1) {
+            codegen_writeln(gen, "    if (JFM_WIRE_BIG_ENDIAN) jfm_wire_swap(%s + %zu, %zu, %zu);", base, offset, size, count);
+        }
+        offset = field_offset;
+        size = field_size;
+        count = field_count;
     }
 }
 
 /**
- * Generates C code for function definitions.
- * Includes return type, parameters, and function body.
+ * Emits the serialiser of a #[derive(Encode)] struct: jfm_encoded_size_S,
+ * jfm_encode_into_S, which writes the wire format without bounds checks,
+ * and jfm_encode_S behind value.encode(buf, capacity).
  * 
  * @param gen The code generator instance
- * @param func The function AST node
+ * @param struct_def The struct definition
  */
-static void generate_function(CodeGenerator* gen, AstNode* func) {
-    generate_type(gen, func->data.function.return_type);
-    codegen_write(gen, " %s(", func->data.function.name);
+static void generate_encoder(CodeGenerator* gen, AstNode* struct_def) {
+    const char* name = struct_def->data.struct_def.name;
+    const StructLayout* layout = layout_of_struct(gen->program, struct_def);
+    Field* fields = struct_def->data.struct_def.fields;
+    size_t field_count = struct_def->data.struct_def.field_count;
     
-    if (func->data.function.param_count == 0) {
-        codegen_write(gen, "void");
-    } else {
-        for (size_t i = 0; i < func->data.function.param_count; i++) {
-            if (i > 0) codegen_write(gen, ", ");
-            generate_type(gen, func->data.function.params[i].type);
-            codegen_write(gen, " %s", func->data.function.params[i].name);
+    size_t fixed_size = 0;
+    bool variable = false;
+    for (size_t i = 0; i < field_count; i++) {
+        if (is_fixed_wire_field(gen, &fields[i])) {
+            fixed_size += layout_size_of(gen->program, fields[i].type);
+        } else {
+            variable = true;
         }
     }
     
-    codegen_write(gen, ") ");
+    codegen_writeln(gen, "static inline size_t jfm_encoded_size_%s(const %s* v) {", name, name);
+    codegen_writeln(gen, "    size_t size = %zu;", fixed_size);
+    if (!variable) codegen_writeln(gen, "    (void)v;");
+    for (size_t k = 0; k < field_count; k++) {
+        Field* field = &fields[layout->order[k]];
+        size_t count;
+        Type* element = wire_element(gen, field, &count);
+        if (element->kind == TYPE_STRUCT) {
+            const char* inner = element->data.struct_type.name;
+            if (count > 1) {
+                codegen_writeln(gen, "    for (size_t i = 0; i < %zu; i++) size += jfm_encoded_size_%s(&v->%s[i]);",
+                                count, inner, field->name);
+            } else {
+                codegen_writeln(gen, "    size += jfm_encoded_size_%s(&v->%s);", inner, field->name);
+            }
+        } else if (!is_fixed_wire_field(gen, field)) {
+            codegen_writeln(gen, type_is_signed(element) ? "    size += jfm_varint_size(jfm_zigzag((int64_t)v->%s));" :
+                                                           "    size += jfm_varint_size((uint64_t)v->%s);", field->name);
+        }
+    }
+    codegen_writeln(gen, "    return size;");
+    codegen_writeln(gen, "}");
     
-    generate_statement(gen, func->data.function.body);
-    codegen_write(gen, "\n\n");
+    codegen_writeln(gen, "static inline size_t jfm_encode_into_%s(const %s* v, uint8_t* out) {", name, name);
+    codegen_writeln(gen, "    size_t pos = 0;");
+    if (field_count == 0) codegen_writeln(gen, "    (void)v; (void)out;");
+    for (size_t k = 0; k < field_count;) {
+        Field* field = &fields[layout->order[k]];
+        size_t count;
+        Type* element = wire_element(gen, field, &count);
+        if (is_fixed_wire_field(gen, field)) {
+            size_t bytes;
+            size_t end = wire_run_end(gen, struct_def, k, &bytes);
+            codegen_writeln(gen, "    memcpy(out + pos, (const uint8_t*)v + %zu, %zu);", layout->offsets[layout->order[k]], bytes);
+            generate_wire_swaps(gen, struct_def, k, end, "out + pos", layout->offsets[layout->order[k]]);
+            codegen_writeln(gen, "    pos += %zu;", bytes);
+            k = end;
+            continue;
+        }
+        
+        if (element->kind == TYPE_STRUCT) {
+            const char* inner = element->data.struct_type.name;
+            if (count > 1) {
+                codegen_writeln(gen, "    for (size_t i = 0; i < %zu; i++) pos += jfm_encode_into_%s(&v->%s[i], out + pos);",
+                                count, inner, field->name);
+            } else {
+                codegen_writeln(gen, "    pos += jfm_encode_into_%s(&v->%s, out + pos);", inner, field->name);
+            }
+        } else {
+            codegen_writeln(gen, type_is_signed(element) ? "    pos += jfm_varint_put(out + pos, jfm_zigzag((int64_t)v->%s));" :
+                                                           "    pos += jfm_varint_put(out + pos, (uint64_t)v->%s);", field->name);
+        }
+        k++;
+    }
+    codegen_writeln(gen, "    return pos;");
+    codegen_writeln(gen, "}");
+    
+    Type* result_type = type_create(TYPE_OPTION);
+    result_type->data.option.value_type = type_create(TYPE_U64);
+    codegen_write(gen, "static inline ");
+    generate_type(gen, result_type);
+    codegen_write(gen, " jfm_encode_%s(const %s* v, uint8_t* out, size_t capacity) {\n", name, name);
+    codegen_writeln(gen, "    size_t size = jfm_encoded_size_%s(v);", name);
+    codegen_write(gen, "    if (size > capacity) return ");
+    generate_none(gen, result_type);
+    codegen_write(gen, ";\n");
+    codegen_writeln(gen, "    jfm_encode_into_%s(v, out);", name);
+    codegen_write(gen, "    return ");
+    generate_wrapper_open(gen, result_type, false);
+    codegen_write(gen, "size");
+    generate_wrapper_close(gen, result_type, false);
+    codegen_write(gen, ";\n");
+    codegen_writeln(gen, "}");
+    type_destroy(result_type->data.option.value_type);
+    type_destroy(result_type);
 }
 
 /**
- * Generates C code for struct definitions.
- * Creates typedef struct with all fields. Skips extern structs.
+ * Emits the zero-copy view of a #[derive(Decode)] struct whose wire format
+ * is its memory layout: jfm_view_check_S rejects bool bytes other than 0
+ * and 1, and jfm_view_S behind Struct::view(buf, length) also rejects
+ * short, misaligned and big-endian buffers.
  * 
  * @param gen The code generator instance
- * @param struct_def The struct definition AST node
+ * @param struct_def The struct definition
  */
-static void generate_struct(CodeGenerator* gen, AstNode* struct_def) {
-    if (struct_def->data.struct_def.is_extern) {
-        return;
-    }
-    
-    codegen_writeln(gen, "typedef struct %s {", struct_def->data.struct_def.name);
-    gen->indent_level++;
+static void generate_view(CodeGenerator* gen, AstNode* struct_def) {
+    const char* name = struct_def->data.struct_def.name;
+    const StructLayout* layout = layout_of_struct(gen->program, struct_def);
     
+    codegen_writeln(gen, "static inline bool jfm_view_check_%s(const uint8_t* in) {", name);
+    bool checked = false;
     for (size_t i = 0; i < struct_def->data.struct_def.field_count; i++) {
-        codegen_indent(gen);
-        generate_type(gen, struct_def->data.struct_def.fields[i].type);
-        codegen_write(gen, " %s;\n", struct_def->data.struct_def.fields[i].name);
+        size_t count;
+        Type* element = wire_element(gen, &struct_def->data.struct_def.fields[i], &count);
+        size_t offset = layout->offsets[i];
+        if (element->kind == TYPE_STRUCT) {
+            size_t size = layout_size_of(gen->program, element);
+            codegen_writeln(gen, "    for (size_t i = 0; i < %zu; i++) if (!jfm_view_check_%s(in + %zu + i * %zu)) return false;",
+                            count, element->data.struct_type.name, offset, size);
+            checked = true;
+        } else if (element->kind == TYPE_BOOL) {
+            codegen_writeln(gen, "    for (size_t i = 0; i < %zu; i++) if (in[%zu + i] > 1) return false;", count, offset);
+            checked = true;
+        }
     }
+    if (!checked) codegen_writeln(gen, "    (void)in;");
+    codegen_writeln(gen, "    return true;");
+    codegen_writeln(gen, "}");
     
-    gen->indent_level--;
-    codegen_writeln(gen, "} %s;\n", struct_def->data.struct_def.name);
+    codegen_writeln(gen, "static inline const %s* jfm_view_%s(const uint8_t* in, size_t length) {", name, name);
+    codegen_writeln(gen, "    if (JFM_WIRE_BIG_ENDIAN || length < sizeof(%s) || (uintptr_t)in %% _Alignof(%s) != 0) return NULL;",
+                    name, name);
+    codegen_writeln(gen, "    return jfm_view_check_%s(in) ? (const %s*)in : NULL;", name, name);
+    codegen_writeln(gen, "}");
 }
 
 /**
- * Generates C code for impl blocks.
- * Converts methods to regular C functions with StructName_methodName naming.
+ * Emits the deserialiser of a #[derive(Decode)] struct: jfm_decode_into_S,
+ * which validates the buffer as it reads it (length, bool bytes, varint
+ * ranges), jfm_decode_S behind Struct::decode(buf, length), and the
+ * zero-copy view when the struct has one.
  * 
  * @param gen The code generator instance
- * @param impl The impl block AST node
+ * @param struct_def The struct definition
  */
-static void generate_impl(CodeGenerator* gen, AstNode* impl) {
-    for (size_t i = 0; i < impl->data.impl_block.function_count; i++) {
-        AstNode* method = impl->data.impl_block.functions[i];
-        
-        generate_type(gen, method->data.function.return_type);
-        
-        codegen_write(gen, " %s_%s(", 
-                     impl->data.impl_block.struct_name,
-                     method->data.function.name);
+static void generate_decoder(CodeGenerator* gen, AstNode* struct_def) {
+    const char* name = struct_def->data.struct_def.name;
+    const StructLayout* layout = layout_of_struct(gen->program, struct_def);
+    Field* fields = struct_def->data.struct_def.fields;
+    size_t field_count = struct_def->data.struct_def.field_count;
+    
+    codegen_writeln(gen, "static inline bool jfm_decode_into_%s(%s* v, const uint8_t* in, size_t length, size_t* pos) {",
+                    name, name);
+    bool varints = false;
+    for (size_t i = 0; i < field_count; i++) {
+        varints |= ast_find_attribute(fields[i].attributes, fields[i].attribute_count, "varint") != NULL;
+    }
+    if (varints) codegen_writeln(gen, "    uint64_t raw;");
+    if (field_count == 0) codegen_writeln(gen, "    (void)v; (void)in; (void)length; (void)pos;");
+    for (size_t k = 0; k < field_count;) {
+        Field* field = &fields[layout->order[k]];
+        size_t count;
+        Type* element = wire_element(gen, field, &count);
+        if (is_fixed_wire_field(gen, field)) {
+            size_t bytes;
+            size_t end = wire_run_end(gen, struct_def, k, &bytes);
+            size_t start = layout->offsets[layout->order[k]];
+            codegen_writeln(gen, "    if (length - *pos < %zu) return false;", bytes);
+            for (size_t j = k; j < end; j++) {
+                size_t bool_count;
+                size_t index = layout->order[j];
+                if (wire_element(gen, &fields[index], &bool_count)->kind != TYPE_BOOL) continue;
+                if (bool_count > 1) {
+                    codegen_writeln(gen, "    for (size_t i = 0; i < %zu; i++) if (in[*pos + %zu + i] > 1) return false;",
+                                    bool_count, layout->offsets[index] - start);
+                } else {
+                    codegen_writeln(gen, "    if (in[*pos + %zu] > 1) return false;", layout->offsets[index] - start);
+                }
+            }
+            codegen_writeln(gen, "    memcpy((uint8_t*)v + %zu, in + *pos, %zu);", start, bytes);
+            generate_wire_swaps(gen, struct_def, k, end, "(uint8_t*)v", 0);
+            codegen_writeln(gen, "    *pos += %zu;", bytes);
+            k = end;
+            continue;
+        }
         
-        if (method->data.function.param_count == 0) {
-            codegen_write(gen, "void");
+        if (element->kind == TYPE_STRUCT) {
+            const char* inner = element->data.struct_type.name;
+            if (count > 1) {
+                codegen_writeln(gen, "    for (size_t i = 0; i < %zu; i++) if (!jfm_decode_into_%s(&v->%s[i], in, length, pos)) return false;",
+                                count, inner, field->name);
+            } else {
+                codegen_writeln(gen, "    if (!jfm_decode_into_%s(&v->%s, in, length, pos)) return false;", inner, field->name);
+            }
         } else {
-            for (size_t j = 0; j < method->data.function.param_count; j++) {
-                if (j > 0) codegen_write(gen, ", ");
-                generate_type(gen, method->data.function.params[j].type);
-                codegen_write(gen, " %s", method->data.function.params[j].name);
+            // Values outside the field's range are rejected rather than
+            // truncated; every value fits a 64-bit field
+            const char* c_type = get_c_type(element->kind);
+            bool wide = element->kind == TYPE_I64 || element->kind == TYPE_U64;
+            codegen_writeln(gen, "    if (!jfm_varint_get(in, length, pos, &raw)) return false;");
+            if (type_is_signed(element)) {
+                if (!wide) {
+                    codegen_writeln(gen, "    if ((int64_t)(%s)jfm_unzigzag(raw) != jfm_unzigzag(raw)) return false;", c_type);
+                }
+                codegen_writeln(gen, "    v->%s = (%s)jfm_unzigzag(raw);", field->name, c_type);
+            } else {
+                if (!wide) {
+                    codegen_writeln(gen, "    if ((uint64_t)(%s)raw != raw) return false;", c_type);
+                }
+                codegen_writeln(gen, "    v->%s = (%s)raw;", field->name, c_type);
             }
         }
-        
-        codegen_write(gen, ") ");
-        
-        generate_statement(gen, method->data.function.body);
-        codegen_write(gen, "\n\n");
+        k++;
+    }
+    codegen_writeln(gen, "    return true;");
+    codegen_writeln(gen, "}");
+    
+    Type* struct_type = type_create(TYPE_STRUCT);
+    struct_type->data.struct_type.name = string_duplicate(struct_def->data.struct_def.name);
+    Type* result_type = type_create(TYPE_OPTION);
+    result_type->data.option.value_type = struct_type;
+    codegen_write(gen, "static inline ");
+    generate_type(gen, result_type);
+    codegen_write(gen, " jfm_decode_%s(const uint8_t* in, size_t length) {\n", name);
+    codegen_write(gen, "    ");
+    generate_type(gen, result_type);
+    codegen_write(gen, " result = { .is_some = 0 };\n");
+    codegen_writeln(gen, "    size_t pos = 0;");
+    codegen_writeln(gen, "    result.is_some = jfm_decode_into_%s(&result.value, in, length, &pos);", name);
+    codegen_writeln(gen, "    return result;");
+    codegen_writeln(gen, "}");
+    type_destroy(result_type);
+    type_destroy(struct_type);
+    
+    if (layout_wire_viewable(gen->program, struct_def)) {
+        generate_view(gen, struct_def);
+    }
+}
+
+/**
+ * Writes the program's include directives.
+ * 
+ * @param gen The code generator instance
+ * @param program The program AST node
+ */
+static void generate_includes(CodeGenerator* gen, AstNode* program) {
+    for (size_t i = 0; i < program->data.program.count; i++) {
+        AstNode* inc = program->data.program.items[i];
+        if (inc->type != AST_INCLUDE) continue;
+        if (inc->data.include.is_system) {
+            codegen_writeln(gen, "#include <%s>", inc->data.include.path);
+        } else {
+            codegen_writeln(gen, "#include \"%s\"", inc->data.include.path);
+        }
     }
 }
 
@@ -756,22 +4130,15 @@ static void generate_node(CodeGenerator* gen, AstNode* node) {
     switch (node->type) {
         case AST_PROGRAM:
             codegen_writeln(gen, "/* Generated C code from JFM compiler */");
+            if (gen->hot_reload) {
+                codegen_writeln(gen, "#define _POSIX_C_SOURCE 200809L");
+            }
             codegen_writeln(gen, "#include <stdio.h>");
             codegen_writeln(gen, "#include <stdlib.h>");
             codegen_writeln(gen, "#include <stdint.h>");
             codegen_writeln(gen, "#include <stdbool.h>");
             codegen_writeln(gen, "#include <math.h>");
-            
-            for (size_t i = 0; i < node->data.program.count; i++) {
-                if (node->data.program.items[i]->type == AST_INCLUDE) {
-                    AstNode* inc = node->data.program.items[i];
-                    if (inc->data.include.is_system) {
-                        codegen_writeln(gen, "#include <%s>", inc->data.include.path);
-                    } else {
-                        codegen_writeln(gen, "#include \"%s\"", inc->data.include.path);
-                    }
-                }
-            }
+            generate_includes(gen, node);
             codegen_writeln(gen, "");
             
             for (size_t i = 0; i < node->data.program.count; i++) {
@@ -780,12 +4147,46 @@ static void generate_node(CodeGenerator* gen, AstNode* node) {
                 }
             }
             
+            find_function_values(node, &gen->uses_function_values);
+            if (gen->uses_function_values) {
+                codegen_writeln(gen, "typedef struct { void (*code)(void); void* env; } jfm_fn;");
+                codegen_writeln(gen, "");
+            }
+            
+            find_prelude_uses(node, gen);
+            generate_numeric_prelude(gen);
+            generate_byte_access_prelude(gen);
+            generate_serial_prelude(gen);
+            if (gen->uses_wrappers) {
+                codegen_writeln(gen, "static _Noreturn void jfm_unwrap_failed(const char* message) {");
+                codegen_writeln(gen, "    fflush(stdout);");
+                codegen_writeln(gen, "    fprintf(stderr, \"%%s\\n\", message);");
+                codegen_writeln(gen, "    abort();");
+                codegen_writeln(gen, "}");
+                generate_wrapper_typedefs(gen, 0);
+                codegen_writeln(gen, "");
+            }
+            
             for (size_t i = 0; i < node->data.program.count; i++) {
                 if (node->data.program.items[i]->type == AST_STRUCT) {
                     generate_struct(gen, node->data.program.items[i]);
+                    generate_wrapper_typedefs(gen, i + 1);
                 }
             }
             
+            for (size_t i = 0; i < node->data.program.count; i++) {
+                AstNode* item = node->data.program.items[i];
+                if (item->type != AST_STRUCT) continue;
+                if (semantic_derives(item, "Encode")) generate_encoder(gen, item);
+                if (semantic_derives(item, "Decode")) generate_decoder(gen, item);
+                if (semantic_derives(item, "Encode") || semantic_derives(item, "Decode")) codegen_writeln(gen, "");
+            }
+            
+            if (gen->hot_reload) {
+                generate_hot_program(gen, node);
+                break;
+            }
+            
             for (size_t i = 0; i < node->data.program.count; i++) {
                 if (node->data.program.items[i]->type == AST_IMPL) {
                     generate_impl(gen, node->data.program.items[i]);
@@ -830,7 +4231,93 @@ bool codegen_generate(CodeGenerator* gen, AstNode* ast, SymbolTable* symbols) {
     if (!gen || !ast) return false;
     
     gen->symbols = symbols;
+    gen->program = ast;
     generate_node(gen, ast);
     
+    return true;
+}
+
+/**
+ * Writes the prototype of a pub function or method.
+ * 
+ * @param gen The code generator instance
+ * @param func The function AST node
+ * @param prefix Struct name for methods (emitted as Struct_method), or NULL
+ */
+static void generate_prototype(CodeGenerator* gen, AstNode* func, const char* prefix) {
+    generate_return_type(gen, func);
+    if (prefix) {
+        codegen_write(gen, " %s_%s", prefix, func->data.function.name);
+    } else {
+        codegen_write(gen, " %s", func->data.function.name);
+    }
+    generate_parameters(gen, func, true);
+    codegen_write(gen, ";\n");
+}
+
+/**
+ * Writes the C header of a library build: the program's includes, the pub
+ * structs with the same field order and attributes as in the C file, and
+ * prototypes of the pub functions and methods. Prototypes keep the JFM
+ * calling convention, so a large struct result is written through a
+ * leading pointer and large struct arguments may be passed by const pointer.
+ * 
+ * @param gen The code generator instance, writing to the header file
+ * @param ast The root AST node (program)
+ * @param symbols The symbol table for type information
+ * @param guard Name of the include guard macro
+ * @return true if generation succeeded, false otherwise
+ */
+bool codegen_generate_header(CodeGenerator* gen, AstNode* ast, SymbolTable* symbols, const char* guard) {
+    if (!gen || !ast) return false;
+    
+    gen->symbols = symbols;
+    gen->program = ast;
+    gen->in_header = true;
+    
+    codegen_writeln(gen, "/* Generated C header from JFM compiler */");
+    codegen_writeln(gen, "#ifndef %s", guard);
+    codegen_writeln(gen, "#define %s", guard);
+    codegen_writeln(gen, "");
+    codegen_writeln(gen, "#include <stdint.h>");
+    codegen_writeln(gen, "#include <stdbool.h>");
+    generate_includes(gen, ast);
+    codegen_writeln(gen, "");
+    codegen_writeln(gen, "#ifdef __cplusplus");
+    codegen_writeln(gen, "extern \"C\" {");
+    codegen_writeln(gen, "#endif");
+    codegen_writeln(gen, "");
+    
+    for (size_t i = 0; i < ast->data.program.count; i++) {
+        AstNode* item = ast->data.program.items[i];
+        if (item->type == AST_STRUCT && item->data.struct_def.is_pub) {
+            generate_struct(gen, item);
+        }
+    }
+    
+    bool any_function = false;
+    for (size_t i = 0; i < ast->data.program.count; i++) {
+        AstNode* item = ast->data.program.items[i];
+        if (item->type == AST_FUNCTION && item->data.function.is_pub) {
+            generate_prototype(gen, item, NULL);
+            any_function = true;
+        } else if (item->type == AST_IMPL) {
+            for (size_t j = 0; j < item->data.impl_block.function_count; j++) {
+                AstNode* method = item->data.impl_block.functions[j];
+                if (!method->data.function.is_pub) continue;
+                generate_prototype(gen, method, item->data.impl_block.struct_name);
+                any_function = true;
+            }
+        }
+    }
+    if (any_function) codegen_writeln(gen, "");
+    
+    codegen_writeln(gen, "#ifdef __cplusplus");
+    codegen_writeln(gen, "}");
+    codegen_writeln(gen, "#endif");
+    codegen_writeln(gen, "");
+    codegen_writeln(gen, "#endif");
+    
+    gen->in_header = false;
     return true;
 }
\ No newline at end of file
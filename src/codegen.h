@@ -6,16 +6,105 @@
 #include <stdio.h>
 #include <stdbool.h>
 
+// Name emitted as (*name): a struct parameter of the current function passed
+// as a hidden const pointer, or an array element bound by a for loop
+typedef struct {
+    const char* name;
+    size_t shadowed_at;            // Block depth of a local hiding it, 0 if visible
+} ReferenceParam;
+
+// Function a fn value is statically known to hold
+typedef struct {
+    AstNode* function;             // JFM function, or NULL
+    AstNode* closure;              // Closure, or NULL
+    AstNode* source;               // Expression whose value carries the closure's environment
+    const char* env_param;         // Parameter of a specialised clone carrying it instead
+} StaticFunction;
+
+// Copy of a function whose fn parameters are bound to known functions, so
+// calls through them are direct calls the C compiler can inline
+typedef struct {
+    AstNode* function;
+    StaticFunction* targets;       // One per parameter; unbound ones are all NULL
+    size_t id;
+} Specialisation;
+
+// Option / Result instantiation emitted as a C typedef
+typedef struct {
+    Type* type;
+    size_t order;                  // Position in which it was recorded (payloads first)
+    size_t ready_after;            // Program items to emit before it (its last struct + 1)
+} WrapperType;
+
 typedef struct {
     FILE* output;
     int indent_level;
     bool in_struct_init;
     SymbolTable* symbols;
+    
+    // Hot-reload mode: functions go into a shared object, main() calls them
+    // through a table of function pointers that is rebound at runtime
+    bool hot_reload;
+    const char* hot_manifest;      // File naming the current shared object
+    bool in_hot_host;              // Generating main() in hot-reload mode
+    
+    // Library builds: only pub functions keep external linkage, and the
+    // header declares the pub structs and functions
+    bool library;
+    bool in_header;                // Writing the header rather than the C file
+    AstNode* program;
+    const char* block_prologue;    // Statement emitted at the top of the next block
+    AstNode* block_bindings;       // Array for loop or closure whose bindings open the next block
+    
+    // Large struct returns: the callee writes through a caller-provided pointer
+    bool return_slot;              // Current function returns through jfm_ret
+    Type* return_type;             // Declared return type of the current function or closure
+    const char* call_slot;         // Destination pointer for the next call expression
+    size_t slot_temp_count;        // Counter for temporaries holding returned structs
+    
+    // Large struct parameters: identifiers naming them are emitted as (*name)
+    ReferenceParam* ref_params;
+    size_t ref_param_count;
+    size_t ref_param_capacity;
+    size_t block_depth;
+    
+    // Function values: closures are lifted to static C functions, named
+    // functions get thunks with the closure calling convention, and calls
+    // passing known functions go to specialised clones
+    bool uses_function_values;
+    size_t closure_count;
+    AstNode** thunks;
+    size_t thunk_count;
+    size_t thunk_capacity;
+    Specialisation** specialisations;
+    size_t specialisation_count;
+    size_t specialisation_capacity;
+    Specialisation* current_specialisation;   // Clone being generated, or NULL
+    
+    // Numeric types whose C spelling comes from the prelude
+    bool uses_wide_integers;       // i128 / u128
+    bool uses_f16;
+    bool uses_bf16;
+    bool uses_byte_access;         // load_le_u32 and the other byte access builtins
+    
+    // Option<T> and Result<T, E>: typedefs of the instantiations without a niche
+    bool uses_wrappers;
+    WrapperType* wrapper_types;
+    size_t wrapper_count;
+    size_t wrapper_capacity;
+    size_t* wrapper_index;         // Hash of wrapper_types by type: index + 1, 0 when empty
+    size_t wrapper_index_size;
+    size_t wrappers_emitted;       // Typedefs written, in ready_after order
+    size_t wrapper_temp_count;     // Counter for temporaries holding them in methods and `?`
+    bool uses_serialisers;         // #[derive(Encode, Decode)]
 } CodeGenerator;
 
 CodeGenerator* codegen_create(FILE* output);
 void codegen_destroy(CodeGenerator* gen);
+void codegen_enable_hot_reload(CodeGenerator* gen, const char* manifest_path);
 bool codegen_generate(CodeGenerator* gen, AstNode* ast, SymbolTable* symbols);
+void codegen_enable_library(CodeGenerator* gen);
+bool codegen_generate_header(CodeGenerator* gen, AstNode* ast, SymbolTable* symbols, const char* guard);
 
 void codegen_indent(CodeGenerator* gen);
 void codegen_write(CodeGenerator* gen, const char* format, ...);
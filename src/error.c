@@ -1,6 +1,7 @@
 #include "error.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <string.h>
 #include <stdbool.h>
 
@@ -26,8 +27,12 @@
 #define COLOR_BOLD    "\033[1m"
 #define COLOR_DIM     "\033[2m"
 
-static bool colors_enabled = true;
-static bool colors_initialized = false;
+// Rendered text of one diagnostic, handed to the sink in a single call
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} TextBuffer;
 
 /**
  * Initialize Windows console for ANSI color support
@@ -54,41 +59,22 @@ static void init_windows_console(void) {
 
 /**
  * Check if colors should be enabled based on terminal support
+ * 
+ * @return Whether stderr is a terminal and NO_COLOR is unset
  */
-static void init_colors(void) {
-    if (colors_initialized) return;
-    colors_initialized = true;
-
+static bool stderr_wants_colors(void) {
     #ifdef _WIN32
     // fileno is defined as a macro in MinGW's stdio.h, use it directly
     if (!isatty(stderr->_file)) {
     #else
     if (!isatty(fileno(stderr))) {
     #endif
-        colors_enabled = false;
-        return;
+        return false;
     }
 
     init_windows_console();
 
-    if (getenv("NO_COLOR")) {
-        colors_enabled = false;
-    }
-}
-
-/**
- * Enable colored output
- */
-void enable_colors(void) {
-    colors_enabled = true;
-    init_colors();
-}
-
-/**
- * Disable colored output
- */
-void disable_colors(void) {
-    colors_enabled = false;
+    return getenv("NO_COLOR") == NULL;
 }
 
 /**
@@ -101,8 +87,14 @@ ErrorList* error_list_create(void) {
     list->errors = NULL;
     list->error_count = 0;
     list->error_capacity = 0;
+    list->warning_count = 0;
     list->source_code = NULL;
-    init_colors();
+    list->sink = NULL;
+    list->sink_context = NULL;
+    list->colors = stderr_wants_colors();
+    list->indexed_source = NULL;
+    list->line_starts = NULL;
+    list->line_count = 0;
     return list;
 }
 
@@ -118,20 +110,21 @@ void error_list_destroy(ErrorList* list) {
         free((char*)list->errors[i].message);
     }
     free(list->errors);
+    free(list->line_starts);
     free(list);
 }
 
 /**
- * Adds a new error to the error list.
- * Automatically expands the list capacity as needed.
+ * Appends an error or warning to the list, growing it as needed.
  * 
  * @param list The error list
- * @param message The error message (will be duplicated)
+ * @param message The message (will be duplicated)
  * @param file The source file name
  * @param line The line number
  * @param column The column number
+ * @param is_warning Whether the entry is a warning
  */
-void error_list_add(ErrorList* list, const char* message, const char* file, size_t line, size_t column) {
+static void error_list_append(ErrorList* list, const char* message, const char* file, size_t line, size_t column, bool is_warning) {
     if (list->error_count >= list->error_capacity) {
         list->error_capacity = list->error_capacity == 0 ? 8 : list->error_capacity * 2;
         list->errors = realloc(list->errors, sizeof(Error) * list->error_capacity);
@@ -144,179 +137,287 @@ void error_list_add(ErrorList* list, const char* message, const char* file, size
         .message = msg_copy,
         .file = file,
         .line = line,
-        .column = column
+        .column = column,
+        .is_warning = is_warning
     };
     
     list->errors[list->error_count++] = error;
+    if (is_warning) list->warning_count++;
+}
+
+/**
+ * Adds a new error to the error list.
+ * Automatically expands the list capacity as needed.
+ * 
+ * @param list The error list
+ * @param message The error message (will be duplicated)
+ * @param file The source file name
+ * @param line The line number
+ * @param column The column number
+ */
+void error_list_add(ErrorList* list, const char* message, const char* file, size_t line, size_t column) {
+    error_list_append(list, message, file, line, column, false);
+}
+
+/**
+ * Adds a warning to the error list. Warnings are printed with the errors
+ * but do not count towards "aborting due to N previous errors".
+ * 
+ * @param list The error list
+ * @param message The warning message (will be duplicated)
+ * @param file The source file name
+ * @param line The line number
+ * @param column The column number
+ */
+void error_list_add_warning(ErrorList* list, const char* message, const char* file, size_t line, size_t column) {
+    error_list_append(list, message, file, line, column, true);
+}
+
+/**
+ * Routes diagnostics to a caller-provided sink instead of stderr.
+ * Colours are switched off, since the sink is rarely a terminal;
+ * call error_list_set_colors afterwards to turn them back on.
+ * 
+ * @param list The error list
+ * @param sink Receives each rendered diagnostic (NULL restores stderr)
+ * @param context Passed through to the sink unchanged
+ */
+void error_list_set_sink(ErrorList* list, DiagnosticSink sink, void* context) {
+    if (!list) return;
+    list->sink = sink;
+    list->sink_context = context;
+    list->colors = sink ? false : stderr_wants_colors();
+}
+
+/**
+ * Enables or disables ANSI colours in the rendered diagnostics.
+ * 
+ * @param list The error list
+ * @param enabled Whether to emit colour codes
+ */
+void error_list_set_colors(ErrorList* list, bool enabled) {
+    if (list) list->colors = enabled;
 }
 
 /**
- * Prints all errors in the list to stderr.
+ * Appends formatted text to a diagnostic buffer, growing it as needed.
+ * 
+ * @param text The buffer to append to
+ * @param format Printf-style format string
+ * @param ... Format arguments
+ */
+static void text_printf(TextBuffer* text, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int needed = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (needed < 0) return;
+    
+    if (text->length + (size_t)needed + 1 > text->capacity) {
+        if (text->capacity == 0) text->capacity = 256;
+        while (text->length + (size_t)needed + 1 > text->capacity) {
+            text->capacity *= 2;
+        }
+        text->data = realloc(text->data, text->capacity);
+    }
+    
+    va_start(args, format);
+    vsnprintf(text->data + text->length, text->capacity - text->length, format, args);
+    va_end(args);
+    text->length += (size_t)needed;
+}
+
+/**
+ * Hands a rendered diagnostic to the list's sink (or stderr) and empties
+ * the buffer for the next one.
+ * 
+ * @param list The error list
+ * @param text The rendered diagnostic
+ */
+static void text_flush(ErrorList* list, TextBuffer* text) {
+    if (text->length == 0) return;
+    if (list->sink) {
+        list->sink(list->sink_context, text->data, text->length);
+    } else {
+        fwrite(text->data, 1, text->length, stderr);
+    }
+    text->length = 0;
+}
+
+/**
+ * Prints all errors in the list to the list's sink.
  * Formats each error with message and location information.
  * 
  * @param list The error list to print
  */
 void error_list_print(ErrorList* list) {
+    TextBuffer text = { NULL, 0, 0 };
     for (size_t i = 0; i < list->error_count; i++) {
         Error* e = &list->errors[i];
-        fprintf(stderr, "Error: %s\n", e->message);
+        text_printf(&text, "%s: %s\n", e->is_warning ? "Warning" : "Error", e->message);
         if (e->file) {
-            fprintf(stderr, "  --> %s:%lu:%lu\n", e->file, (unsigned long)e->line, (unsigned long)e->column);
+            text_printf(&text, "  --> %s:%lu:%lu\n", e->file, (unsigned long)e->line, (unsigned long)e->column);
         }
+        text_flush(list, &text);
     }
+    free(text.data);
 }
 
-/**
- * Reports a single error directly to stderr.
- * Utility function for immediate error reporting.
- * 
- * @param message The error message
- * @param file The source file name
- * @param line The line number
- * @param column The column number
- */
 /**
  * Set the source code for the error list
  */
 void error_list_set_source(ErrorList* list, const char* source) {
     if (list) {
         list->source_code = source;
+        list->indexed_source = NULL;
     }
 }
 
 /**
- * Extract a line from source code
+ * Records where every line of a source starts. "\n", "\r", "\r\n" and
+ * "\n\r" each end one line; a break at the very end starts no new line.
  */
-static const char* get_line_from_source(const char* source, size_t line_num, size_t* line_length) {
-    if (line_num == 0) return NULL;
+static void index_source_lines(ErrorList* list, const char* source) {
+    size_t capacity = 64;
+    free(list->line_starts);
+    list->line_starts = malloc(sizeof(size_t) * capacity);
+    list->line_count = 0;
+    list->indexed_source = source;
     
-    size_t current_line = 1;
-    const char* line_start;
     const char* p = source;
-    
     while (*p) {
-        if (current_line == line_num) {
-            line_start = p;
-            while (*p && *p != '\n' && *p != '\r') p++;
-            *line_length = p - line_start;
-            return line_start;
+        if (list->line_count >= capacity) {
+            capacity *= 2;
+            list->line_starts = realloc(list->line_starts, sizeof(size_t) * capacity);
         }
+        list->line_starts[list->line_count++] = (size_t)(p - source);
         
+        while (*p && *p != '\n' && *p != '\r') p++;
         if (*p == '\n') {
-            current_line++;
             p++;
             if (*p == '\r') p++;
         } else if (*p == '\r') {
-            current_line++;
             p++;
             if (*p == '\n') p++;
-        } else {
-            p++;
         }
     }
-    
-    return NULL;
 }
 
 /**
- * Print beautiful error with source code snippet
+ * Extract a line from source code, indexing the source on first use
  */
-void error_report_beautiful(const char* message, const char* file, size_t line, size_t column, const char* source) {
-    init_colors();
+static const char* get_line_from_source(ErrorList* list, const char* source, size_t line_num, size_t* line_length) {
+    if (line_num == 0) return NULL;
+    
+    if (list->indexed_source != source) {
+        index_source_lines(list, source);
+    }
+    if (line_num > list->line_count) return NULL;
+    
+    const char* line_start = source + list->line_starts[line_num - 1];
+    const char* p = line_start;
+    while (*p && *p != '\n' && *p != '\r') p++;
+    *line_length = p - line_start;
+    return line_start;
+}
 
-    if (colors_enabled) {
-        fprintf(stderr, "%s%serror%s: %s\n", COLOR_BOLD, COLOR_RED, COLOR_RESET, message);
+/**
+ * Render a diagnostic with source code snippet, labelled and coloured
+ * according to its severity
+ */
+static void render_beautiful(ErrorList* list, TextBuffer* text, const char* label, const char* color,
+                             const Error* e, const char* source) {
+    bool colors = list->colors;
+    if (colors) {
+        text_printf(text, "%s%s%s%s: %s\n", COLOR_BOLD, color, label, COLOR_RESET, e->message);
     } else {
-        fprintf(stderr, "error: %s\n", message);
+        text_printf(text, "%s: %s\n", label, e->message);
     }
 
-    if (file) {
-        if (colors_enabled) {
-            fprintf(stderr, " %s-->%s %s%s:%lu:%lu%s\n", 
-                    COLOR_BLUE, COLOR_RESET,
-                    COLOR_CYAN, file, (unsigned long)line, (unsigned long)column, COLOR_RESET);
+    if (e->file) {
+        if (colors) {
+            text_printf(text, " %s-->%s %s%s:%lu:%lu%s\n", 
+                        COLOR_BLUE, COLOR_RESET,
+                        COLOR_CYAN, e->file, (unsigned long)e->line, (unsigned long)e->column, COLOR_RESET);
         } else {
-            fprintf(stderr, " --> %s:%lu:%lu\n", file, (unsigned long)line, (unsigned long)column);
+            text_printf(text, " --> %s:%lu:%lu\n", e->file, (unsigned long)e->line, (unsigned long)e->column);
         }
     }
 
-    if (source && line > 0) {
+    if (source && e->line > 0) {
         size_t line_length = 0;
-        const char* line_text = get_line_from_source(source, line, &line_length);
+        const char* line_text = get_line_from_source(list, source, e->line, &line_length);
         
         if (line_text) {
             char line_str[32];
-            snprintf(line_str, sizeof(line_str), "%lu", (unsigned long)line);
+            snprintf(line_str, sizeof(line_str), "%lu", (unsigned long)e->line);
             size_t line_num_width = strlen(line_str);
 
-            if (colors_enabled) {
-                fprintf(stderr, " %s%*s |%s\n", COLOR_BLUE, (int)line_num_width, "", COLOR_RESET);
+            if (colors) {
+                text_printf(text, " %s%*s |%s\n", COLOR_BLUE, (int)line_num_width, "", COLOR_RESET);
             } else {
-                fprintf(stderr, " %*s |\n", (int)line_num_width, "");
+                text_printf(text, " %*s |\n", (int)line_num_width, "");
             }
 
-            if (colors_enabled) {
-                fprintf(stderr, " %s%*lu |%s ", COLOR_BLUE, (int)line_num_width, (unsigned long)line, COLOR_RESET);
+            if (colors) {
+                text_printf(text, " %s%*lu |%s ", COLOR_BLUE, (int)line_num_width, (unsigned long)e->line, COLOR_RESET);
             } else {
-                fprintf(stderr, " %*lu | ", (int)line_num_width, (unsigned long)line);
+                text_printf(text, " %*lu | ", (int)line_num_width, (unsigned long)e->line);
             }
 
-            fwrite(line_text, 1, line_length, stderr);
-            fprintf(stderr, "\n");
+            text_printf(text, "%.*s\n", (int)line_length, line_text);
 
-            if (column > 0) {
-                if (colors_enabled) {
-                    fprintf(stderr, " %s%*s |%s ", COLOR_BLUE, (int)line_num_width, "", COLOR_RESET);
+            if (e->column > 0) {
+                if (colors) {
+                    text_printf(text, " %s%*s |%s ", COLOR_BLUE, (int)line_num_width, "", COLOR_RESET);
                 } else {
-                    fprintf(stderr, " %*s | ", (int)line_num_width, "");
+                    text_printf(text, " %*s | ", (int)line_num_width, "");
                 }
 
-                for (size_t i = 1; i < column && i <= line_length; i++) {
-                    if (line_text[i-1] == '\t') {
-                        fprintf(stderr, "\t");
-                    } else {
-                        fprintf(stderr, " ");
-                    }
+                for (size_t i = 1; i < e->column && i <= line_length; i++) {
+                    text_printf(text, "%c", line_text[i-1] == '\t' ? '\t' : ' ');
                 }
 
-                if (colors_enabled) {
-                    fprintf(stderr, "%s%s^%s\n", COLOR_BOLD, COLOR_RED, COLOR_RESET);
+                if (colors) {
+                    text_printf(text, "%s%s^%s\n", COLOR_BOLD, color, COLOR_RESET);
                 } else {
-                    fprintf(stderr, "^\n");
+                    text_printf(text, "^\n");
                 }
             }
         }
     }
     
-    fprintf(stderr, "\n");
+    text_printf(text, "\n");
 }
 
 /**
- * Print all errors in beautiful format
+ * Print all errors in beautiful format to the list's sink
  */
 void error_list_print_beautiful(ErrorList* list) {
     if (!list || list->error_count == 0) return;
     
+    TextBuffer text = { NULL, 0, 0 };
     for (size_t i = 0; i < list->error_count; i++) {
         Error* e = &list->errors[i];
-        error_report_beautiful(e->message, e->file, e->line, e->column, 
-                             list->source_code ? list->source_code : e->source_code);
-    }
-
-    if (list->error_count > 1) {
-        if (colors_enabled) {
-            fprintf(stderr, "%s%serror%s: aborting due to %lu previous errors\n",
-                    COLOR_BOLD, COLOR_RED, COLOR_RESET, (unsigned long)list->error_count);
+        const char* source = list->source_code ? list->source_code : e->source_code;
+        if (e->is_warning) {
+            render_beautiful(list, &text, "warning", COLOR_YELLOW, e, source);
         } else {
-            fprintf(stderr, "error: aborting due to %lu previous errors\n", 
-                    (unsigned long)list->error_count);
+            render_beautiful(list, &text, "error", COLOR_RED, e, source);
         }
+        text_flush(list, &text);
     }
-}
 
-void error_report(const char* message, const char* file, size_t line, size_t column) {
-    fprintf(stderr, "Error: %s\n", message);
-    if (file) {
-        fprintf(stderr, "  --> %s:%lu:%lu\n", file, (unsigned long)line, (unsigned long)column);
+    size_t errors = list->error_count - list->warning_count;
+    if (errors > 1) {
+        if (list->colors) {
+            text_printf(&text, "%s%serror%s: aborting due to %lu previous errors\n",
+                        COLOR_BOLD, COLOR_RED, COLOR_RESET, (unsigned long)errors);
+        } else {
+            text_printf(&text, "error: aborting due to %lu previous errors\n", 
+                        (unsigned long)errors);
+        }
+        text_flush(list, &text);
     }
+    free(text.data);
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef ERROR_H
 #define ERROR_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 typedef struct {
@@ -9,26 +10,38 @@ typedef struct {
     size_t line;
     size_t column;
     const char* source_code;
+    bool is_warning;
 } Error;
 
+// Receives each rendered diagnostic as one complete chunk of text, so
+// concurrent compilations never interleave their output
+typedef void (*DiagnosticSink)(void* context, const char* text, size_t length);
+
 typedef struct {
     Error* errors;
     size_t error_count;
     size_t error_capacity;
+    size_t warning_count;   // Entries in errors that are warnings
     const char* source_code;
+    DiagnosticSink sink;    // NULL writes to stderr
+    void* sink_context;
+    bool colors;            // Render with ANSI colour codes
+    
+    // Start offset of every line of indexed_source, built on first render
+    // so each diagnostic finds its line without rescanning the source
+    const char* indexed_source;
+    size_t* line_starts;
+    size_t line_count;
 } ErrorList;
 
 ErrorList* error_list_create(void);
 void error_list_destroy(ErrorList* list);
 void error_list_add(ErrorList* list, const char* message, const char* file, size_t line, size_t column);
+void error_list_add_warning(ErrorList* list, const char* message, const char* file, size_t line, size_t column);
 void error_list_print(ErrorList* list);
 void error_list_print_beautiful(ErrorList* list);
 void error_list_set_source(ErrorList* list, const char* source);
-
-void error_report(const char* message, const char* file, size_t line, size_t column);
-void error_report_beautiful(const char* message, const char* file, size_t line, size_t column, const char* source);
-
-void enable_colors(void);
-void disable_colors(void);
+void error_list_set_sink(ErrorList* list, DiagnosticSink sink, void* context);
+void error_list_set_colors(ErrorList* list, bool enabled);
 
 #endif
\ No newline at end of file
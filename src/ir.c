@@ -0,0 +1,1463 @@
+#include "ir.h"
+#include "semantic.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A name in scope: a scalar variable, or an array and the register holding
+// the address of its first element
+typedef struct {
+    const char* name;
+    int reg;
+    IrType type;             // Scalar type, or the element type of an array
+    bool is_array;
+    size_t length;
+    size_t depth;            // Block depth it was declared at
+} Binding;
+
+// Value of a lowered expression and its type in the generated C
+typedef struct {
+    int reg;
+    IrType type;
+} Value;
+
+typedef struct {
+    AstNode* program;
+    IrModule* module;
+    IrFunction* function;
+    AstNode** function_decls;  // Declaration of each module function
+    Binding* bindings;
+    size_t binding_count;
+    size_t binding_capacity;
+    size_t depth;
+    int break_label;         // -1 outside loops
+    int continue_label;
+    char* unsupported;       // First construct the IR cannot express
+} Lowering;
+
+static Value lower_expression(Lowering* l, AstNode* expr);
+static void lower_statement(Lowering* l, AstNode* stmt);
+
+/**
+ * Returns the size in bytes of a value of an IR type in memory.
+ *
+ * @param type The type
+ * @return Its size, 0 for void
+ */
+size_t ir_type_size(IrType type) {
+    switch (type) {
+        case IR_BOOL: case IR_I8: case IR_U8: return 1;
+        case IR_I16: case IR_U16: return 2;
+        case IR_I32: case IR_U32: case IR_F32: return 4;
+        case IR_I64: case IR_U64: case IR_F64: case IR_PTR: return 8;
+        default: return 0;
+    }
+}
+
+/**
+ * Checks whether an IR type is held in a floating-point register.
+ *
+ * @param type The type
+ * @return true for f32 and f64
+ */
+bool ir_type_is_float(IrType type) {
+    return type == IR_F32 || type == IR_F64;
+}
+
+/**
+ * Checks whether an IR integer type is signed.
+ *
+ * @param type The type
+ * @return true for i8 through i64
+ */
+bool ir_type_is_signed(IrType type) {
+    return type == IR_I8 || type == IR_I16 || type == IR_I32 || type == IR_I64;
+}
+
+/**
+ * Lists the virtual registers an instruction reads.
+ *
+ * @param instr The instruction
+ * @param operands Output array
+ * @param capacity Size of the output array
+ * @return Number of registers read (may exceed capacity for calls)
+ */
+size_t ir_operands(const IrInstr* instr, int* operands, size_t capacity) {
+    size_t count = 0;
+    if (instr->op == IR_CALL) {
+        for (size_t i = 0; i < instr->arg_count; i++) {
+            if (count < capacity) operands[count] = instr->args[i];
+            count++;
+        }
+        return count;
+    }
+
+    int regs[3] = { instr->a, instr->b, instr->c };
+    for (size_t i = 0; i < 3; i++) {
+        if (regs[i] < 0) continue;
+        if (count < capacity) operands[count] = regs[i];
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Records the first construct the IR cannot express; the caller then falls
+ * back to the C backend.
+ *
+ * @param l The lowering state
+ * @param node The construct (for its line), or NULL
+ * @param format printf-style description
+ */
+static void unsupported(Lowering* l, AstNode* node, const char* format, ...) {
+    if (l->unsupported) return;
+
+    va_list args;
+    va_start(args, format);
+    char* what = string_vformat(format, args);
+    va_end(args);
+
+    if (node && node->location.line > 0) {
+        l->unsupported = string_format("line %zu: %s", node->location.line, what);
+        free(what);
+    } else {
+        l->unsupported = what;
+    }
+}
+
+/**
+ * Maps a JFM type to the IR type of its values.
+ *
+ * @param type The JFM type (may be NULL)
+ * @return The IR type, or IR_VOID if the type is not a supported scalar
+ */
+static IrType scalar_type(Type* type) {
+    if (!type) return IR_VOID;
+
+    switch (type->kind) {
+        case TYPE_I8:   return IR_I8;
+        case TYPE_I16:  return IR_I16;
+        case TYPE_I32:  return IR_I32;
+        case TYPE_I64:  return IR_I64;
+        case TYPE_U8:   return IR_U8;
+        case TYPE_U16:  return IR_U16;
+        case TYPE_U32:  return IR_U32;
+        case TYPE_U64:  return IR_U64;
+        case TYPE_F32:  return IR_F32;
+        case TYPE_F64:  return IR_F64;
+        case TYPE_BOOL: return IR_BOOL;
+        case TYPE_CHAR: return IR_I8;
+        case TYPE_STR:  return IR_PTR;
+        default:        return IR_VOID;
+    }
+}
+
+/**
+ * Describes an array of scalars, looking through a reference to it.
+ *
+ * @param type The type to check
+ * @param element Set to the element type
+ * @param length Set to the number of elements
+ * @return true if type is such an array (nested arrays and arrays of structs are not)
+ */
+static bool array_shape(Type* type, IrType* element, size_t* length) {
+    if (type && type->kind == TYPE_REFERENCE) type = type->data.reference.referenced_type;
+    if (!type || type->kind != TYPE_ARRAY) return false;
+
+    *element = scalar_type(type->data.array.element_type);
+    *length = type->data.array.size;
+    return *element != IR_VOID;
+}
+
+/**
+ * Appends an instruction with every register operand unused.
+ *
+ * @param l The lowering state
+ * @param op The opcode
+ * @return The new instruction, valid until the next one is emitted
+ */
+static IrInstr* emit(Lowering* l, IrOpcode op) {
+    IrFunction* f = l->function;
+    if (f->count >= f->capacity) {
+        f->capacity = f->capacity ? f->capacity * 2 : 64;
+        f->code = realloc(f->code, sizeof(IrInstr) * f->capacity);
+    }
+
+    IrInstr* instr = &f->code[f->count++];
+    memset(instr, 0, sizeof(IrInstr));
+    instr->op = op;
+    instr->dst = instr->a = instr->b = instr->c = -1;
+    return instr;
+}
+
+/**
+ * Creates a virtual register.
+ *
+ * @param l The lowering state
+ * @param type Type of the values it holds
+ * @return The register number
+ */
+static int new_vreg(Lowering* l, IrType type) {
+    IrFunction* f = l->function;
+    if (f->vreg_count >= f->vreg_capacity) {
+        f->vreg_capacity = f->vreg_capacity ? f->vreg_capacity * 2 : 32;
+        f->vreg_types = realloc(f->vreg_types, sizeof(IrType) * f->vreg_capacity);
+    }
+    f->vreg_types[f->vreg_count] = type;
+    return (int)f->vreg_count++;
+}
+
+static int new_label(Lowering* l) {
+    return (int)l->function->label_count++;
+}
+
+static void place_label(Lowering* l, int label) {
+    emit(l, IR_LABEL)->imm = label;
+}
+
+static void emit_jump(Lowering* l, IrOpcode op, int condition, int label) {
+    IrInstr* instr = emit(l, op);
+    instr->a = condition;
+    instr->imm = label;
+}
+
+static Value emit_constant(Lowering* l, IrType type, int64_t value) {
+    int reg = new_vreg(l, type);
+    IrInstr* instr = emit(l, IR_CONST);
+    instr->type = type;
+    instr->dst = reg;
+    instr->imm = value;
+    return (Value){ reg, type };
+}
+
+static Value emit_float_constant(Lowering* l, IrType type, double value) {
+    int reg = new_vreg(l, type);
+    IrInstr* instr = emit(l, IR_FCONST);
+    instr->type = type;
+    instr->dst = reg;
+    instr->fimm = value;
+    return (Value){ reg, type };
+}
+
+static Value emit_binary(Lowering* l, IrOpcode op, IrType type, IrType result, int a, int b) {
+    int reg = new_vreg(l, result);
+    IrInstr* instr = emit(l, op);
+    instr->type = type;
+    instr->dst = reg;
+    instr->a = a;
+    instr->b = b;
+    return (Value){ reg, result };
+}
+
+static void emit_move(Lowering* l, int dst, Value value) {
+    IrInstr* instr = emit(l, IR_MOVE);
+    instr->type = value.type;
+    instr->dst = dst;
+    instr->a = value.reg;
+}
+
+/**
+ * Converts a value as an assignment or cast in the generated C would.
+ *
+ * @param l The lowering state
+ * @param value The value
+ * @param to The destination type
+ * @return The converted value
+ */
+static Value convert(Lowering* l, Value value, IrType to) {
+    if (value.type == to || value.reg < 0) return value;
+
+    int reg = new_vreg(l, to);
+    IrInstr* instr = emit(l, IR_CONVERT);
+    instr->type = to;
+    instr->from = value.type;
+    instr->dst = reg;
+    instr->a = value.reg;
+    return (Value){ reg, to };
+}
+
+/**
+ * Applies C's integer promotions: types narrower than int become int.
+ */
+static IrType promote(IrType type) {
+    switch (type) {
+        case IR_BOOL: case IR_I8: case IR_I16: case IR_U8: case IR_U16: return IR_I32;
+        default: return type;
+    }
+}
+
+/**
+ * Computes the type C's usual arithmetic conversions give two operands.
+ *
+ * @param a Type of the left operand
+ * @param b Type of the right operand
+ * @return The common type
+ */
+static IrType arithmetic_type(IrType a, IrType b) {
+    if (a == IR_F64 || b == IR_F64) return IR_F64;
+    if (a == IR_F32 || b == IR_F32) return IR_F32;
+
+    a = promote(a);
+    b = promote(b);
+    if (a == b) return a;
+    if (ir_type_is_signed(a) == ir_type_is_signed(b)) {
+        return ir_type_size(a) >= ir_type_size(b) ? a : b;
+    }
+
+    // An unsigned operand wins unless the signed one is wider (i64 holds every u32)
+    IrType unsigned_type = ir_type_is_signed(a) ? b : a;
+    IrType signed_type = ir_type_is_signed(a) ? a : b;
+    return ir_type_size(unsigned_type) >= ir_type_size(signed_type) ? unsigned_type : signed_type;
+}
+
+/**
+ * Produces a register that is non-zero exactly when a value is true in C.
+ *
+ * @param l The lowering state
+ * @param value The tested value
+ * @return Register holding an integer
+ */
+static int truth(Lowering* l, Value value) {
+    if (!ir_type_is_float(value.type)) return value.reg;
+    return convert(l, value, IR_BOOL).reg;
+}
+
+/**
+ * Finds the innermost binding of a name.
+ */
+static Binding* find_binding(Lowering* l, const char* name) {
+    for (size_t i = l->binding_count; i > 0; i--) {
+        if (strcmp(l->bindings[i - 1].name, name) == 0) return &l->bindings[i - 1];
+    }
+    return NULL;
+}
+
+static void bind(Lowering* l, const char* name, int reg, IrType type, bool is_array, size_t length) {
+    if (l->binding_count >= l->binding_capacity) {
+        l->binding_capacity = l->binding_capacity ? l->binding_capacity * 2 : 32;
+        l->bindings = realloc(l->bindings, sizeof(Binding) * l->binding_capacity);
+    }
+    l->bindings[l->binding_count++] = (Binding){ name, reg, type, is_array, length, l->depth };
+}
+
+static void enter_scope(Lowering* l) {
+    l->depth++;
+}
+
+static void exit_scope(Lowering* l) {
+    while (l->binding_count > 0 && l->bindings[l->binding_count - 1].depth >= l->depth) {
+        l->binding_count--;
+    }
+    l->depth--;
+}
+
+/**
+ * Finds a JFM function of the program by name.
+ *
+ * @param l The lowering state
+ * @param name The function name
+ * @return Its index in the module, or -1
+ */
+static int find_function(Lowering* l, const char* name) {
+    for (size_t i = 0; i < l->module->function_count; i++) {
+        if (strcmp(l->module->functions[i].name, name) == 0) return (int)i;
+    }
+    return -1;
+}
+
+/**
+ * Finds an extern fn by name, adding it to the module on its first call.
+ *
+ * @param l The lowering state
+ * @param name The function name
+ * @param call The call, for diagnostics
+ * @return Its index in the module's externs, or -1
+ */
+static int find_extern(Lowering* l, const char* name, AstNode* call) {
+    IrModule* module = l->module;
+    for (size_t i = 0; i < module->extern_count; i++) {
+        if (strcmp(module->externs[i].name, name) == 0) return (int)i;
+    }
+
+    AstNode* decl = NULL;
+    for (size_t i = 0; i < l->program->data.program.count && !decl; i++) {
+        AstNode* item = l->program->data.program.items[i];
+        if (item->type == AST_EXTERN_FUNCTION && strcmp(item->data.extern_function.name, name) == 0) {
+            decl = item;
+        }
+    }
+    if (!decl) return -1;
+
+    IrType return_type = IR_VOID;
+    Type* declared_return = decl->data.extern_function.return_type;
+    if (declared_return && declared_return->kind != TYPE_VOID) {
+        return_type = scalar_type(declared_return);
+        if (return_type == IR_VOID) {
+            unsupported(l, call, "extern fn %s returns %s", name, type_to_string(declared_return));
+            return -1;
+        }
+    }
+
+    IrType* params = malloc(sizeof(IrType) * (decl->data.extern_function.param_count + 1));
+    for (size_t i = 0; i < decl->data.extern_function.param_count; i++) {
+        Type* type = decl->data.extern_function.params[i].type;
+        params[i] = scalar_type(type);
+        if (params[i] == IR_VOID) {
+            unsupported(l, call, "extern fn %s takes %s", name, type_to_string(type));
+            free(params);
+            return -1;
+        }
+    }
+
+    module->externs = realloc(module->externs, sizeof(IrExtern) * (module->extern_count + 1));
+    module->externs[module->extern_count] = (IrExtern){
+        string_duplicate(name), params, decl->data.extern_function.param_count, return_type
+    };
+    return (int)module->extern_count++;
+}
+
+/**
+ * Decodes the escape sequences of a string literal as the C compiler would.
+ *
+ * @param text The literal as written, without quotes
+ * @param length Set to the decoded length
+ * @return The decoded bytes (NUL-terminated)
+ */
+static char* decode_string(const char* text, size_t* length) {
+    char* out = malloc(strlen(text) + 1);
+    size_t n = 0;
+
+    for (const char* p = text; *p; p++) {
+        if (*p != '\\' || !p[1]) {
+            out[n++] = *p;
+            continue;
+        }
+
+        p++;
+        switch (*p) {
+            case 'n': out[n++] = '\n'; break;
+            case 't': out[n++] = '\t'; break;
+            case 'r': out[n++] = '\r'; break;
+            case 'a': out[n++] = '\a'; break;
+            case 'b': out[n++] = '\b'; break;
+            case 'f': out[n++] = '\f'; break;
+            case 'v': out[n++] = '\v'; break;
+            case 'x': {
+                unsigned value = 0;
+                while (strchr("0123456789abcdefABCDEF", p[1]) && p[1]) {
+                    p++;
+                    value = value * 16 + (unsigned)(*p <= '9' ? *p - '0' : (*p | 0x20) - 'a' + 10);
+                }
+                out[n++] = (char)value;
+                break;
+            }
+            default:
+                if (*p >= '0' && *p <= '7') {
+                    unsigned value = (unsigned)(*p - '0');
+                    for (int digits = 1; digits < 3 && p[1] >= '0' && p[1] <= '7'; digits++) {
+                        p++;
+                        value = value * 8 + (unsigned)(*p - '0');
+                    }
+                    out[n++] = (char)value;
+                } else {
+                    out[n++] = *p;   // \\, \", \' and \?
+                }
+                break;
+        }
+    }
+
+    out[n] = '\0';
+    *length = n;
+    return out;
+}
+
+/**
+ * Adds a string constant to the module.
+ *
+ * @param l The lowering state
+ * @param text The literal as written
+ * @return Its index
+ */
+static int add_string(Lowering* l, const char* text) {
+    IrModule* module = l->module;
+    size_t length;
+    char* decoded = decode_string(text, &length);
+
+    for (size_t i = 0; i < module->string_count; i++) {
+        if (module->string_lengths[i] == length && memcmp(module->strings[i], decoded, length) == 0) {
+            free(decoded);
+            return (int)i;
+        }
+    }
+
+    module->strings = realloc(module->strings, sizeof(char*) * (module->string_count + 1));
+    module->string_lengths = realloc(module->string_lengths, sizeof(size_t) * (module->string_count + 1));
+    module->strings[module->string_count] = decoded;
+    module->string_lengths[module->string_count] = length;
+    return (int)module->string_count++;
+}
+
+/**
+ * Lowers a literal. Its value is the one the generated C spells: integer
+ * literals are int unless they need long, and floating-point literals are
+ * doubles printed with %f.
+ */
+static Value lower_literal(Lowering* l, AstNode* expr) {
+    TypeKind kind = expr->data_type ? expr->data_type->kind : TYPE_UNKNOWN;
+
+    switch (kind) {
+        case TYPE_STR: {
+            int reg = new_vreg(l, IR_PTR);
+            IrInstr* instr = emit(l, IR_STRING);
+            instr->type = IR_PTR;
+            instr->dst = reg;
+            instr->imm = add_string(l, expr->data.literal.string_value);
+            return (Value){ reg, IR_PTR };
+        }
+        case TYPE_BOOL:
+            return emit_constant(l, IR_I32, expr->data.literal.bool_value ? 1 : 0);
+        case TYPE_CHAR:
+            return emit_constant(l, IR_I32, (signed char)expr->data.literal.char_value);
+        case TYPE_F32:
+        case TYPE_F64: {
+            char text[512];
+            snprintf(text, sizeof(text), "%f", expr->data.literal.float_value);
+            return emit_float_constant(l, IR_F64, strtod(text, NULL));
+        }
+        case TYPE_I8: case TYPE_I16: case TYPE_I32: case TYPE_I64:
+        case TYPE_U8: case TYPE_U16: case TYPE_U32: case TYPE_U64: {
+            if (expr->data.literal.int_high) {
+                unsupported(l, expr, "integer literals above 64 bits");
+                return (Value){ -1, IR_VOID };
+            }
+            unsigned long long value = expr->data.literal.int_value;
+            return emit_constant(l, value <= 2147483647ULL ? IR_I32 : IR_I64, (int64_t)value);
+        }
+        default:
+            unsupported(l, expr, "%s literals", expr->data_type ? type_to_string(expr->data_type) : "untyped");
+            return (Value){ -1, IR_VOID };
+    }
+}
+
+/**
+ * Lowers an expression that denotes an array: a local or parameter array,
+ * or a reference to one.
+ *
+ * @param l The lowering state
+ * @param expr The expression
+ * @param element Set to the element type
+ * @param length Set to the number of elements
+ * @return Register holding the address of the first element, or -1
+ */
+static int lower_array_address(Lowering* l, AstNode* expr, IrType* element, size_t* length) {
+    AstNode* target = expr;
+    if (target->type == AST_UNARY_OP && target->data.unary.op == TOKEN_AND) {
+        target = target->data.unary.operand;
+    }
+
+    if (target->type == AST_IDENTIFIER) {
+        Binding* binding = find_binding(l, target->data.identifier.name);
+        if (binding && binding->is_array) {
+            *element = binding->type;
+            *length = binding->length;
+            return binding->reg;
+        }
+    }
+
+    unsupported(l, expr, "this array expression");
+    return -1;
+}
+
+/**
+ * Lowers the arguments of a call to a JFM or extern function.
+ *
+ * @param l The lowering state
+ * @param call The call
+ * @param param_types IR types of the parameters
+ * @param array_params Which parameters are arrays (NULL for extern fns)
+ * @return The argument registers
+ */
+static int* lower_arguments(Lowering* l, AstNode* call, IrType* param_types, bool* array_params) {
+    size_t count = call->data.call.argument_count;
+    int* args = malloc(sizeof(int) * (count + 1));
+    size_t ints = 0;
+    size_t floats = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        AstNode* arg = call->data.call.arguments[i];
+        if (array_params && array_params[i]) {
+            IrType element;
+            size_t length;
+            args[i] = lower_array_address(l, arg, &element, &length);
+        } else {
+            args[i] = convert(l, lower_expression(l, arg), param_types[i]).reg;
+        }
+        if (ir_type_is_float(param_types[i])) floats++; else ints++;
+    }
+
+    if (ints > IR_MAX_INT_ARGS || floats > IR_MAX_FLOAT_ARGS) {
+        unsupported(l, call, "calls with more than %d integer or %d floating-point arguments",
+                    IR_MAX_INT_ARGS, IR_MAX_FLOAT_ARGS);
+    }
+    return args;
+}
+
+/**
+ * Lowers println(value) or print(value) as printf does it in the generated
+ * C: integers are widened to 64 bits, floats to double, and bools print
+ * as true or false.
+ */
+static Value lower_print(Lowering* l, AstNode* expr, bool newline) {
+    int reg = -1;
+    IrType type = IR_VOID;
+
+    Type* arg_type = expr->data.call.argument_count > 0 ? expr->data.call.arguments[0]->data_type : NULL;
+    if (arg_type) {
+        Value value = lower_expression(l, expr->data.call.arguments[0]);
+        if (arg_type->kind == TYPE_STR) {
+            type = IR_PTR;
+        } else if (arg_type->kind == TYPE_BOOL) {
+            value = (Value){ truth(l, value), IR_BOOL };
+            type = IR_BOOL;
+        } else if (arg_type->kind == TYPE_CHAR) {
+            value = convert(l, value, IR_I32);
+            type = IR_I8;
+        } else if (type_is_integral(arg_type) && scalar_type(arg_type) != IR_VOID) {
+            type = type_is_signed(arg_type) ? IR_I64 : IR_U64;
+            value = convert(l, value, type);
+        } else if (type_is_float(arg_type) && scalar_type(arg_type) != IR_VOID) {
+            type = IR_F64;
+            value = convert(l, value, type);
+        } else {
+            unsupported(l, expr, "printing %s", type_to_string(arg_type));
+        }
+        reg = value.reg;
+    } else if (!newline) {
+        return (Value){ -1, IR_VOID };
+    }
+
+    IrInstr* instr = emit(l, IR_PRINT);
+    instr->type = type;
+    instr->a = reg;
+    instr->imm = newline;
+    return (Value){ -1, IR_VOID };
+}
+
+/**
+ * Lowers a call to a builtin, a JFM function or an extern fn.
+ */
+static Value lower_call(Lowering* l, AstNode* expr) {
+    AstNode* callee = expr->data.call.function;
+    if (callee->type != AST_IDENTIFIER) {
+        unsupported(l, expr, "method calls");
+        return (Value){ -1, IR_VOID };
+    }
+    if (callee->data_type && callee->data_type->kind == TYPE_FUNCTION) {
+        unsupported(l, expr, "calls through fn values");
+        return (Value){ -1, IR_VOID };
+    }
+
+    const char* name = callee->data.identifier.name;
+    ByteAccess access;
+    if (strcmp(name, "println") == 0 || strcmp(name, "print") == 0) {
+        return lower_print(l, expr, name[5] == 'l');
+    }
+    if (semantic_byte_access(name, &access) || strcmp(name, "Some") == 0 ||
+        strcmp(name, "Ok") == 0 || strcmp(name, "Err") == 0) {
+        unsupported(l, expr, "%s()", name);
+        return (Value){ -1, IR_VOID };
+    }
+    if (strcmp(name, "sqrt") == 0) {
+        if (expr->data.call.argument_count != 1) {
+            unsupported(l, expr, "sqrt() without one argument");
+            return (Value){ -1, IR_VOID };
+        }
+        Value arg = convert(l, lower_expression(l, expr->data.call.arguments[0]), IR_F64);
+        return emit_binary(l, IR_SQRT, IR_F64, IR_F64, arg.reg, -1);
+    }
+
+    int index = find_function(l, name);
+    bool external = index < 0;
+    IrType* param_types;
+    IrType return_type;
+    bool* array_params = NULL;
+    size_t param_count;
+
+    if (!external) {
+        IrFunction* target = &l->module->functions[index];
+        param_types = target->param_types;
+        param_count = target->param_count;
+        return_type = target->return_type;
+
+        AstNode* decl = l->function_decls[index];
+        array_params = calloc(param_count + 1, sizeof(bool));
+        for (size_t i = 0; i < param_count; i++) {
+            IrType element;
+            size_t length;
+            array_params[i] = array_shape(decl->data.function.params[i].type, &element, &length);
+        }
+    } else {
+        index = find_extern(l, name, expr);
+        if (index < 0) {
+            unsupported(l, expr, "call to %s", name);
+            return (Value){ -1, IR_VOID };
+        }
+        IrExtern* target = &l->module->externs[index];
+        param_types = target->param_types;
+        param_count = target->param_count;
+        return_type = target->return_type;
+    }
+
+    if (param_count != expr->data.call.argument_count) {
+        unsupported(l, expr, "call to %s with %zu arguments", name, expr->data.call.argument_count);
+        free(array_params);
+        return (Value){ -1, IR_VOID };
+    }
+
+    int* args = lower_arguments(l, expr, param_types, array_params);
+    free(array_params);
+
+    int reg = return_type == IR_VOID ? -1 : new_vreg(l, return_type);
+    IrInstr* instr = emit(l, IR_CALL);
+    instr->type = return_type;
+    instr->dst = reg;
+    instr->imm = index;
+    instr->external = external;
+    instr->args = args;
+    instr->arg_count = expr->data.call.argument_count;
+    return (Value){ reg, return_type };
+}
+
+/**
+ * Lowers && and || with the short-circuit evaluation of C, giving an int.
+ */
+static Value lower_logical(Lowering* l, AstNode* expr) {
+    bool is_and = expr->data.binary.op == TOKEN_AND_AND;
+    int result = new_vreg(l, IR_I32);
+    int done = new_label(l);
+
+    emit_move(l, result, emit_constant(l, IR_I32, is_and ? 0 : 1));
+    Value left = lower_expression(l, expr->data.binary.left);
+    emit_jump(l, is_and ? IR_JUMP_UNLESS : IR_JUMP_IF, truth(l, left), done);
+    Value right = lower_expression(l, expr->data.binary.right);
+    emit_move(l, result, convert(l, right, IR_BOOL));
+    place_label(l, done);
+    return (Value){ result, IR_I32 };
+}
+
+/**
+ * Lowers a binary operation with the operand conversions of C.
+ */
+static Value lower_binary(Lowering* l, AstNode* expr) {
+    TokenType op = expr->data.binary.op;
+    if (op == TOKEN_AND_AND || op == TOKEN_OR_OR) return lower_logical(l, expr);
+
+    Value left = lower_expression(l, expr->data.binary.left);
+    Value right = lower_expression(l, expr->data.binary.right);
+    if (left.reg < 0 || right.reg < 0) return (Value){ -1, IR_VOID };
+
+    // Shifts take the promoted type of the left operand; the count may have any integer type
+    if (op == TOKEN_LT_LT || op == TOKEN_GT_GT) {
+        IrType type = promote(left.type);
+        if (ir_type_is_float(type) || type == IR_PTR || ir_type_is_float(right.type)) {
+            unsupported(l, expr, "shifting this operand");
+            return (Value){ -1, IR_VOID };
+        }
+        left = convert(l, left, type);
+        return emit_binary(l, op == TOKEN_LT_LT ? IR_SHL : IR_SHR, type, type, left.reg, right.reg);
+    }
+
+    bool comparison = op == TOKEN_EQ_EQ || op == TOKEN_NOT_EQ || op == TOKEN_LT || op == TOKEN_LT_EQ ||
+                      op == TOKEN_GT || op == TOKEN_GT_EQ;
+    IrType type;
+    if (left.type == IR_PTR || right.type == IR_PTR) {
+        // Strings only compare by address, as in the generated C
+        if ((op != TOKEN_EQ_EQ && op != TOKEN_NOT_EQ) || left.type != right.type) {
+            unsupported(l, expr, "arithmetic on str");
+            return (Value){ -1, IR_VOID };
+        }
+        type = IR_U64;
+    } else {
+        type = arithmetic_type(left.type, right.type);
+    }
+
+    bool integral_only = op == TOKEN_PERCENT || op == TOKEN_AND || op == TOKEN_OR || op == TOKEN_XOR;
+    if (integral_only && ir_type_is_float(type)) {
+        unsupported(l, expr, "this operator on floating-point operands");
+        return (Value){ -1, IR_VOID };
+    }
+
+    if (left.type != IR_PTR) {
+        left = convert(l, left, type);
+        right = convert(l, right, type);
+    }
+
+    IrOpcode opcode;
+    switch (op) {
+        case TOKEN_PLUS:    opcode = IR_ADD; break;
+        case TOKEN_MINUS:   opcode = IR_SUB; break;
+        case TOKEN_STAR:    opcode = IR_MUL; break;
+        case TOKEN_SLASH:   opcode = IR_DIV; break;
+        case TOKEN_PERCENT: opcode = IR_REM; break;
+        case TOKEN_AND:     opcode = IR_AND; break;
+        case TOKEN_OR:      opcode = IR_OR; break;
+        case TOKEN_XOR:     opcode = IR_XOR; break;
+        case TOKEN_EQ_EQ:   opcode = IR_EQ; break;
+        case TOKEN_NOT_EQ:  opcode = IR_NE; break;
+        case TOKEN_LT:      opcode = IR_LT; break;
+        case TOKEN_LT_EQ:   opcode = IR_LE; break;
+        case TOKEN_GT:      opcode = IR_GT; break;
+        case TOKEN_GT_EQ:   opcode = IR_GE; break;
+        default:
+            unsupported(l, expr, "this binary operator");
+            return (Value){ -1, IR_VOID };
+    }
+
+    return emit_binary(l, opcode, type, comparison ? IR_I32 : type, left.reg, right.reg);
+}
+
+/**
+ * Lowers -x and !x; & and * only appear as array arguments in the IR.
+ */
+static Value lower_unary(Lowering* l, AstNode* expr) {
+    TokenType op = expr->data.unary.op;
+    if (op != TOKEN_MINUS && op != TOKEN_NOT) {
+        unsupported(l, expr, "pointers and references outside array arguments");
+        return (Value){ -1, IR_VOID };
+    }
+
+    Value operand = lower_expression(l, expr->data.unary.operand);
+    if (operand.reg < 0) return operand;
+    if (operand.type == IR_PTR) {
+        unsupported(l, expr, "this operator on str");
+        return (Value){ -1, IR_VOID };
+    }
+
+    if (op == TOKEN_NOT) {
+        Value zero = ir_type_is_float(operand.type) ? emit_float_constant(l, operand.type, 0.0)
+                                                   : emit_constant(l, operand.type, 0);
+        return emit_binary(l, IR_EQ, operand.type, IR_I32, operand.reg, zero.reg);
+    }
+
+    IrType type = promote(operand.type);
+    operand = convert(l, operand, type);
+    return emit_binary(l, IR_NEG, type, type, operand.reg, -1);
+}
+
+/**
+ * Lowers the target and value of an assignment; the result is the stored value.
+ */
+static Value lower_assignment(Lowering* l, AstNode* expr) {
+    AstNode* target = expr->data.assignment.target;
+    if (expr->data.assignment.op != TOKEN_EQ) {
+        unsupported(l, expr, "compound assignment");
+        return (Value){ -1, IR_VOID };
+    }
+
+    if (target->type == AST_IDENTIFIER) {
+        Binding* binding = find_binding(l, target->data.identifier.name);
+        if (!binding || binding->is_array) {
+            unsupported(l, expr, "assignment to %s", target->data.identifier.name);
+            return (Value){ -1, IR_VOID };
+        }
+        int reg = binding->reg;
+        IrType type = binding->type;
+        Value value = convert(l, lower_expression(l, expr->data.assignment.value), type);
+        emit_move(l, reg, value);
+        return (Value){ reg, type };
+    }
+
+    if (target->type == AST_INDEX) {
+        IrType element;
+        size_t length;
+        int base = lower_array_address(l, target->data.index.array, &element, &length);
+        Value index = lower_expression(l, target->data.index.index);
+        Value value = convert(l, lower_expression(l, expr->data.assignment.value), element);
+
+        IrInstr* instr = emit(l, IR_STORE);
+        instr->type = element;
+        instr->a = base;
+        instr->b = index.reg;
+        instr->c = value.reg;
+        return value;
+    }
+
+    unsupported(l, expr, "this assignment target");
+    return (Value){ -1, IR_VOID };
+}
+
+/**
+ * Lowers an expression to the register holding its value.
+ *
+ * @param l The lowering state
+ * @param expr The expression
+ * @return The value and its C type; reg is -1 for void or unsupported expressions
+ */
+static Value lower_expression(Lowering* l, AstNode* expr) {
+    if (!expr || l->unsupported) return (Value){ -1, IR_VOID };
+
+    switch (expr->type) {
+        case AST_LITERAL:
+            return lower_literal(l, expr);
+
+        case AST_IDENTIFIER: {
+            Binding* binding = find_binding(l, expr->data.identifier.name);
+            if (!binding || binding->is_array) {
+                unsupported(l, expr, "use of %s as a value", expr->data.identifier.name);
+                return (Value){ -1, IR_VOID };
+            }
+            return (Value){ binding->reg, binding->type };
+        }
+
+        case AST_BINARY_OP:
+            return lower_binary(l, expr);
+
+        case AST_UNARY_OP:
+            return lower_unary(l, expr);
+
+        case AST_CAST: {
+            IrType type = scalar_type(expr->data.cast.target_type);
+            if (type == IR_VOID || type == IR_PTR) {
+                unsupported(l, expr, "casts to %s", type_to_string(expr->data.cast.target_type));
+                return (Value){ -1, IR_VOID };
+            }
+            Value value = lower_expression(l, expr->data.cast.expression);
+            if (value.type == IR_PTR) {
+                unsupported(l, expr, "casts from str");
+                return (Value){ -1, IR_VOID };
+            }
+            return convert(l, value, type);
+        }
+
+        case AST_CALL:
+            return lower_call(l, expr);
+
+        case AST_INDEX: {
+            IrType element;
+            size_t length;
+            int base = lower_array_address(l, expr->data.index.array, &element, &length);
+            Value index = lower_expression(l, expr->data.index.index);
+            if (ir_type_is_float(index.type) || index.type == IR_PTR) {
+                unsupported(l, expr, "this array index");
+                return (Value){ -1, IR_VOID };
+            }
+
+            int reg = new_vreg(l, element);
+            IrInstr* instr = emit(l, IR_LOAD);
+            instr->type = element;
+            instr->dst = reg;
+            instr->a = base;
+            instr->b = index.reg;
+            return (Value){ reg, element };
+        }
+
+        case AST_ASSIGNMENT:
+            return lower_assignment(l, expr);
+
+        default:
+            unsupported(l, expr, "this kind of expression");
+            return (Value){ -1, IR_VOID };
+    }
+}
+
+/**
+ * Lowers a let statement: scalars get a virtual register, arrays storage
+ * in the stack frame.
+ */
+static void lower_let(Lowering* l, AstNode* stmt) {
+    Type* type = stmt->data.let_stmt.type;
+    AstNode* value = stmt->data.let_stmt.value;
+    if (!type && value) type = value->data_type;
+    const char* name = stmt->data.let_stmt.name;
+
+    IrType element;
+    size_t length;
+    if (type && type->kind == TYPE_ARRAY && array_shape(type, &element, &length)) {
+        IrFunction* f = l->function;
+        if (f->frame_count >= f->frame_capacity) {
+            f->frame_capacity = f->frame_capacity ? f->frame_capacity * 2 : 8;
+            f->frame = realloc(f->frame, sizeof(IrFrameObject) * f->frame_capacity);
+        }
+        f->frame[f->frame_count] = (IrFrameObject){ length * ir_type_size(element), 16 };
+
+        int address = new_vreg(l, IR_PTR);
+        IrInstr* instr = emit(l, IR_FRAME);
+        instr->type = IR_PTR;
+        instr->dst = address;
+        instr->imm = (int64_t)f->frame_count++;
+
+        if (value) {
+            if (value->type != AST_ARRAY_LITERAL) {
+                unsupported(l, stmt, "array initialisers other than literals");
+                return;
+            }
+            // Elements the literal leaves out are zero, as in C; [value; N]
+            // stores its one element N times
+            size_t repeat = value->data.array_literal.repeat;
+            for (size_t i = 0; i < length; i++) {
+                Value element_value;
+                if (repeat || i < value->data.array_literal.element_count) {
+                    AstNode* element_node = value->data.array_literal.elements[repeat ? 0 : i];
+                    if (element_node->type == AST_ARRAY_LITERAL) {
+                        unsupported(l, stmt, "nested array literals");
+                        return;
+                    }
+                    element_value = lower_expression(l, element_node);
+                } else {
+                    element_value = emit_constant(l, IR_I32, 0);
+                }
+                element_value = convert(l, element_value, element);
+                Value index = emit_constant(l, IR_I64, (int64_t)i);
+
+                IrInstr* store = emit(l, IR_STORE);
+                store->type = element;
+                store->a = address;
+                store->b = index.reg;
+                store->c = element_value.reg;
+            }
+        }
+        bind(l, name, address, element, true, length);
+        return;
+    }
+
+    if (type && type->kind == TYPE_REFERENCE && array_shape(type, &element, &length) && value) {
+        int address = lower_array_address(l, value, &element, &length);
+        bind(l, name, address, element, true, length);
+        return;
+    }
+
+    IrType scalar = scalar_type(type);
+    if (scalar == IR_VOID) {
+        unsupported(l, stmt, "variables of type %s", type ? type_to_string(type) : "unknown");
+        return;
+    }
+
+    int reg = new_vreg(l, scalar);
+    Value initial = value ? convert(l, lower_expression(l, value), scalar)
+                          : ir_type_is_float(scalar) ? emit_float_constant(l, scalar, 0.0)
+                                                     : emit_constant(l, scalar, 0);
+    emit_move(l, reg, initial);
+    bind(l, name, reg, scalar, false, 0);
+}
+
+/**
+ * Lowers a statement in a new block scope.
+ */
+static void lower_scoped(Lowering* l, AstNode* stmt) {
+    enter_scope(l);
+    lower_statement(l, stmt);
+    exit_scope(l);
+}
+
+/**
+ * Lowers a loop body with its break and continue targets.
+ */
+static void lower_loop_body(Lowering* l, AstNode* body, int break_label, int continue_label) {
+    int saved_break = l->break_label;
+    int saved_continue = l->continue_label;
+    l->break_label = break_label;
+    l->continue_label = continue_label;
+    lower_scoped(l, body);
+    l->break_label = saved_break;
+    l->continue_label = saved_continue;
+}
+
+/**
+ * Lowers a loop over a range like the generated C: an int counter from
+ * the start, with the bound and step evaluated on every iteration.
+ */
+static void lower_range_for(Lowering* l, AstNode* stmt) {
+    bool reverse = stmt->data.for_loop.reverse;
+    int counter = new_vreg(l, IR_I32);
+    int top = new_label(l);
+    int step_label = new_label(l);
+    int done = new_label(l);
+
+    Value first;
+    if (reverse) {
+        first = lower_expression(l, stmt->data.for_loop.end);
+        if (!stmt->data.for_loop.inclusive) {
+            IrType type = arithmetic_type(first.type, IR_I32);
+            first = convert(l, first, type);
+            Value one = convert(l, emit_constant(l, IR_I32, 1), type);
+            first = emit_binary(l, IR_SUB, type, type, first.reg, one.reg);
+        }
+    } else {
+        first = lower_expression(l, stmt->data.for_loop.start);
+    }
+    emit_move(l, counter, convert(l, first, IR_I32));
+
+    enter_scope(l);
+    bind(l, stmt->data.for_loop.iterator, counter, IR_I32, false, 0);
+
+    place_label(l, top);
+    Value bound = lower_expression(l, reverse ? stmt->data.for_loop.start : stmt->data.for_loop.end);
+    IrType type = arithmetic_type(IR_I32, bound.type);
+    Value current = convert(l, (Value){ counter, IR_I32 }, type);
+    bound = convert(l, bound, type);
+    IrOpcode compare = reverse ? IR_GE : stmt->data.for_loop.inclusive ? IR_LE : IR_LT;
+    emit_jump(l, IR_JUMP_UNLESS, emit_binary(l, compare, type, IR_I32, current.reg, bound.reg).reg, done);
+
+    lower_loop_body(l, stmt->data.for_loop.body, done, step_label);
+
+    place_label(l, step_label);
+    Value step = stmt->data.for_loop.step ? lower_expression(l, stmt->data.for_loop.step)
+                                          : emit_constant(l, IR_I32, 1);
+    type = arithmetic_type(IR_I32, step.type);
+    current = convert(l, (Value){ counter, IR_I32 }, type);
+    step = convert(l, step, type);
+    Value next = emit_binary(l, reverse ? IR_SUB : IR_ADD, type, type, current.reg, step.reg);
+    emit_move(l, counter, convert(l, next, IR_I32));
+    emit(l, IR_JUMP)->imm = top;
+
+    exit_scope(l);
+    place_label(l, done);
+}
+
+/**
+ * Lowers a loop over the elements of one array, or two zipped arrays,
+ * as a counted loop that loads each element into its binding.
+ */
+static void lower_array_for(Lowering* l, AstNode* stmt) {
+    if (stmt->data.for_loop.iterator_mut || stmt->data.for_loop.zip_mut) {
+        unsupported(l, stmt, "&mut element bindings");
+        return;
+    }
+
+    IrType element, zip_element = IR_VOID;
+    size_t length, zip_length;
+    int base = lower_array_address(l, stmt->data.for_loop.iterable, &element, &length);
+    int zip_base = -1;
+    if (stmt->data.for_loop.zip_with) {
+        zip_base = lower_array_address(l, stmt->data.for_loop.zip_with, &zip_element, &zip_length);
+        if (zip_length < length) length = zip_length;
+    }
+    if (l->unsupported) return;
+
+    bool reverse = stmt->data.for_loop.reverse;
+    int counter = new_vreg(l, IR_I32);
+    int top = new_label(l);
+    int step_label = new_label(l);
+    int done = new_label(l);
+
+    emit_move(l, counter, emit_constant(l, IR_I32, reverse ? (int64_t)length - 1 : 0));
+    enter_scope(l);
+    if (stmt->data.for_loop.index_name) {
+        bind(l, stmt->data.for_loop.index_name, counter, IR_I32, false, 0);
+    }
+
+    place_label(l, top);
+    Value bound = emit_constant(l, IR_I32, reverse ? 0 : (int64_t)length);
+    emit_jump(l, IR_JUMP_UNLESS, emit_binary(l, reverse ? IR_GE : IR_LT, IR_I32, IR_I32, counter, bound.reg).reg, done);
+
+    enter_scope(l);
+    int value = new_vreg(l, element);
+    IrInstr* load = emit(l, IR_LOAD);
+    load->type = element;
+    load->dst = value;
+    load->a = base;
+    load->b = counter;
+    bind(l, stmt->data.for_loop.iterator, value, element, false, 0);
+    if (zip_base >= 0) {
+        int zip_value = new_vreg(l, zip_element);
+        load = emit(l, IR_LOAD);
+        load->type = zip_element;
+        load->dst = zip_value;
+        load->a = zip_base;
+        load->b = counter;
+        bind(l, stmt->data.for_loop.zip_name, zip_value, zip_element, false, 0);
+    }
+    lower_loop_body(l, stmt->data.for_loop.body, done, step_label);
+    exit_scope(l);
+
+    place_label(l, step_label);
+    Value one = emit_constant(l, IR_I32, 1);
+    emit_move(l, counter, emit_binary(l, reverse ? IR_SUB : IR_ADD, IR_I32, IR_I32, counter, one.reg));
+    emit(l, IR_JUMP)->imm = top;
+
+    exit_scope(l);
+    place_label(l, done);
+}
+
+/**
+ * Lowers a statement.
+ *
+ * @param l The lowering state
+ * @param stmt The statement
+ */
+static void lower_statement(Lowering* l, AstNode* stmt) {
+    if (!stmt || l->unsupported) return;
+
+    switch (stmt->type) {
+        case AST_BLOCK:
+            if (stmt->data.block.final_expr) {
+                unsupported(l, stmt, "block values");
+                return;
+            }
+            enter_scope(l);
+            for (size_t i = 0; i < stmt->data.block.statement_count; i++) {
+                lower_statement(l, stmt->data.block.statements[i]);
+            }
+            exit_scope(l);
+            break;
+
+        case AST_LET:
+            lower_let(l, stmt);
+            break;
+
+        case AST_IF: {
+            int else_label = new_label(l);
+            int done = new_label(l);
+            Value condition = lower_expression(l, stmt->data.if_stmt.condition);
+            emit_jump(l, IR_JUMP_UNLESS, truth(l, condition), else_label);
+            lower_scoped(l, stmt->data.if_stmt.then_branch);
+            if (stmt->data.if_stmt.else_branch) emit(l, IR_JUMP)->imm = done;
+            place_label(l, else_label);
+            if (stmt->data.if_stmt.else_branch) {
+                lower_scoped(l, stmt->data.if_stmt.else_branch);
+                place_label(l, done);
+            }
+            break;
+        }
+
+        case AST_WHILE: {
+            int top = new_label(l);
+            int done = new_label(l);
+            place_label(l, top);
+            Value condition = lower_expression(l, stmt->data.while_loop.condition);
+            emit_jump(l, IR_JUMP_UNLESS, truth(l, condition), done);
+            lower_loop_body(l, stmt->data.while_loop.body, done, top);
+            emit(l, IR_JUMP)->imm = top;
+            place_label(l, done);
+            break;
+        }
+
+        case AST_LOOP: {
+            int top = new_label(l);
+            int done = new_label(l);
+            place_label(l, top);
+            lower_loop_body(l, stmt->data.loop_stmt.body, done, top);
+            emit(l, IR_JUMP)->imm = top;
+            place_label(l, done);
+            break;
+        }
+
+        case AST_FOR:
+            if (stmt->data.for_loop.iterable) {
+                lower_array_for(l, stmt);
+            } else {
+                lower_range_for(l, stmt);
+            }
+            break;
+
+        case AST_RETURN: {
+            IrType type = l->function->return_type;
+            Value value = { -1, IR_VOID };
+            if (stmt->data.return_stmt.value) {
+                value = convert(l, lower_expression(l, stmt->data.return_stmt.value), type);
+            }
+            IrInstr* instr = emit(l, IR_RETURN);
+            instr->type = type;
+            instr->a = type == IR_VOID ? -1 : value.reg;
+            break;
+        }
+
+        case AST_BREAK:
+        case AST_CONTINUE: {
+            int label = stmt->type == AST_BREAK ? l->break_label : l->continue_label;
+            if (label < 0) {
+                unsupported(l, stmt, "break or continue outside a loop");
+                return;
+            }
+            emit(l, IR_JUMP)->imm = label;
+            break;
+        }
+
+        case AST_ASM:
+            unsupported(l, stmt, "asm! statements");
+            break;
+
+        default:
+            lower_expression(l, stmt);
+            break;
+    }
+}
+
+/**
+ * Lowers the body of a JFM function whose signature is already in the module.
+ *
+ * @param l The lowering state
+ * @param func The function AST node
+ * @param f The IR function
+ */
+static void lower_function(Lowering* l, AstNode* func, IrFunction* f) {
+    l->function = f;
+    l->binding_count = 0;
+    l->depth = 0;
+    l->break_label = -1;
+    l->continue_label = -1;
+
+    // Parameters are the first virtual registers
+    enter_scope(l);
+    for (size_t i = 0; i < f->param_count; i++) {
+        Param* param = &func->data.function.params[i];
+        IrType element;
+        size_t length;
+        int reg = new_vreg(l, f->param_types[i]);
+        if (array_shape(param->type, &element, &length)) {
+            bind(l, param->name, reg, element, true, length);
+        } else {
+            bind(l, param->name, reg, f->param_types[i], false, 0);
+        }
+    }
+
+    lower_statement(l, func->data.function.body);
+    exit_scope(l);
+
+    // Falling off the end returns, with 0 from functions returning a value
+    int result = -1;
+    if (f->return_type != IR_VOID) {
+        result = ir_type_is_float(f->return_type) ? emit_float_constant(l, f->return_type, 0.0).reg
+                                                  : emit_constant(l, f->return_type, 0).reg;
+    }
+    IrInstr* instr = emit(l, IR_RETURN);
+    instr->type = f->return_type;
+    instr->a = result;
+}
+
+/**
+ * Builds the signature of a JFM function.
+ *
+ * @param l The lowering state
+ * @param func The function AST node
+ * @param f The IR function to fill in
+ */
+static void declare_function(Lowering* l, AstNode* func, IrFunction* f) {
+    memset(f, 0, sizeof(IrFunction));
+    f->name = string_duplicate(func->data.function.name);
+    f->param_count = func->data.function.param_count;
+    f->param_types = malloc(sizeof(IrType) * (f->param_count + 1));
+
+    size_t ints = 0, floats = 0;
+    for (size_t i = 0; i < f->param_count; i++) {
+        Type* type = func->data.function.params[i].type;
+        IrType element;
+        size_t length;
+        if (array_shape(type, &element, &length)) {
+            f->param_types[i] = IR_PTR;
+        } else {
+            f->param_types[i] = scalar_type(type);
+            if (f->param_types[i] == IR_VOID) {
+                unsupported(l, func, "parameters of type %s", type ? type_to_string(type) : "unknown");
+            }
+        }
+        if (ir_type_is_float(f->param_types[i])) floats++; else ints++;
+    }
+    if (ints > IR_MAX_INT_ARGS || floats > IR_MAX_FLOAT_ARGS) {
+        unsupported(l, func, "functions with more than %d integer or %d floating-point parameters",
+                    IR_MAX_INT_ARGS, IR_MAX_FLOAT_ARGS);
+    }
+
+    Type* return_type = func->data.function.return_type;
+    f->return_type = IR_VOID;
+    if (return_type && return_type->kind != TYPE_VOID) {
+        f->return_type = scalar_type(return_type);
+        if (f->return_type == IR_VOID) {
+            unsupported(l, func, "functions returning %s", type_to_string(return_type));
+        }
+    }
+}
+
+/**
+ * Lowers a checked program to the IR shared by the native backend and the
+ * VM. Only a subset of JFM is covered: scalar values, strings, local and
+ * parameter arrays of scalars, control flow and calls. Anything else
+ * (structs, closures, pointers, Option / Result, ...) is reported so the
+ * caller can use the C backend instead.
+ *
+ * @param program The program AST node, after semantic analysis
+ * @param unsupported_construct Set to a description of the first construct not covered (caller frees)
+ * @return The module, or NULL if the program is not covered
+ */
+IrModule* ir_lower(AstNode* program, char** unsupported_construct) {
+    Lowering l;
+    memset(&l, 0, sizeof(l));
+    l.program = program;
+    l.module = calloc(1, sizeof(IrModule));
+    l.module->main_index = (size_t)-1;
+
+    size_t function_count = 0;
+    for (size_t i = 0; i < program->data.program.count; i++) {
+        AstNode* item = program->data.program.items[i];
+        if (item->type == AST_FUNCTION) {
+            function_count++;
+        } else if (item->type == AST_STRUCT || item->type == AST_IMPL) {
+            unsupported(&l, item, "structs");
+        }
+    }
+
+    l.module->functions = calloc(function_count + 1, sizeof(IrFunction));
+    l.function_decls = calloc(function_count + 1, sizeof(AstNode*));
+    for (size_t i = 0; i < program->data.program.count && !l.unsupported; i++) {
+        AstNode* item = program->data.program.items[i];
+        if (item->type != AST_FUNCTION) continue;
+
+        l.function_decls[l.module->function_count] = item;
+        IrFunction* f = &l.module->functions[l.module->function_count++];
+        declare_function(&l, item, f);
+        if (strcmp(f->name, "main") == 0) {
+            l.module->main_index = l.module->function_count - 1;
+            if (f->param_count > 0) unsupported(&l, item, "main with parameters");
+        }
+    }
+    if (l.module->main_index == (size_t)-1) unsupported(&l, NULL, "programs without main");
+
+    for (size_t i = 0; i < l.module->function_count && !l.unsupported; i++) {
+        lower_function(&l, l.function_decls[i], &l.module->functions[i]);
+    }
+
+    free(l.bindings);
+    free(l.function_decls);
+    if (l.unsupported) {
+        *unsupported_construct = l.unsupported;
+        ir_destroy(l.module);
+        return NULL;
+    }
+    return l.module;
+}
+
+/**
+ * Frees a module and everything it owns.
+ *
+ * @param module The module (may be NULL)
+ */
+void ir_destroy(IrModule* module) {
+    if (!module) return;
+
+    for (size_t i = 0; i < module->function_count; i++) {
+        IrFunction* f = &module->functions[i];
+        for (size_t j = 0; j < f->count; j++) {
+            free(f->code[j].args);
+        }
+        free(f->name);
+        free(f->param_types);
+        free(f->vreg_types);
+        free(f->code);
+        free(f->frame);
+    }
+    free(module->functions);
+
+    for (size_t i = 0; i < module->extern_count; i++) {
+        free(module->externs[i].name);
+        free(module->externs[i].param_types);
+    }
+    free(module->externs);
+
+    for (size_t i = 0; i < module->string_count; i++) {
+        free(module->strings[i]);
+    }
+    free(module->strings);
+    free(module->string_lengths);
+    free(module);
+}
@@ -0,0 +1,136 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ast.h"
+
+// Calls pass at most this many integer / floating-point arguments, the
+// ones the System V ABI passes in registers
+#define IR_MAX_INT_ARGS 6
+#define IR_MAX_FLOAT_ARGS 8
+
+// Scalar type of an IR value. Every integer is held in 64 bits, sign- or
+// zero-extended from its width; an f32 is held as the double of the same
+// value, rounded back to single precision after every operation.
+typedef enum {
+    IR_VOID,
+    IR_BOOL,
+    IR_I8,       // Also char, as in the generated C
+    IR_I16,
+    IR_I32,
+    IR_I64,
+    IR_U8,
+    IR_U16,
+    IR_U32,
+    IR_U64,
+    IR_F32,
+    IR_F64,
+    IR_PTR,      // str and array addresses
+} IrType;
+
+typedef enum {
+    IR_LABEL,        // Jump target number imm
+    IR_CONST,        // dst = imm
+    IR_FCONST,       // dst = fimm
+    IR_STRING,       // dst = address of string constant imm
+    IR_FRAME,        // dst = address of frame object imm
+    IR_MOVE,         // dst = a
+    IR_ADD,          // dst = a op b, computed in type
+    IR_SUB,
+    IR_MUL,
+    IR_DIV,
+    IR_REM,
+    IR_AND,
+    IR_OR,
+    IR_XOR,
+    IR_SHL,
+    IR_SHR,          // Arithmetic for signed types
+    IR_NEG,          // dst = -a
+    IR_NOT,          // dst = ~a
+    IR_SQRT,         // dst = sqrt(a), f64
+    IR_EQ,           // dst = a op b compared as type, 0 or 1 (i32)
+    IR_NE,
+    IR_LT,
+    IR_LE,
+    IR_GT,
+    IR_GE,
+    IR_CONVERT,      // dst = a converted from `from` to type
+    IR_LOAD,         // dst = ((type*)a)[b]
+    IR_STORE,        // ((type*)a)[b] = c
+    IR_JUMP,         // goto label imm
+    IR_JUMP_IF,      // if (a != 0) goto label imm
+    IR_JUMP_UNLESS,  // if (a == 0) goto label imm
+    IR_CALL,         // dst = function imm (args); dst is -1 for void
+    IR_PRINT,        // printf a as type (PTR: %s, BOOL: true/false, I8: %c); imm 1 appends a newline
+    IR_RETURN,       // return a, or nothing when a is -1
+} IrOpcode;
+
+typedef struct {
+    IrOpcode op;
+    IrType type;
+    IrType from;           // Source type of IR_CONVERT
+    int dst;               // Virtual registers, -1 when unused
+    int a;
+    int b;
+    int c;
+    int64_t imm;
+    double fimm;
+    int* args;             // IR_CALL arguments
+    size_t arg_count;
+    bool external;         // IR_CALL of an extern fn rather than a JFM function
+} IrInstr;
+
+// Array local: storage in the function's stack frame
+typedef struct {
+    size_t size;
+    size_t align;
+} IrFrameObject;
+
+// A JFM function. Its parameters are virtual registers 0..param_count-1.
+typedef struct {
+    char* name;
+    IrType* param_types;
+    size_t param_count;
+    IrType return_type;
+    IrType* vreg_types;
+    size_t vreg_count;
+    size_t vreg_capacity;
+    IrInstr* code;
+    size_t count;
+    size_t capacity;
+    size_t label_count;
+    IrFrameObject* frame;
+    size_t frame_count;
+    size_t frame_capacity;
+} IrFunction;
+
+// An extern fn the program calls, resolved by the linker or the VM
+typedef struct {
+    char* name;
+    IrType* param_types;
+    size_t param_count;
+    IrType return_type;
+} IrExtern;
+
+typedef struct {
+    IrFunction* functions;
+    size_t function_count;
+    IrExtern* externs;
+    size_t extern_count;
+    char** strings;        // Decoded string literals
+    size_t* string_lengths;
+    size_t string_count;
+    size_t main_index;
+} IrModule;
+
+IrModule* ir_lower(AstNode* program, char** unsupported_construct);
+void ir_destroy(IrModule* module);
+
+size_t ir_type_size(IrType type);
+bool ir_type_is_float(IrType type);
+bool ir_type_is_signed(IrType type);
+size_t ir_operands(const IrInstr* instr, int* operands, size_t capacity);
+
+#endif
@@ -2,31 +2,52 @@
  * JFM Compiler - A Rust-like language that transpiles to C
  * 
  * Usage: jfmc [options] <input.jfm>
+ *        jfmc run [options] <input.jfm> [program args...]
+ *        jfmc --hot-reload [options] <input.jfm>
+ *        jfmc --watch [options] <input.jfm>
  * 
  * Options:
  *   -o <output>   Output file (default: <input>.c)
  *   -ast          Print AST to stdout and exit
  *   -tokens       Print tokens to stdout and exit
  *   -check        Only perform semantic analysis (no code generation)
+ *   -MD, -MF <f>  Write a make/ninja dependency file
+ *   -time         Report the time and peak memory of each phase
  *   -v, -verbose  Verbose output
  *   -h, -help     Show this help message
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <time.h>
 #include <getopt.h>
 #ifdef _WIN32
 #include <process.h>  // For _getpid on Windows
 #define getpid _getpid
 #else
 #include <unistd.h>   // For getpid on Unix
+#include <sys/wait.h> // For WEXITSTATUS in run mode
+#include <sys/stat.h> // For watching the source in hot-reload mode
+#include <sys/resource.h> // For the peak memory reported by --time
+#endif
+#ifdef __linux__
+#include <sys/inotify.h> // For --watch
+#include <poll.h>
 #endif
 #include "lexer.h"
 #include "parser.h"
 #include "semantic.h"
 #include "codegen.h"
+#include "layout.h"
+#include "ir.h"
+#include "x86_64.h"
+#include "vm.h"
 #include "ast.h"
 #include "utils.h"
 
@@ -34,6 +55,28 @@
 #define VERSION "1.0.0"
 #define AUTHOR "JFM Compiler Team"
 
+// Outputs selectable with --emit; several may be given, separated by commas
+enum {
+    EMIT_EXE       = 1 << 0,
+    EMIT_C         = 1 << 1,
+    EMIT_OBJ       = 1 << 2,
+    EMIT_STATICLIB = 1 << 3,
+    EMIT_SHAREDLIB = 1 << 4,
+    EMIT_HEADER    = 1 << 5,
+};
+
+// Backends selectable with --backend. Builds default to C; 'jfmc run'
+// defaults to the bytecode VM, which needs no C compiler
+typedef enum {
+    BACKEND_DEFAULT,
+    BACKEND_C,
+    BACKEND_NATIVE,
+    BACKEND_VM,
+} Backend;
+
+// Outputs built from the C in library mode, where only pub functions are exported
+#define EMIT_LIBRARY (EMIT_OBJ | EMIT_STATICLIB | EMIT_SHAREDLIB)
+
 // Command-line options
 typedef struct {
     char* input_file;
@@ -41,12 +84,27 @@ typedef struct {
     bool print_tokens;
     bool print_ast;
     bool print_semantic;
+    bool print_layout;  // Print struct layouts and cache-line report
     bool print_c;
     bool print_all;  // Print all intermediate steps
     bool check_only;
     bool compile_exe;  // Compile to executable
     bool keep_c_file;  // Keep intermediate C file
+    unsigned emit;     // EMIT_* outputs requested with --emit (0: executable)
     char* cc_flags;    // Additional flags for C compiler
+    char* cc;          // C compiler used to build the executable
+    Backend backend;   // --backend: how the executable is built or the program run
+    bool run;          // Build to a temporary executable and run it
+    int run_argc;      // Arguments forwarded to the program in run mode
+    char** run_argv;
+    bool hot_reload;   // Keep the program running and swap in rebuilt code
+    bool watch;        // Rebuild whenever the source or its includes change
+    char** watch_files;      // Source plus local includes seen in the last build
+    size_t watch_file_count;
+    char* watch_c_code;      // Generated C of the last successful watch build
+    bool write_deps;   // -MD: write a make/ninja dependency file
+    char* dep_file;    // -MF: dependency file name (default: <output>.d)
+    bool time_phases;  // --time: report each phase's time and peak memory
     bool verbose;
 } Options;
 
@@ -54,19 +112,32 @@ typedef struct {
 static void print_usage(const char* program_name) {
     printf("JFM Compiler v%s\n", VERSION);
     printf("A Rust-like language that transpiles to C\n\n");
-    printf("Usage: %s [options] <input.jfm>\n\n", program_name);
+    printf("Usage: %s [options] <input.jfm>\n", program_name);
+    printf("       %s run [options] <input.jfm> [args...]\n\n", program_name);
     printf("Options:\n");
     printf("  -o <output>     Output file (default: <input>.c or <input>.exe)\n");
     printf("  -e, --exe       Compile to executable (default)\n");
     printf("  --c-only        Only generate C code, don't compile\n");
     printf("  --keep-c        Keep intermediate C file when compiling to exe\n");
+    printf("  --emit=<kinds>  Outputs to produce, comma-separated: exe, c, obj, staticlib,\n");
+    printf("                  sharedlib, header (libraries export pub items only)\n");
     printf("  --cc-flags <f>  Additional flags for C compiler (e.g., '-O2 -Wall')\n");
+    printf("  --cc <compiler> C compiler to build with (default: $JFM_CC or gcc)\n");
+    printf("  --backend=<b>   c (default for builds), native (x86-64 ELF) or vm (bytecode\n");
+    printf("                  interpreter, default for run); native and vm fall back to c\n");
+    printf("                  for programs they do not cover\n");
+    printf("  --hot-reload    Run the program and reload functions when the source changes\n");
+    printf("  --watch         Rebuild whenever the source or its local includes change\n");
+    printf("  -MD             Write a dependency file for make/ninja (<output>.d)\n");
+    printf("  -MF <file>      Write the dependency file to <file> (implies -MD)\n");
     printf("  --tokens        Print tokens to stdout\n");
     printf("  --ast           Print AST to stdout\n");
     printf("  --semantic      Print semantic analysis results\n");
+    printf("  --layout        Print struct layouts (offsets, holes, cache lines)\n");
     printf("  --c             Print generated C code to stdout\n");
     printf("  --all           Print all intermediate steps\n");
     printf("  --check         Only perform semantic analysis (no code generation)\n");
+    printf("  --time          Report the CPU time and peak memory of each phase\n");
     printf("  -v, --verbose   Verbose output\n");
     printf("  -h, --help      Show this help message\n");
     printf("  --version       Show version information\n");
@@ -106,10 +177,76 @@ static char* read_source_file(const char* filename) {
     return buffer;
 }
 
+// Pick the C compiler: --cc wins, then $JFM_CC, then gcc
+static const char* get_c_compiler(Options* opts) {
+    if (opts->cc && opts->cc[0]) {
+        return opts->cc;
+    }
+    
+    const char* env_cc = getenv("JFM_CC");
+    if (env_cc && env_cc[0]) {
+        return env_cc;
+    }
+    
+    return "gcc";
+}
+
+// Build the temporary executable name used by 'jfmc run'
+static char* get_run_output(void) {
+    char* output = malloc(64);
+#ifdef _WIN32
+    snprintf(output, 64, "jfm_run_%d.exe", (int)getpid());
+#else
+    snprintf(output, 64, "./jfm_run_%d", (int)getpid());
+#endif
+    return output;
+}
+
+// Run the freshly built executable, forwarding arguments, and return its
+// exit code (128 + the signal number if it was killed). The program is
+// started directly rather than through the shell, so arguments reach it
+// exactly as given.
+static int run_executable(Options* opts, const char* exe_file) {
+    char** child_argv = malloc((opts->run_argc + 2) * sizeof(char*));
+    child_argv[0] = (char*)exe_file;
+    for (int i = 0; i < opts->run_argc; i++) {
+        child_argv[i + 1] = opts->run_argv[i];
+    }
+    child_argv[opts->run_argc + 1] = NULL;
+    
+    fflush(stdout);
+#ifdef _WIN32
+    intptr_t status = _spawnv(_P_WAIT, exe_file, (const char* const*)child_argv);
+    free(child_argv);
+    if (status == -1) {
+        fprintf(stderr, "Error: Could not run '%s'\n", exe_file);
+        return 1;
+    }
+    return (int)status;
+#else
+    pid_t child = fork();
+    if (child == 0) {
+        execv(exe_file, child_argv);
+        perror("execv");
+        _exit(127);
+    }
+    free(child_argv);
+    
+    int status;
+    if (child < 0 || waitpid(child, &status, 0) < 0) {
+        fprintf(stderr, "Error: Could not run '%s'\n", exe_file);
+        return 1;
+    }
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    }
+    return 128 + (WIFSIGNALED(status) ? WTERMSIG(status) : 0);
+#endif
+}
+
 // Generate default output filename
-static char* get_default_output(const char* input_file, bool for_exe) {
+static char* get_default_output(const char* input_file, const char* extension) {
     size_t len = strlen(input_file);
-    const char* extension = for_exe ? ".exe" : ".c";
     size_t ext_len = strlen(extension);
     char* output = malloc(len + ext_len + 1);
     
@@ -125,6 +262,241 @@ static char* get_default_output(const char* input_file, bool for_exe) {
     return output;
 }
 
+// Parse the comma-separated kinds of --emit into EMIT_* bits
+static bool parse_emit(const char* kinds, unsigned* emit) {
+    static const struct { const char* name; unsigned bit; } names[] = {
+        { "exe", EMIT_EXE }, { "c", EMIT_C }, { "obj", EMIT_OBJ },
+        { "staticlib", EMIT_STATICLIB }, { "sharedlib", EMIT_SHAREDLIB }, { "header", EMIT_HEADER },
+    };
+    
+    const char* p = kinds;
+    while (*p) {
+        size_t len = strcspn(p, ",");
+        bool known = false;
+        for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+            if (strlen(names[i].name) == len && strncmp(p, names[i].name, len) == 0) {
+                *emit |= names[i].bit;
+                known = true;
+            }
+        }
+        if (!known) {
+            fprintf(stderr, "Error: Unknown --emit kind '%.*s' (expected exe, c, obj, staticlib, sharedlib or header)\n",
+                    (int)len, p);
+            return false;
+        }
+        p += len;
+        if (*p == ',') p++;
+    }
+    return true;
+}
+
+// Name of an --emit output: -o when it is the only output requested,
+// otherwise the input name with the extension replaced and, for
+// libraries, "lib" in front of the file name (src/kernels.jfm -> src/libkernels.a)
+static char* get_emit_output(Options* opts, unsigned kind, const char* extension) {
+    if (opts->output_file && opts->emit == kind) {
+        return string_duplicate(opts->output_file);
+    }
+    
+    char* output = get_default_output(opts->input_file, extension);
+    if (kind != EMIT_STATICLIB && kind != EMIT_SHAREDLIB) {
+        return output;
+    }
+    
+    const char* slash = strrchr(output, '/');
+#ifdef _WIN32
+    const char* backslash = strrchr(output, '\\');
+    if (!slash || (backslash && backslash > slash)) slash = backslash;
+#endif
+    size_t dir_len = slash ? (size_t)(slash - output) + 1 : 0;
+    char* library = malloc(strlen(output) + 4);
+    memcpy(library, output, dir_len);
+    strcpy(library + dir_len, "lib");
+    strcpy(library + dir_len + 3, output + dir_len);
+    free(output);
+    return library;
+}
+
+// Run a shell command built from a printf-style format, echoing it in
+// verbose mode. Returns true if the command succeeded.
+static bool run_build_command(Options* opts, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    
+    char* command = malloc((size_t)len + 1);
+    va_start(args, format);
+    vsnprintf(command, (size_t)len + 1, format, args);
+    va_end(args);
+    
+    if (opts->verbose) {
+        printf("Running: %s\n", command);
+    }
+    int result = system(command);
+    free(command);
+    return result == 0;
+}
+
+// Write the C header declaring the program's pub structs and functions
+// (--emit=header). The include guard is derived from the header's file name.
+static bool write_header(Options* opts, AstNode* ast, SemanticAnalyzer* analyzer) {
+    char* header_file = get_emit_output(opts, EMIT_HEADER, ".h");
+    
+    const char* base = strrchr(header_file, '/');
+    base = base ? base + 1 : header_file;
+    char* guard = malloc(strlen(base) + 5);
+    size_t guard_len = 0;
+    if (isdigit((unsigned char)base[0])) {
+        strcpy(guard, "JFM_");
+        guard_len = 4;
+    }
+    for (const char* p = base; *p; p++) {
+        guard[guard_len++] = isalnum((unsigned char)*p) ? (char)toupper((unsigned char)*p) : '_';
+    }
+    guard[guard_len] = '\0';
+    
+    FILE* output = fopen(header_file, "w");
+    if (!output) {
+        fprintf(stderr, "Error: Could not create header '%s'\n", header_file);
+        free(guard);
+        free(header_file);
+        return false;
+    }
+    
+    CodeGenerator* gen = codegen_create(output);
+    bool ok = codegen_generate_header(gen, ast, analyzer->symbols, guard);
+    codegen_destroy(gen);
+    fclose(output);
+    
+    if (opts->verbose && ok) {
+        printf("Successfully generated header: %s\n", header_file);
+    }
+    free(guard);
+    free(header_file);
+    return ok;
+}
+
+// Build the executable with the native x86-64 backend: lower the checked
+// AST to the IR, write an ELF object and link it with the system linker
+// (through the C compiler driver, for libc and -lm). Returns 1 when built,
+// 0 when the program uses something the backend does not cover, so the
+// caller falls back to the C backend, and -1 on failure.
+static int build_native(Options* opts, AstNode* ast, const char* exe_file) {
+#if defined(__x86_64__) && !defined(_WIN32) && !defined(__APPLE__)
+    char* unsupported = NULL;
+    IrModule* module = ir_lower(ast, &unsupported);
+    if (!module) {
+        fprintf(stderr, "note: native backend does not support %s; using the C backend\n", unsupported);
+        free(unsupported);
+        return 0;
+    }
+    
+    char* obj_file = string_format("jfm_temp_%d.o", (int)getpid());
+    bool ok = x86_64_write_object(module, obj_file);
+    ir_destroy(module);
+    if (!ok) {
+        fprintf(stderr, "Error: Could not write object file '%s'\n", obj_file);
+    } else {
+        ok = run_build_command(opts, "%s -o \"%s\" \"%s\" -lm%s%s", get_c_compiler(opts), exe_file, obj_file,
+                               opts->cc_flags ? " " : "", opts->cc_flags ? opts->cc_flags : "");
+    }
+    remove(obj_file);
+    free(obj_file);
+    return ok ? 1 : -1;
+#else
+    (void)opts;
+    (void)ast;
+    (void)exe_file;
+    fprintf(stderr, "note: native backend only targets x86-64 ELF; using the C backend\n");
+    return 0;
+#endif
+}
+
+// Run the program on the bytecode VM. Returns false when it uses something
+// the VM does not cover, so the caller builds it with the C backend instead;
+// that is noted when --backend=vm was asked for explicitly.
+static bool run_on_vm(Options* opts, AstNode* ast, int* exit_code) {
+    char* unsupported = NULL;
+    IrModule* module = ir_lower(ast, &unsupported);
+    VmProgram* program = module ? vm_compile(module, &unsupported) : NULL;
+    ir_destroy(module);
+    if (!program) {
+        if (opts->backend == BACKEND_VM || opts->verbose) {
+            fprintf(stderr, "note: bytecode VM does not support %s; using the C backend\n", unsupported);
+        }
+        free(unsupported);
+        return false;
+    }
+    
+    if (opts->verbose) {
+        printf("Running on the bytecode VM...\n");
+    }
+    fflush(stdout);
+    *exit_code = vm_run(program);
+    vm_destroy(program);
+    return true;
+}
+
+// Build the library outputs from the generated C: an object file
+// (--emit=obj), a static archive (--emit=staticlib) and a shared library
+// (--emit=sharedlib). The C was generated in library mode, so only pub
+// functions are exported.
+static bool build_library(Options* opts, const char* c_file) {
+    const char* cc = get_c_compiler(opts);
+    const char* extra = opts->cc_flags ? opts->cc_flags : "";
+#ifdef _WIN32
+    const char* pic = "";
+    const char* shared_extension = ".dll";
+#else
+    const char* pic = " -fPIC";
+    const char* shared_extension = ".so";
+#endif
+    
+    char* obj_file;
+    if (opts->emit & EMIT_OBJ) {
+        obj_file = get_emit_output(opts, EMIT_OBJ, ".o");
+    } else {
+        obj_file = malloc(64);
+        snprintf(obj_file, 64, "jfm_temp_%d.o", (int)getpid());
+    }
+    
+    bool ok = run_build_command(opts, "%s -c%s -o \"%s\" \"%s\" %s", cc, pic, obj_file, c_file, extra);
+    if (!ok) {
+        fprintf(stderr, "Error: C compilation failed\n");
+    }
+    
+    if (ok && (opts->emit & EMIT_STATICLIB)) {
+        const char* ar = getenv("JFM_AR");
+        char* archive = get_emit_output(opts, EMIT_STATICLIB, ".a");
+        remove(archive);  // ar would keep members of a previous build
+        ok = run_build_command(opts, "%s rcs \"%s\" \"%s\"", ar && ar[0] ? ar : "ar", archive, obj_file);
+        if (!ok) {
+            fprintf(stderr, "Error: Could not create archive '%s'\n", archive);
+        } else if (opts->verbose) {
+            printf("Successfully generated static library: %s\n", archive);
+        }
+        free(archive);
+    }
+    
+    if (ok && (opts->emit & EMIT_SHAREDLIB)) {
+        char* shared = get_emit_output(opts, EMIT_SHAREDLIB, shared_extension);
+        ok = run_build_command(opts, "%s -shared -o \"%s\" \"%s\" -lm %s", cc, shared, obj_file, extra);
+        if (!ok) {
+            fprintf(stderr, "Error: Could not link shared library '%s'\n", shared);
+        } else if (opts->verbose) {
+            printf("Successfully generated shared library: %s\n", shared);
+        }
+        free(shared);
+    }
+    
+    if (!(opts->emit & EMIT_OBJ)) {
+        remove(obj_file);
+    }
+    free(obj_file);
+    return ok;
+}
+
 // Print tokens in a readable format
 static void print_tokens_formatted(Token* tokens, size_t count) {
     printf("=== TOKENS ===\n");
@@ -154,6 +526,8 @@ static void print_tokens_formatted(Token* tokens, size_t count) {
             case TOKEN_IMPL: type_name = "IMPL"; break;
             case TOKEN_IN: type_name = "IN"; break;
             case TOKEN_INCLUDE: type_name = "INCLUDE"; break;
+            case TOKEN_ASM: type_name = "ASM"; break;
+            case TOKEN_PUB: type_name = "PUB"; break;
             case TOKEN_EXTERN: type_name = "EXTERN"; break;
             case TOKEN_TRUE: type_name = "TRUE"; break;
             case TOKEN_FALSE: type_name = "FALSE"; break;
@@ -161,10 +535,14 @@ static void print_tokens_formatted(Token* tokens, size_t count) {
             case TOKEN_I16: type_name = "I16"; break;
             case TOKEN_I32: type_name = "I32"; break;
             case TOKEN_I64: type_name = "I64"; break;
+            case TOKEN_I128: type_name = "I128"; break;
             case TOKEN_U8: type_name = "U8"; break;
             case TOKEN_U16: type_name = "U16"; break;
             case TOKEN_U32: type_name = "U32"; break;
             case TOKEN_U64: type_name = "U64"; break;
+            case TOKEN_U128: type_name = "U128"; break;
+            case TOKEN_F16: type_name = "F16"; break;
+            case TOKEN_BF16: type_name = "BF16"; break;
             case TOKEN_F32: type_name = "F32"; break;
             case TOKEN_F64: type_name = "F64"; break;
             case TOKEN_BOOL: type_name = "BOOL"; break;
@@ -205,6 +583,10 @@ static void print_tokens_formatted(Token* tokens, size_t count) {
             case TOKEN_DOT: type_name = "DOT"; break;
             case TOKEN_ARROW: type_name = "ARROW"; break;
             case TOKEN_DOT_DOT: type_name = "DOT_DOT"; break;
+            case TOKEN_DOT_DOT_EQ: type_name = "DOT_DOT_EQ"; break;
+            case TOKEN_DOUBLE_COLON: type_name = "DOUBLE_COLON"; break;
+            case TOKEN_HASH: type_name = "HASH"; break;
+            case TOKEN_QUESTION: type_name = "QUESTION"; break;
             default: break;
         }
         
@@ -226,7 +608,7 @@ static void print_tokens_formatted(Token* tokens, size_t count) {
         // Print value if applicable
         switch (t->type) {
             case TOKEN_INT_LITERAL:
-                printf("%lld", t->value.int_value);
+                printf("%llu", t->value.int_value);
                 break;
             case TOKEN_FLOAT_LITERAL:
                 printf("%f", t->value.float_value);
@@ -246,6 +628,486 @@ static void print_tokens_formatted(Token* tokens, size_t count) {
     printf("\nTotal tokens: %zu\n", count);
 }
 
+// Lex, parse, analyze and generate C for the input file, printing any
+// diagnostics. Used by hot-reload mode, which regenerates on every change.
+static bool translate_to_c(Options* opts, const char* c_file, const char* manifest) {
+    char* source = read_source_file(opts->input_file);
+    if (!source) {
+        fprintf(stderr, "Error: Could not read file '%s'\n", opts->input_file);
+        return false;
+    }
+    
+    Lexer* lexer = lexer_create(source);
+    Token* tokens = lexer_scan_tokens(lexer);
+    
+    size_t token_count = 0;
+    Token* lexer_error = NULL;
+    while (tokens[token_count].type != TOKEN_EOF) {
+        if (tokens[token_count].type == TOKEN_ERROR) lexer_error = &tokens[token_count];
+        token_count++;
+    }
+    token_count++;  // Include EOF token
+    
+    if (lexer_error) {
+        fprintf(stderr, "Error: Lexical analysis failed: %.*s at line %zu\n",
+                (int)lexer_error->length, lexer_error->start, lexer_error->line);
+        lexer_destroy(lexer);
+        free(source);
+        return false;
+    }
+    
+    Parser* parser = parser_create(tokens, token_count);
+    AstNode* ast = parser_parse(parser);
+    
+    if (!ast || parser->had_error) {
+        parser_print_errors(parser);
+        if (ast) ast_destroy(ast);
+        parser_destroy(parser);
+        lexer_destroy(lexer);
+        free(source);
+        return false;
+    }
+    
+    SemanticAnalyzer* analyzer = semantic_create();
+    semantic_set_source(analyzer, source, opts->input_file);
+    bool ok = semantic_analyze(analyzer, ast);
+    
+    if (!ok) {
+        if (analyzer->errors->error_count > 0) {
+            error_list_print_beautiful(analyzer->errors);
+        } else {
+            fprintf(stderr, "Error: Semantic analysis failed\n");
+        }
+    } else {
+        error_list_print_beautiful(analyzer->errors);
+        FILE* output = fopen(c_file, "w");
+        if (!output) {
+            fprintf(stderr, "Error: Could not create C file '%s'\n", c_file);
+            ok = false;
+        } else {
+            CodeGenerator* gen = codegen_create(output);
+            codegen_enable_hot_reload(gen, manifest);
+            ok = codegen_generate(gen, ast, analyzer->symbols);
+            codegen_destroy(gen);
+            fclose(output);
+        }
+    }
+    
+    semantic_destroy(analyzer);
+    ast_destroy(ast);
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+    free(source);
+    return ok;
+}
+
+#ifndef _WIN32
+// Run a compiler command built from a format string, echoing it when verbose
+static bool run_compiler(Options* opts, const char* format, const char* output, const char* c_file) {
+    const char* cc = get_c_compiler(opts);
+    const char* flags = opts->cc_flags ? opts->cc_flags : "";
+    size_t len = strlen(format) + strlen(cc) + strlen(output) + strlen(c_file) + strlen(flags) + 1;
+    char* command = malloc(len);
+    snprintf(command, len, format, cc, output, c_file, flags);
+    
+    if (opts->verbose) {
+        printf("Running: %s\n", command);
+    }
+    
+    int result = system(command);
+    free(command);
+    return result == 0;
+}
+
+// Build generation N of the reloadable code as <exe>.hot.N.so
+static char* build_hot_library(Options* opts, const char* exe_file, const char* c_file, int generation) {
+    // dlopen() only searches the current directory for paths with a slash
+    const char* prefix = strchr(exe_file, '/') ? "" : "./";
+    size_t len = strlen(exe_file) + 34;
+    char* lib_file = malloc(len);
+    snprintf(lib_file, len, "%s%s.hot.%d.so", prefix, exe_file, generation);
+    
+    if (!run_compiler(opts, "%s -shared -fPIC -DJFM_HOT_LIB -o \"%s\" \"%s\" -lm %s", lib_file, c_file)) {
+        fprintf(stderr, "Error: C compilation of reloadable code failed\n");
+        free(lib_file);
+        return NULL;
+    }
+    
+    return lib_file;
+}
+
+// Point the running program at a new shared object. The manifest is replaced
+// with rename() so the program never reads a half-written path.
+static bool write_hot_manifest(const char* manifest, const char* lib_file) {
+    size_t len = strlen(manifest) + 5;
+    char* temp = malloc(len);
+    snprintf(temp, len, "%s.tmp", manifest);
+    
+    FILE* file = fopen(temp, "w");
+    if (!file) {
+        free(temp);
+        return false;
+    }
+    
+    fprintf(file, "%s\n", lib_file);
+    fclose(file);
+    
+    bool ok = rename(temp, manifest) == 0;
+    free(temp);
+    return ok;
+}
+
+// Milliseconds elapsed since start on the monotonic clock
+static long elapsed_ms(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long)(now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+// Build the program as a host executable plus a reloadable shared object,
+// start it, and rebuild the shared object whenever the source file changes.
+// The running program picks up the new code at its next loop iteration.
+static int hot_reload(Options* opts) {
+    char* exe_file = opts->output_file;
+    bool allocated_exe = false;
+    if (!exe_file) {
+        exe_file = get_default_output(opts->input_file, ".exe");
+        allocated_exe = true;
+    }
+    
+    size_t len = strlen(exe_file) + 5;
+    char* manifest = malloc(len);
+    snprintf(manifest, len, "%s.hot", exe_file);
+    
+    char c_file[64];
+    snprintf(c_file, sizeof(c_file), "jfm_hot_%d.c", (int)getpid());
+    
+    int generation = 1;
+    int exit_code = 1;
+    char* lib_file = NULL;
+    
+    if (!translate_to_c(opts, c_file, manifest) ||
+        !(lib_file = build_hot_library(opts, exe_file, c_file, generation)) ||
+        !write_hot_manifest(manifest, lib_file) ||
+        !run_compiler(opts, "%s -o \"%s\" \"%s\" -lm -ldl %s", exe_file, c_file)) {
+        fprintf(stderr, "Error: Could not build '%s' for hot reloading\n", opts->input_file);
+        goto cleanup;
+    }
+    free(lib_file);
+    lib_file = NULL;
+    
+    struct stat last_stat;
+    stat(opts->input_file, &last_stat);
+    
+    fflush(stdout);
+    pid_t child = fork();
+    if (child < 0) {
+        fprintf(stderr, "Error: Could not start '%s'\n", exe_file);
+        goto cleanup;
+    }
+    
+    if (child == 0) {
+        char** child_argv = malloc((opts->run_argc + 2) * sizeof(char*));
+        child_argv[0] = exe_file;
+        for (int i = 0; i < opts->run_argc; i++) {
+            child_argv[i + 1] = opts->run_argv[i];
+        }
+        child_argv[opts->run_argc + 1] = NULL;
+        
+        // Run from the current directory if the path has no slash
+        if (!strchr(exe_file, '/')) {
+            size_t path_len = strlen(exe_file) + 3;
+            char* path = malloc(path_len);
+            snprintf(path, path_len, "./%s", exe_file);
+            execv(path, child_argv);
+        } else {
+            execv(exe_file, child_argv);
+        }
+        perror("execv");
+        _exit(127);
+    }
+    
+    fprintf(stderr, "[hot-reload] Watching %s (main() and struct changes need a restart)\n", opts->input_file);
+    
+    for (;;) {
+        int status;
+        pid_t done = waitpid(child, &status, WNOHANG);
+        if (done == child) {
+            if (WIFEXITED(status)) {
+                exit_code = WEXITSTATUS(status);
+            } else {
+                exit_code = 128 + (WIFSIGNALED(status) ? WTERMSIG(status) : 0);
+            }
+            break;
+        }
+        
+        struct timespec interval = {0, 100 * 1000000L};
+        nanosleep(&interval, NULL);
+        
+        struct stat current;
+        if (stat(opts->input_file, &current) != 0) continue;
+        if (current.st_mtim.tv_sec == last_stat.st_mtim.tv_sec &&
+            current.st_mtim.tv_nsec == last_stat.st_mtim.tv_nsec &&
+            current.st_size == last_stat.st_size) {
+            continue;
+        }
+        last_stat = current;
+        
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        
+        if (!translate_to_c(opts, c_file, manifest)) {
+            fprintf(stderr, "[hot-reload] Keeping previous code\n");
+            continue;
+        }
+        
+        lib_file = build_hot_library(opts, exe_file, c_file, generation + 1);
+        if (!lib_file) {
+            fprintf(stderr, "[hot-reload] Keeping previous code\n");
+            continue;
+        }
+        
+        generation++;
+        write_hot_manifest(manifest, lib_file);
+        fprintf(stderr, "[hot-reload] Rebuilt %s in %ld ms\n", lib_file, elapsed_ms(&start));
+        free(lib_file);
+        lib_file = NULL;
+    }
+    
+cleanup:
+    free(lib_file);
+    remove(c_file);
+    remove(manifest);
+    for (int i = 1; i <= generation; i++) {
+        char* old_lib = malloc(strlen(exe_file) + 32);
+        sprintf(old_lib, "%s.hot.%d.so", exe_file, i);
+        remove(old_lib);
+        free(old_lib);
+    }
+    remove(exe_file);
+    free(manifest);
+    if (allocated_exe) free(exe_file);
+    return exit_code;
+}
+#else
+static int hot_reload(Options* opts) {
+    (void)opts;
+    fprintf(stderr, "Error: --hot-reload is not supported on Windows\n");
+    return 1;
+}
+#endif
+
+// Join a directory prefix taken from base_file with a relative path
+static char* path_relative_to(const char* base_file, const char* path) {
+    const char* slash = strrchr(base_file, '/');
+    if (!slash) slash = strrchr(base_file, '\\');
+    if (!slash || path[0] == '/') {
+        char* result = malloc(strlen(path) + 1);
+        strcpy(result, path);
+        return result;
+    }
+    
+    size_t dir_len = slash - base_file + 1;
+    char* result = malloc(dir_len + strlen(path) + 1);
+    memcpy(result, base_file, dir_len);
+    strcpy(result + dir_len, path);
+    return result;
+}
+
+// Remember the input file and every quoted include that exists next to it,
+// so watch mode can react to header edits as well as source edits
+static void record_watch_files(Options* opts, AstNode* ast) {
+    for (size_t i = 0; i < opts->watch_file_count; i++) {
+        free(opts->watch_files[i]);
+    }
+    free(opts->watch_files);
+    
+    opts->watch_files = malloc((ast->data.program.count + 1) * sizeof(char*));
+    opts->watch_file_count = 0;
+    opts->watch_files[opts->watch_file_count++] = path_relative_to("", opts->input_file);
+    
+    for (size_t i = 0; i < ast->data.program.count; i++) {
+        AstNode* item = ast->data.program.items[i];
+        if (item->type != AST_INCLUDE || item->data.include.is_system) continue;
+        
+        char* path = path_relative_to(opts->input_file, item->data.include.path);
+        FILE* file = fopen(path, "r");
+        if (file) {
+            fclose(file);
+            opts->watch_files[opts->watch_file_count++] = path;
+        } else {
+            free(path);
+        }
+    }
+}
+
+// In watch mode, check whether the freshly generated C and the headers it
+// includes match the last successful build, in which case the C compiler
+// and linker can be skipped
+static bool watch_c_unchanged(Options* opts, const char* c_file) {
+    if (!opts->watch) return false;
+    
+    char* code = read_source_file(c_file);
+    if (!code) return false;
+    
+    for (size_t i = 1; i < opts->watch_file_count; i++) {
+        char* header = read_source_file(opts->watch_files[i]);
+        if (!header) continue;
+        size_t code_len = strlen(code);
+        code = realloc(code, code_len + strlen(header) + 1);
+        strcpy(code + code_len, header);
+        free(header);
+    }
+    
+    if (opts->watch_c_code && strcmp(code, opts->watch_c_code) == 0) {
+        free(code);
+        return true;
+    }
+    
+    free(opts->watch_c_code);
+    opts->watch_c_code = code;
+    return false;
+}
+
+// Dependency file name for -MD: the target with its extension replaced by .d
+static char* get_default_dep_file(const char* target) {
+    size_t len = strlen(target);
+    char* dep_file = malloc(len + 3);
+    strcpy(dep_file, target);
+    
+    char* dot = strrchr(dep_file, '.');
+    char* slash = strrchr(dep_file, '/');
+    if (dot && (!slash || dot > slash)) {
+        *dot = '\0';
+    }
+    strcat(dep_file, ".d");
+    return dep_file;
+}
+
+// Name the C compiler writes its own dependency output to, which
+// write_dependency_file turns into the dependency file
+static char* get_raw_dep_file(Options* opts, const char* target) {
+    char* dep_file = opts->dep_file ? opts->dep_file : get_default_dep_file(target);
+    char* raw_file = string_format("%s.tmp", dep_file);
+    if (dep_file != opts->dep_file) free(dep_file);
+    return raw_file;
+}
+
+// For builds that do not compile the generated C (--c-only, libraries),
+// run the C compiler's -M on it to find the headers it includes
+static bool scan_c_dependencies(Options* opts, const char* c_file, const char* raw_file) {
+    const char* flags = opts->cc_flags ? opts->cc_flags : "";
+    return run_build_command(opts, "%s -M -MF \"%s\" \"%s\" %s", get_c_compiler(opts), raw_file, c_file, flags);
+}
+
+// Writes a path into a make rule, escaping the characters make would split
+// the rule at or expand
+static void write_make_path(FILE* output, const char* path) {
+    for (const char* p = path; *p; p++) {
+        if (*p == ' ' || *p == '#') {
+            fputc('\\', output);
+        } else if (*p == '$') {
+            fputc('$', output);
+        }
+        fputc(*p, output);
+    }
+}
+
+// Finds the next prerequisite in the C compiler's dependency output,
+// keeping escaped spaces inside it. Returns NULL at the end.
+static const char* next_dependency(const char** cursor, size_t* length) {
+    const char* p = *cursor;
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || (*p == '\\' && (p[1] == '\n' || p[1] == '\r'))) {
+        p++;
+    }
+    if (!*p) return NULL;
+    
+    const char* start = p;
+    while (*p && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') {
+        if (*p == '\\' && p[1] == ' ') p++;
+        p++;
+    }
+    *length = p - start;
+    *cursor = p;
+    return start;
+}
+
+// Write a make-style dependency file: the target depends on the JFM source
+// and on every header the generated C includes, as listed in the C
+// compiler's dependency output raw_file (NULL when no C was compiled).
+// Like -MP, every header also gets an empty rule, so deleting one does not
+// break the build.
+static bool write_dependency_file(Options* opts, const char* c_file, const char* target, const char* raw_file) {
+    char* dep_file = opts->dep_file ? opts->dep_file : get_default_dep_file(target);
+    
+    char* raw = raw_file ? read_source_file(raw_file) : string_duplicate("");
+    if (raw_file) remove(raw_file);
+    
+    FILE* output = raw ? fopen(dep_file, "w") : NULL;
+    if (!output) {
+        fprintf(stderr, "Error: Could not write dependency file '%s'\n", dep_file);
+        free(raw);
+        if (dep_file != opts->dep_file) free(dep_file);
+        return false;
+    }
+    
+    write_make_path(output, target);
+    fprintf(output, ": ");
+    write_make_path(output, opts->input_file);
+    
+    // Copy the prerequisites, dropping the compiler's own target and the
+    // generated C file (which is temporary); the compiler already escaped them
+    char* colon = strchr(raw, ':');
+    const char* deps = colon ? colon + 1 : raw + strlen(raw);
+    size_t c_len = strlen(c_file);
+    const char* cursor = deps;
+    const char* dep;
+    size_t dep_len;
+    while ((dep = next_dependency(&cursor, &dep_len))) {
+        if (dep_len != c_len || strncmp(dep, c_file, dep_len) != 0) {
+            fprintf(output, " \\\n  %.*s", (int)dep_len, dep);
+        }
+    }
+    fprintf(output, "\n");
+    
+    cursor = deps;
+    while ((dep = next_dependency(&cursor, &dep_len))) {
+        if (dep_len != c_len || strncmp(dep, c_file, dep_len) != 0) {
+            fprintf(output, "\n%.*s:\n", (int)dep_len, dep);
+        }
+    }
+    
+    fclose(output);
+    free(raw);
+    if (dep_file != opts->dep_file) free(dep_file);
+    return true;
+}
+
+// Peak resident memory of the process in KB, or 0 where unknown
+static long peak_memory_kb(void) {
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;  // Bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+// With --time, print the CPU time a phase took since *start and the peak
+// memory so far, then restart the clock for the next phase
+static void report_phase(Options* opts, const char* phase, clock_t* start) {
+    if (!opts->time_phases) return;
+    clock_t now = clock();
+    fprintf(stderr, "[time] %-9s %10.3f ms %10ld KB peak\n", phase,
+            (double)(now - *start) * 1000.0 / CLOCKS_PER_SEC, peak_memory_kb());
+    *start = clock();
+}
+
 // Compile a JFM file
 static int compile(Options* opts) {
     // Read source file
@@ -264,22 +1126,24 @@ static int compile(Options* opts) {
         printf("Performing lexical analysis...\n");
     }
     
+    clock_t phase_start = clock();
     Lexer* lexer = lexer_create(source);
     Token* tokens = lexer_scan_tokens(lexer);
+    report_phase(opts, "lex", &phase_start);
     
     // Check for lexer errors (tokens will include ERROR tokens if there were issues)
-    bool had_lexer_error = false;
+    Token* lexer_error = NULL;
     for (size_t i = 0; tokens[i].type != TOKEN_EOF; i++) {
         if (tokens[i].type == TOKEN_ERROR) {
-            had_lexer_error = true;
+            lexer_error = &tokens[i];
             break;
         }
     }
     
-    if (had_lexer_error) {
-        fprintf(stderr, "Error: Lexical analysis failed\n");
+    if (lexer_error) {
+        fprintf(stderr, "Error: Lexical analysis failed: %.*s at line %zu\n",
+                (int)lexer_error->length, lexer_error->start, lexer_error->line);
         lexer_destroy(lexer);
-        free(tokens);
         free(source);
         return 1;
     }
@@ -294,10 +1158,9 @@ static int compile(Options* opts) {
     // Print tokens if requested
     if (opts->print_tokens) {
         print_tokens_formatted(tokens, token_count);
-        if (!opts->print_ast && !opts->print_semantic && !opts->print_c && !opts->check_only) {
+        if (!opts->print_ast && !opts->print_semantic && !opts->print_layout && !opts->print_c && !opts->check_only) {
             // Only tokens requested, exit early
             lexer_destroy(lexer);
-            free(tokens);
             free(source);
             return 0;
         }
@@ -311,12 +1174,21 @@ static int compile(Options* opts) {
     
     Parser* parser = parser_create(tokens, token_count);
     AstNode* ast = parser_parse(parser);
+    report_phase(opts, "parse", &phase_start);
     
-    if (!ast) {
-        fprintf(stderr, "Error: Parsing failed\n");
+    if (opts->watch && ast) {
+        record_watch_files(opts, ast);
+    }
+    
+    if (!ast || parser->had_error) {
+        if (parser->had_error) {
+            parser_print_errors(parser);
+        } else {
+            fprintf(stderr, "Error: Parsing failed\n");
+        }
+        if (ast) ast_destroy(ast);
         parser_destroy(parser);
         lexer_destroy(lexer);
-        free(tokens);
         free(source);
         return 1;
     }
@@ -325,12 +1197,11 @@ static int compile(Options* opts) {
     if (opts->print_ast) {
         printf("=== ABSTRACT SYNTAX TREE ===\n");
         ast_print(ast, 0);
-        if (!opts->print_semantic && !opts->print_c && !opts->check_only) {
+        if (!opts->print_semantic && !opts->print_layout && !opts->print_c && !opts->check_only) {
             // Only AST requested, exit early
             ast_destroy(ast);
             parser_destroy(parser);
             lexer_destroy(lexer);
-            free(tokens);
             free(source);
             return 0;
         }
@@ -345,6 +1216,7 @@ static int compile(Options* opts) {
     SemanticAnalyzer* analyzer = semantic_create();
     semantic_set_source(analyzer, source, opts->input_file);
     bool semantic_ok = semantic_analyze(analyzer, ast);
+    report_phase(opts, "semantic", &phase_start);
     
     if (!semantic_ok) {
         // Use beautiful error reporting
@@ -357,11 +1229,13 @@ static int compile(Options* opts) {
         ast_destroy(ast);
         parser_destroy(parser);
         lexer_destroy(lexer);
-        free(tokens);
         free(source);
         return 1;
     }
     
+    // Warnings only
+    error_list_print_beautiful(analyzer->errors);
+    
     if (opts->verbose || opts->print_semantic) {
         if (opts->print_semantic) {
             printf("=== SEMANTIC ANALYSIS ===\n");
@@ -370,13 +1244,12 @@ static int compile(Options* opts) {
         printf("  Functions: %zu\n", analyzer->functions_analyzed);
         printf("  Structs: %zu\n", analyzer->structs_analyzed);
         printf("  Variables: %zu\n", analyzer->variables_analyzed);
-        if (opts->print_semantic && !opts->print_c && !opts->check_only) {
+        if (opts->print_semantic && !opts->print_layout && !opts->print_c && !opts->check_only) {
             // Only semantic analysis requested, exit early
             semantic_destroy(analyzer);
             ast_destroy(ast);
             parser_destroy(parser);
             lexer_destroy(lexer);
-            free(tokens);
             free(source);
             return 0;
         }
@@ -385,6 +1258,22 @@ static int compile(Options* opts) {
         }
     }
     
+    // Print struct layouts if requested
+    if (opts->print_layout) {
+        printf("=== STRUCT LAYOUT ===\n");
+        layout_print_report(stdout, ast);
+        if (!opts->print_c && !opts->check_only) {
+            // Only layout requested, exit early
+            semantic_destroy(analyzer);
+            ast_destroy(ast);
+            parser_destroy(parser);
+            lexer_destroy(lexer);
+            free(source);
+            return 0;
+        }
+        printf("\n");  // Add spacing between outputs
+    }
+    
     // Check-only mode - stop here
     if (opts->check_only) {
         printf("Semantic analysis successful - no errors found\n");
@@ -392,7 +1281,37 @@ static int compile(Options* opts) {
         ast_destroy(ast);
         parser_destroy(parser);
         lexer_destroy(lexer);
-        free(tokens);
+        free(source);
+        return 0;
+    }
+    
+    // 'jfmc run' interprets the program on the bytecode VM when it covers
+    // it, which skips C generation and the C compiler
+    int vm_exit_code;
+    if (opts->run && (opts->backend == BACKEND_VM || opts->backend == BACKEND_DEFAULT) && !opts->print_c && run_on_vm(opts, ast, &vm_exit_code)) {
+        semantic_destroy(analyzer);
+        ast_destroy(ast);
+        parser_destroy(parser);
+        lexer_destroy(lexer);
+        free(source);
+        return vm_exit_code;
+    }
+    
+    // Header for library builds
+    if ((opts->emit & EMIT_HEADER) && !write_header(opts, ast, analyzer)) {
+        semantic_destroy(analyzer);
+        ast_destroy(ast);
+        parser_destroy(parser);
+        lexer_destroy(lexer);
+        free(source);
+        return 1;
+    }
+    if (opts->emit == EMIT_HEADER) {
+        // Only the header requested, no C to generate
+        semantic_destroy(analyzer);
+        ast_destroy(ast);
+        parser_destroy(parser);
+        lexer_destroy(lexer);
         free(source);
         return 0;
     }
@@ -403,26 +1322,20 @@ static int compile(Options* opts) {
     }
     
     // Determine C output file (might be temporary)
-    char c_file[256] = "";
+    bool library = (opts->emit & EMIT_LIBRARY) != 0;
+    char* c_file = NULL;
     bool c_file_is_temp = false;
     
-    if (opts->compile_exe && !opts->keep_c_file) {
+    if ((opts->compile_exe || library) && !opts->keep_c_file) {
         // Generate temporary C file name
-        sprintf(c_file, "jfm_temp_%d.c", (int)getpid());
+        c_file = string_format("jfm_temp_%d.c", (int)getpid());
         c_file_is_temp = true;
-    } else if (!opts->compile_exe && opts->output_file) {
+    } else if (!opts->compile_exe && !library && opts->output_file) {
         // User specified C output file
-        strcpy(c_file, opts->output_file);
-    } else if (!opts->compile_exe) {
-        // Default C output file
-        char* default_c = get_default_output(opts->input_file, false);
-        strcpy(c_file, default_c);
-        free(default_c);
-    } else if (opts->keep_c_file) {
-        // Compiling to exe but keeping C file
-        char* default_c = get_default_output(opts->input_file, false);
-        strcpy(c_file, default_c);
-        free(default_c);
+        c_file = string_duplicate(opts->output_file);
+    } else {
+        // Default C output file, also kept when compiling to exe
+        c_file = get_default_output(opts->input_file, ".c");
     }
     
     // Open C file for writing
@@ -433,13 +1346,19 @@ static int compile(Options* opts) {
         ast_destroy(ast);
         parser_destroy(parser);
         lexer_destroy(lexer);
-        free(tokens);
+        free(c_file);
         free(source);
         return 1;
     }
     
     CodeGenerator* gen = codegen_create(output);
+    if (library) {
+        codegen_enable_library(gen);
+    }
+    phase_start = clock();
     bool codegen_ok = codegen_generate(gen, ast, analyzer->symbols);
+    fflush(output);
+    report_phase(opts, "codegen", &phase_start);
     
     if (!codegen_ok) {
         fprintf(stderr, "Error: Code generation failed\n");
@@ -450,7 +1369,7 @@ static int compile(Options* opts) {
         ast_destroy(ast);
         parser_destroy(parser);
         lexer_destroy(lexer);
-        free(tokens);
+        free(c_file);
         free(source);
         return 1;
     }
@@ -472,8 +1391,46 @@ static int compile(Options* opts) {
         }
     }
     
+    // Write a dependency file for the generated C if requested. For an
+    // executable, the C compile lists the headers itself (see below).
+    if (opts->write_deps && !opts->run && !opts->compile_exe) {
+        char* raw_deps = get_raw_dep_file(opts, c_file);
+        bool deps_ok = scan_c_dependencies(opts, c_file, raw_deps) &&
+                       write_dependency_file(opts, c_file, c_file, raw_deps);
+        remove(raw_deps);
+        free(raw_deps);
+        
+        if (!deps_ok) {
+            if (c_file_is_temp) remove(c_file);
+            codegen_destroy(gen);
+            semantic_destroy(analyzer);
+            ast_destroy(ast);
+            parser_destroy(parser);
+            lexer_destroy(lexer);
+            free(c_file);
+            free(source);
+            return 1;
+        }
+    }
+    
+    // Build the object file and libraries if requested
+    if (library && !build_library(opts, c_file)) {
+        if (c_file_is_temp) remove(c_file);
+        codegen_destroy(gen);
+        semantic_destroy(analyzer);
+        ast_destroy(ast);
+        parser_destroy(parser);
+        lexer_destroy(lexer);
+        free(c_file);
+        free(source);
+        return 1;
+    }
+    
     // Compile to executable if requested
-    if (opts->compile_exe) {
+    if (opts->compile_exe && watch_c_unchanged(opts, c_file)) {
+        printf("Generated C is unchanged, skipping C compilation\n");
+        if (c_file_is_temp) remove(c_file);
+    } else if (opts->compile_exe) {
         if (opts->verbose) {
             printf("Compiling to executable...\n");
         }
@@ -481,31 +1438,36 @@ static int compile(Options* opts) {
         // Determine executable output file
         char* exe_file = opts->output_file;
         bool allocated_exe = false;
-        if (!exe_file) {
-            exe_file = get_default_output(opts->input_file, true);
+        if (opts->run) {
+            exe_file = get_run_output();
+            allocated_exe = true;
+        } else if (!exe_file) {
+            exe_file = get_default_output(opts->input_file, ".exe");
             allocated_exe = true;
         }
         
-        // Build compiler command
-        char command[1024];
-        snprintf(command, sizeof(command), "gcc -o \"%s\" \"%s\" -lm", 
-                 exe_file, c_file);
-        
-        // Add user-specified flags
-        if (opts->cc_flags) {
-            strcat(command, " ");
-            strcat(command, opts->cc_flags);
-        }
-        
-        if (opts->verbose) {
-            printf("Running: %s\n", command);
-        }
-        
-        // Execute compiler
-        int result = system(command);
+        // Build natively when asked and the program is covered, otherwise run
+        // the C compiler with any user-specified flags. With -MD it writes
+        // the headers it reads to raw_deps as it compiles.
+        char* raw_deps = opts->write_deps && !opts->run ? get_raw_dep_file(opts, exe_file) : NULL;
+        char* dep_flags = raw_deps ? string_format(" -MD -MF \"%s\"", raw_deps) : string_duplicate("");
+        int native = opts->backend == BACKEND_NATIVE ? build_native(opts, ast, exe_file) : 0;
+        bool cc_ok = native > 0 ||
+                     (native == 0 && run_build_command(opts, "%s%s -o \"%s\" \"%s\" -lm%s%s", get_c_compiler(opts),
+                                                       dep_flags, exe_file, c_file, opts->cc_flags ? " " : "",
+                                                       opts->cc_flags ? opts->cc_flags : ""));
+        bool deps_ok = !cc_ok || !raw_deps ||
+                       write_dependency_file(opts, c_file, exe_file, native > 0 ? NULL : raw_deps);
+        if (raw_deps) remove(raw_deps);
+        free(raw_deps);
+        free(dep_flags);
         
-        if (result != 0) {
-            fprintf(stderr, "Error: C compilation failed\n");
+        if (!cc_ok || !deps_ok) {
+            if (!cc_ok) {
+                fprintf(stderr, native < 0 ? "Error: Native build failed\n" : "Error: C compilation failed\n");
+            }
+            free(opts->watch_c_code);
+            opts->watch_c_code = NULL;
             if (c_file_is_temp) remove(c_file);
             if (allocated_exe) free(exe_file);
             codegen_destroy(gen);
@@ -513,7 +1475,7 @@ static int compile(Options* opts) {
             ast_destroy(ast);
             parser_destroy(parser);
             lexer_destroy(lexer);
-            free(tokens);
+            free(c_file);
             free(source);
             return 1;
         }
@@ -527,7 +1489,23 @@ static int compile(Options* opts) {
             remove(c_file);
         }
         
+        if (opts->run) {
+            int exit_code = run_executable(opts, exe_file);
+            remove(exe_file);
+            free(exe_file);
+            codegen_destroy(gen);
+            semantic_destroy(analyzer);
+            ast_destroy(ast);
+            parser_destroy(parser);
+            lexer_destroy(lexer);
+            free(c_file);
+            free(source);
+            return exit_code;
+        }
+        
         if (allocated_exe) free(exe_file);
+    } else if (c_file_is_temp) {
+        remove(c_file);
     } else {
         if (opts->verbose) {
             printf("Successfully generated C file: %s\n", c_file);
@@ -540,12 +1518,181 @@ static int compile(Options* opts) {
     ast_destroy(ast);
     parser_destroy(parser);
     lexer_destroy(lexer);
-    free(tokens);
+    free(c_file);
     free(source);
     
     return 0;
 }
 
+// Watches the source and its local includes across rebuilds. The watch is
+// armed before each build reads the files, so a save made while a build
+// runs starts the next one instead of being lost.
+typedef struct {
+#ifdef __linux__
+    int fd;                  // inotify instance, kept for the whole session
+#else
+    char** paths;            // Files seen when the watch was last armed
+    struct stat* stats;      // Their modification time and size at that point
+    size_t count;
+#endif
+} Watcher;
+
+#ifdef __linux__
+static bool watcher_init(Watcher* watcher) {
+    watcher->fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (watcher->fd < 0) {
+        perror("inotify_init1");
+        return false;
+    }
+    return true;
+}
+
+// Reads the pending events and reports whether one names a watched file
+static bool watcher_read(Watcher* watcher, Options* opts) {
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+    ssize_t len;
+    while ((len = read(watcher->fd, buffer, sizeof(buffer))) > 0) {
+        for (char* ptr = buffer; ptr < buffer + len; ) {
+            struct inotify_event* event = (struct inotify_event*)ptr;
+            for (size_t i = 0; event->len > 0 && i < opts->watch_file_count; i++) {
+                const char* name = strrchr(opts->watch_files[i], '/');
+                name = name ? name + 1 : opts->watch_files[i];
+                if (strcmp(name, event->name) == 0) changed = true;
+            }
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    return changed;
+}
+
+// Watches the directories of the files of the last build, rather than the
+// files, so editors that save by replacing the file are still noticed
+static void watcher_add_directories(Watcher* watcher, Options* opts) {
+    for (size_t i = 0; i < opts->watch_file_count; i++) {
+        char* dir = path_relative_to(opts->watch_files[i], ".");
+        inotify_add_watch(watcher->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        free(dir);
+    }
+}
+
+// Arms the watch before a build. Events already queued are dropped: the
+// build about to start reads the files after them.
+static void watcher_arm(Watcher* watcher, Options* opts) {
+    watcher_add_directories(watcher, opts);
+    watcher_read(watcher, opts);
+}
+
+// Block until one of the watched files is written, created or renamed into
+// place since the watch was armed
+static void wait_for_change(Watcher* watcher, Options* opts) {
+    // Includes first seen by this build are watched from now on
+    watcher_add_directories(watcher, opts);
+    
+    struct pollfd ready = { .fd = watcher->fd, .events = POLLIN };
+    while (!watcher_read(watcher, opts)) {
+        if (poll(&ready, 1, -1) < 0) break;
+    }
+    
+    // Let the editor finish writing before rebuilding
+    struct timespec settle = {0, 50 * 1000000L};
+    nanosleep(&settle, NULL);
+}
+#elif !defined(_WIN32)
+static bool watcher_init(Watcher* watcher) {
+    watcher->paths = NULL;
+    watcher->stats = NULL;
+    watcher->count = 0;
+    return true;
+}
+
+// Records the modification time and size of the files of the last build
+static void watcher_arm(Watcher* watcher, Options* opts) {
+    for (size_t i = 0; i < watcher->count; i++) {
+        free(watcher->paths[i]);
+    }
+    watcher->paths = realloc(watcher->paths, opts->watch_file_count * sizeof(char*));
+    watcher->stats = realloc(watcher->stats, opts->watch_file_count * sizeof(struct stat));
+    watcher->count = opts->watch_file_count;
+    for (size_t i = 0; i < watcher->count; i++) {
+        watcher->paths[i] = string_duplicate(opts->watch_files[i]);
+        memset(&watcher->stats[i], 0, sizeof(struct stat));
+        stat(watcher->paths[i], &watcher->stats[i]);
+    }
+}
+
+// Block until the modification time or size of a watched file differs from
+// when the watch was armed. Includes first seen by the last build are
+// compared against their state when the wait starts.
+static void wait_for_change(Watcher* watcher, Options* opts) {
+    struct stat* last = calloc(opts->watch_file_count, sizeof(struct stat));
+    for (size_t i = 0; i < opts->watch_file_count; i++) {
+        size_t known = 0;
+        while (known < watcher->count && strcmp(watcher->paths[known], opts->watch_files[i]) != 0) {
+            known++;
+        }
+        if (known < watcher->count) {
+            last[i] = watcher->stats[known];
+        } else {
+            stat(opts->watch_files[i], &last[i]);
+        }
+    }
+    
+    for (bool changed = false; !changed; ) {
+        for (size_t i = 0; i < opts->watch_file_count; i++) {
+            struct stat current;
+            if (stat(opts->watch_files[i], &current) != 0) continue;
+            if (current.st_mtime != last[i].st_mtime || current.st_size != last[i].st_size) {
+                changed = true;
+            }
+        }
+        if (changed) break;
+        
+        struct timespec interval = {0, 200 * 1000000L};
+        nanosleep(&interval, NULL);
+    }
+    
+    free(last);
+}
+#endif
+
+#ifndef _WIN32
+// Rebuild on every change to the source or its local includes. Each rebuild
+// reruns the full pipeline; the C compiler is skipped when the generated C
+// is identical to the last successful build.
+static int watch(Options* opts) {
+    opts->watch_files = malloc(sizeof(char*));
+    opts->watch_files[0] = path_relative_to("", opts->input_file);
+    opts->watch_file_count = 1;
+    
+    Watcher watcher;
+    if (!watcher_init(&watcher)) return 1;
+    
+    for (;;) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        
+        watcher_arm(&watcher, opts);
+        int result = compile(opts);
+        fflush(stdout);
+        
+        fprintf(stderr, "[watch] %s in %ld ms, watching %zu file%s\n",
+                result == 0 ? "Build succeeded" : "Build failed", elapsed_ms(&start),
+                opts->watch_file_count, opts->watch_file_count == 1 ? "" : "s");
+        
+        wait_for_change(&watcher, opts);
+    }
+    
+    return 0;
+}
+#else
+static int watch(Options* opts) {
+    (void)opts;
+    fprintf(stderr, "Error: --watch is not supported on Windows\n");
+    return 1;
+}
+#endif
+
 int main(int argc, char* argv[]) {
     Options opts = {0};
     
@@ -554,13 +1701,20 @@ int main(int argc, char* argv[]) {
         {"tokens",   no_argument,       0, 't'},
         {"ast",      no_argument,       0, 'a'},
         {"semantic", no_argument,       0, 's'},
+        {"layout",   no_argument,       0, 'L'},
         {"c",        no_argument,       0, 'C'},
         {"all",      no_argument,       0, 'A'},
         {"check",    no_argument,       0, 'c'},
+        {"time",     no_argument,       0, 'T'},
         {"exe",      no_argument,       0, 'e'},
         {"c-only",   no_argument,       0, 'O'},
         {"keep-c",   no_argument,       0, 'k'},
+        {"emit",     required_argument, 0, 'E'},
         {"cc-flags", required_argument, 0, 'f'},
+        {"cc",       required_argument, 0, 'K'},
+        {"backend",  required_argument, 0, 'B'},
+        {"hot-reload", no_argument,     0, 'H'},
+        {"watch",    no_argument,       0, 'W'},
         {"verbose",  no_argument,       0, 'v'},
         {"help",     no_argument,       0, 'h'},
         {"version",  no_argument,       0, 'V'},
@@ -574,7 +1728,33 @@ int main(int argc, char* argv[]) {
     // Default to compiling to executable
     opts.compile_exe = true;
     
-    while ((c = getopt_long(argc, argv, "o:evhV", long_options, &option_index)) != -1) {
+    // 'jfmc run' stops option parsing at the input file so the remaining
+    // arguments can be forwarded to the program
+    const char* optstring = "o:evhV";
+    if (argc > 1 && strcmp(argv[1], "run") == 0) {
+        opts.run = true;
+        argv[1] = argv[0];
+        argc--;
+        argv++;
+        optstring = "+o:evhV";
+    }
+    
+    // -MD and -MF follow the C compiler spelling, which getopt cannot parse,
+    // so pull them out before the regular option parsing
+    int kept = 1;
+    for (int i = 1; i < argc; i++) {
+        if (!opts.run && strcmp(argv[i], "-MD") == 0) {
+            opts.write_deps = true;
+        } else if (!opts.run && strcmp(argv[i], "-MF") == 0 && i + 1 < argc) {
+            opts.write_deps = true;
+            opts.dep_file = argv[++i];
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    argc = kept;
+    
+    while ((c = getopt_long(argc, argv, optstring, long_options, &option_index)) != -1) {
         switch (c) {
             case 't':
                 opts.print_tokens = true;
@@ -585,6 +1765,9 @@ int main(int argc, char* argv[]) {
             case 's':
                 opts.print_semantic = true;
                 break;
+            case 'L':
+                opts.print_layout = true;
+                break;
             case 'C':
                 opts.print_c = true;
                 break;
@@ -598,6 +1781,9 @@ int main(int argc, char* argv[]) {
             case 'c':
                 opts.check_only = true;
                 break;
+            case 'T':
+                opts.time_phases = true;
+                break;
             case 'e':
                 opts.compile_exe = true;
                 break;
@@ -607,9 +1793,33 @@ int main(int argc, char* argv[]) {
             case 'k':
                 opts.keep_c_file = true;
                 break;
+            case 'E':
+                if (!parse_emit(optarg, &opts.emit)) return 1;
+                break;
             case 'f':
                 opts.cc_flags = optarg;
                 break;
+            case 'K':
+                opts.cc = optarg;
+                break;
+            case 'B':
+                if (strcmp(optarg, "c") == 0) {
+                    opts.backend = BACKEND_C;
+                } else if (strcmp(optarg, "native") == 0) {
+                    opts.backend = BACKEND_NATIVE;
+                } else if (strcmp(optarg, "vm") == 0) {
+                    opts.backend = BACKEND_VM;
+                } else {
+                    fprintf(stderr, "Error: Unknown --backend '%s' (expected c, native or vm)\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'H':
+                opts.hot_reload = true;
+                break;
+            case 'W':
+                opts.watch = true;
+                break;
             case 'v':
                 opts.verbose = true;
                 break;
@@ -639,12 +1849,43 @@ int main(int argc, char* argv[]) {
     
     opts.input_file = argv[optind];
     
+    // --emit replaces the default executable; the C file is kept only when
+    // requested, and -o can only name a single output
+    if (opts.emit && !opts.run && !opts.hot_reload) {
+        if (opts.output_file && (opts.emit & (opts.emit - 1))) {
+            fprintf(stderr, "Error: -o cannot be used when --emit requests several outputs\n");
+            return 1;
+        }
+        opts.compile_exe = (opts.emit & EMIT_EXE) != 0;
+        opts.keep_c_file = (opts.emit & EMIT_C) && (opts.emit & ~EMIT_C);
+    }
+    
+    if (opts.backend == BACKEND_VM && !opts.run) {
+        fprintf(stderr, "Error: --backend=vm only runs programs (use 'jfmc run')\n");
+        return 1;
+    }
+    
+    if (opts.run) {
+        opts.compile_exe = true;
+        opts.keep_c_file = false;
+        opts.run_argc = argc - optind - 1;
+        opts.run_argv = argv + optind + 1;
+    }
+    
     // Check file extension
     size_t len = strlen(opts.input_file);
     if (len < 4 || strcmp(opts.input_file + len - 4, ".jfm") != 0) {
         fprintf(stderr, "Warning: Input file does not have .jfm extension\n");
     }
     
+    if (opts.hot_reload) {
+        return hot_reload(&opts);
+    }
+    
+    if (opts.watch) {
+        return watch(&opts);
+    }
+    
     // Compile
     return compile(&opts);
 }
\ No newline at end of file
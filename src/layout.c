@@ -0,0 +1,939 @@
+#include "layout.h"
+#include "utils.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Placeholder stored on a struct while its layout is being computed, so a
+// struct that (invalidly) contains itself does not recurse forever. It is
+// never written, so compilations on different threads can share it
+static const StructLayout layout_in_progress = { NULL, NULL, 0, 1, 0, false };
+
+/**
+ * Rounds an offset up to the next multiple of an alignment.
+ * 
+ * @param offset The offset to round
+ * @param align The alignment (a power of two, or 1)
+ * @return The aligned offset
+ */
+static size_t align_up(size_t offset, size_t align) {
+    if (align <= 1) return offset;
+    return (offset + align - 1) / align * align;
+}
+
+/**
+ * Computes the struct index slot a name hashes to (djb2).
+ * 
+ * @param name The struct name
+ * @param size Number of slots (a power of two)
+ * @return The first slot to probe
+ */
+static size_t struct_index_hash(const char* name, size_t size) {
+    size_t hash = 5381;
+    for (const char* c = name; *c; c++) {
+        hash = ((hash << 5) + hash) + (unsigned char)*c;
+    }
+    return hash & (size - 1);
+}
+
+/**
+ * Adds a struct to a program's struct index unless a struct of the same
+ * name is already there, so the first definition wins as in a linear scan.
+ * 
+ * @param program The program AST node
+ * @param struct_def The struct definition node
+ * @param position Index of the struct among the program items
+ */
+static void struct_index_insert(AstNode* program, AstNode* struct_def, size_t position) {
+    AstNode** index = program->data.program.struct_index;
+    size_t size = program->data.program.struct_index_size;
+    size_t slot = struct_index_hash(struct_def->data.struct_def.name, size);
+    while (index[slot]) {
+        if (strcmp(index[slot]->data.struct_def.name, struct_def->data.struct_def.name) == 0) return;
+        slot = (slot + 1) & (size - 1);
+    }
+    index[slot] = struct_def;
+    program->data.program.struct_positions[slot] = position;
+}
+
+/**
+ * Brings a program's struct index up to date with its items. The index is
+ * an open-addressed table kept at most half full, so lookups stay constant
+ * time however many structs the program declares.
+ * 
+ * @param program The program AST node
+ */
+static void update_struct_index(AstNode* program) {
+    size_t count = program->data.program.count;
+    if (program->data.program.indexed_count == count && program->data.program.struct_index) return;
+    
+    if (program->data.program.struct_index_size < count * 2 + 2) {
+        size_t size = 16;
+        while (size < count * 2 + 2) size *= 2;
+        free(program->data.program.struct_index);
+        free(program->data.program.struct_positions);
+        program->data.program.struct_index = calloc(size, sizeof(AstNode*));
+        program->data.program.struct_positions = malloc(size * sizeof(size_t));
+        program->data.program.struct_index_size = size;
+        program->data.program.indexed_count = 0;
+    }
+    
+    for (size_t i = program->data.program.indexed_count; i < count; i++) {
+        AstNode* item = program->data.program.items[i];
+        if (item->type == AST_STRUCT && item->data.struct_def.name) {
+            struct_index_insert(program, item, i);
+        }
+    }
+    program->data.program.indexed_count = count;
+}
+
+/**
+ * Finds the struct index slot holding the struct with the given name.
+ * 
+ * @param program The program AST node
+ * @param name The struct name
+ * @return The slot, or the struct index size if there is no such struct
+ */
+static size_t struct_index_find(AstNode* program, const char* name) {
+    update_struct_index(program);
+    AstNode** index = program->data.program.struct_index;
+    size_t size = program->data.program.struct_index_size;
+    size_t slot = struct_index_hash(name, size);
+    while (index[slot]) {
+        if (strcmp(index[slot]->data.struct_def.name, name) == 0) {
+            return slot;
+        }
+        slot = (slot + 1) & (size - 1);
+    }
+    
+    return size;
+}
+
+/**
+ * Finds the struct definition with the given name in a program.
+ * 
+ * @param program The program AST node
+ * @param name The struct name
+ * @return The struct definition node, or NULL if not found
+ */
+AstNode* layout_find_struct(AstNode* program, const char* name) {
+    if (!program || !name) return NULL;
+    
+    size_t slot = struct_index_find(program, name);
+    return slot < program->data.program.struct_index_size ? program->data.program.struct_index[slot] : NULL;
+}
+
+/**
+ * Finds where the struct with the given name is declared in a program.
+ * 
+ * @param program The program AST node
+ * @param name The struct name
+ * @return Index of the struct among the program items, or SIZE_MAX if not found
+ */
+size_t layout_struct_position(AstNode* program, const char* name) {
+    if (!program || !name) return SIZE_MAX;
+    
+    size_t slot = struct_index_find(program, name);
+    return slot < program->data.program.struct_index_size ? program->data.program.struct_positions[slot] : SIZE_MAX;
+}
+
+/**
+ * Returns the struct definition behind an array of a #[soa] struct.
+ * 
+ * @param program The program AST node
+ * @param type The type to inspect
+ * @return The #[soa] struct definition, or NULL if type is not such an array
+ */
+AstNode* layout_soa_struct(AstNode* program, Type* type) {
+    if (!type || type->kind != TYPE_ARRAY || !type->data.array.element_type ||
+        type->data.array.element_type->kind != TYPE_STRUCT) {
+        return NULL;
+    }
+    
+    AstNode* struct_def = layout_find_struct(program, type->data.array.element_type->data.struct_type.name);
+    if (!struct_def || !ast_find_attribute(struct_def->attributes, struct_def->attribute_count, "soa")) {
+        return NULL;
+    }
+    return struct_def;
+}
+
+/**
+ * Lays out an array of a #[soa] struct: one array per field, in
+ * declaration order.
+ * 
+ * @param program The program AST node
+ * @param struct_def The #[soa] struct definition
+ * @param length Number of elements
+ * @param align Output: alignment of the emitted struct of arrays
+ * @return Size of the emitted struct of arrays
+ */
+static size_t soa_array_size(AstNode* program, AstNode* struct_def, size_t length, size_t* align) {
+    size_t offset = 0;
+    *align = 1;
+    
+    for (size_t i = 0; i < struct_def->data.struct_def.field_count; i++) {
+        Type* type = struct_def->data.struct_def.fields[i].type;
+        size_t field_align = layout_align_of(program, type);
+        
+        offset = align_up(offset, field_align) + layout_size_of(program, type) * length;
+        if (field_align > *align) *align = field_align;
+    }
+    
+    return align_up(offset, *align);
+}
+
+/**
+ * Finds the niche an Option<T> stores None in: a NULL pointer for
+ * references, pointers and str, and the otherwise unused byte value 2
+ * for bool. Other payloads need a separate is_some flag.
+ * 
+ * @param type The Option type
+ * @return Where None is encoded
+ */
+OptionNiche layout_option_niche(Type* type) {
+    Type* value_type = type->data.option.value_type;
+    if (!value_type) return NICHE_NONE;
+    
+    switch (value_type->kind) {
+        case TYPE_REFERENCE: case TYPE_POINTER: case TYPE_STR:
+            return NICHE_NULL;
+        case TYPE_BOOL:
+            return NICHE_BOOL;
+        default:
+            return NICHE_NONE;
+    }
+}
+
+/**
+ * Returns the size in bytes of a JFM type as emitted in C.
+ * Unknown types (e.g. opaque extern structs) have size 0.
+ * 
+ * @param program The program AST node, used to resolve struct types
+ * @param type The type to measure
+ * @return Size in bytes
+ */
+size_t layout_size_of(AstNode* program, Type* type) {
+    if (!type) return 0;
+    
+    switch (type->kind) {
+        case TYPE_I8: case TYPE_U8: case TYPE_BOOL: case TYPE_CHAR:
+            return 1;
+        case TYPE_I16: case TYPE_U16: case TYPE_F16: case TYPE_BF16:
+            return 2;
+        case TYPE_I32: case TYPE_U32: case TYPE_F32:
+            return 4;
+        case TYPE_I64: case TYPE_U64: case TYPE_F64:
+            return 8;
+        case TYPE_I128: case TYPE_U128:
+            return 16;
+        case TYPE_STR: case TYPE_POINTER: case TYPE_REFERENCE:
+            return sizeof(void*);
+        case TYPE_FUNCTION:
+            return 2 * sizeof(void*);   // jfm_fn: code and environment pointers
+        case TYPE_ARRAY: {
+            AstNode* soa = layout_soa_struct(program, type);
+            if (soa) {
+                size_t align;
+                return soa_array_size(program, soa, type->data.array.size, &align);
+            }
+            return layout_size_of(program, type->data.array.element_type) * type->data.array.size;
+        }
+        case TYPE_STRUCT: {
+            AstNode* struct_def = layout_find_struct(program, type->data.struct_type.name);
+            return struct_def ? layout_of_struct(program, struct_def)->size : 0;
+        }
+        case TYPE_OPTION: {
+            Type* value_type = type->data.option.value_type;
+            if (layout_option_niche(type) != NICHE_NONE) {
+                return layout_size_of(program, value_type);
+            }
+            return align_up(layout_size_of(program, value_type) + 1, layout_align_of(program, value_type));
+        }
+        case TYPE_RESULT: {
+            // A union of the two payloads followed by the is_ok flag
+            size_t ok_size = layout_size_of(program, type->data.result.ok_type);
+            size_t err_size = layout_size_of(program, type->data.result.err_type);
+            return align_up((ok_size > err_size ? ok_size : err_size) + 1, layout_align_of(program, type));
+        }
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Returns the alignment in bytes of a JFM type as emitted in C.
+ * 
+ * @param program The program AST node, used to resolve struct types
+ * @param type The type to measure
+ * @return Alignment in bytes (at least 1)
+ */
+size_t layout_align_of(AstNode* program, Type* type) {
+    if (!type) return 1;
+    
+    switch (type->kind) {
+        case TYPE_ARRAY: {
+            AstNode* soa = layout_soa_struct(program, type);
+            if (soa) {
+                size_t align;
+                soa_array_size(program, soa, type->data.array.size, &align);
+                return align;
+            }
+            return layout_align_of(program, type->data.array.element_type);
+        }
+        case TYPE_STRUCT: {
+            AstNode* struct_def = layout_find_struct(program, type->data.struct_type.name);
+            return struct_def ? layout_of_struct(program, struct_def)->align : 1;
+        }
+        case TYPE_FUNCTION:
+            return sizeof(void*);
+        case TYPE_OPTION:
+            return layout_align_of(program, type->data.option.value_type);
+        case TYPE_RESULT: {
+            size_t ok_align = layout_align_of(program, type->data.result.ok_type);
+            size_t err_align = layout_align_of(program, type->data.result.err_type);
+            return ok_align > err_align ? ok_align : err_align;
+        }
+        default: {
+            size_t size = layout_size_of(program, type);
+            return size ? size : 1;
+        }
+    }
+}
+
+/**
+ * Returns the alignment requested by #[align(N)] or #[cache_aligned], or 0
+ * if neither is present. Malformed values (rejected by the semantic pass)
+ * are ignored.
+ * 
+ * @param attributes The attributes of a struct, field or let
+ * @param count Number of attributes
+ * @return Requested alignment in bytes, or 0
+ */
+size_t layout_requested_align(Attribute* attributes, size_t count) {
+    size_t align = 0;
+    
+    for (size_t i = 0; i < count; i++) {
+        size_t value = 0;
+        if (strcmp(attributes[i].name, "cache_aligned") == 0) {
+            value = CACHE_LINE_SIZE;
+        } else if (strcmp(attributes[i].name, "align") == 0 && attributes[i].arg_count == 1) {
+            value = strtoul(attributes[i].args[0], NULL, 0);
+            if (value == 0 || (value & (value - 1)) != 0 || value > MAX_ALIGNMENT) value = 0;
+        }
+        if (value > align) align = value;
+    }
+    
+    return align;
+}
+
+/**
+ * Checks for a #[packed] attribute.
+ * 
+ * @param attributes The attributes of a struct or field
+ * @param count Number of attributes
+ * @return true if packed
+ */
+bool layout_is_packed(Attribute* attributes, size_t count) {
+    return ast_find_attribute(attributes, count, "packed") != NULL;
+}
+
+/**
+ * Returns the alignment of a field inside its struct: the natural alignment
+ * of its type, dropped to 1 in a packed struct or for a packed field, then
+ * raised by #[align(N)] or #[cache_aligned] on the field.
+ * 
+ * @param program The program AST node
+ * @param struct_def The struct definition AST node
+ * @param index Declaration index of the field
+ * @return Field alignment in bytes
+ */
+size_t layout_field_align(AstNode* program, AstNode* struct_def, size_t index) {
+    Field* field = &struct_def->data.struct_def.fields[index];
+    size_t align = layout_align_of(program, field->type);
+    
+    if (layout_is_packed(struct_def->attributes, struct_def->attribute_count) ||
+        layout_is_packed(field->attributes, field->attribute_count)) {
+        align = 1;
+    }
+    
+    size_t requested = layout_requested_align(field->attributes, field->attribute_count);
+    return requested > align ? requested : align;
+}
+
+/**
+ * Checks whether a struct must keep its fields in declaration order:
+ * extern structs mirror a C definition, pub structs are laid out for C
+ * code built against the generated header, #[repr(C)] opts out of reordering,
+ * and #[packed] structs have no padding to remove and usually describe a
+ * wire format.
+ * 
+ * @param struct_def The struct definition AST node
+ * @return true if fields must not be reordered
+ */
+bool layout_keeps_declaration_order(AstNode* struct_def) {
+    if (struct_def->data.struct_def.is_extern || struct_def->data.struct_def.is_pub) return true;
+    if (layout_is_packed(struct_def->attributes, struct_def->attribute_count)) return true;
+    
+    Attribute* repr = ast_find_attribute(struct_def->attributes, struct_def->attribute_count, "repr");
+    return repr && repr->arg_count == 1 && strcmp(repr->args[0], "C") == 0;
+}
+
+typedef struct {
+    size_t index;
+    size_t align;
+} FieldRank;
+
+/**
+ * Orders fields by decreasing alignment, keeping declaration order for ties.
+ */
+static int compare_field_rank(const void* a, const void* b) {
+    const FieldRank* fa = a;
+    const FieldRank* fb = b;
+    if (fa->align != fb->align) return fa->align > fb->align ? -1 : 1;
+    return fa->index < fb->index ? -1 : (fa->index > fb->index);
+}
+
+/**
+ * Places fields at increasing offsets in the given order. The struct is
+ * aligned to its most aligned field, or more if the struct itself carries
+ * #[align(N)] or #[cache_aligned].
+ * 
+ * @param program The program AST node
+ * @param struct_def The struct definition AST node
+ * @param order Declaration indices in placement order
+ * @param offsets Output: offset of each field by declaration index (may be NULL)
+ * @param align Output: alignment of the struct
+ * @return Size of the struct including tail padding
+ */
+static size_t place_fields(AstNode* program, AstNode* struct_def, size_t* order, size_t* offsets, size_t* align) {
+    size_t offset = 0;
+    *align = 1;
+    
+    for (size_t i = 0; i < struct_def->data.struct_def.field_count; i++) {
+        Type* type = struct_def->data.struct_def.fields[order[i]].type;
+        size_t field_align = layout_field_align(program, struct_def, order[i]);
+        
+        offset = align_up(offset, field_align);
+        if (offsets) offsets[order[i]] = offset;
+        offset += layout_size_of(program, type);
+        
+        if (field_align > *align) *align = field_align;
+    }
+    
+    size_t requested = layout_requested_align(struct_def->attributes, struct_def->attribute_count);
+    if (requested > *align) *align = requested;
+    
+    return align_up(offset, *align);
+}
+
+/**
+ * Computes (and caches on the node) the emitted layout of a struct.
+ * Unless the struct keeps declaration order, fields are sorted by
+ * decreasing alignment, which removes all interior padding that C
+ * would otherwise insert between mixed-size fields.
+ * 
+ * @param program The program AST node, used to resolve nested structs
+ * @param struct_def The struct definition AST node
+ * @return The struct layout (owned by the AST node)
+ */
+const StructLayout* layout_of_struct(AstNode* program, AstNode* struct_def) {
+    if (struct_def->data.struct_def.layout) {
+        return struct_def->data.struct_def.layout;
+    }
+    struct_def->data.struct_def.layout = &layout_in_progress;
+    
+    size_t field_count = struct_def->data.struct_def.field_count;
+    StructLayout* layout = calloc(1, sizeof(StructLayout));
+    layout->order = malloc(sizeof(size_t) * (field_count + 1));
+    layout->offsets = malloc(sizeof(size_t) * (field_count + 1));
+    
+    for (size_t i = 0; i < field_count; i++) {
+        layout->order[i] = i;
+    }
+    layout->declared_size = place_fields(program, struct_def, layout->order, NULL, &layout->align);
+    
+    if (!layout_keeps_declaration_order(struct_def)) {
+        FieldRank* ranks = malloc(sizeof(FieldRank) * (field_count + 1));
+        for (size_t i = 0; i < field_count; i++) {
+            ranks[i].index = i;
+            ranks[i].align = layout_field_align(program, struct_def, i);
+        }
+        qsort(ranks, field_count, sizeof(FieldRank), compare_field_rank);
+        
+        for (size_t i = 0; i < field_count; i++) {
+            if (ranks[i].index != i) layout->reordered = true;
+            layout->order[i] = ranks[i].index;
+        }
+        free(ranks);
+    }
+    
+    layout->size = place_fields(program, struct_def, layout->order, layout->offsets, &layout->align);
+    
+    struct_def->data.struct_def.layout = layout;
+    return layout;
+}
+
+/**
+ * Checks whether the wire format of a #[derive(Encode, Decode)] struct is
+ * byte for byte its in-memory layout on a little-endian host, so a buffer
+ * can be viewed in place: no #[varint] fields, no padding, and the same
+ * holds for every nested struct.
+ * 
+ * @param program The program AST node
+ * @param struct_def The struct definition
+ * @return true if Struct::view can reinterpret an encoded buffer
+ */
+bool layout_wire_viewable(AstNode* program, AstNode* struct_def) {
+    size_t wire_size = 0;
+    
+    for (size_t i = 0; i < struct_def->data.struct_def.field_count; i++) {
+        Field* field = &struct_def->data.struct_def.fields[i];
+        if (ast_find_attribute(field->attributes, field->attribute_count, "varint")) return false;
+        
+        Type* base = field->type;
+        size_t count = 1;
+        while (base->kind == TYPE_ARRAY) {
+            count *= base->data.array.size;
+            base = base->data.array.element_type;
+        }
+        if (base->kind == TYPE_STRUCT) {
+            AstNode* inner = layout_find_struct(program, base->data.struct_type.name);
+            if (!inner || !layout_wire_viewable(program, inner)) return false;
+        }
+        wire_size += count * layout_size_of(program, base);
+    }
+    
+    return wire_size == layout_of_struct(program, struct_def)->size;
+}
+
+/**
+ * Checks whether a function keeps the plain C calling convention for its
+ * struct parameters and result. pub functions are called from C through
+ * the generated header, so their signature must not depend on their body
+ * or on struct sizes.
+ * 
+ * @param func The function or method AST node
+ * @return true if structs are passed and returned by value
+ */
+static bool keeps_c_signature(AstNode* func) {
+    return func->data.function.is_pub;
+}
+
+/**
+ * Checks whether a function returns its result through a caller-provided
+ * slot (void f(T* jfm_ret, ...)) instead of by value.
+ * 
+ * @param program The program AST node
+ * @param func The function or method AST node
+ * @return true for non-pub functions returning structs larger than LARGE_STRUCT_SIZE
+ */
+bool layout_returns_via_slot(AstNode* program, AstNode* func) {
+    Type* type = func->data.function.return_type;
+    return !keeps_c_signature(func) && type && type->kind == TYPE_STRUCT &&
+           layout_size_of(program, type) > LARGE_STRUCT_SIZE;
+}
+
+typedef struct {
+    const char* name;
+    bool found;
+} AddressSearch;
+
+/**
+ * Looks for &name, &name.field or &name[i] below a node.
+ */
+static void find_address_taken(AstNode* node, void* context) {
+    AddressSearch* search = context;
+    if (search->found) return;
+    
+    if (node->type == AST_UNARY_OP && node->data.unary.op == TOKEN_AND) {
+        AstNode* root = node->data.unary.operand;
+        while (root->type == AST_FIELD || root->type == AST_INDEX) {
+            root = root->type == AST_FIELD ? root->data.field.object : root->data.index.array;
+        }
+        if (root->type == AST_IDENTIFIER && strcmp(root->data.identifier.name, search->name) == 0) {
+            search->found = true;
+            return;
+        }
+    }
+    
+    ast_for_each_child(node, find_address_taken, context);
+}
+
+/**
+ * Checks whether a value of a type can carry a pointer, &mut or closure
+ * through which the callee could write to caller memory, looking through
+ * arrays, struct fields and Option/Result payloads.
+ * 
+ * @param program The program AST node
+ * @param type The type to check
+ * @param depth Nesting depth so far; deep or unresolved types count as writable
+ * @return true if a value of the type may reach caller memory mutably
+ */
+static bool type_can_write_caller(AstNode* program, Type* type, int depth) {
+    if (!type) return false;
+    if (depth > 32) return true;
+    
+    switch (type->kind) {
+        case TYPE_POINTER:
+        case TYPE_FUNCTION:     // A closure may capture the caller's locals by reference
+            return true;
+        case TYPE_REFERENCE:
+            return type->data.reference.is_mutable ||
+                   type_can_write_caller(program, type->data.reference.referenced_type, depth + 1);
+        case TYPE_ARRAY:
+            return type_can_write_caller(program, type->data.array.element_type, depth + 1);
+        case TYPE_OPTION:
+            return type_can_write_caller(program, type->data.option.value_type, depth + 1);
+        case TYPE_RESULT:
+            return type_can_write_caller(program, type->data.result.ok_type, depth + 1) ||
+                   type_can_write_caller(program, type->data.result.err_type, depth + 1);
+        case TYPE_STRUCT: {
+            AstNode* struct_def = layout_find_struct(program, type->data.struct_type.name);
+            if (!struct_def) return true;
+            for (size_t i = 0; i < struct_def->data.struct_def.field_count; i++) {
+                if (type_can_write_caller(program, struct_def->data.struct_def.fields[i].type, depth + 1)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        default:
+            return false;
+    }
+}
+
+/**
+ * Decides whether a struct parameter is passed as a hidden const pointer.
+ * JFM parameters are immutable, so reading the caller's object is only
+ * observable if the callee could write to it (through a pointer, &mut or
+ * closure anywhere inside any parameter) or lets its address escape; such
+ * parameters are copied.
+ * 
+ * @param program The program AST node
+ * @param func The function or method AST node
+ * @param index The parameter index
+ * @return true if the parameter is passed by hidden reference
+ */
+bool layout_passes_by_reference(AstNode* program, AstNode* func, size_t index) {
+    Type* type = func->data.function.params[index].type;
+    if (keeps_c_signature(func) || !type || type->kind != TYPE_STRUCT ||
+        layout_size_of(program, type) <= LARGE_STRUCT_SIZE) {
+        return false;
+    }
+    
+    for (size_t i = 0; i < func->data.function.param_count; i++) {
+        if (type_can_write_caller(program, func->data.function.params[i].type, 0)) {
+            return false;
+        }
+    }
+    
+    AddressSearch search = { func->data.function.params[index].name, false };
+    if (func->data.function.body) {
+        find_address_taken(func->data.function.body, &search);
+    }
+    return !search.found;
+}
+
+/**
+ * Formats a type the way it is written in JFM source (e.g. "[Particle; 100]").
+ * 
+ * @param type The type to format
+ * @return Newly allocated string; the caller frees it
+ */
+static char* format_type(Type* type) {
+    return string_duplicate(type ? type_to_string(type) : "?");
+}
+
+/**
+ * Prints a pahole-style layout of one struct: offsets and sizes of each
+ * field, padding holes, cache-line boundaries and a summary.
+ * 
+ * @param out Output stream
+ * @param program The program AST node
+ * @param struct_def The struct definition AST node
+ */
+static void print_struct_layout(FILE* out, AstNode* program, AstNode* struct_def) {
+    const StructLayout* layout = layout_of_struct(program, struct_def);
+    size_t field_count = struct_def->data.struct_def.field_count;
+    size_t end = 0;
+    size_t holes = 0;
+    size_t hole_bytes = 0;
+    size_t next_line = 1;
+    
+    fprintf(out, "%sstruct %s {\n", struct_def->data.struct_def.is_extern ? "extern " : "",
+            struct_def->data.struct_def.name);
+    
+    for (size_t i = 0; i < field_count; i++) {
+        Field* field = &struct_def->data.struct_def.fields[layout->order[i]];
+        size_t offset = layout->offsets[layout->order[i]];
+        size_t size = layout_size_of(program, field->type);
+        
+        if (offset > end) {
+            fprintf(out, "\n        /* XXX %zu byte%s hole, try to pack */\n\n", offset - end, offset - end == 1 ? "" : "s");
+            holes++;
+            hole_bytes += offset - end;
+        }
+        
+        if (offset >= next_line * CACHE_LINE_SIZE) {
+            size_t line = offset / CACHE_LINE_SIZE;
+            if (offset % CACHE_LINE_SIZE == 0) {
+                fprintf(out, "        /* --- cacheline %zu boundary (%zu bytes) --- */\n", line, offset);
+            } else {
+                fprintf(out, "        /* --- cacheline %zu boundary (%zu bytes) was %zu bytes ago --- */\n",
+                        line, line * CACHE_LINE_SIZE, offset % CACHE_LINE_SIZE);
+            }
+            next_line = line + 1;
+        }
+        
+        char* type_name = format_type(field->type);
+        fprintf(out, "        %-24s %-20s /* %5zu %5zu */", type_name, field->name, offset, size);
+        free(type_name);
+        if (size > 0 && offset / CACHE_LINE_SIZE != (offset + size - 1) / CACHE_LINE_SIZE) {
+            fprintf(out, "  /* straddles cacheline %zu */", (offset + size - 1) / CACHE_LINE_SIZE);
+        }
+        fprintf(out, "\n");
+        
+        end = offset + size;
+    }
+    
+    size_t cachelines = (layout->size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE;
+    fprintf(out, "\n        /* size: %zu, align: %zu, cachelines: %zu, members: %zu */\n",
+            layout->size, layout->align, cachelines, field_count);
+    if (holes > 0) {
+        fprintf(out, "        /* sum members: %zu, holes: %zu, sum holes: %zu */\n",
+                end - hole_bytes, holes, hole_bytes);
+    }
+    if (layout->size > end) {
+        fprintf(out, "        /* padding: %zu */\n", layout->size - end);
+    }
+    if (layout->size % CACHE_LINE_SIZE != 0 && layout->size > 0) {
+        fprintf(out, "        /* last cacheline: %zu bytes */\n", layout->size % CACHE_LINE_SIZE);
+    }
+    if (layout->reordered) {
+        fprintf(out, "        /* reordered: declaration order would be %zu bytes */\n", layout->declared_size);
+    }
+    fprintf(out, "};\n\n");
+}
+
+/**
+ * Counts how many elements in one repeating period of an array straddle a
+ * cache line, assuming the array starts on a cache-line boundary.
+ * 
+ * @param element_size Size of one array element
+ * @param period Output: number of elements after which the pattern repeats
+ * @return Number of straddling elements per period
+ */
+static size_t count_straddling(size_t element_size, size_t* period) {
+    size_t a = element_size;
+    size_t b = CACHE_LINE_SIZE;
+    while (b != 0) {
+        size_t t = a % b;
+        a = b;
+        b = t;
+    }
+    *period = CACHE_LINE_SIZE / a;
+    
+    size_t straddling = 0;
+    for (size_t i = 0; i < *period; i++) {
+        size_t start = i * element_size;
+        if (start / CACHE_LINE_SIZE != (start + element_size - 1) / CACHE_LINE_SIZE &&
+            (element_size <= CACHE_LINE_SIZE || start % CACHE_LINE_SIZE != 0)) {
+            straddling++;
+        }
+    }
+    return straddling;
+}
+
+/**
+ * Reports an array of structs whose element size is not a power of two,
+ * which means some elements straddle cache lines and indexing needs a
+ * multiply instead of a shift.
+ * 
+ * @param out Output stream
+ * @param program The program AST node
+ * @param type The declared type (arrays of structs, also behind a reference
+ *             or pointer, are reported)
+ * @param where Description of the declaration (e.g. "line 12: particles")
+ * @param found Number of arrays reported so far, updated on report
+ */
+static void check_struct_array(FILE* out, AstNode* program, Type* type, const char* where, size_t* found) {
+    Type* array = type;
+    if (array && array->kind == TYPE_REFERENCE) {
+        array = array->data.reference.referenced_type;
+    } else if (array && array->kind == TYPE_POINTER) {
+        array = array->data.pointer.pointed_type;
+    }
+    if (!array || array->kind != TYPE_ARRAY || !array->data.array.element_type ||
+        array->data.array.element_type->kind != TYPE_STRUCT) {
+        return;
+    }
+    
+    size_t size = layout_size_of(program, array->data.array.element_type);
+    if (size == 0 || (size & (size - 1)) == 0 || layout_soa_struct(program, array)) return;
+    
+    if (*found == 0) {
+        fprintf(out, "/* Arrays of structs with non power-of-two element size */\n");
+    }
+    (*found)++;
+    
+    char* type_name = format_type(type);
+    fprintf(out, "%s: %s, element size %zu", where, type_name, size);
+    free(type_name);
+    
+    size_t period;
+    size_t straddling = count_straddling(size, &period);
+    if (straddling > 0) {
+        fprintf(out, ", %zu of every %zu elements straddle a cache line", straddling, period);
+    }
+    fprintf(out, "\n");
+}
+
+/**
+ * Walks statements looking for local array-of-struct declarations.
+ * 
+ * @param out Output stream
+ * @param program The program AST node
+ * @param node The statement to scan
+ * @param found Number of arrays reported so far
+ */
+static void scan_struct_arrays(FILE* out, AstNode* program, AstNode* node, size_t* found) {
+    if (!node) return;
+    
+    char* where;
+    switch (node->type) {
+        case AST_LET:
+            where = string_format("line %zu: %s", node->location.line, node->data.let_stmt.name);
+            check_struct_array(out, program, node->data.let_stmt.type, where, found);
+            free(where);
+            break;
+        case AST_BLOCK:
+            for (size_t i = 0; i < node->data.block.statement_count; i++) {
+                scan_struct_arrays(out, program, node->data.block.statements[i], found);
+            }
+            break;
+        case AST_IF:
+            scan_struct_arrays(out, program, node->data.if_stmt.then_branch, found);
+            scan_struct_arrays(out, program, node->data.if_stmt.else_branch, found);
+            break;
+        case AST_WHILE:
+            scan_struct_arrays(out, program, node->data.while_loop.body, found);
+            break;
+        case AST_FOR:
+            scan_struct_arrays(out, program, node->data.for_loop.body, found);
+            break;
+        case AST_LOOP:
+            scan_struct_arrays(out, program, node->data.loop_stmt.body, found);
+            break;
+        case AST_FUNCTION:
+            for (size_t i = 0; i < node->data.function.param_count; i++) {
+                where = string_format("%s(%s)", node->data.function.name, node->data.function.params[i].name);
+                check_struct_array(out, program, node->data.function.params[i].type, where, found);
+                free(where);
+            }
+            scan_struct_arrays(out, program, node->data.function.body, found);
+            break;
+        case AST_IMPL:
+            for (size_t i = 0; i < node->data.impl_block.function_count; i++) {
+                scan_struct_arrays(out, program, node->data.impl_block.functions[i], found);
+            }
+            break;
+        case AST_STRUCT:
+            for (size_t i = 0; i < node->data.struct_def.field_count; i++) {
+                Field* field = &node->data.struct_def.fields[i];
+                where = string_format("%s.%s", node->data.struct_def.name, field->name);
+                check_struct_array(out, program, field->type, where, found);
+                free(where);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Prints a function whose signature is lowered for large structs, with
+ * the C signature it is emitted as.
+ * 
+ * @param out Output stream
+ * @param program The program AST node
+ * @param func The function or method AST node
+ * @param owner Struct name for methods, or NULL
+ * @param found Number of functions reported so far, updated on report
+ */
+static void print_lowered_signature(FILE* out, AstNode* program, AstNode* func, const char* owner, size_t* found) {
+    bool slot = layout_returns_via_slot(program, func);
+    bool any = slot;
+    for (size_t i = 0; i < func->data.function.param_count && !any; i++) {
+        any = layout_passes_by_reference(program, func, i);
+    }
+    if (!any) return;
+    
+    if (*found == 0) {
+        fprintf(out, "\n/* Signatures lowered for structs larger than %d bytes */\n", LARGE_STRUCT_SIZE);
+    }
+    (*found)++;
+    
+    char* return_name = func->data.function.return_type ? format_type(func->data.function.return_type) : NULL;
+    fprintf(out, "fn %s%s%s(", owner ? owner : "", owner ? "::" : "", func->data.function.name);
+    for (size_t i = 0; i < func->data.function.param_count; i++) {
+        char* type_name = format_type(func->data.function.params[i].type);
+        fprintf(out, "%s%s: %s", i > 0 ? ", " : "", func->data.function.params[i].name, type_name);
+        free(type_name);
+    }
+    fprintf(out, ")");
+    if (return_name) {
+        fprintf(out, " -> %s", return_name);
+    }
+    
+    fprintf(out, "\n    => (");
+    if (slot) {
+        fprintf(out, "jfm_ret: *%s%s", return_name, func->data.function.param_count > 0 ? ", " : "");
+    }
+    for (size_t i = 0; i < func->data.function.param_count; i++) {
+        char* type_name = format_type(func->data.function.params[i].type);
+        fprintf(out, "%s%s: %s%s", i > 0 ? ", " : "", func->data.function.params[i].name,
+                layout_passes_by_reference(program, func, i) ? "&" : "", type_name);
+        free(type_name);
+    }
+    fprintf(out, ")");
+    if (!slot && return_name) {
+        fprintf(out, " -> %s", return_name);
+    }
+    fprintf(out, "\n");
+    free(return_name);
+}
+
+/**
+ * Prints the layout of every struct in the program, followed by the arrays
+ * of structs whose element size is not a power of two.
+ * 
+ * @param out Output stream
+ * @param program The program AST node
+ */
+void layout_print_report(FILE* out, AstNode* program) {
+    for (size_t i = 0; i < program->data.program.count; i++) {
+        AstNode* item = program->data.program.items[i];
+        if (item->type == AST_STRUCT && item->data.struct_def.field_count > 0) {
+            print_struct_layout(out, program, item);
+        }
+    }
+    
+    size_t found = 0;
+    for (size_t i = 0; i < program->data.program.count; i++) {
+        scan_struct_arrays(out, program, program->data.program.items[i], &found);
+    }
+    
+    found = 0;
+    for (size_t i = 0; i < program->data.program.count; i++) {
+        AstNode* item = program->data.program.items[i];
+        if (item->type == AST_FUNCTION) {
+            print_lowered_signature(out, program, item, NULL, &found);
+        } else if (item->type == AST_IMPL) {
+            for (size_t j = 0; j < item->data.impl_block.function_count; j++) {
+                print_lowered_signature(out, program, item->data.impl_block.functions[j],
+                                        item->data.impl_block.struct_name, &found);
+            }
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "ast.h"
+#include "type.h"
+
+#define CACHE_LINE_SIZE 64   // Alignment used by #[cache_aligned]
+#define MAX_ALIGNMENT 4096   // Largest value accepted by #[align(N)]
+
+// Structs larger than this are returned through a caller-provided pointer
+// and passed as hidden const pointers (two registers' worth on 64-bit ABIs)
+#define LARGE_STRUCT_SIZE 16
+
+// Memory layout of a struct as it is emitted in the generated C
+struct StructLayout {
+    size_t* order;          // Declaration indices of the fields in emitted order
+    size_t* offsets;        // Byte offset of each field, indexed by declaration order
+    size_t size;            // sizeof() of the emitted struct
+    size_t align;           // _Alignof() of the emitted struct
+    size_t declared_size;   // Size the struct would have in declaration order
+    bool reordered;         // Emitted order differs from declaration order
+};
+
+// Layout queries (sizes assume the host C ABI)
+size_t layout_size_of(AstNode* program, Type* type);
+size_t layout_align_of(AstNode* program, Type* type);
+AstNode* layout_find_struct(AstNode* program, const char* name);
+size_t layout_struct_position(AstNode* program, const char* name);
+const StructLayout* layout_of_struct(AstNode* program, AstNode* struct_def);
+bool layout_keeps_declaration_order(AstNode* struct_def);
+
+// Alignment attributes: #[align(N)], #[cache_aligned] and #[packed]
+size_t layout_requested_align(Attribute* attributes, size_t count);
+bool layout_is_packed(Attribute* attributes, size_t count);
+size_t layout_field_align(AstNode* program, AstNode* struct_def, size_t index);
+
+// Arrays of #[soa] structs are emitted as one array per field
+AstNode* layout_soa_struct(AstNode* program, Type* type);
+
+// Option<T> payloads with a spare bit pattern that encodes None
+typedef enum {
+    NICHE_NONE,     // { T value; bool is_some; }
+    NICHE_NULL,     // References, pointers and str: None is NULL
+    NICHE_BOOL,     // bool: a byte holding 0 or 1, None is 2
+} OptionNiche;
+
+OptionNiche layout_option_niche(Type* type);
+
+// Wire format of #[derive(Encode, Decode)] structs: fields in emitted order,
+// little-endian and unpadded, #[varint] integers as LEB128
+bool layout_wire_viewable(AstNode* program, AstNode* struct_def);
+
+// Calling convention of JFM functions (extern fns keep the C ABI)
+bool layout_returns_via_slot(AstNode* program, AstNode* func);
+bool layout_passes_by_reference(AstNode* program, AstNode* func, size_t index);
+
+// pahole-style report of every struct in the program (--layout)
+void layout_print_report(FILE* out, AstNode* program);
+
+#endif
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <inttypes.h>
+#include <limits.h>
 
 // Forward declarations
 static void skip_whitespace(Lexer* lexer);
@@ -289,6 +290,34 @@ static Token scan_char(Lexer* lexer, size_t start_line, size_t start_column) {
     return token;
 }
 
+/**
+ * Parses the decimal digits of an integer literal into 128 bits, held as
+ * two 64-bit halves so the compiler does not need a 128-bit host type.
+ * 
+ * @param start First digit
+ * @param end One past the last digit
+ * @param low Set to the low 64 bits of the value
+ * @param high Set to the high 64 bits of the value
+ * @return false if the value does not fit in 128 bits
+ */
+static bool parse_int_literal(const char* start, const char* end, unsigned long long* low, unsigned long long* high) {
+    *low = 0;
+    *high = 0;
+    for (const char* c = start; c < end; c++) {
+        // Multiply by 10 in 32-bit pieces to catch the carry into the high half
+        unsigned long long digit = (unsigned long long)(*c - '0');
+        unsigned long long bottom = (*low & 0xFFFFFFFFULL) * 10 + digit;
+        unsigned long long top = (*low >> 32) * 10 + (bottom >> 32);
+        unsigned long long carry = top >> 32;
+        if (*high > (ULLONG_MAX - carry) / 10) {
+            return false;
+        }
+        *low = (top << 32) | (bottom & 0xFFFFFFFFULL);
+        *high = *high * 10 + carry;
+    }
+    return true;
+}
+
 /**
  * Scans a numeric literal (integer or floating-point).
  * Supports decimal notation and scientific notation (e.g., 1.5e-10).
@@ -329,8 +358,8 @@ static Token scan_number(Lexer* lexer, size_t start_line, size_t start_column) {
     
     if (is_float) {
         token.value.float_value = strtod(start, NULL);
-    } else {
-        token.value.int_value = strtoll(start, NULL, 10);
+    } else if (!parse_int_literal(start, lexer->current, &token.value.int_value, &token.value.int_high)) {
+        return error_token(lexer, "Integer literal is too large for u128");
     }
     
     return token;
@@ -364,9 +393,13 @@ static TokenType identifier_type(const char* start, size_t length) {
     switch (start[0]) {
         case 'a':
             if (length == 2) return check_keyword(start, length, "as", TOKEN_AS);
+            if (length == 3) return check_keyword(start, length, "asm", TOKEN_ASM);
             break;
         case 'b':
-            if (length == 4) return check_keyword(start, length, "bool", TOKEN_BOOL);
+            if (length == 4) {
+                if (memcmp(start, "bool", 4) == 0) return TOKEN_BOOL;
+                if (memcmp(start, "bf16", 4) == 0) return TOKEN_BF16;
+            }
             if (length == 5) return check_keyword(start, length, "break", TOKEN_BREAK);
             break;
         case 'c':
@@ -381,6 +414,7 @@ static TokenType identifier_type(const char* start, size_t length) {
             if (length == 2) return check_keyword(start, length, "fn", TOKEN_FN);
             if (length == 3) {
                 if (memcmp(start, "for", 3) == 0) return TOKEN_FOR;
+                if (memcmp(start, "f16", 3) == 0) return TOKEN_F16;
                 if (memcmp(start, "f32", 3) == 0) return TOKEN_F32;
                 if (memcmp(start, "f64", 3) == 0) return TOKEN_F64;
             }
@@ -397,7 +431,10 @@ static TokenType identifier_type(const char* start, size_t length) {
                 if (memcmp(start, "i32", 3) == 0) return TOKEN_I32;
                 if (memcmp(start, "i64", 3) == 0) return TOKEN_I64;
             }
-            if (length == 4) return check_keyword(start, length, "impl", TOKEN_IMPL);
+            if (length == 4) {
+                if (memcmp(start, "impl", 4) == 0) return TOKEN_IMPL;
+                if (memcmp(start, "i128", 4) == 0) return TOKEN_I128;
+            }
             if (length == 7) return check_keyword(start, length, "include", TOKEN_INCLUDE);
             break;
         case 'l':
@@ -407,6 +444,9 @@ static TokenType identifier_type(const char* start, size_t length) {
         case 'm':
             if (length == 3) return check_keyword(start, length, "mut", TOKEN_MUT);
             break;
+        case 'p':
+            if (length == 3) return check_keyword(start, length, "pub", TOKEN_PUB);
+            break;
         case 'r':
             if (length == 6) return check_keyword(start, length, "return", TOKEN_RETURN);
             break;
@@ -424,6 +464,7 @@ static TokenType identifier_type(const char* start, size_t length) {
                 if (memcmp(start, "u32", 3) == 0) return TOKEN_U32;
                 if (memcmp(start, "u64", 3) == 0) return TOKEN_U64;
             }
+            if (length == 4) return check_keyword(start, length, "u128", TOKEN_U128);
             break;
         case 'w':
             if (length == 5) return check_keyword(start, length, "while", TOKEN_WHILE);
@@ -509,6 +550,8 @@ static Token scan_token(Lexer* lexer) {
         case ',': return make_token_with_pos(lexer, TOKEN_COMMA, start, start_line, start_column);
         case '%': return make_token_with_pos(lexer, TOKEN_PERCENT, start, start_line, start_column);
         case '^': return make_token_with_pos(lexer, TOKEN_XOR, start, start_line, start_column);
+        case '#': return make_token_with_pos(lexer, TOKEN_HASH, start, start_line, start_column);
+        case '?': return make_token_with_pos(lexer, TOKEN_QUESTION, start, start_line, start_column);
         
         case ':':
             if (match(lexer, ':')) {
@@ -518,6 +561,9 @@ static Token scan_token(Lexer* lexer) {
             
         case '.':
             if (match(lexer, '.')) {
+                if (match(lexer, '=')) {
+                    return make_token_with_pos(lexer, TOKEN_DOT_DOT_EQ, start, start_line, start_column);
+                }
                 return make_token_with_pos(lexer, TOKEN_DOT_DOT, start, start_line, start_column);
             }
             return make_token_with_pos(lexer, TOKEN_DOT, start, start_line, start_column);
@@ -677,14 +723,20 @@ const char* token_type_to_string(TokenType type) {
         case TOKEN_STRUCT: return "STRUCT";
         case TOKEN_IMPL: return "IMPL";
         case TOKEN_IN: return "IN";
+        case TOKEN_ASM: return "ASM";
+        case TOKEN_PUB: return "PUB";
         case TOKEN_I8: return "I8";
         case TOKEN_I16: return "I16";
         case TOKEN_I32: return "I32";
         case TOKEN_I64: return "I64";
+        case TOKEN_I128: return "I128";
         case TOKEN_U8: return "U8";
         case TOKEN_U16: return "U16";
         case TOKEN_U32: return "U32";
         case TOKEN_U64: return "U64";
+        case TOKEN_U128: return "U128";
+        case TOKEN_F16: return "F16";
+        case TOKEN_BF16: return "BF16";
         case TOKEN_F32: return "F32";
         case TOKEN_F64: return "F64";
         case TOKEN_BOOL: return "BOOL";
@@ -726,7 +778,10 @@ const char* token_type_to_string(TokenType type) {
         case TOKEN_DOT: return "DOT";
         case TOKEN_ARROW: return "ARROW";
         case TOKEN_DOT_DOT: return "DOT_DOT";
+        case TOKEN_DOT_DOT_EQ: return "DOT_DOT_EQ";
         case TOKEN_DOUBLE_COLON: return "DOUBLE_COLON";
+        case TOKEN_HASH: return "HASH";
+        case TOKEN_QUESTION: return "QUESTION";
         case TOKEN_IDENTIFIER: return "IDENTIFIER";
         case TOKEN_INT_LITERAL: return "INT_LITERAL";
         case TOKEN_FLOAT_LITERAL: return "FLOAT_LITERAL";
@@ -752,7 +807,7 @@ void token_print(Token* token) {
     
     switch (token->type) {
         case TOKEN_INT_LITERAL:
-            printf(", value: %" PRId64, token->value.int_value);
+            printf(", value: %llu", token->value.int_value);
             break;
         case TOKEN_FLOAT_LITERAL:
             printf(", value: %f", token->value.float_value);
@@ -25,15 +25,21 @@ typedef enum {
     TOKEN_IN,
     TOKEN_INCLUDE,
     TOKEN_AS,
+    TOKEN_ASM,
+    TOKEN_PUB,
     
     TOKEN_I8,
     TOKEN_I16,
     TOKEN_I32,
     TOKEN_I64,
+    TOKEN_I128,
     TOKEN_U8,
     TOKEN_U16,
     TOKEN_U32,
     TOKEN_U64,
+    TOKEN_U128,
+    TOKEN_F16,
+    TOKEN_BF16,
     TOKEN_F32,
     TOKEN_F64,
     TOKEN_BOOL,
@@ -82,7 +88,10 @@ typedef enum {
     TOKEN_DOT,
     TOKEN_ARROW,
     TOKEN_DOT_DOT,
+    TOKEN_DOT_DOT_EQ,
     TOKEN_DOUBLE_COLON,
+    TOKEN_HASH,
+    TOKEN_QUESTION,
     
     TOKEN_IDENTIFIER,
     TOKEN_INT_LITERAL,
@@ -101,7 +110,10 @@ typedef struct {
     size_t column;
     
     union {
-        long long int_value;
+        struct {
+            unsigned long long int_value;   // Low 64 bits of an integer literal
+            unsigned long long int_high;    // High 64 bits, for u128 / i128 literals
+        };
         double float_value;
         char char_value;
         bool bool_value;
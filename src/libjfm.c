@@ -0,0 +1,387 @@
+/*
+ * libjfm - the JFM compiler as an embeddable library
+ *
+ * Runs the same lexer, parser, semantic analyzer and code generator as
+ * jfmc, but on a source buffer in memory, producing C in memory and
+ * diagnostics through the context's sink.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "libjfm.h"
+#include "ast.h"
+#include "type.h"
+#include "lexer.h"
+#include "parser.h"
+#include "semantic.h"
+#include "codegen.h"
+#include "error.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct JfmContext {
+    JfmDiagnosticSink sink;       // NULL keeps diagnostics in the result only
+    void* sink_data;
+    bool colors;
+    bool check_only;              // Stop after semantic analysis
+};
+
+// JfmAstKind lists the node kinds in AstNodeType order
+_Static_assert((int)JFM_AST_ASM == (int)AST_ASM, "JfmAstKind is out of step with AstNodeType");
+
+struct JfmResult {
+    char* source;                 // Owned copy; tokens point into it
+    char* filename;
+    Lexer* lexer;
+    Parser* parser;
+    AstPool* pool;                // Every node and type the compilation created
+    AstNode* ast;
+    SemanticAnalyzer* analyzer;
+    ErrorList* diagnostics;       // Every phase's errors and warnings, in order
+    char* c_code;
+    size_t c_length;
+    bool ok;
+};
+
+/**
+ * Creates a compilation context with default settings: no sink, no
+ * colours, and C generation enabled.
+ *
+ * @return Newly allocated context
+ */
+JfmContext* jfm_context_create(void) {
+    return calloc(1, sizeof(JfmContext));
+}
+
+/**
+ * Destroys a context. Results it produced stay valid.
+ *
+ * @param ctx The context to destroy
+ */
+void jfm_context_destroy(JfmContext* ctx) {
+    free(ctx);
+}
+
+/**
+ * Sets the sink that receives each rendered diagnostic of later compilations.
+ *
+ * @param ctx The context
+ * @param sink The sink, or NULL to only record diagnostics in results
+ * @param user_data Passed through to the sink unchanged
+ */
+void jfm_context_set_sink(JfmContext* ctx, JfmDiagnosticSink sink, void* user_data) {
+    ctx->sink = sink;
+    ctx->sink_data = user_data;
+}
+
+/**
+ * Enables or disables ANSI colours in the text handed to the sink.
+ *
+ * @param ctx The context
+ * @param enabled Whether to emit colour codes
+ */
+void jfm_context_set_colors(JfmContext* ctx, bool enabled) {
+    ctx->colors = enabled;
+}
+
+/**
+ * Makes later compilations stop after semantic analysis, like jfmc -check.
+ *
+ * @param ctx The context
+ * @param check_only Whether to skip C generation
+ */
+void jfm_context_set_check_only(JfmContext* ctx, bool check_only) {
+    ctx->check_only = check_only;
+}
+
+/**
+ * Copies a phase's diagnostics into the result, attributing them to the
+ * compiled file.
+ *
+ * @param result The compilation result
+ * @param errors The phase's error list
+ */
+static void collect_diagnostics(JfmResult* result, ErrorList* errors) {
+    for (size_t i = 0; i < errors->error_count; i++) {
+        Error* e = &errors->errors[i];
+        if (e->is_warning) {
+            error_list_add_warning(result->diagnostics, e->message, result->filename, e->line, e->column);
+        } else {
+            error_list_add(result->diagnostics, e->message, result->filename, e->line, e->column);
+        }
+    }
+}
+
+/**
+ * Generates C for an analysed program into a buffer owned by the result.
+ *
+ * @param result The compilation result
+ * @return true if generation succeeded
+ */
+static bool generate_c(JfmResult* result) {
+#ifdef _WIN32
+    FILE* output = tmpfile();
+#else
+    FILE* output = open_memstream(&result->c_code, &result->c_length);
+#endif
+    if (!output) {
+        error_list_add(result->diagnostics, "Could not allocate a buffer for the generated C", result->filename, 0, 0);
+        return false;
+    }
+
+    CodeGenerator* gen = codegen_create(output);
+    bool ok = codegen_generate(gen, result->ast, result->analyzer->symbols);
+    codegen_destroy(gen);
+
+#ifdef _WIN32
+    long length = ftell(output);
+    result->c_length = length > 0 ? (size_t)length : 0;
+    result->c_code = malloc(result->c_length + 1);
+    rewind(output);
+    result->c_length = fread(result->c_code, 1, result->c_length, output);
+    result->c_code[result->c_length] = '\0';
+#endif
+    fclose(output);
+
+    if (!ok) {
+        error_list_add(result->diagnostics, "Code generation failed", result->filename, 0, 0);
+    }
+    return ok;
+}
+
+/**
+ * Runs every phase on the result's source, stopping at the first phase
+ * that reports errors.
+ *
+ * @param ctx The context
+ * @param result The compilation result to fill in
+ * @return true if compilation succeeded
+ */
+static bool run_phases(JfmContext* ctx, JfmResult* result) {
+    result->lexer = lexer_create(result->source);
+    Token* tokens = lexer_scan_tokens(result->lexer);
+
+    size_t token_count = 0;
+    while (tokens[token_count].type != TOKEN_EOF) {
+        if (tokens[token_count].type == TOKEN_ERROR) {
+            Token* t = &tokens[token_count];
+            char* message = string_n_duplicate(t->start, t->length);
+            error_list_add(result->diagnostics, message, result->filename, t->line, t->column);
+            free(message);
+            return false;
+        }
+        token_count++;
+    }
+    token_count++;  // Include EOF token
+
+    result->parser = parser_create(tokens, token_count);
+    result->ast = parser_parse(result->parser);
+    collect_diagnostics(result, result->parser->errors);
+    if (!result->ast || result->parser->had_error) return false;
+
+    result->analyzer = semantic_create();
+    semantic_set_source(result->analyzer, result->source, result->filename);
+    bool ok = semantic_analyze(result->analyzer, result->ast);
+    collect_diagnostics(result, result->analyzer->errors);
+    if (!ok) {
+        if (result->analyzer->errors->error_count == result->analyzer->errors->warning_count) {
+            error_list_add(result->diagnostics, "Semantic analysis failed", result->filename, 0, 0);
+        }
+        return false;
+    }
+
+    return ctx->check_only || generate_c(result);
+}
+
+/**
+ * Compiles a JFM source buffer. Diagnostics are recorded in the result
+ * and, if the context has a sink, rendered to it.
+ *
+ * @param ctx The context supplying the settings
+ * @param source The source text (need not be NUL-terminated)
+ * @param length Length of the source in bytes
+ * @param filename Name used in diagnostics, or NULL for "input"
+ * @return The compilation result (never NULL; check jfm_result_ok)
+ */
+JfmResult* jfm_compile(JfmContext* ctx, const char* source, size_t length, const char* filename) {
+    JfmResult* result = calloc(1, sizeof(JfmResult));
+    result->source = string_n_duplicate(source, length);
+    result->filename = string_duplicate(filename ? filename : "input");
+    result->diagnostics = error_list_create();
+    error_list_set_source(result->diagnostics, result->source);
+
+    result->pool = ast_pool_create();
+    ast_pool_enter(result->pool);
+    result->ok = run_phases(ctx, result);
+    ast_pool_leave();
+
+    if (ctx->sink) {
+        error_list_set_sink(result->diagnostics, ctx->sink, ctx->sink_data);
+        error_list_set_colors(result->diagnostics, ctx->colors);
+        error_list_print_beautiful(result->diagnostics);
+    }
+    return result;
+}
+
+/**
+ * Destroys a compilation result, including every AST node and type of
+ * the compilation and the generated C.
+ *
+ * @param result The result to destroy
+ */
+void jfm_result_destroy(JfmResult* result) {
+    if (!result) return;
+    semantic_destroy(result->analyzer);
+    ast_pool_destroy(result->pool);
+    parser_destroy(result->parser);
+    lexer_destroy(result->lexer);
+    error_list_destroy(result->diagnostics);
+    free(result->c_code);
+    free(result->filename);
+    free(result->source);
+    free(result);
+}
+
+/**
+ * @param result The compilation result
+ * @return true if every phase succeeded
+ */
+bool jfm_result_ok(const JfmResult* result) {
+    return result->ok;
+}
+
+/**
+ * @param result The compilation result
+ * @return Number of errors and warnings reported
+ */
+size_t jfm_result_diagnostic_count(const JfmResult* result) {
+    return result->diagnostics->error_count;
+}
+
+/**
+ * Reads one diagnostic. Its strings live as long as the result.
+ *
+ * @param result The compilation result
+ * @param index Index of the diagnostic, in reporting order
+ * @param out Receives the diagnostic
+ * @return false if index is out of range
+ */
+bool jfm_result_diagnostic(const JfmResult* result, size_t index, JfmDiagnostic* out) {
+    if (index >= result->diagnostics->error_count) return false;
+    Error* e = &result->diagnostics->errors[index];
+    out->is_warning = e->is_warning;
+    out->message = e->message;
+    out->file = e->file;
+    out->line = e->line;
+    out->column = e->column;
+    return true;
+}
+
+/**
+ * @param result The compilation result
+ * @return The analysed AST, or NULL if parsing failed
+ */
+const JfmAst* jfm_result_ast(const JfmResult* result) {
+    return (const JfmAst*)result->ast;
+}
+
+/**
+ * @param result The compilation result
+ * @param length Receives the length of the C code (may be NULL)
+ * @return The generated C, NUL-terminated, or NULL if none was generated
+ */
+const char* jfm_result_c_code(const JfmResult* result, size_t* length) {
+    if (length) *length = result->c_code ? result->c_length : 0;
+    return result->c_code;
+}
+
+/**
+ * @param node An AST node
+ * @return The kind of the node
+ */
+JfmAstKind jfm_ast_kind(const JfmAst* node) {
+    return (JfmAstKind)((const AstNode*)node)->type;
+}
+
+/**
+ * Reads the name a node declares or refers to: the function, struct, impl
+ * target, variable, field, struct literal or include path.
+ *
+ * @param node An AST node
+ * @return The name, or NULL for nodes without one
+ */
+const char* jfm_ast_name(const JfmAst* node) {
+    const AstNode* ast = (const AstNode*)node;
+    switch (ast->type) {
+        case AST_FUNCTION: return ast->data.function.name;
+        case AST_STRUCT: return ast->data.struct_def.name;
+        case AST_IMPL: return ast->data.impl_block.struct_name;
+        case AST_LET: return ast->data.let_stmt.name;
+        case AST_FOR: return ast->data.for_loop.iterator;
+        case AST_FIELD: return ast->data.field.field_name;
+        case AST_IDENTIFIER: return ast->data.identifier.name;
+        case AST_STRUCT_LITERAL: return ast->data.struct_literal.struct_name;
+        case AST_INCLUDE: return ast->data.include.path;
+        case AST_EXTERN_FUNCTION: return ast->data.extern_function.name;
+        default: return NULL;
+    }
+}
+
+/**
+ * Reads the type semantic analysis gave an expression, by its name
+ * ("i32", "Point", "Option"; arrays and pointers are not spelled out).
+ *
+ * @param node An AST node
+ * @return The type name, or NULL for nodes without a type
+ */
+const char* jfm_ast_type(const JfmAst* node) {
+    const AstNode* ast = (const AstNode*)node;
+    return ast->data_type ? type_to_string(ast->data_type) : NULL;
+}
+
+/**
+ * @param node An AST node
+ * @return 1-based source line of the node, 0 when unknown
+ */
+size_t jfm_ast_line(const JfmAst* node) {
+    return ((const AstNode*)node)->location.line;
+}
+
+/**
+ * @param node An AST node
+ * @return 1-based source column of the node, 0 when unknown
+ */
+size_t jfm_ast_column(const JfmAst* node) {
+    return ((const AstNode*)node)->location.column;
+}
+
+typedef struct {
+    JfmAstVisitor visitor;
+    void* user_data;
+} ChildVisit;
+
+/**
+ * Hands one child to the caller's visitor.
+ *
+ * @param child The child node
+ * @param context The ChildVisit
+ */
+static void visit_child(AstNode* child, void* context) {
+    ChildVisit* visit = context;
+    visit->visitor((const JfmAst*)child, visit->user_data);
+}
+
+/**
+ * Calls a visitor on every direct child of a node (items, statements,
+ * operands, function bodies), in source order.
+ *
+ * @param node An AST node
+ * @param visitor Called once per child
+ * @param user_data Passed through to the visitor unchanged
+ */
+void jfm_ast_for_each_child(const JfmAst* node, JfmAstVisitor visitor, void* user_data) {
+    ChildVisit visit = { visitor, user_data };
+    ast_for_each_child((AstNode*)node, visit_child, &visit);
+}
@@ -0,0 +1,101 @@
+#ifndef LIBJFM_H
+#define LIBJFM_H
+
+// Embeddable JFM compiler (libjfm.a / libjfm.so)
+// 
+// Compiles a source buffer held in memory to C held in memory, without
+// touching the filesystem or any process-wide state. A context carries
+// settings and can be reused for any number of compilations; distinct
+// contexts may be used concurrently from different threads.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JFM_API_VERSION 2
+
+typedef struct JfmContext JfmContext;
+typedef struct JfmResult JfmResult;
+
+// Node of the typed AST of a compilation, read through the jfm_ast_*
+// accessors below. Nodes live as long as their result.
+typedef struct JfmAst JfmAst;
+
+typedef enum {
+    JFM_AST_PROGRAM,
+    JFM_AST_FUNCTION,
+    JFM_AST_STRUCT,
+    JFM_AST_IMPL,
+    JFM_AST_BLOCK,
+    JFM_AST_IF,
+    JFM_AST_WHILE,
+    JFM_AST_FOR,
+    JFM_AST_LOOP,
+    JFM_AST_RETURN,
+    JFM_AST_BREAK,
+    JFM_AST_CONTINUE,
+    JFM_AST_LET,
+    JFM_AST_BINARY_OP,
+    JFM_AST_UNARY_OP,
+    JFM_AST_CALL,
+    JFM_AST_FIELD,
+    JFM_AST_INDEX,
+    JFM_AST_LITERAL,
+    JFM_AST_IDENTIFIER,
+    JFM_AST_ASSIGNMENT,
+    JFM_AST_STRUCT_LITERAL,
+    JFM_AST_ARRAY_LITERAL,
+    JFM_AST_INCLUDE,
+    JFM_AST_EXTERN_FUNCTION,
+    JFM_AST_CAST,
+    JFM_AST_CLOSURE,
+    JFM_AST_ASM,
+} JfmAstKind;
+
+typedef void (*JfmAstVisitor)(const JfmAst* child, void* user_data);
+
+typedef struct {
+    bool is_warning;
+    const char* message;
+    const char* file;
+    size_t line;             // 1-based, 0 when unknown
+    size_t column;           // 1-based, 0 when unknown
+} JfmDiagnostic;
+
+// Receives each rendered diagnostic (message plus source snippet) as one
+// complete chunk of text
+typedef void (*JfmDiagnosticSink)(void* user_data, const char* text, size_t length);
+
+// Contexts
+JfmContext* jfm_context_create(void);
+void jfm_context_destroy(JfmContext* ctx);
+void jfm_context_set_sink(JfmContext* ctx, JfmDiagnosticSink sink, void* user_data);
+void jfm_context_set_colors(JfmContext* ctx, bool enabled);
+void jfm_context_set_check_only(JfmContext* ctx, bool check_only);
+
+// Compilation; the result owns everything it hands out
+JfmResult* jfm_compile(JfmContext* ctx, const char* source, size_t length, const char* filename);
+void jfm_result_destroy(JfmResult* result);
+
+bool jfm_result_ok(const JfmResult* result);
+size_t jfm_result_diagnostic_count(const JfmResult* result);
+bool jfm_result_diagnostic(const JfmResult* result, size_t index, JfmDiagnostic* out);
+const JfmAst* jfm_result_ast(const JfmResult* result);
+const char* jfm_result_c_code(const JfmResult* result, size_t* length);
+
+// AST nodes
+JfmAstKind jfm_ast_kind(const JfmAst* node);
+const char* jfm_ast_name(const JfmAst* node);
+const char* jfm_ast_type(const JfmAst* node);
+size_t jfm_ast_line(const JfmAst* node);
+size_t jfm_ast_column(const JfmAst* node);
+void jfm_ast_for_each_child(const JfmAst* node, JfmAstVisitor visitor, void* user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
@@ -32,8 +32,12 @@ int main(int argc, char* argv[]) {
     const char* output_file = NULL;
     bool compile_to_exe = false;
     
-    // Collect linker flags
-    char linker_flags[1024] = "";
+    // Collect linker flags; every argument fits with its " -l" prefix
+    size_t flags_size = 1;
+    for (int i = 2; i < argc; i++) {
+        flags_size += strlen(argv[i]) + 3;
+    }
+    char* linker_flags = calloc(flags_size, 1);
     
     for (int i = 2; i < argc; i++) {
         if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
@@ -52,6 +56,7 @@ int main(int argc, char* argv[]) {
     char* source = read_file(input_file);
     if (!source) {
         fprintf(stderr, "Error: Could not read file '%s'\n", input_file);
+        free(linker_flags);
         return 1;
     }
     
@@ -68,6 +73,7 @@ int main(int argc, char* argv[]) {
     
     if (lexer_error) {
         lexer_destroy(lexer);
+        free(linker_flags);
         free(source);
         return 1;
     }
@@ -79,6 +85,7 @@ int main(int argc, char* argv[]) {
         parser_print_errors(parser);
         parser_destroy(parser);
         lexer_destroy(lexer);
+        free(linker_flags);
         free(source);
         return 1;
     }
@@ -90,14 +97,15 @@ int main(int argc, char* argv[]) {
         ast_destroy(ast);
         parser_destroy(parser);
         lexer_destroy(lexer);
+        free(linker_flags);
         free(source);
         return 1;
     }
     
     // Default behavior: compile to executable
     // Unless -o is specified for C output only
-    char temp_c_file[256];
-    char exe_name[256];
+    char* temp_c_file = NULL;
+    char* exe_name = NULL;
     bool using_temp = false;
     
     if (!output_file && !compile_to_exe) {
@@ -112,14 +120,14 @@ int main(int argc, char* argv[]) {
         else base++;
         
         // Create exe name by removing .jfm extension
-        strncpy(exe_name, base, sizeof(exe_name) - 1);
+        exe_name = string_duplicate(base);
         char* dot = strrchr(exe_name, '.');
         if (dot && strcmp(dot, ".jfm") == 0) {
             *dot = '\0';
         }
         
         // Create temp C file name
-        snprintf(temp_c_file, sizeof(temp_c_file), "%s_temp.c", exe_name);
+        temp_c_file = string_format("%s_temp.c", exe_name);
         output_file = temp_c_file;
     }
     
@@ -132,6 +140,9 @@ int main(int argc, char* argv[]) {
             ast_destroy(ast);
             parser_destroy(parser);
             lexer_destroy(lexer);
+            free(temp_c_file);
+            free(exe_name);
+            free(linker_flags);
             free(source);
             return 1;
         }
@@ -147,16 +158,16 @@ int main(int argc, char* argv[]) {
     
     // Compile to executable if requested
     if (compile_to_exe && output_file) {
-        char gcc_cmd[512];
         if (!using_temp) {
             // User specified output file, create exe with same base name
-            strncpy(exe_name, output_file, sizeof(exe_name) - 1);
+            exe_name = string_duplicate(output_file);
             char* dot = strrchr(exe_name, '.');
             if (dot) *dot = '\0';
         }
         
-        snprintf(gcc_cmd, sizeof(gcc_cmd), "gcc -o %s.exe %s -lm%s", exe_name, output_file, linker_flags);
+        char* gcc_cmd = string_format("gcc -o %s.exe %s -lm%s", exe_name, output_file, linker_flags);
         int result = system(gcc_cmd);
+        free(gcc_cmd);
         
         // Clean up temp file if we created one
         if (using_temp) {
@@ -169,6 +180,9 @@ int main(int argc, char* argv[]) {
             ast_destroy(ast);
             parser_destroy(parser);
             lexer_destroy(lexer);
+            free(temp_c_file);
+            free(exe_name);
+            free(linker_flags);
             free(source);
             return 1;
         }
@@ -178,6 +192,9 @@ int main(int argc, char* argv[]) {
     ast_destroy(ast);
     parser_destroy(parser);
     lexer_destroy(lexer);
+    free(temp_c_file);
+    free(exe_name);
+    free(linker_flags);
     free(source);
     
     return 0;
@@ -161,6 +161,8 @@ static void synchronize(Parser* parser) {
             case TOKEN_RETURN:
             case TOKEN_BREAK:
             case TOKEN_CONTINUE:
+            case TOKEN_ASM:
+            case TOKEN_PUB:
             case TOKEN_STRUCT:
             case TOKEN_IMPL:
                 return;
@@ -176,6 +178,75 @@ static AstNode* expression(Parser* parser);
 static AstNode* statement(Parser* parser);
 static AstNode* declaration(Parser* parser);
 static Type* parse_type(Parser* parser);
+static AstNode* block_statement(Parser* parser);
+
+/**
+ * Parses a closure after its opening '|' or '||'. Parameters are typed as
+ * in a function declaration. A body in braces is a void closure unless a
+ * return type is given; any other body is a single expression whose value
+ * is returned.
+ * 
+ * @param parser The parser instance
+ * @param start The '|' or '||' token that opened the closure
+ * @return AST node for the closure
+ */
+static AstNode* closure_expression(Parser* parser, Token* start) {
+    AstNode* node = create_node_with_location(parser, AST_CLOSURE, start);
+    
+    size_t param_capacity = 4;
+    node->data.closure.params = malloc(sizeof(Param) * param_capacity);
+    node->data.closure.param_count = 0;
+    
+    if (start->type == TOKEN_OR && !match(parser, TOKEN_OR)) {
+        do {
+            if (node->data.closure.param_count >= param_capacity) {
+                param_capacity *= 2;
+                node->data.closure.params = realloc(node->data.closure.params, sizeof(Param) * param_capacity);
+            }
+            
+            Param* param = &node->data.closure.params[node->data.closure.param_count++];
+            param->name = NULL;
+            param->type = NULL;
+            
+            Token* param_name = consume(parser, TOKEN_IDENTIFIER, "Expected closure parameter name");
+            if (param_name) {
+                param->name = string_n_duplicate(param_name->start, param_name->length);
+            }
+            
+            consume(parser, TOKEN_COLON, "Expected ':' after closure parameter name");
+            param->type = parse_type(parser);
+        } while (match(parser, TOKEN_COMMA));
+        
+        consume(parser, TOKEN_OR, "Expected '|' after closure parameters");
+    }
+    
+    if (match(parser, TOKEN_ARROW)) {
+        node->data.closure.return_type = parse_type(parser);
+        consume(parser, TOKEN_LBRACE, "Expected '{' before closure body");
+        node->data.closure.body = block_statement(parser);
+        return node;
+    }
+    
+    if (match(parser, TOKEN_LBRACE)) {
+        node->data.closure.return_type = type_create(TYPE_VOID);
+        node->data.closure.body = block_statement(parser);
+        return node;
+    }
+    
+    // The expression body becomes { return expr; }; its type is inferred
+    AstNode* value = expression(parser);
+    AstNode* ret = create_node_with_location(parser, AST_RETURN, start);
+    ret->data.return_stmt.value = value;
+    
+    AstNode* body = create_node_with_location(parser, AST_BLOCK, start);
+    body->data.block.statements = malloc(sizeof(AstNode*));
+    body->data.block.statements[0] = ret;
+    body->data.block.statement_count = 1;
+    
+    node->data.closure.body = body;
+    node->data.closure.expression_body = true;
+    return node;
+}
 
 static AstNode* primary(Parser* parser) {
     if (peek(parser)->type == TOKEN_ERROR) {
@@ -204,6 +275,7 @@ static AstNode* primary(Parser* parser) {
         Token* lit_token = previous(parser);
         AstNode* node = create_node_with_location(parser, AST_LITERAL, lit_token);
         node->data.literal.int_value = lit_token->value.int_value;
+        node->data.literal.int_high = lit_token->value.int_high;
         node->data_type = type_create(TYPE_I32);
         return node;
     }
@@ -297,16 +369,32 @@ static AstNode* primary(Parser* parser) {
         size_t capacity = 8;
         node->data.array_literal.elements = malloc(sizeof(AstNode*) * capacity);
         node->data.array_literal.element_count = 0;
+        node->data.array_literal.repeat = 0;
+        
+        // [value; N] repeats one value, like the array type [T; N]
+        bool more = !check(parser, TOKEN_RBRACKET);
+        if (more) {
+            node->data.array_literal.elements[node->data.array_literal.element_count++] = expression(parser);
+            if (match(parser, TOKEN_SEMICOLON)) {
+                Token* count_token = consume(parser, TOKEN_INT_LITERAL, "Expected repeat count");
+                if (count_token && count_token->value.int_value == 0) {
+                    error_at(parser, count_token, "Repeat count must be at least 1");
+                }
+                consume(parser, TOKEN_RBRACKET, "Expected ']' after repeat count");
+                node->data.array_literal.repeat = count_token ? count_token->value.int_value : 0;
+                return node;
+            }
+            more = match(parser, TOKEN_COMMA);
+        }
         
-        while (!check(parser, TOKEN_RBRACKET) && !is_at_end(parser)) {
+        while (more && !check(parser, TOKEN_RBRACKET) && !is_at_end(parser)) {
             if (node->data.array_literal.element_count >= capacity) {
                 capacity *= 2;
                 node->data.array_literal.elements = realloc(node->data.array_literal.elements, sizeof(AstNode*) * capacity);
             }
             
             node->data.array_literal.elements[node->data.array_literal.element_count++] = expression(parser);
-            
-            if (!match(parser, TOKEN_COMMA)) break;
+            more = match(parser, TOKEN_COMMA);
         }
         
         consume(parser, TOKEN_RBRACKET, "Expected ']' after array elements");
@@ -319,13 +407,17 @@ static AstNode* primary(Parser* parser) {
         return expr;
     }
     
+    if (match(parser, TOKEN_OR) || match(parser, TOKEN_OR_OR)) {
+        return closure_expression(parser, previous(parser));
+    }
+    
     error_at_current(parser, "Expected expression");
     return NULL;
 }
 
 /**
  * Parses postfix expressions (function calls, field access, array indexing).
- * Includes loop guard to prevent infinite loops in deeply nested expressions.
+ * Every iteration consumes a postfix operator, so chains of any length end.
  * 
  * @param parser The parser instance
  * @return AST node for the call/postfix expression
@@ -333,15 +425,7 @@ static AstNode* primary(Parser* parser) {
 static AstNode* call(Parser* parser) {
     AstNode* expr = primary(parser);
     
-    int iteration_count = 0;
-    const int MAX_CHAIN_DEPTH = 100;
-    
     while (true) {
-        if (++iteration_count > MAX_CHAIN_DEPTH) {
-            error_at_current(parser, "Expression chain too deep (possible infinite loop)");
-            break;
-        }
-        
         if (match(parser, TOKEN_LPAREN)) {
             Token* lparen = previous(parser);
             AstNode* node = create_node_with_location(parser, AST_CALL, lparen);
@@ -379,6 +463,12 @@ static AstNode* call(Parser* parser) {
                 node->data.field.field_name = string_n_duplicate(field->start, field->length);
             }
             expr = node;
+        } else if (match(parser, TOKEN_QUESTION)) {
+            // expr? returns early with the None or Err it holds
+            AstNode* node = create_node_with_location(parser, AST_UNARY_OP, previous(parser));
+            node->data.unary.op = TOKEN_QUESTION;
+            node->data.unary.operand = expr;
+            expr = node;
         } else if (match(parser, TOKEN_DOUBLE_COLON)) {
             Token* method = consume(parser, TOKEN_IDENTIFIER, "Expected method name after '::'");
             if (method) {
@@ -387,8 +477,7 @@ static AstNode* call(Parser* parser) {
                 char* full_name = malloc(len);
                 snprintf(full_name, len, "%s::%.*s", expr->data.identifier.name, (int)method->length, method->start);
                 node->data.identifier.name = full_name;
-                free(expr->data.identifier.name);
-                free(expr);
+                ast_destroy(expr);
                 expr = node;
             }
         } else {
@@ -702,12 +791,57 @@ static AstNode* expression(Parser* parser) {
 }
 
 /**
- * Parses type annotations including primitives, pointers, references, arrays, and structs.
+ * Consumes the '>' closing a type argument list. The '>>' closing two
+ * nested lists, as in Option<Option<i32>>, is split so the outer list
+ * still finds its '>'.
+ * 
+ * @param parser The parser instance
+ */
+static void consume_closing_angle(Parser* parser) {
+    if (check(parser, TOKEN_GT_GT)) {
+        Token* token = peek(parser);
+        token->type = TOKEN_GT;
+        token->start++;
+        token->length--;
+        token->column++;
+        return;
+    }
+    consume(parser, TOKEN_GT, "Expected '>' after type arguments");
+}
+
+/**
+ * Parses type annotations including primitives, pointers, references, arrays,
+ * function types such as fn(i32, i32) -> bool, Option<T>, Result<T, E> and
+ * structs.
  * 
  * @param parser The parser instance
  * @return Type structure representing the parsed type
  */
 static Type* parse_type(Parser* parser) {
+    if (match(parser, TOKEN_FN)) {
+        consume(parser, TOKEN_LPAREN, "Expected '(' after 'fn' in function type");
+        
+        Type* fn_type = type_create(TYPE_FUNCTION);
+        size_t capacity = 4;
+        fn_type->data.function.param_types = malloc(sizeof(Type*) * capacity);
+        fn_type->data.function.param_count = 0;
+        
+        if (!check(parser, TOKEN_RPAREN)) {
+            do {
+                if (fn_type->data.function.param_count >= capacity) {
+                    capacity *= 2;
+                    fn_type->data.function.param_types = realloc(fn_type->data.function.param_types,
+                                                                 sizeof(Type*) * capacity);
+                }
+                fn_type->data.function.param_types[fn_type->data.function.param_count++] = parse_type(parser);
+            } while (match(parser, TOKEN_COMMA));
+        }
+        
+        consume(parser, TOKEN_RPAREN, "Expected ')' after function type parameters");
+        fn_type->data.function.return_type = match(parser, TOKEN_ARROW) ? parse_type(parser) : NULL;
+        return fn_type;
+    }
+    
     if (match(parser, TOKEN_AND)) {
         bool is_mut = match(parser, TOKEN_MUT);
         Type* ref_type = type_create(TYPE_REFERENCE);
@@ -723,18 +857,9 @@ static Type* parse_type(Parser* parser) {
     }
     
     if (match(parser, TOKEN_LBRACKET)) {
-        Type* elem_type = NULL;
-
-        Token* type_token = peek(parser);
-        elem_type = type_from_token(type_token->type);
-        if (elem_type) {
-            advance(parser);
-        } else if (check(parser, TOKEN_IDENTIFIER)) {
-            advance(parser);
-            elem_type = type_create(TYPE_STRUCT);
-            elem_type->data.struct_type.name = string_n_duplicate(previous(parser)->start, previous(parser)->length);
-        } else {
-            error_at_current(parser, "Expected element type in array");
+        // Any type may be an element type, so [[f32; 4]; 4] is a 4x4 matrix
+        Type* elem_type = parse_type(parser);
+        if (!elem_type) {
             return NULL;
         }
         
@@ -756,8 +881,26 @@ static Type* parse_type(Parser* parser) {
     }
     
     if (match(parser, TOKEN_IDENTIFIER)) {
+        Token* name = previous(parser);
+        if (check(parser, TOKEN_LT) && name->length == 6 && memcmp(name->start, "Option", 6) == 0) {
+            advance(parser);
+            Type* option_type = type_create(TYPE_OPTION);
+            option_type->data.option.value_type = parse_type(parser);
+            consume_closing_angle(parser);
+            return option_type;
+        }
+        if (check(parser, TOKEN_LT) && name->length == 6 && memcmp(name->start, "Result", 6) == 0) {
+            advance(parser);
+            Type* result_type = type_create(TYPE_RESULT);
+            result_type->data.result.ok_type = parse_type(parser);
+            consume(parser, TOKEN_COMMA, "Expected ',' between Result<T, E> type arguments");
+            result_type->data.result.err_type = parse_type(parser);
+            consume_closing_angle(parser);
+            return result_type;
+        }
+        
         Type* struct_type = type_create(TYPE_STRUCT);
-        struct_type->data.struct_type.name = string_n_duplicate(previous(parser)->start, previous(parser)->length);
+        struct_type->data.struct_type.name = string_n_duplicate(name->start, name->length);
         return struct_type;
     }
     
@@ -765,10 +908,66 @@ static Type* parse_type(Parser* parser) {
     return NULL;
 }
 
+/**
+ * Parses zero or more attributes such as #[repr(C)] or #[align(64), packed].
+ * Attribute arguments are single tokens (identifiers, numbers or type names)
+ * and are stored as written; their meaning is checked by semantic analysis.
+ * 
+ * @param parser The parser instance
+ * @param count Output: number of attributes parsed
+ * @return Array of attributes, or NULL if there were none
+ */
+static Attribute* parse_attributes(Parser* parser, size_t* count) {
+    Attribute* attributes = NULL;
+    size_t capacity = 0;
+    *count = 0;
+    
+    while (match(parser, TOKEN_HASH)) {
+        Token* hash = previous(parser);
+        if (!consume(parser, TOKEN_LBRACKET, "Expected '[' after '#'")) break;
+        
+        do {
+            Token* name = consume(parser, TOKEN_IDENTIFIER, "Expected attribute name");
+            if (!name) break;
+            
+            if (*count >= capacity) {
+                capacity = capacity ? capacity * 2 : 4;
+                attributes = realloc(attributes, sizeof(Attribute) * capacity);
+            }
+            
+            Attribute* attr = &attributes[(*count)++];
+            attr->name = string_n_duplicate(name->start, name->length);
+            attr->args = NULL;
+            attr->arg_count = 0;
+            attr->line = hash->line;
+            attr->column = hash->column;
+            attr->ignored = false;
+            
+            if (match(parser, TOKEN_LPAREN)) {
+                size_t arg_capacity = 0;
+                while (!check(parser, TOKEN_RPAREN) && !is_at_end(parser)) {
+                    Token* arg = advance(parser);
+                    if (attr->arg_count >= arg_capacity) {
+                        arg_capacity = arg_capacity ? arg_capacity * 2 : 4;
+                        attr->args = realloc(attr->args, sizeof(char*) * arg_capacity);
+                    }
+                    attr->args[attr->arg_count++] = string_n_duplicate(arg->start, arg->length);
+                    if (!match(parser, TOKEN_COMMA)) break;
+                }
+                consume(parser, TOKEN_RPAREN, "Expected ')' after attribute arguments");
+            }
+        } while (match(parser, TOKEN_COMMA));
+        
+        consume(parser, TOKEN_RBRACKET, "Expected ']' after attribute");
+    }
+    
+    return attributes;
+}
+
 /**
  * Parses a block statement ({ ... }).
  * Handles both statements and optional final expression without semicolon.
- * Includes loop guard to prevent infinite loops.
+ * A token that cannot start a statement is skipped so the loop always advances.
  * 
  * @param parser The parser instance
  * @return AST node for the block statement
@@ -781,15 +980,8 @@ static AstNode* block_statement(Parser* parser) {
     node->data.block.statement_count = 0;
     node->data.block.final_expr = NULL;
     
-    int loop_guard = 0;
-    const int MAX_STATEMENTS = 10000;
-    
     while (!check(parser, TOKEN_RBRACE) && !is_at_end(parser)) {
-        if (++loop_guard > MAX_STATEMENTS) {
-            error_at_current(parser, "Block too large or parser stuck in loop");
-            break;
-        }
-        
+        size_t start = parser->current;
         
         if (node->data.block.statement_count >= capacity) {
             capacity *= 2;
@@ -797,7 +989,8 @@ static AstNode* block_statement(Parser* parser) {
         }
         
         AstNode* stmt = NULL;
-        if (check(parser, TOKEN_LET) || check(parser, TOKEN_FN) || check(parser, TOKEN_STRUCT)) {
+        if (check(parser, TOKEN_LET) || check(parser, TOKEN_FN) || check(parser, TOKEN_STRUCT) ||
+            check(parser, TOKEN_HASH)) {
             stmt = declaration(parser);
             if (stmt) {
                 node->data.block.statements[node->data.block.statement_count++] = stmt;
@@ -805,7 +998,8 @@ static AstNode* block_statement(Parser* parser) {
         } else if (check(parser, TOKEN_IF) || check(parser, TOKEN_WHILE) || 
                    check(parser, TOKEN_FOR) || check(parser, TOKEN_LOOP) ||
                    check(parser, TOKEN_RETURN) || check(parser, TOKEN_BREAK) || 
-                   check(parser, TOKEN_CONTINUE) || check(parser, TOKEN_LBRACE)) {
+                   check(parser, TOKEN_CONTINUE) || check(parser, TOKEN_LBRACE) ||
+                   check(parser, TOKEN_ASM)) {
             stmt = statement(parser);
             if (stmt) {
                 node->data.block.statements[node->data.block.statement_count++] = stmt;
@@ -824,6 +1018,8 @@ static AstNode* block_statement(Parser* parser) {
                 error_at_current(parser, "Expected ';' or '}' after expression");
             }
         }
+        
+        if (parser->current == start) advance(parser);
     }
     
     consume(parser, TOKEN_RBRACE, "Expected '}' after block");
@@ -878,17 +1074,174 @@ static AstNode* while_statement(Parser* parser) {
 }
 
 /**
- * Parses a for loop statement with range syntax (for i in 0..10).
+ * Parses one binding of a for loop pattern: a name, or &mut name to bind
+ * an array element in place.
+ * 
+ * @param parser The parser instance
+ * @param is_mut Output: whether the binding was written &mut name
+ * @return The bound name, or NULL on error
+ */
+static char* parse_loop_binding(Parser* parser, bool* is_mut) {
+    *is_mut = false;
+    if (match(parser, TOKEN_AND)) {
+        consume(parser, TOKEN_MUT, "Expected 'mut' after '&' in loop binding");
+        *is_mut = true;
+    }
+    
+    Token* name = consume(parser, TOKEN_IDENTIFIER, "Expected iterator name");
+    return name ? string_n_duplicate(name->start, name->length) : NULL;
+}
+
+/**
+ * Looks ahead from an opening parenthesis to decide whether it encloses a
+ * range, as in (0..n).rev(), rather than starting an expression.
+ * 
+ * @param parser The parser instance, positioned at '('
+ * @return true if '..' or '..=' appears directly inside the parentheses
+ */
+static bool range_in_parentheses(Parser* parser) {
+    int depth = 0;
+    for (size_t i = parser->current; i < parser->token_count; i++) {
+        TokenType type = parser->tokens[i].type;
+        if (type == TOKEN_LPAREN || type == TOKEN_LBRACKET) {
+            depth++;
+        } else if (type == TOKEN_RPAREN || type == TOKEN_RBRACKET) {
+            if (--depth == 0) return false;
+        } else if ((type == TOKEN_DOT_DOT || type == TOKEN_DOT_DOT_EQ) && depth == 1) {
+            return true;
+        } else if (type == TOKEN_LBRACE || type == TOKEN_SEMICOLON || type == TOKEN_EOF) {
+            return false;
+        }
+    }
+    return false;
+}
+
+/**
+ * Parses a range start..end or start..=end into a for loop node.
+ * 
+ * @param parser The parser instance
+ * @param node The for loop AST node
+ */
+static void parse_range(Parser* parser, AstNode* node) {
+    node->data.for_loop.start = expression(parser);
+    if (match(parser, TOKEN_DOT_DOT_EQ)) {
+        node->data.for_loop.inclusive = true;
+    } else {
+        consume(parser, TOKEN_DOT_DOT, "Expected '..' in for range");
+    }
+    node->data.for_loop.end = expression(parser);
+}
+
+/**
+ * Parses the adapters of a parenthesised range: .rev() and .step_by(k).
+ * A stepped range can only be reversed before the step is applied.
+ * 
+ * @param parser The parser instance
+ * @param node The for loop AST node
+ */
+static void parse_range_adapters(Parser* parser, AstNode* node) {
+    while (match(parser, TOKEN_DOT)) {
+        Token* name = consume(parser, TOKEN_IDENTIFIER, "Expected 'rev' or 'step_by' after '.'");
+        if (!name) return;
+        consume(parser, TOKEN_LPAREN, "Expected '(' after range adapter");
+        
+        if (name->length == 3 && strncmp(name->start, "rev", 3) == 0) {
+            if (node->data.for_loop.step) {
+                error_at(parser, name, "Call .rev() before .step_by()");
+            }
+            node->data.for_loop.reverse = true;
+        } else if (name->length == 7 && strncmp(name->start, "step_by", 7) == 0) {
+            if (node->data.for_loop.step) {
+                error_at(parser, name, "Range already has a step");
+            }
+            node->data.for_loop.step = expression(parser);
+        } else {
+            error_at(parser, name, "Unknown range adapter; expected 'rev' or 'step_by'");
+        }
+        
+        consume(parser, TOKEN_RPAREN, "Expected ')' after range adapter");
+    }
+}
+
+/**
+ * Checks whether an expression is a call of an iterator adapter, i.e. a
+ * method-style call arr.name(...) with the given name.
+ * 
+ * @param expr The expression to check
+ * @param name The adapter name
+ * @return true if expr is such a call
+ */
+static bool is_adapter_call(AstNode* expr, const char* name) {
+    // The field name is NULL when the parser recovered from a missing one (a.())
+    return expr->type == AST_CALL && expr->data.call.function->type == AST_FIELD &&
+           expr->data.call.function->data.field.field_name &&
+           strcmp(expr->data.call.function->data.field.field_name, name) == 0;
+}
+
+/**
+ * Takes apart the array a for loop iterates over. Accepted forms are arr,
+ * arr.enumerate() and a.zip(b), each optionally followed by .rev(); the
+ * adapter calls are removed from the tree and recorded on the loop.
+ * 
+ * @param parser The parser instance
+ * @param node The for loop AST node
+ * @param source The expression after 'in'
+ * @return true if the array was enumerated
+ */
+static bool parse_array_adapters(Parser* parser, AstNode* node, AstNode* source) {
+    bool enumerated = false;
+    if (source && is_adapter_call(source, "rev") && source->data.call.argument_count == 0) {
+        node->data.for_loop.reverse = true;
+        AstNode* call = source;
+        source = call->data.call.function->data.field.object;
+        ast_destroy(call->data.call.function);
+        ast_destroy(call);
+    }
+    
+    if (source && is_adapter_call(source, "enumerate") && source->data.call.argument_count == 0) {
+        enumerated = true;
+        AstNode* call = source;
+        source = call->data.call.function->data.field.object;
+        ast_destroy(call->data.call.function);
+        ast_destroy(call);
+    } else if (source && is_adapter_call(source, "zip") && source->data.call.argument_count == 1) {
+        node->data.for_loop.zip_with = source->data.call.arguments[0];
+        AstNode* call = source;
+        source = call->data.call.function->data.field.object;
+        ast_destroy(call->data.call.function);
+        ast_destroy(call);
+    }
+    
+    if (source && (is_adapter_call(source, "rev") || is_adapter_call(source, "enumerate") ||
+                   is_adapter_call(source, "zip"))) {
+        error_at(parser, previous(parser), "Unsupported iterator chain; use arr.enumerate().rev() or a.zip(b).rev()");
+    }
+    
+    node->data.for_loop.iterable = source;
+    return enumerated;
+}
+
+/**
+ * Parses a for loop statement: a range (for i in 0..10, 0..=10,
+ * (0..10).rev().step_by(2)) or an array (for x in arr, for &mut x in arr,
+ * for (i, x) in arr.enumerate(), for (x, y) in a.zip(b)).
  * 
  * @param parser The parser instance
  * @return AST node for the for statement
  */
 static AstNode* for_statement(Parser* parser) {
-    AstNode* node = ast_create_node(AST_FOR);
-    
-    Token* iter = consume(parser, TOKEN_IDENTIFIER, "Expected iterator name");
-    if (iter) {
-        node->data.for_loop.iterator = string_n_duplicate(iter->start, iter->length);
+    AstNode* node = create_node_with_location(parser, AST_FOR, previous(parser));
+    
+    // Pattern: x, &mut x, or a pair (i, x) / (x, y) for enumerate() and zip()
+    char* second_name = NULL;
+    bool second_mut = false;
+    bool enumerated = false;
+    bool pair = match(parser, TOKEN_LPAREN);
+    node->data.for_loop.iterator = parse_loop_binding(parser, &node->data.for_loop.iterator_mut);
+    if (pair) {
+        consume(parser, TOKEN_COMMA, "Expected ',' between loop bindings");
+        second_name = parse_loop_binding(parser, &second_mut);
+        consume(parser, TOKEN_RPAREN, "Expected ')' after loop bindings");
     }
     
     if (match(parser, TOKEN_COLON)) {
@@ -897,9 +1250,42 @@ static AstNode* for_statement(Parser* parser) {
     
     consume(parser, TOKEN_IN, "Expected 'in' in for loop");
     
-    node->data.for_loop.start = expression(parser);
-    consume(parser, TOKEN_DOT_DOT, "Expected '..' in for range");
-    node->data.for_loop.end = expression(parser);
+    if (check(parser, TOKEN_LPAREN) && range_in_parentheses(parser)) {
+        advance(parser);
+        parse_range(parser, node);
+        consume(parser, TOKEN_RPAREN, "Expected ')' after range");
+        parse_range_adapters(parser, node);
+    } else {
+        AstNode* source = expression(parser);
+        if (check(parser, TOKEN_DOT_DOT) || check(parser, TOKEN_DOT_DOT_EQ)) {
+            node->data.for_loop.start = source;
+            node->data.for_loop.inclusive = advance(parser)->type == TOKEN_DOT_DOT_EQ;
+            node->data.for_loop.end = expression(parser);
+        } else {
+            enumerated = parse_array_adapters(parser, node, source);
+        }
+    }
+    
+    if (enumerated || node->data.for_loop.zip_with) {
+        if (!pair) {
+            error_at(parser, previous(parser), "Expected a pair of bindings, e.g. 'for (i, x) in ...'");
+        } else if (enumerated) {
+            // (i, x) in arr.enumerate(): the index comes first
+            if (node->data.for_loop.iterator_mut) {
+                error_at(parser, previous(parser), "The index of enumerate() cannot be bound with '&mut'");
+            }
+            node->data.for_loop.index_name = node->data.for_loop.iterator;
+            node->data.for_loop.iterator = second_name;
+            node->data.for_loop.iterator_mut = second_mut;
+        } else {
+            node->data.for_loop.zip_name = second_name;
+            node->data.for_loop.zip_mut = second_mut;
+        }
+    } else if (pair) {
+        error_at(parser, previous(parser), "A pair of bindings needs enumerate() or zip()");
+    } else if (node->data.for_loop.iterator_mut && !node->data.for_loop.iterable) {
+        error_at(parser, previous(parser), "Only array elements can be bound with '&mut'");
+    }
     
     consume(parser, TOKEN_LBRACE, "Expected '{' after for header");
     node->data.for_loop.body = block_statement(parser);
@@ -1015,6 +1401,119 @@ static AstNode* expression_statement(Parser* parser) {
     return expr;
 }
 
+/**
+ * Parses one operand list of an asm! statement: comma-separated operands
+ * of the form [name] "constraint" (expression), the name being optional.
+ * 
+ * @param parser The parser instance
+ * @param node The AST_ASM node the operands are appended to
+ * @param capacity Capacity of the operand arrays, updated as they grow
+ */
+static void asm_operands(Parser* parser, AstNode* node, size_t* capacity) {
+    if (!check(parser, TOKEN_STRING_LITERAL) && !check(parser, TOKEN_LBRACKET)) return;
+    
+    do {
+        if (node->data.asm_stmt.operand_count >= *capacity) {
+            *capacity *= 2;
+            node->data.asm_stmt.operands = realloc(node->data.asm_stmt.operands, sizeof(AstNode*) * *capacity);
+            node->data.asm_stmt.constraints = realloc(node->data.asm_stmt.constraints, sizeof(char*) * *capacity);
+            node->data.asm_stmt.names = realloc(node->data.asm_stmt.names, sizeof(char*) * *capacity);
+        }
+        size_t index = node->data.asm_stmt.operand_count++;
+        node->data.asm_stmt.names[index] = NULL;
+        node->data.asm_stmt.constraints[index] = NULL;
+        node->data.asm_stmt.operands[index] = NULL;
+        
+        if (match(parser, TOKEN_LBRACKET)) {
+            Token* name = consume(parser, TOKEN_IDENTIFIER, "Expected operand name after '['");
+            if (name) {
+                node->data.asm_stmt.names[index] = string_n_duplicate(name->start, name->length);
+            }
+            consume(parser, TOKEN_RBRACKET, "Expected ']' after operand name");
+        }
+        
+        Token* constraint = consume(parser, TOKEN_STRING_LITERAL, "Expected constraint string for asm operand");
+        if (constraint) {
+            node->data.asm_stmt.constraints[index] = string_n_duplicate(constraint->start + 1, constraint->length - 2);
+        }
+        consume(parser, TOKEN_LPAREN, "Expected '(' after asm constraint");
+        node->data.asm_stmt.operands[index] = expression(parser);
+        consume(parser, TOKEN_RPAREN, "Expected ')' after asm operand");
+    } while (match(parser, TOKEN_COMMA));
+}
+
+/**
+ * Parses an inline assembly statement in GCC extended-asm form:
+ * asm!("template" : outputs : inputs : clobbers); with every section
+ * optional. Adjacent template strings are concatenated as in C.
+ * 
+ * @param parser The parser instance
+ * @return AST node for the asm statement
+ */
+static AstNode* asm_statement(Parser* parser) {
+    AstNode* node = create_node_with_location(parser, AST_ASM, previous(parser));
+    consume(parser, TOKEN_NOT, "Expected '!' after 'asm'");
+    consume(parser, TOKEN_LPAREN, "Expected '(' after 'asm!'");
+    
+    size_t template_capacity = 4;
+    node->data.asm_stmt.template_parts = malloc(sizeof(char*) * template_capacity);
+    do {
+        Token* part = consume(parser, TOKEN_STRING_LITERAL, "Expected assembly template string");
+        if (!part) break;
+        if (node->data.asm_stmt.template_count >= template_capacity) {
+            template_capacity *= 2;
+            node->data.asm_stmt.template_parts = realloc(node->data.asm_stmt.template_parts,
+                                                         sizeof(char*) * template_capacity);
+        }
+        node->data.asm_stmt.template_parts[node->data.asm_stmt.template_count++] =
+            string_n_duplicate(part->start + 1, part->length - 2);
+    } while (check(parser, TOKEN_STRING_LITERAL));
+    
+    size_t capacity = 4;
+    node->data.asm_stmt.operands = malloc(sizeof(AstNode*) * capacity);
+    node->data.asm_stmt.constraints = malloc(sizeof(char*) * capacity);
+    node->data.asm_stmt.names = malloc(sizeof(char*) * capacity);
+    size_t clobber_capacity = 4;
+    node->data.asm_stmt.clobbers = malloc(sizeof(char*) * clobber_capacity);
+    
+    // "::" skips the outputs, as in C
+    int section = 0;
+    while (check(parser, TOKEN_COLON) || check(parser, TOKEN_DOUBLE_COLON)) {
+        if (match(parser, TOKEN_DOUBLE_COLON)) {
+            section += 2;
+        } else {
+            advance(parser);
+            section++;
+        }
+        if (section > 3) {
+            error_at_current(parser, "asm! takes at most outputs, inputs and clobbers");
+        }
+        
+        if (section == 1) {
+            asm_operands(parser, node, &capacity);
+            node->data.asm_stmt.output_count = node->data.asm_stmt.operand_count;
+        } else if (section == 2) {
+            asm_operands(parser, node, &capacity);
+        } else if (check(parser, TOKEN_STRING_LITERAL)) {
+            do {
+                Token* clobber = consume(parser, TOKEN_STRING_LITERAL, "Expected clobber string");
+                if (!clobber) break;
+                if (node->data.asm_stmt.clobber_count >= clobber_capacity) {
+                    clobber_capacity *= 2;
+                    node->data.asm_stmt.clobbers = realloc(node->data.asm_stmt.clobbers,
+                                                           sizeof(char*) * clobber_capacity);
+                }
+                node->data.asm_stmt.clobbers[node->data.asm_stmt.clobber_count++] =
+                    string_n_duplicate(clobber->start + 1, clobber->length - 2);
+            } while (match(parser, TOKEN_COMMA));
+        }
+    }
+    
+    consume(parser, TOKEN_RPAREN, "Expected ')' after asm! operands");
+    consume(parser, TOKEN_SEMICOLON, "Expected ';' after asm! statement");
+    return node;
+}
+
 /**
  * Dispatches to the appropriate statement parser based on current token.
  * 
@@ -1030,6 +1529,7 @@ static AstNode* statement(Parser* parser) {
     if (match(parser, TOKEN_BREAK)) return break_statement(parser);
     if (match(parser, TOKEN_CONTINUE)) return continue_statement(parser);
     if (match(parser, TOKEN_LBRACE)) return block_statement(parser);
+    if (match(parser, TOKEN_ASM)) return asm_statement(parser);
     
     return expression_statement(parser);
 }
@@ -1089,7 +1589,6 @@ static AstNode* function_declaration(Parser* parser) {
 
 /**
  * Parses a struct declaration with fields.
- * Includes loop guard to prevent infinite loops.
  * 
  * @param parser The parser instance
  * @return AST node for the struct declaration
@@ -1109,21 +1608,14 @@ static AstNode* struct_declaration(Parser* parser) {
     node->data.struct_def.fields = malloc(sizeof(Field) * field_capacity);
     node->data.struct_def.field_count = 0;
     
-    int loop_guard = 0;
-    const int MAX_FIELDS = 1000;
-    
     while (!check(parser, TOKEN_RBRACE) && !is_at_end(parser)) {
-        if (++loop_guard > MAX_FIELDS) {
-            error_at_current(parser, "Too many struct fields or parser stuck in loop");
-            break;
-        }
-        
         if (node->data.struct_def.field_count >= field_capacity) {
             field_capacity *= 2;
             node->data.struct_def.fields = realloc(node->data.struct_def.fields, sizeof(Field) * field_capacity);
         }
         
         Field* field = &node->data.struct_def.fields[node->data.struct_def.field_count++];
+        field->attributes = parse_attributes(parser, &field->attribute_count);
         
         Token* field_name = consume(parser, TOKEN_IDENTIFIER, "Expected field name");
         if (field_name) {
@@ -1144,9 +1636,50 @@ static AstNode* struct_declaration(Parser* parser) {
     return node;
 }
 
+/**
+ * Marks a function or struct as exported from library builds. The node
+ * takes the location of the 'pub' keyword, which diagnostics about its
+ * C signature point at.
+ * 
+ * @param node The function or struct AST node
+ * @param pub The 'pub' token
+ */
+static void mark_public(AstNode* node, Token* pub) {
+    if (node->type == AST_FUNCTION) {
+        node->data.function.is_pub = true;
+    } else {
+        node->data.struct_def.is_pub = true;
+    }
+    node->location.line = pub->line;
+    node->location.column = pub->column;
+}
+
+/**
+ * Parses the item after 'pub', which must be a function or a struct.
+ * 
+ * @param parser The parser instance
+ * @return AST node for the item, or NULL on error
+ */
+static AstNode* public_declaration(Parser* parser) {
+    Token* pub = previous(parser);
+    AstNode* node = NULL;
+    
+    if (match(parser, TOKEN_FN)) {
+        node = function_declaration(parser);
+    } else if (match(parser, TOKEN_STRUCT)) {
+        node = struct_declaration(parser);
+    } else {
+        error_at_current(parser, "Expected 'fn' or 'struct' after 'pub'");
+        return NULL;
+    }
+    
+    mark_public(node, pub);
+    return node;
+}
+
 /**
  * Parses an impl block for struct methods.
- * Includes loop guard and progress tracking to prevent infinite loops.
+ * Includes progress tracking to prevent infinite loops.
  * 
  * @param parser The parser instance
  * @return AST node for the impl block
@@ -1166,31 +1699,26 @@ static AstNode* impl_block(Parser* parser) {
     node->data.impl_block.functions = malloc(sizeof(AstNode*) * fn_capacity);
     node->data.impl_block.function_count = 0;
     
-    int loop_guard = 0;
-    const int MAX_IMPL_FUNCTIONS = 500;
     size_t prev_position = (size_t)-1;
     
-    
     while (!check(parser, TOKEN_RBRACE) && !is_at_end(parser)) {
-        if (++loop_guard > MAX_IMPL_FUNCTIONS) {
-            error_at_current(parser, "Too many functions in impl block or parser stuck in loop");
-            break;
-        }
-
         if (prev_position != (size_t)-1 && parser->current == prev_position) {
             error_at_current(parser, "Parser stuck in impl block parsing");
             advance(parser);
-            if (loop_guard > 10) break;
+            continue;
         }
         prev_position = parser->current;
         
+        Token* pub = match(parser, TOKEN_PUB) ? previous(parser) : NULL;
         if (match(parser, TOKEN_FN)) {
             if (node->data.impl_block.function_count >= fn_capacity) {
                 fn_capacity *= 2;
                 node->data.impl_block.functions = realloc(node->data.impl_block.functions, sizeof(AstNode*) * fn_capacity);
             }
             
-            node->data.impl_block.functions[node->data.impl_block.function_count++] = function_declaration(parser);
+            AstNode* method = function_declaration(parser);
+            if (pub) mark_public(method, pub);
+            node->data.impl_block.functions[node->data.impl_block.function_count++] = method;
         } else {
             error_at_current(parser, "Expected 'fn' in impl block");
             synchronize(parser);
@@ -1228,6 +1756,8 @@ static AstNode* extern_declaration(Parser* parser) {
             node->data.struct_def.field_count = 0;
             
             while (!check(parser, TOKEN_RBRACE) && !is_at_end(parser)) {
+                size_t attribute_count;
+                Attribute* attributes = parse_attributes(parser, &attribute_count);
                 Token* field_name = consume(parser, TOKEN_IDENTIFIER, "Expected field name");
                 consume(parser, TOKEN_COLON, "Expected ':' after field name");
                 Type* field_type = parse_type(parser);
@@ -1242,6 +1772,8 @@ static AstNode* extern_declaration(Parser* parser) {
                     node->data.struct_def.fields[node->data.struct_def.field_count].name = 
                         string_n_duplicate(field_name->start, field_name->length);
                     node->data.struct_def.fields[node->data.struct_def.field_count].type = field_type;
+                    node->data.struct_def.fields[node->data.struct_def.field_count].attributes = attributes;
+                    node->data.struct_def.fields[node->data.struct_def.field_count].attribute_count = attribute_count;
                     node->data.struct_def.field_count++;
                 }
                 
@@ -1333,10 +1865,22 @@ static AstNode* include_directive(Parser* parser) {
  * @return AST node for the declaration
  */
 static AstNode* declaration(Parser* parser) {
+    if (check(parser, TOKEN_HASH)) {
+        size_t attribute_count;
+        Attribute* attributes = parse_attributes(parser, &attribute_count);
+        AstNode* node = declaration(parser);
+        if (node) {
+            node->attributes = attributes;
+            node->attribute_count = attribute_count;
+        }
+        return node;
+    }
+    
     if (match(parser, TOKEN_INCLUDE)) return include_directive(parser);
     if (match(parser, TOKEN_EXTERN)) return extern_declaration(parser);
     if (match(parser, TOKEN_FN)) return function_declaration(parser);
     if (match(parser, TOKEN_STRUCT)) return struct_declaration(parser);
+    if (match(parser, TOKEN_PUB)) return public_declaration(parser);
     if (match(parser, TOKEN_IMPL)) return impl_block(parser);
     if (match(parser, TOKEN_LET)) return let_statement(parser);
     
@@ -1375,7 +1919,8 @@ void parser_destroy(Parser* parser) {
 
 /**
  * Main parsing function that builds the complete AST.
- * Includes loop guards and progress tracking to prevent infinite loops.
+ * Includes progress tracking to prevent infinite loops; programs of any
+ * size are accepted.
  * 
  * @param parser The parser instance
  * @return AST node representing the entire program
@@ -1387,17 +1932,10 @@ AstNode* parser_parse(Parser* parser) {
     program->data.program.items = malloc(sizeof(AstNode*) * capacity);
     program->data.program.count = 0;
     
-    int loop_guard = 0;
-    const int MAX_DECLARATIONS = 50000;
     size_t prev_position = parser->current;
     int stuck_count = 0;
     
     while (!is_at_end(parser)) {
-        if (++loop_guard > MAX_DECLARATIONS) {
-            error_at_current(parser, "Program too large or parser stuck in infinite loop");
-            break;
-        }
-        
         if (parser->current == prev_position) {
             stuck_count++;
             if (stuck_count > 5) {
@@ -1,9 +1,12 @@
 #include "semantic.h"
+#include "layout.h"
 #include "utils.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
 
 
 static void analyze_node(SemanticAnalyzer* analyzer, AstNode* node);
@@ -68,19 +71,14 @@ void semantic_error(SemanticAnalyzer* analyzer, const char* format, ...) {
     
     analyzer->success = false;
     
-    char buffer[512];
     va_list args;
     va_start(args, format);
-    int written = vsnprintf(buffer, sizeof(buffer), format, args);
+    char* message = string_vformat(format, args);
     va_end(args);
     
-    // Debug: check for issues
-    if (written < 0 || strlen(buffer) == 0) {
-        fprintf(stderr, "WARNING: Error formatting message. Format='%s', written=%d\n", format, written);
-        snprintf(buffer, sizeof(buffer), "Unknown error (format issue)");
-    }
-    
-    error_list_add(analyzer->errors, buffer, analyzer->filename ? analyzer->filename : "semantic", 0, 0);
+    const char* text = message && message[0] ? message : "Unknown error (format issue)";
+    error_list_add(analyzer->errors, text, analyzer->filename ? analyzer->filename : "semantic", 0, 0);
+    free(message);
 }
 
 /**
@@ -95,13 +93,13 @@ void semantic_error(SemanticAnalyzer* analyzer, const char* format, ...) {
 void semantic_error_at(SemanticAnalyzer* analyzer, size_t line, size_t column, const char* format, ...) {
     analyzer->success = false;
     
-    char buffer[512];
     va_list args;
     va_start(args, format);
-    vsnprintf(buffer, sizeof(buffer), format, args);
+    char* message = string_vformat(format, args);
     va_end(args);
     
-    error_list_add(analyzer->errors, buffer, analyzer->filename ? analyzer->filename : "semantic", line, column);
+    error_list_add(analyzer->errors, message, analyzer->filename ? analyzer->filename : "semantic", line, column);
+    free(message);
 }
 
 /**
@@ -117,15 +115,57 @@ void semantic_error_node(SemanticAnalyzer* analyzer, AstNode* node, const char*
     
     analyzer->success = false;
     
-    char buffer[512];
     va_list args;
     va_start(args, format);
-    vsnprintf(buffer, sizeof(buffer), format, args);
+    char* message = string_vformat(format, args);
     va_end(args);
     
     size_t line = node->location.line;
     size_t column = node->location.column;
-    error_list_add(analyzer->errors, buffer, analyzer->filename ? analyzer->filename : "semantic", line, column);
+    error_list_add(analyzer->errors, message, analyzer->filename ? analyzer->filename : "semantic", line, column);
+    free(message);
+}
+
+/**
+ * Reports a semantic warning at a specific source location.
+ * Warnings are printed but do not make the analysis fail.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param line Source line number
+ * @param column Source column number
+ * @param format Printf-style format string
+ * @param ... Format arguments
+ */
+void semantic_warning_at(SemanticAnalyzer* analyzer, size_t line, size_t column, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    char* message = string_vformat(format, args);
+    va_end(args);
+    
+    error_list_add_warning(analyzer->errors, message, analyzer->filename ? analyzer->filename : "semantic", line, column);
+    free(message);
+}
+
+/**
+ * Reports a semantic warning with location extracted from AST node.
+ * Warnings are printed but do not make the analysis fail.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param node AST node to extract location from
+ * @param format Printf-style format string
+ * @param ... Format arguments
+ */
+void semantic_warning_node(SemanticAnalyzer* analyzer, AstNode* node, const char* format, ...) {
+    if (!analyzer || !format || !node) return;
+    
+    va_list args;
+    va_start(args, format);
+    char* message = string_vformat(format, args);
+    va_end(args);
+    
+    error_list_add_warning(analyzer->errors, message, analyzer->filename ? analyzer->filename : "semantic",
+                           node->location.line, node->location.column);
+    free(message);
 }
 
 /**
@@ -155,6 +195,30 @@ bool types_equal(Type* a, Type* b) {
         case TYPE_STRUCT:
             return strcmp(a->data.struct_type.name, b->data.struct_type.name) == 0;
         
+        case TYPE_OPTION:
+            return a->data.option.value_type == b->data.option.value_type ||
+                   types_equal(a->data.option.value_type, b->data.option.value_type);
+        
+        case TYPE_RESULT:
+            return types_equal(a->data.result.ok_type, b->data.result.ok_type) &&
+                   types_equal(a->data.result.err_type, b->data.result.err_type);
+        
+        case TYPE_FUNCTION: {
+            if (a->data.function.param_count != b->data.function.param_count) return false;
+            for (size_t i = 0; i < a->data.function.param_count; i++) {
+                if (!types_equal(a->data.function.param_types[i], b->data.function.param_types[i])) {
+                    return false;
+                }
+            }
+            
+            // A missing return type and void are the same
+            Type* a_return = a->data.function.return_type;
+            Type* b_return = b->data.function.return_type;
+            bool a_void = !a_return || a_return->kind == TYPE_VOID;
+            bool b_void = !b_return || b_return->kind == TYPE_VOID;
+            return (a_void && b_void) || types_equal(a_return, b_return);
+        }
+        
         default:
             return true;  // Primitive types with same kind are equal
     }
@@ -173,10 +237,14 @@ bool type_is_numeric(Type* type) {
         case TYPE_I16:
         case TYPE_I32:
         case TYPE_I64:
+        case TYPE_I128:
         case TYPE_U8:
         case TYPE_U16:
         case TYPE_U32:
         case TYPE_U64:
+        case TYPE_U128:
+        case TYPE_F16:
+        case TYPE_BF16:
         case TYPE_F32:
         case TYPE_F64:
             return true;
@@ -198,10 +266,12 @@ bool type_is_integral(Type* type) {
         case TYPE_I16:
         case TYPE_I32:
         case TYPE_I64:
+        case TYPE_I128:
         case TYPE_U8:
         case TYPE_U16:
         case TYPE_U32:
         case TYPE_U64:
+        case TYPE_U128:
             return true;
         default:
             return false;
@@ -221,6 +291,9 @@ bool type_is_signed(Type* type) {
         case TYPE_I16:
         case TYPE_I32:
         case TYPE_I64:
+        case TYPE_I128:
+        case TYPE_F16:
+        case TYPE_BF16:
         case TYPE_F32:
         case TYPE_F64:
             return true;
@@ -229,6 +302,28 @@ bool type_is_signed(Type* type) {
     }
 }
 
+/**
+ * Checks if a type is a floating-point type of any width.
+ * 
+ * @param type The type to check
+ * @return true if type is f16, bf16, f32 or f64, false otherwise
+ */
+bool type_is_float(Type* type) {
+    return type && (type->kind == TYPE_F16 || type->kind == TYPE_BF16 ||
+                    type->kind == TYPE_F32 || type->kind == TYPE_F64);
+}
+
+/**
+ * Checks if a type is one of the 16-bit storage floats. Arithmetic on
+ * them is carried out in f32.
+ * 
+ * @param type The type to check
+ * @return true if type is f16 or bf16, false otherwise
+ */
+bool type_is_half(Type* type) {
+    return type && (type->kind == TYPE_F16 || type->kind == TYPE_BF16);
+}
+
 /**
  * Checks if a type is a reference type.
  * 
@@ -272,20 +367,38 @@ Type* type_dereference(Type* type) {
  * 
  * @param expected The expected/target type
  * @param actual The actual/source type
- * @return true if types are compatible, false otherwise
+ * @return true if types are compatible, false otherwise (also if either is NULL)
  */
 bool semantic_check_types_compatible(Type* expected, Type* actual) {
+    if (!expected || !actual) return false;
     if (types_equal(expected, actual)) return true;
+    
+    // Array literals of numeric literals, e.g. [[0.0, 1.0]; ...] for [[f32; 2]; N]
+    if (expected->kind == TYPE_ARRAY && actual->kind == TYPE_ARRAY) {
+        return expected->data.array.size == actual->data.array.size &&
+               semantic_check_types_compatible(expected->data.array.element_type, actual->data.array.element_type);
+    }
 
     if (type_is_integral(expected) && type_is_integral(actual)) {
         return true;
     }
 
-    if ((expected->kind == TYPE_F64 || expected->kind == TYPE_F32) && 
-        (actual->kind == TYPE_F64 || actual->kind == TYPE_F32)) {
+    if (type_is_float(expected) && type_is_float(actual)) {
         return true;
     }
     
+    // None, Ok(v) and Err(e) leave a payload open; set payloads convert like plain values
+    if (expected->kind == TYPE_OPTION && actual->kind == TYPE_OPTION) {
+        return !actual->data.option.value_type ||
+               semantic_check_types_compatible(expected->data.option.value_type, actual->data.option.value_type);
+    }
+    if (expected->kind == TYPE_RESULT && actual->kind == TYPE_RESULT) {
+        return (!actual->data.result.ok_type ||
+                semantic_check_types_compatible(expected->data.result.ok_type, actual->data.result.ok_type)) &&
+               (!actual->data.result.err_type ||
+                semantic_check_types_compatible(expected->data.result.err_type, actual->data.result.err_type));
+    }
+    
     return false;
 }
 
@@ -316,10 +429,18 @@ static Type* check_binary_op(SemanticAnalyzer* analyzer, AstNode* expr) {
         if (left_type->kind == TYPE_F64 || right_type->kind == TYPE_F64) {
             return type_create(TYPE_F64);
         }
-        if (left_type->kind == TYPE_F32 || right_type->kind == TYPE_F32) {
+        if (type_is_float(left_type) || type_is_float(right_type)) {
             return type_create(TYPE_F32);
         }
         
+        // 128-bit operands must not be narrowed to the default integer type
+        if (left_type->kind == TYPE_I128 || left_type->kind == TYPE_U128) {
+            return left_type;
+        }
+        if (right_type->kind == TYPE_I128 || right_type->kind == TYPE_U128) {
+            return right_type;
+        }
+        
         return type_create(TYPE_I32);
     }
     
@@ -359,6 +480,101 @@ static Type* check_binary_op(SemanticAnalyzer* analyzer, AstNode* expr) {
     return NULL;
 }
 
+/**
+ * Computes the alignment the address of an already-checked lvalue is
+ * guaranteed to have. Members of packed structs, and anything nested in
+ * them, may be guaranteed less than the natural alignment of their type.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param expr The lvalue expression
+ * @return Guaranteed alignment in bytes
+ */
+static size_t lvalue_alignment(SemanticAnalyzer* analyzer, AstNode* expr) {
+    AstNode* program = analyzer->program;
+    
+    if (expr->type == AST_FIELD && expr->data.field.object->data_type) {
+        AstNode* object = expr->data.field.object;
+        Type* object_type = object->data_type;
+        size_t base;
+        if (type_is_reference(object_type) || type_is_pointer(object_type)) {
+            object_type = type_dereference(object_type);
+            base = layout_align_of(program, object_type);
+        } else {
+            base = lvalue_alignment(analyzer, object);
+        }
+        
+        AstNode* struct_def = object_type->kind == TYPE_STRUCT ?
+            layout_find_struct(program, object_type->data.struct_type.name) : NULL;
+        if (!struct_def) return layout_align_of(program, expr->data_type);
+        
+        const StructLayout* layout = layout_of_struct(program, struct_def);
+        for (size_t i = 0; i < struct_def->data.struct_def.field_count; i++) {
+            if (strcmp(struct_def->data.struct_def.fields[i].name, expr->data.field.field_name) == 0) {
+                size_t align = base < layout->align ? base : layout->align;
+                while (align > 1 && layout->offsets[i] % align != 0) align /= 2;
+                return align;
+            }
+        }
+    }
+    
+    if (expr->type == AST_INDEX && expr->data.index.array->data_type &&
+        expr->data.index.array->data_type->kind == TYPE_ARRAY) {
+        size_t align = lvalue_alignment(analyzer, expr->data.index.array);
+        size_t element_size = layout_size_of(program, expr->data_type);
+        while (align > 1 && element_size % align != 0) align /= 2;
+        return align;
+    }
+    
+    return layout_align_of(program, expr->data_type);
+}
+
+/**
+ * Performs semantic analysis on the `?` operator. It unwraps an Option or
+ * Result, returning the None or Err from the enclosing function, which
+ * must therefore return an Option or a Result with a compatible error.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param expr The `?` unary operation node
+ * @param operand_type Type of the unwrapped expression
+ * @return The payload type, or NULL on error
+ */
+static Type* check_try(SemanticAnalyzer* analyzer, AstNode* expr, Type* operand_type) {
+    Type* return_type = symbol_table_get_return_type(analyzer->symbols);
+    
+    if (operand_type->kind == TYPE_OPTION) {
+        if (!return_type || return_type->kind != TYPE_OPTION) {
+            semantic_error_node(analyzer, expr, "'?' on an Option requires the function to return an Option");
+            return NULL;
+        }
+        if (!operand_type->data.option.value_type) {
+            semantic_error_node(analyzer, expr, "Cannot infer the type of None here");
+            return NULL;
+        }
+        return operand_type->data.option.value_type;
+    }
+    
+    if (operand_type->kind == TYPE_RESULT) {
+        if (!return_type || return_type->kind != TYPE_RESULT) {
+            semantic_error_node(analyzer, expr, "'?' on a Result requires the function to return a Result");
+            return NULL;
+        }
+        Type* err_type = operand_type->data.result.err_type;
+        if (err_type && !semantic_check_types_compatible(return_type->data.result.err_type, err_type)) {
+            semantic_error_node(analyzer, expr, "'?' cannot convert error type %s into %s",
+                                type_to_string(err_type), type_to_string(return_type->data.result.err_type));
+            return NULL;
+        }
+        if (!operand_type->data.result.ok_type || !err_type) {
+            semantic_error_node(analyzer, expr, "Cannot infer the type of %s(...) here", err_type ? "Err" : "Ok");
+            return NULL;
+        }
+        return operand_type->data.result.ok_type;
+    }
+    
+    semantic_error_node(analyzer, expr, "'?' requires an Option or Result, got %s", type_to_string(operand_type));
+    return NULL;
+}
+
 /**
  * Performs semantic analysis on unary operations.
  * Handles negation, logical NOT, dereference, and address-of operations.
@@ -378,9 +594,16 @@ static Type* check_unary_op(SemanticAnalyzer* analyzer, AstNode* expr) {
             semantic_error_node(analyzer, expr, "Negation requires numeric type");
             return NULL;
         }
+        if (type_is_half(operand_type)) {
+            return type_create(TYPE_F32);
+        }
         return operand_type;
     }
     
+    if (op == TOKEN_QUESTION) {
+        return check_try(analyzer, expr, operand_type);
+    }
+    
     if (op == TOKEN_NOT) {
         if (operand_type->kind != TYPE_BOOL) {
             semantic_error_node(analyzer, expr, "Logical NOT requires boolean type");
@@ -399,6 +622,17 @@ static Type* check_unary_op(SemanticAnalyzer* analyzer, AstNode* expr) {
     }
     
     if (op == TOKEN_AND) {
+        size_t needed = layout_align_of(analyzer->program, operand_type);
+        size_t guaranteed = lvalue_alignment(analyzer, expr->data.unary.operand);
+        if (guaranteed < needed) {
+            AstNode* operand = expr->data.unary.operand;
+            semantic_warning_node(analyzer, operand,
+                                  "Taking the address of packed member '%s' may result in an unaligned pointer "
+                                  "(needs %zu-byte alignment, only %zu is guaranteed)",
+                                  operand->type == AST_FIELD ? operand->data.field.field_name : "[]",
+                                  needed, guaranteed);
+        }
+        
         Type* ref_type = type_create(TYPE_REFERENCE);
         ref_type->data.reference.referenced_type = operand_type;
         ref_type->data.reference.is_mutable = expr->data.unary.is_mut_ref;
@@ -409,6 +643,674 @@ static Type* check_unary_op(SemanticAnalyzer* analyzer, AstNode* expr) {
     return NULL;
 }
 
+/**
+ * Finds a top-level JFM function by name.
+ * 
+ * @param program The program AST node
+ * @param name The function name
+ * @return The function AST node, or NULL
+ */
+static AstNode* find_program_function(AstNode* program, const char* name) {
+    return ast_find_function(program, NULL, 0, name);
+}
+
+/**
+ * Builds the fn type of a named function from its symbol.
+ * 
+ * @param sym The function symbol
+ * @return The function type
+ */
+static Type* function_symbol_type(Symbol* sym) {
+    Type* fn_type = type_create(TYPE_FUNCTION);
+    fn_type->data.function.param_count = sym->info.function.param_count;
+    fn_type->data.function.param_types = malloc(sizeof(Type*) * (sym->info.function.param_count + 1));
+    for (size_t i = 0; i < sym->info.function.param_count; i++) {
+        fn_type->data.function.param_types[i] = sym->info.function.param_types[i];
+    }
+    fn_type->data.function.return_type = sym->type && sym->type->kind != TYPE_VOID ? sym->type : NULL;
+    return fn_type;
+}
+
+/**
+ * Records a variable used inside closures that is declared outside them.
+ * Every enclosing closure between the use and the declaration captures it.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param sym The variable or parameter symbol
+ * @return true if the innermost closure captures the symbol
+ */
+static bool record_capture(SemanticAnalyzer* analyzer, Symbol* sym) {
+    if (sym->kind != SYMBOL_VARIABLE && sym->kind != SYMBOL_PARAMETER) return false;
+    
+    bool captured = false;
+    for (ClosureContext* context = analyzer->closures; context; context = context->parent) {
+        if (sym->scope->level >= context->scope->level) break;
+        
+        AstNode* closure = context->closure;
+        bool known = false;
+        for (size_t i = 0; i < closure->data.closure.capture_count; i++) {
+            if (strcmp(closure->data.closure.captures[i], sym->name) == 0) {
+                known = true;
+                break;
+            }
+        }
+        if (!known) {
+            size_t count = closure->data.closure.capture_count;
+            closure->data.closure.captures = realloc(closure->data.closure.captures, sizeof(char*) * (count + 1));
+            closure->data.closure.capture_types = realloc(closure->data.closure.capture_types, sizeof(Type*) * (count + 1));
+            closure->data.closure.capture_params = realloc(closure->data.closure.capture_params, sizeof(size_t) * (count + 1));
+            closure->data.closure.captures[count] = string_duplicate(sym->name);
+            closure->data.closure.capture_types[count] = sym->type;
+            closure->data.closure.capture_params[count] =
+                sym->kind == SYMBOL_PARAMETER && sym->type && sym->type->kind == TYPE_FUNCTION ? sym->info.param.index + 1 : 0;
+            closure->data.closure.capture_count++;
+        }
+        captured = true;
+    }
+    return captured;
+}
+
+/**
+ * Lets a closure with an expression body take the return type its context
+ * expects, so |x: i64| x + 1 is a fn(i64) -> i64 although 1 is an i32.
+ * 
+ * @param expected The expected type
+ * @param value The value expression
+ */
+static void coerce_closure_return(Type* expected, AstNode* value) {
+    if (!expected || expected->kind != TYPE_FUNCTION || !value || value->type != AST_CLOSURE ||
+        !value->data.closure.expression_body || !value->data_type) {
+        return;
+    }
+    
+    Type* inferred = value->data_type->data.function.return_type;
+    Type* wanted = expected->data.function.return_type;
+    if (!inferred || !wanted || types_equal(inferred, wanted) ||
+        !semantic_check_types_compatible(wanted, inferred)) {
+        return;
+    }
+    value->data.closure.return_type = wanted;
+    value->data_type->data.function.return_type = wanted;
+}
+
+/**
+ * Reports an integer literal too large for the integer type it is given
+ * to, e.g. 300 for a u8 or 2^64 for a u64. Literals are never negative:
+ * -128 is the negation of 128 and is not checked.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param expected The expected type
+ * @param value The value expression
+ */
+static void check_literal_range(SemanticAnalyzer* analyzer, Type* expected, AstNode* value) {
+    if (!expected || !value || value->type != AST_LITERAL || !type_is_integral(expected) ||
+        !type_is_integral(value->data_type)) {
+        return;
+    }
+    
+    unsigned long long max_low = ULLONG_MAX;
+    unsigned long long max_high = 0;
+    switch (expected->kind) {
+        case TYPE_I8: max_low = INT8_MAX; break;
+        case TYPE_I16: max_low = INT16_MAX; break;
+        case TYPE_I32: max_low = INT32_MAX; break;
+        case TYPE_I64: max_low = INT64_MAX; break;
+        case TYPE_I128: max_high = INT64_MAX; break;
+        case TYPE_U8: max_low = UINT8_MAX; break;
+        case TYPE_U16: max_low = UINT16_MAX; break;
+        case TYPE_U32: max_low = UINT32_MAX; break;
+        case TYPE_U128: max_high = ULLONG_MAX; break;
+        default: break;
+    }
+    
+    unsigned long long high = value->data.literal.int_high;
+    if (high > max_high || (high == max_high && value->data.literal.int_value > max_low)) {
+        semantic_error_node(analyzer, value, "Integer literal out of range for %s", type_to_string(expected));
+    }
+}
+
+/**
+ * Checks whether the value of a [value; N] literal can be written N times
+ * without evaluating anything more than once: a literal, a negated
+ * literal, a variable, or an array literal of them.
+ * 
+ * @param value The repeated expression
+ * @return true if the value can be repeated
+ */
+static bool is_repeatable(AstNode* value) {
+    switch (value->type) {
+        case AST_LITERAL:
+        case AST_IDENTIFIER:
+            return true;
+        case AST_UNARY_OP:
+            return value->data.unary.op == TOKEN_MINUS && value->data.unary.operand->type == AST_LITERAL;
+        case AST_ARRAY_LITERAL:
+            for (size_t i = 0; i < value->data.array_literal.element_count; i++) {
+                if (!is_repeatable(value->data.array_literal.elements[i])) return false;
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Checks whether values of a type can hold a fn value: a fn type, or an
+ * array, Option, Result or struct containing one.
+ * 
+ * @param program The program AST node, to look up struct fields
+ * @param type The type to check (may be NULL)
+ * @param depth Structs already looked through, to stop on recursive structs
+ * @return true if the type can hold a fn value
+ */
+static bool type_holds_function(AstNode* program, Type* type, int depth) {
+    if (!type || depth > 32) return false;
+    
+    switch (type->kind) {
+        case TYPE_FUNCTION:
+            return true;
+        case TYPE_ARRAY:
+            return type_holds_function(program, type->data.array.element_type, depth);
+        case TYPE_OPTION:
+            return type_holds_function(program, type->data.option.value_type, depth);
+        case TYPE_RESULT:
+            return type_holds_function(program, type->data.result.ok_type, depth) ||
+                   type_holds_function(program, type->data.result.err_type, depth);
+        case TYPE_STRUCT: {
+            AstNode* struct_def = layout_find_struct(program, type->data.struct_type.name);
+            if (!struct_def) return false;
+            for (size_t i = 0; i < struct_def->data.struct_def.field_count; i++) {
+                if (type_holds_function(program, struct_def->data.struct_def.fields[i].type, depth + 1)) return true;
+            }
+            return false;
+        }
+        default:
+            return false;
+    }
+}
+
+typedef struct {
+    SemanticAnalyzer* analyzer;
+    size_t level;
+} CaptureLevel;
+
+static size_t capture_level(SemanticAnalyzer* analyzer, AstNode* value);
+
+/**
+ * Raises a CaptureLevel to the capture level of one child expression.
+ * 
+ * @param child The child node
+ * @param context The CaptureLevel
+ */
+static void child_capture_level(AstNode* child, void* context) {
+    CaptureLevel* result = context;
+    size_t level = capture_level(result->analyzer, child);
+    if (level > result->level) result->level = level;
+}
+
+/**
+ * Finds the deepest scope holding the environment of a capturing closure
+ * that a value may contain: a closure written in place, one stored in a
+ * variable, or one in a struct, array, Option or call result built from
+ * them. The value must not be stored where it outlives that scope.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param value The checked value expression (may be NULL)
+ * @return The scope level, or 0 if the value holds no capturing closure
+ */
+static size_t capture_level(SemanticAnalyzer* analyzer, AstNode* value) {
+    if (!value || !type_holds_function(analyzer->program, value->data_type, 0)) return 0;
+    
+    switch (value->type) {
+        case AST_CLOSURE:
+            return value->data.closure.scope_level;
+        case AST_IDENTIFIER: {
+            Symbol* sym = symbol_table_lookup(analyzer->symbols, value->data.identifier.name);
+            return sym ? sym->capture_level : 0;
+        }
+        default: {
+            CaptureLevel result = { analyzer, 0 };
+            ast_for_each_child(value, child_capture_level, &result);
+            return result.level;
+        }
+    }
+}
+
+/**
+ * Finds the variable an assignment target is a place in (x, x.field,
+ * x[i] and combinations). Places reached through a reference or pointer
+ * have no such variable: they may live in any scope.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param target The assignment target
+ * @return The variable's symbol, or NULL
+ */
+static Symbol* target_variable(SemanticAnalyzer* analyzer, AstNode* target) {
+    while (target->type == AST_FIELD || target->type == AST_INDEX) {
+        target = target->type == AST_FIELD ? target->data.field.object : target->data.index.array;
+    }
+    if (target->type != AST_IDENTIFIER) return NULL;
+    
+    Symbol* sym = symbol_table_lookup(analyzer->symbols, target->data.identifier.name);
+    if (!sym || (sym->type && (sym->type->kind == TYPE_REFERENCE || sym->type->kind == TYPE_POINTER))) {
+        return NULL;
+    }
+    return sym;
+}
+
+/**
+ * Performs semantic analysis on a call through a variable or parameter of
+ * fn type.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param expr The call expression AST node
+ * @return The return type of the function type, or NULL on error
+ */
+static Type* check_indirect_call(SemanticAnalyzer* analyzer, AstNode* expr) {
+    Type* fn_type = check_expression(analyzer, expr->data.call.function);
+    if (!fn_type) return NULL;
+    
+    const char* name = expr->data.call.function->data.identifier.name;
+    if (expr->data.call.argument_count != fn_type->data.function.param_count) {
+        semantic_error_node(analyzer, expr, "%s expects %lu arguments, got %lu", name,
+                            (unsigned long)fn_type->data.function.param_count,
+                            (unsigned long)expr->data.call.argument_count);
+        return NULL;
+    }
+    
+    for (size_t i = 0; i < expr->data.call.argument_count; i++) {
+        Type* arg_type = check_expression(analyzer, expr->data.call.arguments[i]);
+        if (!arg_type) continue;
+        
+        Type* param_type = fn_type->data.function.param_types[i];
+        coerce_closure_return(param_type, expr->data.call.arguments[i]);
+        check_literal_range(analyzer, param_type, expr->data.call.arguments[i]);
+        if (!semantic_check_types_compatible(param_type, arg_type)) {
+            semantic_error_node(analyzer, expr, "Argument %lu type mismatch in call to %s",
+                                (unsigned long)(i + 1), name);
+        }
+    }
+    
+    return fn_type->data.function.return_type ? fn_type->data.function.return_type : type_create(TYPE_VOID);
+}
+
+/**
+ * Performs semantic analysis on a closure. The body is checked as a
+ * function of its own; an expression body's type is inferred first and
+ * becomes the return type. Enclosing variables the body uses are recorded
+ * as captures.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param expr The closure AST node
+ * @return The fn type of the closure, or NULL on error
+ */
+static Type* check_closure(SemanticAnalyzer* analyzer, AstNode* expr) {
+    AstNode* body = expr->data.closure.body;
+    if (!body) return NULL;
+    
+    symbol_table_enter_function_scope(analyzer->symbols, expr->data.closure.return_type);
+    ClosureContext context = { expr, analyzer->symbols->current, analyzer->closures };
+    analyzer->closures = &context;
+    int in_loop_count = analyzer->in_loop_count;
+    analyzer->in_loop_count = 0;
+    
+    for (size_t i = 0; i < expr->data.closure.param_count; i++) {
+        Param* param = &expr->data.closure.params[i];
+        if (!param->name || !param->type) continue;
+        
+        Symbol* sym = symbol_table_define(analyzer->symbols, param->name, SYMBOL_VARIABLE, param->type, false);
+        if (!sym) {
+            semantic_error_node(analyzer, expr, "Duplicate closure parameter %s", param->name);
+            continue;
+        }
+        sym->is_initialized = true;
+    }
+    
+    if (expr->data.closure.expression_body) {
+        AstNode* value = body->data.block.statements[0]->data.return_stmt.value;
+        Type* value_type = check_expression(analyzer, value);
+        if (value_type && value_type->kind == TYPE_VOID) {
+            body->data.block.statements[0] = value;
+        }
+        expr->data.closure.return_type = value_type;
+        analyzer->symbols->current->return_type = value_type;
+    }
+    
+    if (expr->data.closure.return_type) {
+        check_statement(analyzer, body);
+    }
+    
+    analyzer->in_loop_count = in_loop_count;
+    analyzer->closures = context.parent;
+    symbol_table_exit_scope(analyzer->symbols);
+    
+    // The environment of pointers to the captures lives in the C block the
+    // closure is written in
+    if (expr->data.closure.capture_count > 0) {
+        expr->data.closure.scope_level = analyzer->symbols->current->level;
+    }
+    
+    if (!expr->data.closure.return_type) return NULL;
+    
+    Type* fn_type = type_create(TYPE_FUNCTION);
+    fn_type->data.function.param_count = expr->data.closure.param_count;
+    fn_type->data.function.param_types = malloc(sizeof(Type*) * (expr->data.closure.param_count + 1));
+    for (size_t i = 0; i < expr->data.closure.param_count; i++) {
+        fn_type->data.function.param_types[i] = expr->data.closure.params[i].type;
+    }
+    if (expr->data.closure.return_type->kind != TYPE_VOID) {
+        fn_type->data.function.return_type = expr->data.closure.return_type;
+    }
+    return fn_type;
+}
+
+/**
+ * Performs semantic analysis on the built-in methods of Option and Result:
+ * is_some / is_none, is_ok / is_err, unwrap, unwrap_or(default) and
+ * unwrap_err.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param expr The method call expression
+ * @param type The Option or Result type of the receiver
+ * @return The method's result type, or NULL on error
+ */
+static Type* check_wrapper_method(SemanticAnalyzer* analyzer, AstNode* expr, Type* type) {
+    const char* method = expr->data.call.function->data.field.field_name;
+    bool is_option = type->kind == TYPE_OPTION;
+    Type* value_type = is_option ? type->data.option.value_type : type->data.result.ok_type;
+    size_t expected_args = strcmp(method, "unwrap_or") == 0 ? 1 : 0;
+    
+    Type* result_type = NULL;
+    if (is_option ? (strcmp(method, "is_some") == 0 || strcmp(method, "is_none") == 0)
+                  : (strcmp(method, "is_ok") == 0 || strcmp(method, "is_err") == 0)) {
+        result_type = type_create(TYPE_BOOL);
+    } else if (strcmp(method, "unwrap") == 0 || strcmp(method, "unwrap_or") == 0) {
+        result_type = value_type;
+    } else if (!is_option && strcmp(method, "unwrap_err") == 0) {
+        result_type = type->data.result.err_type;
+    } else {
+        semantic_error_node(analyzer, expr, "Undefined method: %s on %s", method, type_to_string(type));
+        return NULL;
+    }
+    
+    if (!result_type) {
+        semantic_error_node(analyzer, expr, "Cannot infer the payload type of this %s", type_to_string(type));
+        return NULL;
+    }
+    if (expr->data.call.argument_count != expected_args) {
+        semantic_error_node(analyzer, expr, "Method %s expects %zu arguments, got %zu",
+                            method, expected_args, expr->data.call.argument_count);
+        return NULL;
+    }
+    if (expected_args == 1) {
+        Type* default_type = check_expression(analyzer, expr->data.call.arguments[0]);
+        if (default_type && !semantic_check_types_compatible(value_type, default_type)) {
+            semantic_error_node(analyzer, expr, "unwrap_or default must be a %s", type_to_string(value_type));
+        }
+    }
+    return result_type;
+}
+
+/**
+ * Performs semantic analysis on the Some(v), Ok(v) and Err(e) constructors.
+ * The side of a Result that is not given stays NULL and matches any type.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param expr The call expression AST node
+ * @param kind TYPE_OPTION for Some, TYPE_RESULT for Ok and Err
+ * @param is_err Whether the constructor is Err
+ * @return The constructed type, or NULL on error
+ */
+static Type* check_wrapper_constructor(SemanticAnalyzer* analyzer, AstNode* expr, TypeKind kind, bool is_err) {
+    const char* name = expr->data.call.function->data.identifier.name;
+    if (expr->data.call.argument_count != 1) {
+        semantic_error_node(analyzer, expr, "%s expects 1 argument", name);
+        return NULL;
+    }
+    
+    Type* payload = check_expression(analyzer, expr->data.call.arguments[0]);
+    if (!payload) return NULL;
+    if (payload->kind == TYPE_VOID || payload->kind == TYPE_ARRAY) {
+        semantic_error_node(analyzer, expr, "%s cannot wrap a %s value", name, type_to_string(payload));
+        return NULL;
+    }
+    
+    Type* type = type_create(kind);
+    if (kind == TYPE_OPTION) {
+        type->data.option.value_type = payload;
+    } else if (is_err) {
+        type->data.result.err_type = payload;
+    } else {
+        type->data.result.ok_type = payload;
+    }
+    return type;
+}
+
+/**
+ * Recognises the byte access builtins: load_le_T / load_be_T and
+ * store_le_T / store_be_T for explicit byte order, and read_unaligned_T /
+ * write_unaligned_T for host order, where T is a 16, 32 or 64-bit integer
+ * type, f32 or f64.
+ * 
+ * @param name The called function name
+ * @param access Output: what the builtin does, when it is one
+ * @return true if name is a byte access builtin, false otherwise
+ */
+bool semantic_byte_access(const char* name, ByteAccess* access) {
+    static const struct { const char* prefix; bool is_store; char order; } forms[] = {
+        { "load_le_", false, 'l' }, { "load_be_", false, 'b' }, { "read_unaligned_", false, 'n' },
+        { "store_le_", true, 'l' }, { "store_be_", true, 'b' }, { "write_unaligned_", true, 'n' },
+    };
+    static const struct { const char* name; TypeKind kind; } types[] = {
+        { "i16", TYPE_I16 }, { "i32", TYPE_I32 }, { "i64", TYPE_I64 },
+        { "u16", TYPE_U16 }, { "u32", TYPE_U32 }, { "u64", TYPE_U64 },
+        { "f32", TYPE_F32 }, { "f64", TYPE_F64 },
+    };
+    
+    for (size_t i = 0; i < sizeof(forms) / sizeof(forms[0]); i++) {
+        size_t length = strlen(forms[i].prefix);
+        if (strncmp(name, forms[i].prefix, length) != 0) continue;
+        
+        for (size_t j = 0; j < sizeof(types) / sizeof(types[0]); j++) {
+            if (strcmp(name + length, types[j].name) == 0) {
+                access->is_store = forms[i].is_store;
+                access->order = forms[i].order;
+                access->kind = types[j].kind;
+                return true;
+            }
+        }
+        return false;
+    }
+    return false;
+}
+
+/**
+ * Checks a call to a byte access builtin: the first argument must point
+ * at the bytes (any pointer, or a reference - mutable for stores), and a
+ * store takes the value as its second argument.
+ * 
+ * @param analyzer The semantic analyzer instance
+ * @param expr The call expression AST node
+ * @param access The builtin being called
+ * @return The loaded type, void for stores, or NULL on error
+ */
+static Type* check_byte_access(SemanticAnalyzer* analyzer, AstNode* expr, ByteAccess* access) {
+    const char* name = expr->data.call.function->data.identifier.name;
+    size_t expected = access->is_store ? 2 : 1;
+    if (expr->data.call.argument_count != expected) {
+        semantic_error_node(analyzer, expr, "%s expects %zu argument%s", name, expected, expected == 1 ? "" : "s");
+        return NULL;
+    }
+    
+    Type* address_type = check_expression(analyzer, expr->data.call.arguments[0]);
+    if (!address_type) return NULL;
+    if (!type_is_pointer(address_type) && !type_is_reference(address_type)) {
+        semantic_error_node(analyzer, expr->data.call.arguments[0],
+                            "%s expects a pointer or reference to the bytes, got %s",
+                            name, type_to_string(address_type));
+        return NULL;
+    }
+    
+    Type* value_type = type_create(access->kind);
+    if (!access->is_store) {
+        return value_type;
+    }
+    
+    if (type_is_reference(address_type) && !address_type->data.reference.is_mutable) {
+        semantic_error_node(analyzer, expr->data.call.arguments[0], "%s needs a mutable reference (&mut)", name);
+    }
+    Type* arg_type = check_expression(analyzer, expr->data.call.arguments[1]);
+    if (arg_type && !semantic_check_types_compatible(value_type, arg_type)) {
+        semantic_error_node(analyzer, expr->data.call.arguments[1], "%s stores a %s, got %s",
+                            name, type_to_string(value_type), type_to_string(arg_type));
+    }
+    return type_create(TYPE_VOID);
+}
+
+/**
+ * Checks whether a struct has #[derive(...)] naming the given trait.
+ * 
+ * @param struct_def The struct definition
+ * @param trait Encode or Decode
+ * @return true if the struct derives the trait
+ */
+bool semantic_derives(AstNode* struct_def, const char* trait) {
+    for (size_t i = 0; i < struct_def->attribute_count; i++) {
+        Attribute* attr = &struct_def->attributes[i];
+        if (strcmp(attr->name, "derive") != 0) continue;
+        for (size_t j = 0; j < attr->arg_count; j++) {
+            if (strcmp(attr->args[j], trait) == 0) return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Recognises a call to a method generated by #[derive(Encode, Decode)]:
+ * value.encoded_size() and value.encode(buf, capacity) for Encode,
+ * Struct::decode(buf, length) and Struct::view(buf, length) for Decode.
+ * The receiver of a method call must already have its type.
+ * 
+ * @param program The program AST node
+ * @param call The call expression
+ * @param struct_def Receives the struct the method belongs to
+ * @return The generated method, or SERIAL_NONE for any other call
+ */
+SerialMethod semantic_serial_call(AstNode* program, AstNode* call, AstNode** struct_def) {
+    AstNode* callee = call->data.call.function;
+    const char* method;
+    *struct_def = NULL;
+    
+    if (callee->type == AST_FIELD) {
+        Type* type = callee->data.field.object->data_type;
+        if (type_is_reference(type) || type_is_pointer(type)) type = type_dereference(type);
+        if (!type || type->kind != TYPE_STRUCT) return SERIAL_NONE;
+        *struct_def = layout_find_struct(program, type->data.struct_type.name);
+        method = callee->data.field.field_name;
+    } else if (callee->type == AST_IDENTIFIER && strstr(callee->data.identifier.name, "::")) {
+        const char* name = callee->data.identifier.name;
+        const char* separator = strstr(name, "::");
+        char* struct_name = string_n_duplicate(name, (size_t)(separator - name));
+        *struct_def = layout_find_struct(program, struct_name);
+        free(struct_name);
+        method = separator + 2;
+    } else {
+        return SERIAL_NONE;
+    }
+    if (!*struct_def) return SERIAL_NONE;
+    
+    bool is_static = callee->type == AST_IDENTIFIER;
+    if (!is_static && semantic_derives(*struct_def, "Encode")) {
+        if (strcmp(method, "encoded_size") == 0) return SERIAL_ENCODED_SIZE;
+        if (strcmp(method, "encode") == 0) return SERIAL_ENCODE;
+    }
+    if (is_static && semantic_derives(*struct_def, "Decode")) {
+        if (strcmp(method, "decode") == 0) return SERIAL_DECODE;
+        if (strcmp(method, "view") == 0) return SERIAL_VIEW;
+    }
+    return SERIAL_NONE;
+}
+
+/**
+ * Checks whether a type is a byte buffer the serialisers can read or,
+ * if writable, write: *u8, &mut [u8; N], or &[u8; N] for reading.
+ * 
+ * @param type The buffer argument type
+ * @param writable Whether the buffer is written
+ * @return true if the type is accepted
+ */
+static bool is_byte_buffer(Type* type, bool writable) {
+    if (type->kind == TYPE_POINTER) {
+        return type->data.pointer.pointed_type->kind == TYPE_U8;
+    }
+    if (type->kind != TYPE_REFERENCE || (writable && !type->data.reference.is_mutable)) {
+        return false;
+    }
+    
+    Type* array = type->data.reference.referenced_type;
+    return array->kind == TYPE_ARRAY && array->data.array.element_type->kind == TYPE_U8;
+}
+
+/**
+ * Performs semantic analysis on the methods of #[derive(Encode, Decode)].
+ * encode returns the number of bytes written, or None if the buffer is
+ * too small; decode returns None for a truncated or invalid buffer, and
+ * view also for a misaligned one.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param expr The call expression
+ * @param method The generated method
+ * @param struct_def The struct it belongs to
+ * @return The method's result type, or NULL on error
+ */
+static Type* check_serial_call(SemanticAnalyzer* analyzer, AstNode* expr, SerialMethod method, AstNode* struct_def) {
+    static const char* const names[] = { "", "encoded_size", "encode", "decode", "view" };
+    const char* struct_name = struct_def->data.struct_def.name;
+    size_t expected_args = method == SERIAL_ENCODED_SIZE ? 0 : 2;
+    
+    if (expr->data.call.argument_count != expected_args) {
+        semantic_error_node(analyzer, expr, "Method %s expects %zu arguments, got %zu",
+                            names[method], expected_args, expr->data.call.argument_count);
+        return NULL;
+    }
+    if (expected_args == 2) {
+        Type* buffer_type = check_expression(analyzer, expr->data.call.arguments[0]);
+        Type* length_type = check_expression(analyzer, expr->data.call.arguments[1]);
+        if (buffer_type && !is_byte_buffer(buffer_type, method == SERIAL_ENCODE)) {
+            semantic_error_node(analyzer, expr, "%s needs a %s buffer, got %s", names[method],
+                                method == SERIAL_ENCODE ? "*u8 or &mut [u8; N]" : "*u8 or &[u8; N]",
+                                type_to_string(buffer_type));
+        }
+        if (length_type && !type_is_integral(length_type)) {
+            semantic_error_node(analyzer, expr, "Buffer length must be an integer, got %s", type_to_string(length_type));
+        }
+    }
+    if (method == SERIAL_VIEW && !layout_wire_viewable(analyzer->program, struct_def)) {
+        semantic_error_node(analyzer, expr, "%s::view requires a struct without padding or #[varint] fields", struct_name);
+        return NULL;
+    }
+    
+    if (method == SERIAL_ENCODED_SIZE) return type_create(TYPE_U64);
+    
+    Type* result = type_create(TYPE_OPTION);
+    if (method == SERIAL_ENCODE) {
+        result->data.option.value_type = type_create(TYPE_U64);
+        return result;
+    }
+    
+    Type* struct_type = type_create(TYPE_STRUCT);
+    struct_type->data.struct_type.name = string_duplicate(struct_name);
+    if (method == SERIAL_DECODE) {
+        result->data.option.value_type = struct_type;
+    } else {
+        Type* reference = type_create(TYPE_REFERENCE);
+        reference->data.reference.referenced_type = struct_type;
+        reference->data.reference.is_mutable = false;
+        result->data.option.value_type = reference;
+    }
+    return result;
+}
+
 /**
  * Performs semantic analysis on function and method calls.
  * Handles built-in functions, regular functions, and method calls.
@@ -427,16 +1329,25 @@ static Type* check_call(SemanticAnalyzer* analyzer, AstNode* expr) {
             obj_type = type_dereference(obj_type);
         }
         
+        if (obj_type->kind == TYPE_OPTION || obj_type->kind == TYPE_RESULT) {
+            return check_wrapper_method(analyzer, expr, obj_type);
+        }
+        
         if (obj_type->kind != TYPE_STRUCT) {
             semantic_error_node(analyzer, expr, "Method call on non-struct type");
             return NULL;
         }
-
-        char method_full_name[256];
-        snprintf(method_full_name, sizeof(method_full_name), "%s::%s",
-                obj_type->data.struct_type.name, field_expr->data.field.field_name);
         
+        AstNode* struct_def;
+        SerialMethod serial = semantic_serial_call(analyzer->program, expr, &struct_def);
+        if (serial != SERIAL_NONE) {
+            return check_serial_call(analyzer, expr, serial, struct_def);
+        }
+
+        char* method_full_name = string_format("%s::%s", obj_type->data.struct_type.name,
+                                               field_expr->data.field.field_name);
         Symbol* method_sym = symbol_table_lookup_function(analyzer->symbols, method_full_name);
+        free(method_full_name);
         if (!method_sym) {
             semantic_error_node(analyzer, expr, "Undefined method: %s", field_expr->data.field.field_name);
             return NULL;
@@ -455,6 +1366,7 @@ static Type* check_call(SemanticAnalyzer* analyzer, AstNode* expr) {
             if (!arg_type) continue;
             
             Type* param_type = method_sym->info.function.param_types[i + 1]; // Skip self
+            check_literal_range(analyzer, param_type, expr->data.call.arguments[i]);
             if (!semantic_check_types_compatible(param_type, arg_type)) {
                 semantic_error_node(analyzer, expr, "Argument %lu type mismatch in method call to %s",
                               (unsigned long)(i + 1), field_expr->data.field.field_name);
@@ -470,6 +1382,12 @@ static Type* check_call(SemanticAnalyzer* analyzer, AstNode* expr) {
     }
     
     const char* func_name = expr->data.call.function->data.identifier.name;
+    
+    Symbol* value_sym = symbol_table_lookup(analyzer->symbols, func_name);
+    if (value_sym && value_sym->kind != SYMBOL_FUNCTION && value_sym->type &&
+        value_sym->type->kind == TYPE_FUNCTION) {
+        return check_indirect_call(analyzer, expr);
+    }
 
     if (strcmp(func_name, "println") == 0 || strcmp(func_name, "print") == 0) {
         for (size_t i = 0; i < expr->data.call.argument_count; i++) {
@@ -478,6 +1396,18 @@ static Type* check_call(SemanticAnalyzer* analyzer, AstNode* expr) {
         return type_create(TYPE_VOID);
     }
     
+    if (strcmp(func_name, "Some") == 0) {
+        return check_wrapper_constructor(analyzer, expr, TYPE_OPTION, false);
+    }
+    if (strcmp(func_name, "Ok") == 0 || strcmp(func_name, "Err") == 0) {
+        return check_wrapper_constructor(analyzer, expr, TYPE_RESULT, func_name[0] == 'E');
+    }
+    
+    ByteAccess access;
+    if (semantic_byte_access(func_name, &access)) {
+        return check_byte_access(analyzer, expr, &access);
+    }
+    
     if (strcmp(func_name, "sqrt") == 0) {
         if (expr->data.call.argument_count != 1) {
             semantic_error_node(analyzer, expr, "sqrt expects 1 argument");
@@ -491,6 +1421,12 @@ static Type* check_call(SemanticAnalyzer* analyzer, AstNode* expr) {
         return type_create(TYPE_F32);
     }
 
+    AstNode* struct_def;
+    SerialMethod serial = semantic_serial_call(analyzer->program, expr, &struct_def);
+    if (serial != SERIAL_NONE) {
+        return check_serial_call(analyzer, expr, serial, struct_def);
+    }
+
     Symbol* func_sym = symbol_table_lookup_function(analyzer->symbols, func_name);
     if (!func_sym) {
         if (strstr(func_name, "::")) {
@@ -514,6 +1450,8 @@ static Type* check_call(SemanticAnalyzer* analyzer, AstNode* expr) {
         if (!arg_type) continue;
         
         Type* param_type = func_sym->info.function.param_types[i];
+        coerce_closure_return(param_type, expr->data.call.arguments[i]);
+        check_literal_range(analyzer, param_type, expr->data.call.arguments[i]);
         if (!semantic_check_types_compatible(param_type, arg_type)) {
             semantic_error_node(analyzer, expr, "Argument %lu type mismatch in call to %s",
                           (unsigned long)(i + 1), func_name);
@@ -532,6 +1470,9 @@ static Type* check_call(SemanticAnalyzer* analyzer, AstNode* expr) {
  * @return The element type of the array, or NULL on error
  */
 static Type* check_index(SemanticAnalyzer* analyzer, AstNode* expr) {
+    bool field_access = analyzer->soa_element_access;
+    analyzer->soa_element_access = false;
+    
     Type* array_type = check_expression(analyzer, expr->data.index.array);
     Type* index_type = check_expression(analyzer, expr->data.index.index);
     
@@ -553,6 +1494,12 @@ static Type* check_index(SemanticAnalyzer* analyzer, AstNode* expr) {
         return NULL;
     }
     
+    // Elements of a #[soa] array do not exist as structs in memory
+    if (!field_access && layout_soa_struct(analyzer->program, array_type)) {
+        semantic_error_node(analyzer, expr, "Elements of a #[soa] array can only be accessed one field at a time, e.g. arr[i].field");
+        return NULL;
+    }
+    
     return array_type->data.array.element_type;
 }
 
@@ -565,7 +1512,9 @@ static Type* check_index(SemanticAnalyzer* analyzer, AstNode* expr) {
  * @return The type of the accessed field, or NULL on error
  */
 static Type* check_field(SemanticAnalyzer* analyzer, AstNode* expr) {
+    analyzer->soa_element_access = expr->data.field.object->type == AST_INDEX;
     Type* object_type = check_expression(analyzer, expr->data.field.object);
+    analyzer->soa_element_access = false;
     if (!object_type) return NULL;
 
     if (type_is_reference(object_type) || type_is_pointer(object_type)) {
@@ -596,6 +1545,37 @@ static Type* check_field(SemanticAnalyzer* analyzer, AstNode* expr) {
     return NULL;
 }
 
+/**
+ * Checks that a place expression may be written: the variable it names,
+ * or the array it indexes, must be mutable or reached through &mut.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param expr The node errors are reported at
+ * @param target The written place
+ * @return true if the place is writable, false otherwise
+ */
+static bool check_writable(SemanticAnalyzer* analyzer, AstNode* expr, AstNode* target) {
+    if (target->type == AST_IDENTIFIER) {
+        Symbol* var = symbol_table_lookup(analyzer->symbols, target->data.identifier.name);
+        if (var && !var->is_mutable) {
+            semantic_error_node(analyzer, expr, "Cannot assign to immutable variable");
+            return false;
+        }
+    }
+
+    if (target->type == AST_INDEX && target->data.index.array->type == AST_IDENTIFIER) {
+      Symbol* var = symbol_table_lookup(analyzer->symbols, target->data.index.array->data.identifier.name);
+      bool through_mut_ref = var && var->type && var->type->kind == TYPE_REFERENCE &&
+                             var->type->data.reference.is_mutable;
+      if (var && !var->is_mutable && !through_mut_ref) {
+        semantic_error_node(analyzer, expr, "Cannot assign to read-only location");
+        return false;
+      }
+    }
+    
+    return true;
+}
+
 /**
  * Performs semantic analysis on assignment operations.
  * Checks mutability and type compatibility.
@@ -608,30 +1588,29 @@ static Type* check_assignment(SemanticAnalyzer* analyzer, AstNode* expr) {
     Type* target_type = check_expression(analyzer, expr->data.assignment.target);
     Type* value_type = check_expression(analyzer, expr->data.assignment.value);
     
-    if (!target_type || !value_type) return NULL;
-
-    AstNode* target = expr->data.assignment.target;
-    if (target->type == AST_IDENTIFIER) {
-        Symbol* var = symbol_table_lookup(analyzer->symbols, target->data.identifier.name);
-        if (var && !var->is_mutable) {
-            semantic_error_node(analyzer, expr, "Cannot assign to immutable variable");
-            return NULL;
-        }
-    }
+    if (!target_type || !value_type) return NULL;
 
-    if (target->type == AST_INDEX) {
-      Symbol* var = symbol_table_lookup(analyzer->symbols, target->data.index.array->data.identifier.name);
-      if (var && !var->is_mutable) {
-        semantic_error_node(analyzer, expr, "Cannot assign to read-only location");
+    if (!check_writable(analyzer, expr, expr->data.assignment.target)) {
         return NULL;
-      }
     }
     
+    check_literal_range(analyzer, target_type, expr->data.assignment.value);
     if (!semantic_check_types_compatible(target_type, value_type)) {
         semantic_error_node(analyzer, expr, "Type mismatch in assignment");
         return NULL;
     }
     
+    // A capturing closure must not outlive the block it was created in
+    size_t level = capture_level(analyzer, expr->data.assignment.value);
+    if (level > 0) {
+        Symbol* var = target_variable(analyzer, expr->data.assignment.target);
+        if (!var || var->scope->level < level) {
+            semantic_error_node(analyzer, expr, "A closure that captures local variables cannot be stored where it outlives them");
+            return NULL;
+        }
+        if (level > var->capture_level) var->capture_level = level;
+    }
+    
     return target_type;
 }
 
@@ -676,6 +1655,10 @@ static Type* check_expression(SemanticAnalyzer* analyzer, AstNode* expr) {
             }
             
             Symbol* sym = symbol_table_lookup(analyzer->symbols, name);
+            if (!sym && strcmp(name, "None") == 0) {
+                result_type = type_create(TYPE_OPTION);
+                break;
+            }
             if (!sym) {
                 semantic_error_node(analyzer, expr, "Undefined variable: %s", name);
                 return NULL;
@@ -683,10 +1666,32 @@ static Type* check_expression(SemanticAnalyzer* analyzer, AstNode* expr) {
             if (!sym->is_initialized && sym->kind == SYMBOL_VARIABLE) {
                 semantic_error_node(analyzer, expr, "Use of uninitialized variable: %s", name);
             }
+            
+            // A function named as a value, e.g. passed as a fn argument
+            if (sym->kind == SYMBOL_FUNCTION) {
+                AstNode* func = find_program_function(analyzer->program, name);
+                if (!func) {
+                    semantic_error_node(analyzer, expr, "%s cannot be used as a value", name);
+                    return NULL;
+                }
+                expr->data.identifier.function_value = func;
+                result_type = function_symbol_type(sym);
+                break;
+            }
+            
+            bool captured = record_capture(analyzer, sym);
+            if (sym->kind == SYMBOL_PARAMETER && !captured && sym->type && sym->type->kind == TYPE_FUNCTION) {
+                expr->data.identifier.param_number = sym->info.param.index + 1;
+            }
+            expr->data.identifier.function_value = sym->function_value;
             result_type = sym->type;
             break;
         }
         
+        case AST_CLOSURE:
+            result_type = check_closure(analyzer, expr);
+            break;
+        
         case AST_BINARY_OP:
             result_type = check_binary_op(analyzer, expr);
             break;
@@ -736,9 +1741,19 @@ static Type* check_expression(SemanticAnalyzer* analyzer, AstNode* expr) {
                 }
             }
             
+            size_t size = expr->data.array_literal.element_count;
+            if (expr->data.array_literal.repeat > 0) {
+                size = expr->data.array_literal.repeat;
+                if (!is_repeatable(expr->data.array_literal.elements[0])) {
+                    semantic_error_node(analyzer, expr->data.array_literal.elements[0],
+                                        "The value of [value; N] must be a literal, a variable or an array of them");
+                    return NULL;
+                }
+            }
+            
             Type* array_type = type_create(TYPE_ARRAY);
             array_type->data.array.element_type = elem_type;
-            array_type->data.array.size = expr->data.array_literal.element_count;
+            array_type->data.array.size = size;
             return array_type;
         }
         
@@ -759,6 +1774,7 @@ static Type* check_expression(SemanticAnalyzer* analyzer, AstNode* expr) {
                     Symbol* field = struct_sym->info.struct_def.fields[j];
                     if (strcmp(field->name, field_name) == 0) {
                         found = true;
+                        check_literal_range(analyzer, field->type, expr->data.struct_literal.field_values[i]);
                         if (!semantic_check_types_compatible(field->type, value_type)) {
                             semantic_error_node(analyzer, expr, "Type mismatch for field %s in struct literal", field_name);
                         }
@@ -820,11 +1836,20 @@ static void check_let_statement(SemanticAnalyzer* analyzer, AstNode* stmt) {
     }
     
     Type* var_type = declared_type;
-
+    
+    coerce_closure_return(declared_type, stmt->data.let_stmt.value);
+    check_literal_range(analyzer, declared_type, stmt->data.let_stmt.value);
     if (init_type && !semantic_check_types_compatible(declared_type, init_type)) {
         semantic_error_node(analyzer, stmt, "Type mismatch in variable declaration");
         return;
     }
+    
+    if (stmt->data.let_stmt.value && stmt->data.let_stmt.value->type == AST_ARRAY_LITERAL &&
+        layout_soa_struct(analyzer->program, declared_type)) {
+        semantic_error_node(analyzer, stmt, "An array of #[soa] struct %s cannot be initialised with an array literal",
+                            declared_type->data.array.element_type->data.struct_type.name);
+        return;
+    }
 
     Symbol* var_sym = symbol_table_define(analyzer->symbols, var_name, SYMBOL_VARIABLE,
                                           var_type, stmt->data.let_stmt.is_mutable);
@@ -833,10 +1858,21 @@ static void check_let_statement(SemanticAnalyzer* analyzer, AstNode* stmt) {
         return;
     }
     
-    if (stmt->data.let_stmt.value) {
+    // A mutable array of a #[soa] struct cannot take an array literal, so
+    // without initializer it is storage whose elements are assigned later
+    if (stmt->data.let_stmt.value ||
+        (stmt->data.let_stmt.is_mutable && layout_soa_struct(analyzer->program, var_type))) {
         var_sym->is_initialized = true;
     }
     
+    // Calls through an immutable fn variable go straight to what it holds
+    AstNode* value = stmt->data.let_stmt.value;
+    var_sym->capture_level = capture_level(analyzer, value);
+    if (var_type->kind == TYPE_FUNCTION && !stmt->data.let_stmt.is_mutable && value) {
+        var_sym->function_value = value->type == AST_CLOSURE ? value :
+                                  value->type == AST_IDENTIFIER ? value->data.identifier.function_value : NULL;
+    }
+    
     analyzer->variables_analyzed++;
 }
 
@@ -884,6 +1920,90 @@ static void check_while_statement(SemanticAnalyzer* analyzer, AstNode* stmt) {
     analyzer->in_loop_count--;
 }
 
+/**
+ * Declares a variable bound by a for loop in the loop's scope.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param name The bound name
+ * @param type The type of the binding
+ * @param is_mutable Whether the binding may be assigned (&mut x)
+ */
+static void define_loop_binding(SemanticAnalyzer* analyzer, const char* name, Type* type, bool is_mutable) {
+    if (!name) return;
+    
+    Symbol* symbol = symbol_table_define(analyzer->symbols, name, SYMBOL_VARIABLE, type, is_mutable);
+    if (symbol) {
+        symbol->is_initialized = true;
+    }
+}
+
+/**
+ * Checks an array iterated by a for loop and returns its element type.
+ * Binding elements with &mut needs a mutable array or a &mut reference.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param array The iterated expression
+ * @param want_mut Whether the elements are bound with &mut
+ * @return The element type, or NULL on error
+ */
+static Type* check_iterated_array(SemanticAnalyzer* analyzer, AstNode* array, bool want_mut) {
+    Type* type = check_expression(analyzer, array);
+    if (!type) return NULL;
+    
+    bool through_reference = type->kind == TYPE_REFERENCE;
+    bool writable = through_reference && type->data.reference.is_mutable;
+    if (through_reference) type = type->data.reference.referenced_type;
+    
+    if (!type || type->kind != TYPE_ARRAY) {
+        semantic_error_node(analyzer, array, "For loop can only iterate over a range or an array");
+        return NULL;
+    }
+    
+    if (layout_soa_struct(analyzer->program, type)) {
+        semantic_error_node(analyzer, array, "Elements of a #[soa] array cannot be bound; iterate over its indices");
+        return NULL;
+    }
+    
+    if (want_mut && !through_reference) {
+        AstNode* root = array;
+        while (root->type == AST_FIELD || root->type == AST_INDEX) {
+            root = root->type == AST_FIELD ? root->data.field.object : root->data.index.array;
+        }
+        Symbol* var = root->type == AST_IDENTIFIER ? symbol_table_lookup(analyzer->symbols, root->data.identifier.name) : NULL;
+        if (var && var->type && var->type->kind == TYPE_REFERENCE) {
+            writable = var->type->data.reference.is_mutable;
+        } else {
+            writable = var && var->is_mutable;
+        }
+    }
+    
+    if (want_mut && !writable) {
+        semantic_error_node(analyzer, array, "Cannot bind elements of an immutable array with '&mut'");
+        return NULL;
+    }
+    
+    return type->data.array.element_type;
+}
+
+/**
+ * Checks a for loop over an array (optionally enumerated or zipped with a
+ * second array) and declares its bindings.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param stmt The for loop AST node
+ */
+static void check_array_iteration(SemanticAnalyzer* analyzer, AstNode* stmt) {
+    Type* element = check_iterated_array(analyzer, stmt->data.for_loop.iterable, stmt->data.for_loop.iterator_mut);
+    define_loop_binding(analyzer, stmt->data.for_loop.iterator, element, stmt->data.for_loop.iterator_mut);
+    
+    if (stmt->data.for_loop.zip_with) {
+        Type* other = check_iterated_array(analyzer, stmt->data.for_loop.zip_with, stmt->data.for_loop.zip_mut);
+        define_loop_binding(analyzer, stmt->data.for_loop.zip_name, other, stmt->data.for_loop.zip_mut);
+    }
+    
+    define_loop_binding(analyzer, stmt->data.for_loop.index_name, type_create(TYPE_I32), false);
+}
+
 /**
  * Performs semantic analysis on for loops.
  * Checks range types, defines iterator variable, and tracks loop nesting.
@@ -895,17 +2015,27 @@ static void check_for_statement(SemanticAnalyzer* analyzer, AstNode* stmt) {
     analyzer->in_loop_count++;
     symbol_table_enter_scope(analyzer->symbols, SCOPE_LOOP);
 
-    Type* start_type = check_expression(analyzer, stmt->data.for_loop.start);
-    Type* end_type = check_expression(analyzer, stmt->data.for_loop.end);
-    
-    if (!type_is_integral(start_type) || !type_is_integral(end_type)) {
-        semantic_error_node(analyzer, stmt, "For loop range must be integral");
-    }
-
-    Symbol* iter = symbol_table_define(analyzer->symbols, stmt->data.for_loop.iterator,
-                                       SYMBOL_VARIABLE, type_create(TYPE_I32), false);
-    if (iter) {
-        iter->is_initialized = true;
+    if (stmt->data.for_loop.iterable) {
+        check_array_iteration(analyzer, stmt);
+    } else {
+        Type* start_type = check_expression(analyzer, stmt->data.for_loop.start);
+        Type* end_type = check_expression(analyzer, stmt->data.for_loop.end);
+        
+        if (!type_is_integral(start_type) || !type_is_integral(end_type)) {
+            semantic_error_node(analyzer, stmt, "For loop range must be integral");
+        }
+        
+        AstNode* step = stmt->data.for_loop.step;
+        if (step) {
+            Type* step_type = check_expression(analyzer, step);
+            if (!type_is_integral(step_type)) {
+                semantic_error_node(analyzer, step, "step_by() requires an integral step");
+            } else if (step->type == AST_LITERAL && step->data.literal.int_value == 0) {
+                semantic_error_node(analyzer, step, "step_by() requires a positive step");
+            }
+        }
+        
+        define_loop_binding(analyzer, stmt->data.for_loop.iterator, type_create(TYPE_I32), false);
     }
     
     check_statement(analyzer, stmt->data.for_loop.body);
@@ -930,14 +2060,64 @@ static void check_return_statement(SemanticAnalyzer* analyzer, AstNode* stmt) {
     
     if (stmt->data.return_stmt.value) {
         Type* value_type = check_expression(analyzer, stmt->data.return_stmt.value);
-        if (!semantic_check_types_compatible(return_type, value_type)) {
+        coerce_closure_return(return_type, stmt->data.return_stmt.value);
+        check_literal_range(analyzer, return_type, stmt->data.return_stmt.value);
+        if (!value_type) {
+            return;     // The value's own error has been reported
+        } else if (!semantic_check_types_compatible(return_type, value_type)) {
             semantic_error_node(analyzer, stmt, "Return type mismatch");
+        } else if (capture_level(analyzer, stmt->data.return_stmt.value) > 0) {
+            semantic_error_node(analyzer, stmt, "A closure that captures local variables cannot be returned");
         }
     } else if (return_type->kind != TYPE_VOID) {
         semantic_error_node(analyzer, stmt, "Function expects return value");
     }
 }
 
+/**
+ * Performs semantic analysis on asm! statements. Output operands must be
+ * writable places with an '=' or '+' constraint, inputs must not use
+ * either, and an operand that does not fit in a register needs a memory
+ * ("m") constraint.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param stmt The asm statement AST node
+ */
+static void check_asm_statement(SemanticAnalyzer* analyzer, AstNode* stmt) {
+    for (size_t i = 0; i < stmt->data.asm_stmt.operand_count; i++) {
+        AstNode* operand = stmt->data.asm_stmt.operands[i];
+        const char* constraint = stmt->data.asm_stmt.constraints[i];
+        Type* type = check_expression(analyzer, operand);
+        if (!type || !constraint) continue;
+        
+        bool is_output = i < stmt->data.asm_stmt.output_count;
+        bool writes = constraint[0] == '=' || constraint[0] == '+';
+        if (is_output && !writes) {
+            semantic_error_node(analyzer, operand, "Output constraint \"%s\" must start with '=' or '+'", constraint);
+        } else if (!is_output && writes) {
+            semantic_error_node(analyzer, operand, "Input constraint \"%s\" cannot start with '%c'",
+                                constraint, constraint[0]);
+        }
+        
+        if (is_output) {
+            bool place = operand->type == AST_IDENTIFIER || operand->type == AST_FIELD || operand->type == AST_INDEX ||
+                         (operand->type == AST_UNARY_OP && operand->data.unary.op == TOKEN_STAR);
+            if (!place) {
+                semantic_error_node(analyzer, operand, "asm! output must be a variable, field, element or dereference");
+            } else {
+                check_writable(analyzer, operand, operand);
+            }
+        }
+        
+        bool in_register = (type_is_numeric(type) && type->kind != TYPE_BF16) || type->kind == TYPE_BOOL ||
+                           type->kind == TYPE_CHAR || type_is_pointer(type) || type_is_reference(type);
+        if (!in_register && !strchr(constraint, 'm')) {
+            semantic_error_node(analyzer, operand, "asm! operand of type %s needs a memory constraint (\"m\")",
+                                type_to_string(type));
+        }
+    }
+}
+
 /**
  * Performs semantic analysis on break statements.
  * Ensures break occurs within a loop context.
@@ -985,6 +2165,268 @@ static void check_block(SemanticAnalyzer* analyzer, AstNode* block) {
     symbol_table_exit_scope(analyzer->symbols);
 }
 
+// Places an attribute can be attached to
+typedef enum {
+    ATTR_ON_STRUCT    = 1 << 0,
+    ATTR_ON_FIELD     = 1 << 1,
+    ATTR_ON_FUNCTION  = 1 << 2,
+    ATTR_ON_STATEMENT = 1 << 3,
+    ATTR_ON_LET       = 1 << 4,
+    ATTR_ON_LOOP      = 1 << 5,
+    ATTR_ON_OTHER     = 1 << 6,
+} AttributeTarget;
+
+// Attributes understood by the compiler and where each may appear
+static const struct {
+    const char* name;
+    unsigned targets;
+} known_attributes[] = {
+    { "repr", ATTR_ON_STRUCT },
+    { "align", ATTR_ON_STRUCT | ATTR_ON_FIELD | ATTR_ON_LET },
+    { "cache_aligned", ATTR_ON_STRUCT | ATTR_ON_FIELD | ATTR_ON_LET },
+    { "packed", ATTR_ON_STRUCT | ATTR_ON_FIELD },
+    { "soa", ATTR_ON_STRUCT },
+    { "derive", ATTR_ON_STRUCT },
+    { "varint", ATTR_ON_FIELD },
+    { "unroll", ATTR_ON_LOOP },
+    { "no_unroll", ATTR_ON_LOOP },
+    { "vectorize", ATTR_ON_LOOP },
+    { "ivdep", ATTR_ON_LOOP },
+};
+
+/**
+ * Checks whether an attribute is a loop hint.
+ * 
+ * @param name The attribute name
+ * @return true for attributes that only apply to loops
+ */
+static bool is_loop_hint(const char* name) {
+    for (size_t i = 0; i < sizeof(known_attributes) / sizeof(known_attributes[0]); i++) {
+        if (strcmp(known_attributes[i].name, name) == 0) {
+            return known_attributes[i].targets == ATTR_ON_LOOP;
+        }
+    }
+    return false;
+}
+
+/**
+ * Returns a human-readable name for an attribute target, for diagnostics.
+ * 
+ * @param target The attribute target
+ * @return Description of the target
+ */
+static const char* attribute_target_name(AttributeTarget target) {
+    switch (target) {
+        case ATTR_ON_STRUCT: return "a struct";
+        case ATTR_ON_FIELD: return "a struct field";
+        case ATTR_ON_FUNCTION: return "a function";
+        case ATTR_ON_STATEMENT: return "a statement";
+        case ATTR_ON_LET: return "a let declaration";
+        case ATTR_ON_LOOP: return "a loop";
+        default: return "this item";
+    }
+}
+
+/**
+ * Validates the argument of #[align(N)]: a power of two no larger than
+ * MAX_ALIGNMENT.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param attr The align attribute
+ */
+static void check_alignment_attribute(SemanticAnalyzer* analyzer, Attribute* attr) {
+    if (attr->arg_count != 1) {
+        semantic_error_at(analyzer, attr->line, attr->column, "Expected #[align(N)]");
+        return;
+    }
+    
+    char* end;
+    unsigned long value = strtoul(attr->args[0], &end, 0);
+    if (*end != '\0' || attr->args[0][0] == '-') {
+        semantic_error_at(analyzer, attr->line, attr->column, "Alignment must be an integer, found '%s'", attr->args[0]);
+    } else if (value == 0 || (value & (value - 1)) != 0) {
+        semantic_error_at(analyzer, attr->line, attr->column, "Alignment %lu is not a power of two", value);
+    } else if (value > MAX_ALIGNMENT) {
+        semantic_error_at(analyzer, attr->line, attr->column, "Alignment %lu exceeds the maximum of %d", value, MAX_ALIGNMENT);
+    }
+}
+
+/**
+ * Validates the argument of #[unroll(N)]: an unroll factor from 1 to
+ * MAX_UNROLL, the range `#pragma GCC unroll` accepts.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param attr The unroll attribute
+ */
+static void check_unroll_attribute(SemanticAnalyzer* analyzer, Attribute* attr) {
+    if (attr->arg_count != 1) {
+        semantic_error_at(analyzer, attr->line, attr->column, "Expected #[unroll(N)]");
+        return;
+    }
+    
+    char* end;
+    unsigned long value = strtoul(attr->args[0], &end, 0);
+    if (*end != '\0' || attr->args[0][0] == '-') {
+        semantic_error_at(analyzer, attr->line, attr->column, "Unroll factor must be an integer, found '%s'", attr->args[0]);
+    } else if (value == 0 || value > MAX_UNROLL) {
+        semantic_error_at(analyzer, attr->line, attr->column, "Unroll factor %lu is outside 1..%d", value, MAX_UNROLL);
+    }
+}
+
+/**
+ * Validates the attributes attached to a declaration, field or statement.
+ * Reports unknown attributes, attributes in the wrong place, and malformed
+ * arguments.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param attributes The attributes to check
+ * @param count Number of attributes
+ * @param target What the attributes are attached to
+ */
+static void check_attributes(SemanticAnalyzer* analyzer, Attribute* attributes, size_t count, AttributeTarget target) {
+    size_t known_count = sizeof(known_attributes) / sizeof(known_attributes[0]);
+    
+    for (size_t i = 0; i < count; i++) {
+        Attribute* attr = &attributes[i];
+        
+        size_t known = 0;
+        while (known < known_count && strcmp(known_attributes[known].name, attr->name) != 0) {
+            known++;
+        }
+        
+        if (known == known_count) {
+            semantic_error_at(analyzer, attr->line, attr->column, "Unknown attribute '%s'", attr->name);
+            continue;
+        }
+        
+        // Loop hints only tune code generation, so a misplaced one is ignored
+        if (known_attributes[known].targets == ATTR_ON_LOOP && target != ATTR_ON_LOOP) {
+            semantic_warning_at(analyzer, attr->line, attr->column, "Loop hint '%s' on %s has no effect",
+                                attr->name, attribute_target_name(target));
+            continue;
+        }
+        
+        if (!(known_attributes[known].targets & target)) {
+            semantic_error_at(analyzer, attr->line, attr->column, "Attribute '%s' cannot be applied to %s",
+                             attr->name, attribute_target_name(target));
+            continue;
+        }
+        
+        if (strcmp(attr->name, "repr") == 0 && (attr->arg_count != 1 || strcmp(attr->args[0], "C") != 0)) {
+            semantic_error_at(analyzer, attr->line, attr->column, "Expected #[repr(C)]");
+        } else if (strcmp(attr->name, "align") == 0) {
+            check_alignment_attribute(analyzer, attr);
+        } else if (strcmp(attr->name, "unroll") == 0) {
+            check_unroll_attribute(analyzer, attr);
+        } else if (strcmp(attr->name, "derive") == 0) {
+            if (attr->arg_count == 0) {
+                semantic_error_at(analyzer, attr->line, attr->column, "Expected #[derive(Encode, Decode)]");
+            }
+            for (size_t j = 0; j < attr->arg_count; j++) {
+                if (strcmp(attr->args[j], "Encode") != 0 && strcmp(attr->args[j], "Decode") != 0) {
+                    semantic_error_at(analyzer, attr->line, attr->column, "Cannot derive '%s': expected Encode or Decode",
+                                      attr->args[j]);
+                }
+            }
+        } else if (strcmp(attr->name, "no_unroll") == 0 && ast_find_attribute(attributes, count, "unroll")) {
+            semantic_error_at(analyzer, attr->line, attr->column, "Conflicting loop hints 'unroll' and 'no_unroll'");
+        } else if ((strcmp(attr->name, "packed") == 0 || strcmp(attr->name, "cache_aligned") == 0 ||
+                    strcmp(attr->name, "soa") == 0 || strcmp(attr->name, "no_unroll") == 0 ||
+                    strcmp(attr->name, "varint") == 0 ||
+                    strcmp(attr->name, "vectorize") == 0 || strcmp(attr->name, "ivdep") == 0) &&
+                   attr->arg_count != 0) {
+            semantic_error_at(analyzer, attr->line, attr->column, "Attribute '%s' takes no arguments", attr->name);
+        }
+    }
+}
+
+/**
+ * Checks a loop nested in a vectorised loop for a return or `?`, which
+ * leave the outer loop too. Its breaks do not.
+ * 
+ * @param node A statement or expression inside the nested loop
+ * @param context Points to a bool set when an exit is found
+ */
+static void find_nested_exit(AstNode* node, void* context) {
+    bool* found = context;
+    if (*found || node->type == AST_BREAK || node->type == AST_CLOSURE) return;
+    
+    if (node->type == AST_RETURN || (node->type == AST_UNARY_OP && node->data.unary.op == TOKEN_QUESTION)) {
+        *found = true;
+        return;
+    }
+    ast_for_each_child(node, find_nested_exit, found);
+}
+
+/**
+ * Checks whether a loop body can leave the loop other than by finishing an
+ * iteration: a break out of the loop itself, a return, or a `?` that
+ * returns an error. A `#pragma omp simd` loop must not.
+ * 
+ * @param node A statement or expression inside the loop body
+ * @param context Points to a bool set when an early exit is found
+ */
+static void find_early_exit(AstNode* node, void* context) {
+    bool* found = context;
+    if (*found) return;
+    
+    switch (node->type) {
+        case AST_RETURN:
+        case AST_BREAK:
+            *found = true;
+            return;
+        case AST_UNARY_OP:
+            if (node->data.unary.op == TOKEN_QUESTION) {
+                *found = true;
+                return;
+            }
+            break;
+        case AST_CLOSURE:
+            // Returns from a closure leave the closure, not the loop
+            return;
+        case AST_FOR:
+        case AST_WHILE:
+        case AST_LOOP: {
+            // A break in a nested loop only leaves that loop
+            bool nested_break = false;
+            ast_for_each_child(node, find_nested_exit, &nested_break);
+            if (nested_break) *found = true;
+            return;
+        }
+        default:
+            break;
+    }
+    ast_for_each_child(node, find_early_exit, found);
+}
+
+/**
+ * Checks the #[vectorize] hint of a loop. `#pragma omp simd` needs a
+ * counted for loop that runs every iteration, so on a while loop or a
+ * loop that can exit early the hint is ignored with a warning.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param stmt The loop statement AST node
+ */
+static void check_vectorize_hint(SemanticAnalyzer* analyzer, AstNode* stmt) {
+    Attribute* attr = ast_find_attribute(stmt->attributes, stmt->attribute_count, "vectorize");
+    if (!attr) return;
+    
+    if (stmt->type == AST_WHILE) {
+        semantic_warning_at(analyzer, attr->line, attr->column,
+                            "Loop hint 'vectorize' on a while loop has no effect");
+        attr->ignored = true;
+        return;
+    }
+    
+    bool early_exit = false;
+    ast_for_each_child(stmt->data.for_loop.body, find_early_exit, &early_exit);
+    if (early_exit) {
+        semantic_warning_at(analyzer, attr->line, attr->column,
+                            "Loop hint 'vectorize' on a loop that can exit early has no effect");
+        attr->ignored = true;
+    }
+}
+
 /**
  * Main statement semantic analysis dispatcher.
  * Routes different statement types to their specific analyzers.
@@ -995,6 +2437,27 @@ static void check_block(SemanticAnalyzer* analyzer, AstNode* block) {
 static void check_statement(SemanticAnalyzer* analyzer, AstNode* stmt) {
     if (!stmt) return;
     
+    AttributeTarget target = ATTR_ON_STATEMENT;
+    if (stmt->type == AST_LET) {
+        target = ATTR_ON_LET;
+    } else if (stmt->type == AST_FOR || stmt->type == AST_WHILE || stmt->type == AST_LOOP) {
+        target = ATTR_ON_LOOP;
+    }
+    check_attributes(analyzer, stmt->attributes, stmt->attribute_count, target);
+    
+    // 'loop' has no trip count to unroll or vectorize, so its hints are dropped
+    if (stmt->type == AST_LOOP) {
+        for (size_t i = 0; i < stmt->attribute_count; i++) {
+            Attribute* attr = &stmt->attributes[i];
+            if (is_loop_hint(attr->name)) {
+                semantic_warning_at(analyzer, attr->line, attr->column,
+                                    "Loop hint '%s' on an infinite loop has no effect", attr->name);
+            }
+        }
+    } else if (stmt->type == AST_FOR || stmt->type == AST_WHILE) {
+        check_vectorize_hint(analyzer, stmt);
+    }
+    
     switch (stmt->type) {
         case AST_LET:
             check_let_statement(analyzer, stmt);
@@ -1032,6 +2495,10 @@ static void check_statement(SemanticAnalyzer* analyzer, AstNode* stmt) {
             check_continue_statement(analyzer, stmt);
             break;
         
+        case AST_ASM:
+            check_asm_statement(analyzer, stmt);
+            break;
+        
         case AST_BLOCK:
             check_block(analyzer, stmt);
             break;
@@ -1043,6 +2510,88 @@ static void check_statement(SemanticAnalyzer* analyzer, AstNode* stmt) {
     }
 }
 
+/**
+ * Finds the part of a type that the C header of a library build cannot
+ * declare: Option, Result and fn values (their C types are private to the
+ * generated code), i128/u128/f16/bf16 (prelude typedefs), arrays of #[soa]
+ * structs and structs that are not pub. Extern structs come from the
+ * program's includes, which the header repeats.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param type The type to check
+ * @return The offending type, or NULL if the type can be exported
+ */
+static Type* unexportable_part(SemanticAnalyzer* analyzer, Type* type) {
+    if (!type) return NULL;
+    
+    switch (type->kind) {
+        case TYPE_POINTER:
+            return unexportable_part(analyzer, type->data.pointer.pointed_type);
+        case TYPE_REFERENCE:
+            return unexportable_part(analyzer, type->data.reference.referenced_type);
+        case TYPE_ARRAY:
+            if (layout_soa_struct(analyzer->program, type)) return type;
+            return unexportable_part(analyzer, type->data.array.element_type);
+        case TYPE_STRUCT: {
+            AstNode* struct_def = layout_find_struct(analyzer->program, type->data.struct_type.name);
+            if (!struct_def || struct_def->data.struct_def.is_extern || struct_def->data.struct_def.is_pub) return NULL;
+            return type;
+        }
+        case TYPE_OPTION:
+        case TYPE_RESULT:
+        case TYPE_FUNCTION:
+        case TYPE_I128:
+        case TYPE_U128:
+        case TYPE_F16:
+        case TYPE_BF16:
+            return type;
+        default:
+            return NULL;
+    }
+}
+
+/**
+ * Reports a type in the interface of a pub item that the generated C
+ * header cannot declare.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param item The pub function or struct
+ * @param type The type to check
+ */
+static void check_exportable(SemanticAnalyzer* analyzer, AstNode* item, Type* type) {
+    Type* part = unexportable_part(analyzer, type);
+    if (!part) return;
+    
+    const char* kind = item->type == AST_STRUCT ? "struct" : "fn";
+    const char* name = item->type == AST_STRUCT ? item->data.struct_def.name : item->data.function.name;
+    if (part->kind == TYPE_STRUCT) {
+        semantic_error_node(analyzer, item, "pub %s %s exposes struct %s, which must also be pub",
+                            kind, name, part->data.struct_type.name);
+    } else if (part->kind == TYPE_ARRAY) {
+        semantic_error_node(analyzer, item, "pub %s %s exposes an array of #[soa] struct %s, which has no C header form",
+                            kind, name, part->data.array.element_type->data.struct_type.name);
+    } else {
+        semantic_error_node(analyzer, item, "pub %s %s exposes %s, which has no C header form",
+                            kind, name, type_to_string(part));
+    }
+}
+
+/**
+ * Checks that the signature of a pub function or method can be declared
+ * in the generated C header.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param func The function AST node
+ */
+static void check_public_signature(SemanticAnalyzer* analyzer, AstNode* func) {
+    if (!func->data.function.is_pub) return;
+    
+    for (size_t i = 0; i < func->data.function.param_count; i++) {
+        check_exportable(analyzer, func, func->data.function.params[i].type);
+    }
+    check_exportable(analyzer, func, func->data.function.return_type);
+}
+
 /**
  * Performs semantic analysis on function declarations.
  * Registers function in symbol table and analyzes function body in separate scope.
@@ -1052,6 +2601,9 @@ static void check_statement(SemanticAnalyzer* analyzer, AstNode* stmt) {
  */
 void semantic_check_function(SemanticAnalyzer* analyzer, AstNode* func) {
     const char* func_name = func->data.function.name;
+    
+    check_attributes(analyzer, func->attributes, func->attribute_count, ATTR_ON_FUNCTION);
+    check_public_signature(analyzer, func);
 
     size_t param_count = func->data.function.param_count;
     Type** param_types = malloc(sizeof(Type*) * param_count);
@@ -1108,6 +2660,49 @@ void semantic_check_function(SemanticAnalyzer* analyzer, AstNode* func) {
     analyzer->functions_analyzed++;
 }
 
+/**
+ * Validates a field of a #[derive(Encode, Decode)] struct: numbers, bool,
+ * char, arrays of them and structs deriving the same traits can be
+ * encoded; #[varint] applies to integers of up to 64 bits.
+ * 
+ * @param analyzer The semantic analyzer
+ * @param struct_def The struct definition AST node
+ * @param field The field to check
+ */
+static void check_encodable_field(SemanticAnalyzer* analyzer, AstNode* struct_def, Field* field) {
+    static const char* const traits[] = { "Encode", "Decode" };
+    Attribute* derive = ast_find_attribute(struct_def->attributes, struct_def->attribute_count, "derive");
+    Type* base = field->type;
+    while (base->kind == TYPE_ARRAY) base = base->data.array.element_type;
+    
+    Attribute* varint = ast_find_attribute(field->attributes, field->attribute_count, "varint");
+    if (varint && (base != field->type || !type_is_integral(base) || base->kind == TYPE_I128 || base->kind == TYPE_U128)) {
+        semantic_error_at(analyzer, varint->line, varint->column, "#[varint] field %s must be an integer of at most 64 bits",
+                          field->name);
+    }
+    
+    if (base->kind == TYPE_STRUCT) {
+        AstNode* inner = layout_find_struct(analyzer->program, base->data.struct_type.name);
+        if (inner && ast_find_attribute(inner->attributes, inner->attribute_count, "soa") && base != field->type) {
+            semantic_error_at(analyzer, derive->line, derive->column, "Field %s: arrays of #[soa] struct %s cannot be encoded",
+                              field->name, base->data.struct_type.name);
+            return;
+        }
+        for (size_t i = 0; i < 2; i++) {
+            if (semantic_derives(struct_def, traits[i]) && (!inner || !semantic_derives(inner, traits[i]))) {
+                semantic_error_at(analyzer, derive->line, derive->column, "Field %s: struct %s must also derive %s",
+                                  field->name, base->data.struct_type.name, traits[i]);
+            }
+        }
+        return;
+    }
+    
+    if (!type_is_numeric(base) && base->kind != TYPE_BOOL && base->kind != TYPE_CHAR) {
+        semantic_error_at(analyzer, derive->line, derive->column,
+                          "Field %s cannot be encoded: only numbers, bool, char, arrays and derived structs can", field->name);
+    }
+}
+
 /**
  * Performs semantic analysis on struct declarations.
  * Creates struct symbol and registers it in the symbol table.
@@ -1117,6 +2712,23 @@ void semantic_check_function(SemanticAnalyzer* analyzer, AstNode* func) {
  */
 void semantic_check_struct(SemanticAnalyzer* analyzer, AstNode* struct_def) {
     const char* struct_name = struct_def->data.struct_def.name;
+    
+    check_attributes(analyzer, struct_def->attributes, struct_def->attribute_count, ATTR_ON_STRUCT);
+    bool serialised = semantic_derives(struct_def, "Encode") || semantic_derives(struct_def, "Decode");
+    for (size_t i = 0; i < struct_def->data.struct_def.field_count; i++) {
+        Field* field = &struct_def->data.struct_def.fields[i];
+        Attribute* varint = ast_find_attribute(field->attributes, field->attribute_count, "varint");
+        check_attributes(analyzer, field->attributes, field->attribute_count, ATTR_ON_FIELD);
+        if (serialised) {
+            check_encodable_field(analyzer, struct_def, field);
+        } else if (varint) {
+            semantic_error_at(analyzer, varint->line, varint->column,
+                              "#[varint] field %s requires #[derive(Encode)] or #[derive(Decode)]", field->name);
+        }
+        if (struct_def->data.struct_def.is_pub) {
+            check_exportable(analyzer, struct_def, field->type);
+        }
+    }
 
     size_t field_count = struct_def->data.struct_def.field_count;
     Symbol** fields = malloc(sizeof(Symbol*) * field_count);
@@ -1155,14 +2767,21 @@ void semantic_check_impl(SemanticAnalyzer* analyzer, AstNode* impl) {
         return;
     }
 
+    AstNode* struct_def = layout_find_struct(analyzer->program, struct_name);
     for (size_t i = 0; i < impl->data.impl_block.function_count; i++) {
         AstNode* method = impl->data.impl_block.functions[i];
+        const char* name = method->data.function.name;
+        bool encode = strcmp(name, "encode") == 0 || strcmp(name, "encoded_size") == 0;
+        bool decode = strcmp(name, "decode") == 0 || strcmp(name, "view") == 0;
+        if (struct_def && ((encode && semantic_derives(struct_def, "Encode")) ||
+                           (decode && semantic_derives(struct_def, "Decode")))) {
+            Attribute* derive = ast_find_attribute(struct_def->attributes, struct_def->attribute_count, "derive");
+            semantic_error_at(analyzer, derive->line, derive->column, "Method %s conflicts with #[derive(%s)] on %s",
+                              name, encode ? "Encode" : "Decode", struct_name);
+        }
+        check_public_signature(analyzer, method);
 
-        char method_full_name[256];
-        snprintf(method_full_name, sizeof(method_full_name), "%s::%s",
-                struct_name, method->data.function.name);
-
-        char* saved_name = string_duplicate(method_full_name);
+        char* saved_name = string_format("%s::%s", struct_name, method->data.function.name);
         char* orig_name = method->data.function.name;
         method->data.function.name = saved_name;
 
@@ -1215,8 +2834,12 @@ static void analyze_node(SemanticAnalyzer* analyzer, AstNode* node) {
             }
 
             for (size_t i = 0; i < node->data.program.count; i++) {
-                if (node->data.program.items[i]->type == AST_IMPL) {
-                    semantic_check_impl(analyzer, node->data.program.items[i]);
+                AstNode* item = node->data.program.items[i];
+                if (item->type == AST_IMPL) {
+                    semantic_check_impl(analyzer, item);
+                }
+                if (item->type == AST_IMPL || item->type == AST_INCLUDE) {
+                    check_attributes(analyzer, item->attributes, item->attribute_count, ATTR_ON_OTHER);
                 }
             }
 
@@ -1233,6 +2856,7 @@ static void analyze_node(SemanticAnalyzer* analyzer, AstNode* node) {
             break;
         
         case AST_EXTERN_FUNCTION:
+            check_attributes(analyzer, node->attributes, node->attribute_count, ATTR_ON_OTHER);
             {
                 Symbol* func_sym = symbol_table_define(analyzer->symbols, 
                     node->data.extern_function.name,
@@ -1248,6 +2872,13 @@ static void analyze_node(SemanticAnalyzer* analyzer, AstNode* node) {
                     func_sym->info.function.param_mutability = malloc(sizeof(bool) * node->data.extern_function.param_count);
                     
                     for (size_t i = 0; i < node->data.extern_function.param_count; i++) {
+                        // A jfm_fn is a code/environment pair, not a C function pointer
+                        Type* param_type = node->data.extern_function.params[i].type;
+                        if (param_type && param_type->kind == TYPE_FUNCTION) {
+                            semantic_error_node(analyzer, node, "Parameter %s of extern function %s cannot have a fn type",
+                                                node->data.extern_function.params[i].name,
+                                                node->data.extern_function.name);
+                        }
                         func_sym->info.function.param_types[i] = node->data.extern_function.params[i].type;
                         func_sym->info.function.param_names[i] = string_duplicate(node->data.extern_function.params[i].name);
                         func_sym->info.function.param_mutability[i] = false;
@@ -1275,6 +2906,7 @@ static void analyze_node(SemanticAnalyzer* analyzer, AstNode* node) {
  * @return true if analysis succeeded without errors, false otherwise
  */
 bool semantic_analyze(SemanticAnalyzer* analyzer, AstNode* ast) {
+    analyzer->program = ast;
     analyze_node(analyzer, ast);
     return analyzer->success;
 }
\ No newline at end of file
@@ -7,6 +7,32 @@
 #include "error.h"
 #include "type.h"
 
+#define MAX_UNROLL 65534   // Largest factor accepted by #[unroll(N)], as for #pragma GCC unroll
+
+// Closure whose body is being analysed; variables resolved outside its
+// scope are captured by reference
+typedef struct ClosureContext {
+    AstNode* closure;
+    Scope* scope;
+    struct ClosureContext* parent;
+} ClosureContext;
+
+// Byte access builtin such as load_le_u32(p) or store_be_u16(p, v)
+typedef struct {
+    bool is_store;
+    char order;        // 'l'ittle endian, 'b'ig endian or 'n'ative (unaligned access)
+    TypeKind kind;     // Type of the loaded or stored value
+} ByteAccess;
+
+// Method generated by #[derive(Encode, Decode)]
+typedef enum {
+    SERIAL_NONE,
+    SERIAL_ENCODED_SIZE,   // value.encoded_size()
+    SERIAL_ENCODE,         // value.encode(buf, capacity)
+    SERIAL_DECODE,         // Struct::decode(buf, length)
+    SERIAL_VIEW,           // Struct::view(buf, length), zero-copy
+} SerialMethod;
+
 // Semantic analyzer with comprehensive type checking
 typedef struct {
     SymbolTable* symbols;
@@ -26,6 +52,10 @@ typedef struct {
     // Source code for error reporting
     const char* source_code;
     const char* filename;
+    
+    AstNode* program;             // Program being analyzed, for layout queries
+    bool soa_element_access;      // Next index expression is the object of a field access
+    ClosureContext* closures;     // Innermost closure being analysed, or NULL
 } SemanticAnalyzer;
 
 // Analyzer lifecycle
@@ -38,6 +68,9 @@ void semantic_set_source(SemanticAnalyzer* analyzer, const char* source, const c
 Type* semantic_check_expression(SemanticAnalyzer* analyzer, AstNode* expr);
 Type* semantic_infer_type(SemanticAnalyzer* analyzer, AstNode* expr);
 bool semantic_check_types_compatible(Type* expected, Type* actual);
+bool semantic_byte_access(const char* name, ByteAccess* access);
+bool semantic_derives(AstNode* struct_def, const char* trait);
+SerialMethod semantic_serial_call(AstNode* program, AstNode* call, AstNode** struct_def);
 
 // Statement analysis
 void semantic_check_statement(SemanticAnalyzer* analyzer, AstNode* stmt);
@@ -53,6 +86,8 @@ bool types_equal(Type* a, Type* b);
 bool type_is_numeric(Type* type);
 bool type_is_integral(Type* type);
 bool type_is_signed(Type* type);
+bool type_is_float(Type* type);
+bool type_is_half(Type* type);
 bool type_is_reference(Type* type);
 bool type_is_pointer(Type* type);
 Type* type_dereference(Type* type);
@@ -61,5 +96,7 @@ Type* type_dereference(Type* type);
 void semantic_error(SemanticAnalyzer* analyzer, const char* format, ...);
 void semantic_error_at(SemanticAnalyzer* analyzer, size_t line, size_t column, const char* format, ...);
 void semantic_error_node(SemanticAnalyzer* analyzer, AstNode* node, const char* format, ...);
+void semantic_warning_at(SemanticAnalyzer* analyzer, size_t line, size_t column, const char* format, ...);
+void semantic_warning_node(SemanticAnalyzer* analyzer, AstNode* node, const char* format, ...);
 
 #endif
\ No newline at end of file
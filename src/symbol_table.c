@@ -4,8 +4,9 @@
 #include <string.h>
 #include <stdio.h>
 
-#define INITIAL_TABLE_SIZE 127  // Prime number for better hash distribution
-#define INITIAL_TYPE_CAPACITY 32
+#define INITIAL_TABLE_SIZE 7  // Small prime; scope tables grow as symbols are defined
+#define INITIAL_TYPE_CAPACITY 32  // Power of two, for probing the type registry
+#define INITIAL_BINDING_CAPACITY 64  // Power of two, for probing the bindings
 
 /**
  * Computes hash value for string keys using djb2 algorithm.
@@ -37,9 +38,38 @@ static Scope* scope_create(ScopeType type, Scope* parent) {
     scope->table_size = INITIAL_TABLE_SIZE;
     scope->symbols = calloc(scope->table_size, sizeof(Symbol*));
     scope->level = parent ? parent->level + 1 : 0;
+    scope->function = type == SCOPE_FUNCTION ? scope : parent ? parent->function : NULL;
+    scope->impl = type == SCOPE_STRUCT ? scope : parent ? parent->impl : NULL;
     return scope;
 }
 
+/**
+ * Frees a symbol with its name, parameter lists and field symbols. The
+ * types it refers to belong to the AST and are not freed.
+ * 
+ * @param sym The symbol to free
+ */
+static void symbol_destroy(Symbol* sym) {
+    free(sym->name);
+    if (sym->kind == SYMBOL_FUNCTION) {
+        if (sym->info.function.param_names) {
+            for (size_t j = 0; j < sym->info.function.param_count; j++) {
+                free(sym->info.function.param_names[j]);
+            }
+        }
+        free(sym->info.function.param_names);
+        free(sym->info.function.param_mutability);
+        free(sym->info.function.param_types);
+    } else if (sym->kind == SYMBOL_STRUCT) {
+        for (size_t j = 0; j < sym->info.struct_def.field_count; j++) {
+            free(sym->info.struct_def.fields[j]->name);
+            free(sym->info.struct_def.fields[j]);
+        }
+        free(sym->info.struct_def.fields);
+    }
+    free(sym);
+}
+
 /**
  * Destroys a scope and all its symbols, freeing associated memory.
  * 
@@ -52,16 +82,7 @@ static void scope_destroy(Scope* scope) {
         Symbol* sym = scope->symbols[i];
         while (sym) {
             Symbol* next = sym->next;
-            free(sym->name);
-            if (sym->kind == SYMBOL_FUNCTION) {
-                for (size_t j = 0; j < sym->info.function.param_count; j++) {
-                    free(sym->info.function.param_names[j]);
-                }
-                free(sym->info.function.param_names);
-                free(sym->info.function.param_mutability);
-            } else if (sym->kind == SYMBOL_STRUCT) {
-            }
-            free(sym);
+            symbol_destroy(sym);
             sym = next;
         }
     }
@@ -71,6 +92,32 @@ static void scope_destroy(Scope* scope) {
     free(scope);
 }
 
+/**
+ * Doubles a scope's hash table and rehashes its symbols, keeping chains
+ * short however many symbols the scope holds.
+ * 
+ * @param scope The scope to grow
+ */
+static void scope_grow(Scope* scope) {
+    size_t new_size = scope->table_size * 2 + 1;
+    Symbol** new_symbols = calloc(new_size, sizeof(Symbol*));
+    
+    for (size_t i = 0; i < scope->table_size; i++) {
+        Symbol* sym = scope->symbols[i];
+        while (sym) {
+            Symbol* next = sym->next;
+            size_t index = hash_string(sym->name, new_size);
+            sym->next = new_symbols[index];
+            new_symbols[index] = sym;
+            sym = next;
+        }
+    }
+    
+    free(scope->symbols);
+    scope->symbols = new_symbols;
+    scope->table_size = new_size;
+}
+
 /**
  * Defines a symbol in the given scope.
  * Checks for redefinition conflicts within the same scope.
@@ -94,6 +141,10 @@ static Symbol* scope_define(Scope* scope, Symbol* symbol) {
     scope->symbols[index] = symbol;
     symbol->scope = scope;
     
+    if (++scope->symbol_count > scope->table_size) {
+        scope_grow(scope);
+    }
+    
     return symbol;
 }
 
@@ -119,6 +170,55 @@ static Symbol* scope_lookup(Scope* scope, const char* name) {
     return NULL;
 }
 
+/**
+ * Finds the binding for a name: the slot holding it, or the empty slot
+ * where it would be inserted.
+ * 
+ * @param bindings The binding slots
+ * @param capacity Number of slots (a power of two)
+ * @param name The symbol name
+ * @return Pointer to the slot
+ */
+static SymbolBinding* find_binding(SymbolBinding* bindings, size_t capacity, const char* name) {
+    size_t index = hash_string(name, capacity);
+    while (bindings[index].name && strcmp(bindings[index].name, name) != 0) {
+        index = (index + 1) & (capacity - 1);
+    }
+    return &bindings[index];
+}
+
+/**
+ * Returns the binding for a name, adding an empty one if the name is new.
+ * Bindings are never removed, so the table stays at most half full.
+ * 
+ * @param table The symbol table
+ * @param name The symbol name
+ * @return The binding
+ */
+static SymbolBinding* bind_name(SymbolTable* table, const char* name) {
+    SymbolBinding* binding = find_binding(table->bindings, table->binding_capacity, name);
+    if (binding->name) return binding;
+    
+    if ((table->binding_count + 1) * 2 > table->binding_capacity) {
+        size_t new_capacity = table->binding_capacity * 2;
+        SymbolBinding* new_bindings = calloc(new_capacity, sizeof(SymbolBinding));
+        for (size_t i = 0; i < table->binding_capacity; i++) {
+            if (table->bindings[i].name) {
+                *find_binding(new_bindings, new_capacity, table->bindings[i].name) = table->bindings[i];
+            }
+        }
+        free(table->bindings);
+        table->bindings = new_bindings;
+        table->binding_capacity = new_capacity;
+        binding = find_binding(table->bindings, table->binding_capacity, name);
+    }
+    
+    binding->name = string_duplicate(name);
+    binding->symbol = NULL;
+    table->binding_count++;
+    return binding;
+}
+
 /**
  * Creates a new symbol table with global scope.
  * Initializes type storage and error tracking.
@@ -131,6 +231,8 @@ SymbolTable* symbol_table_create(void) {
     table->current = table->global;
     table->type_capacity = INITIAL_TYPE_CAPACITY;
     table->types = calloc(table->type_capacity, sizeof(Symbol*));
+    table->binding_capacity = INITIAL_BINDING_CAPACITY;
+    table->bindings = calloc(table->binding_capacity, sizeof(SymbolBinding));
     table->has_errors = false;
     return table;
 }
@@ -152,6 +254,13 @@ void symbol_table_destroy(SymbolTable* table) {
     
     scope_destroy(table->global);
     
+    for (size_t i = 0; i < table->binding_capacity; i++) {
+        free(table->bindings[i].name);
+    }
+    free(table->bindings);
+    for (size_t i = 0; i < table->type_capacity; i++) {
+        if (table->types[i]) symbol_destroy(table->types[i]);
+    }
     free(table->types);
     free(table);
 }
@@ -191,6 +300,7 @@ void symbol_table_enter_struct_scope(SymbolTable* table, const char* struct_name
 
 /**
  * Exits the current scope and returns to the parent scope.
+ * Its symbols' names are bound again to whatever they shadowed.
  * Does not exit the global scope.
  * 
  * @param table The symbol table
@@ -198,6 +308,11 @@ void symbol_table_enter_struct_scope(SymbolTable* table, const char* struct_name
 void symbol_table_exit_scope(SymbolTable* table) {
     if (table->current && table->current != table->global) {
         Scope* parent = table->current->parent;
+        for (size_t i = 0; i < table->current->table_size; i++) {
+            for (Symbol* sym = table->current->symbols[i]; sym; sym = sym->next) {
+                find_binding(table->bindings, table->binding_capacity, sym->name)->symbol = sym->shadowed;
+            }
+        }
         scope_destroy(table->current);
         table->current = parent;
     }
@@ -236,29 +351,23 @@ Symbol* symbol_table_define(SymbolTable* table, const char* name, SymbolKind kin
         return NULL;
     }
     
+    SymbolBinding* binding = bind_name(table, name);
+    result->shadowed = binding->symbol;
+    binding->symbol = result;
     return result;
 }
 
 /**
- * Looks up a symbol by name, searching through the scope chain.
- * Searches from current scope up to global scope.
+ * Looks up a symbol by name, as seen from the current scope.
+ * Finds the innermost definition in constant time however deeply the
+ * current scope is nested.
  * 
  * @param table The symbol table
  * @param name The symbol name to find
  * @return The found symbol, or NULL if not found
  */
 Symbol* symbol_table_lookup(SymbolTable* table, const char* name) {
-    Scope* scope = table->current;
-    
-    while (scope) {
-        Symbol* sym = scope_lookup(scope, name);
-        if (sym) {
-            return sym;
-        }
-        scope = scope->parent;
-    }
-    
-    return NULL;
+    return find_binding(table->bindings, table->binding_capacity, name)->symbol;
 }
 
 /**
@@ -304,6 +413,23 @@ Symbol* symbol_table_lookup_struct(SymbolTable* table, const char* name) {
     return NULL;
 }
 
+/**
+ * Finds the slot for a type name in the open-addressed type registry: the
+ * slot holding that type, or the empty slot where it would be inserted.
+ * 
+ * @param types The registry slots
+ * @param capacity Number of slots (a power of two)
+ * @param name The type name
+ * @return Pointer to the slot
+ */
+static Symbol** find_type_slot(Symbol** types, size_t capacity, const char* name) {
+    size_t index = hash_string(name, capacity);
+    while (types[index] && strcmp(types[index]->name, name) != 0) {
+        index = (index + 1) & (capacity - 1);
+    }
+    return &types[index];
+}
+
 /**
  * Registers a user-defined type symbol.
  * Expands type storage if needed and checks for duplicates.
@@ -314,37 +440,39 @@ Symbol* symbol_table_lookup_struct(SymbolTable* table, const char* name) {
  * @return true on success, false if already exists
  */
 bool symbol_table_register_type(SymbolTable* table, const char* name, Symbol* type_symbol) {
-    for (size_t i = 0; i < table->type_count; i++) {
-        if (strcmp(table->types[i]->name, name) == 0) {
-            table->has_errors = true;
-            return false;  // Already registered
-        }
+    if (*find_type_slot(table->types, table->type_capacity, name)) {
+        table->has_errors = true;
+        return false;  // Already registered
     }
     
-    if (table->type_count >= table->type_capacity) {
-        table->type_capacity *= 2;
-        table->types = realloc(table->types, table->type_capacity * sizeof(Symbol*));
+    // Keep the registry at most half full so probe sequences stay short
+    if ((table->type_count + 1) * 2 > table->type_capacity) {
+        size_t new_capacity = table->type_capacity * 2;
+        Symbol** new_types = calloc(new_capacity, sizeof(Symbol*));
+        for (size_t i = 0; i < table->type_capacity; i++) {
+            if (table->types[i]) {
+                *find_type_slot(new_types, new_capacity, table->types[i]->name) = table->types[i];
+            }
+        }
+        free(table->types);
+        table->types = new_types;
+        table->type_capacity = new_capacity;
     }
     
-    table->types[table->type_count++] = type_symbol;
+    *find_type_slot(table->types, table->type_capacity, name) = type_symbol;
+    table->type_count++;
     return true;
 }
 
 /**
- * Looks up a type symbol by name.
- * Searches the registered types list.
+ * Looks up a type symbol by name in the type registry.
  * 
  * @param table The symbol table
  * @param name The type name to find
  * @return The type symbol, or NULL if not found
  */
 Symbol* symbol_table_lookup_type(SymbolTable* table, const char* name) {
-    for (size_t i = 0; i < table->type_count; i++) {
-        if (strcmp(table->types[i]->name, name) == 0) {
-            return table->types[i];
-        }
-    }
-    return NULL;
+    return *find_type_slot(table->types, table->type_capacity, name);
 }
 
 /**
@@ -377,36 +505,18 @@ bool symbol_table_in_loop(SymbolTable* table) {
  * @return true if in a function, false otherwise
  */
 bool symbol_table_in_function(SymbolTable* table) {
-    Scope* scope = table->current;
-    
-    while (scope) {
-        if (scope->type == SCOPE_FUNCTION) {
-            return true;
-        }
-        scope = scope->parent;
-    }
-    
-    return false;
+    return table->current && table->current->function;
 }
 
 /**
  * Gets the return type of the current function.
- * Searches up the scope chain for the enclosing function.
  * 
  * @param table The symbol table
  * @return The function's return type, or NULL if not in a function
  */
 Type* symbol_table_get_return_type(SymbolTable* table) {
-    Scope* scope = table->current;
-    
-    while (scope) {
-        if (scope->type == SCOPE_FUNCTION) {
-            return scope->return_type;
-        }
-        scope = scope->parent;
-    }
-    
-    return NULL;
+    Scope* function = table->current ? table->current->function : NULL;
+    return function ? function->return_type : NULL;
 }
 
 /**
@@ -417,16 +527,8 @@ Type* symbol_table_get_return_type(SymbolTable* table) {
  * @return The struct name, or NULL if not in an impl block
  */
 const char* symbol_table_get_current_struct(SymbolTable* table) {
-    Scope* scope = table->current;
-    
-    while (scope) {
-        if (scope->type == SCOPE_STRUCT) {
-            return scope->struct_name;
-        }
-        scope = scope->parent;
-    }
-    
-    return NULL;
+    Scope* impl = table->current ? table->current->impl : NULL;
+    return impl ? impl->struct_name : NULL;
 }
 
 /**
@@ -5,6 +5,8 @@
 #include <stddef.h>
 #include "type.h"
 
+struct AstNode;
+
 // Symbol kinds for different types of identifiers
 typedef enum {
     SYMBOL_VARIABLE,
@@ -39,6 +41,13 @@ typedef struct Symbol {
     struct Scope* scope;
     int offset;  // For stack allocation
     
+    // Function or closure an immutable fn-typed variable is bound to
+    struct AstNode* function_value;
+    
+    // Deepest scope holding the environment of a closure stored in the
+    // value, which must not be stored where it outlives that scope (0: none)
+    size_t capture_level;
+    
     // Additional metadata
     union {
         struct {
@@ -56,7 +65,8 @@ typedef struct Symbol {
         } param;
     } info;
     
-    struct Symbol* next;  // For hash collision chaining
+    struct Symbol* next;      // For hash collision chaining
+    struct Symbol* shadowed;  // Binding of the same name this symbol hides
 } Symbol;
 
 // Scope for managing nested scopes
@@ -64,22 +74,36 @@ typedef struct Scope {
     struct Scope* parent;
     ScopeType type;
     
-    // Hash table for symbols
+    // Hash table for symbols, grown as symbols are defined
     Symbol** symbols;
     size_t table_size;
+    size_t symbol_count;
     
     // Scope metadata
     Type* return_type;      // For function scopes
     char* struct_name;      // For struct impl blocks
     size_t level;          // Nesting level
+    struct Scope* function; // Innermost enclosing function scope (or itself)
+    struct Scope* impl;     // Innermost enclosing struct scope (or itself)
 } Scope;
 
+// Innermost visible symbol for a name, so lookups need not walk the scopes
+typedef struct {
+    char* name;
+    Symbol* symbol;         // NULL while no scope defines the name
+} SymbolBinding;
+
 // Symbol table with scope management
 typedef struct {
     Scope* current;
     Scope* global;
     
-    // Type registry for user-defined types
+    // Open-addressed hash table of every name ever defined
+    SymbolBinding* bindings;
+    size_t binding_count;
+    size_t binding_capacity;
+    
+    // Type registry for user-defined types, an open-addressed hash table
     Symbol** types;
     size_t type_count;
     size_t type_capacity;
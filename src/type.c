@@ -1,5 +1,7 @@
 #include "type.h"
 #include "lexer.h"
+#include "ast.h"
+#include "utils.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -12,16 +14,25 @@
 Type* type_create(TypeKind kind) {
     Type* type = calloc(1, sizeof(Type));
     type->kind = kind;
+    ast_pool_add_type(type);
     return type;
 }
 
 /**
- * Destroys a type and frees its memory.
+ * Destroys a type and what it owns (a struct name, a parameter list).
+ * The types it refers to are not destroyed.
  * 
  * @param type The type to destroy
  */
 void type_destroy(Type* type) {
     if (!type) return;
+    ast_pool_remove_type(type);
+    if (type->kind == TYPE_STRUCT) {
+        free(type->data.struct_type.name);
+    } else if (type->kind == TYPE_FUNCTION) {
+        free(type->data.function.param_types);
+    }
+    free(type->spelling);
     free(type);
 }
 
@@ -39,7 +50,9 @@ bool type_equals(Type* a, Type* b) {
 }
 
 /**
- * Converts a type to its string representation.
+ * Converts a type to its string representation, spelled as in JFM source
+ * (e.g. "[Particle; 100]" or "&mut i32"). The string lives as long as the
+ * type.
  * 
  * @param type The type to convert
  * @return String representation of the type
@@ -52,16 +65,41 @@ const char* type_to_string(Type* type) {
         case TYPE_I16: return "i16";
         case TYPE_I32: return "i32";
         case TYPE_I64: return "i64";
+        case TYPE_I128: return "i128";
         case TYPE_U8: return "u8";
         case TYPE_U16: return "u16";
         case TYPE_U32: return "u32";
         case TYPE_U64: return "u64";
+        case TYPE_U128: return "u128";
+        case TYPE_F16: return "f16";
+        case TYPE_BF16: return "bf16";
         case TYPE_F32: return "f32";
         case TYPE_F64: return "f64";
         case TYPE_BOOL: return "bool";
         case TYPE_CHAR: return "char";
         case TYPE_STR: return "str";
         case TYPE_VOID: return "void";
+        case TYPE_FUNCTION: return "fn";
+        case TYPE_OPTION: return "Option";
+        case TYPE_RESULT: return "Result";
+        case TYPE_STRUCT: return type->data.struct_type.name;
+        case TYPE_ARRAY:
+            if (!type->spelling) {
+                type->spelling = string_format("[%s; %zu]", type_to_string(type->data.array.element_type),
+                                               type->data.array.size);
+            }
+            return type->spelling;
+        case TYPE_POINTER:
+            if (!type->spelling) {
+                type->spelling = string_format("*%s", type_to_string(type->data.pointer.pointed_type));
+            }
+            return type->spelling;
+        case TYPE_REFERENCE:
+            if (!type->spelling) {
+                type->spelling = string_format("&%s%s", type->data.reference.is_mutable ? "mut " : "",
+                                               type_to_string(type->data.reference.referenced_type));
+            }
+            return type->spelling;
         default: return "unknown";
     }
 }
@@ -78,10 +116,14 @@ Type* type_from_token(TokenType token) {
         case TOKEN_I16: return type_create(TYPE_I16);
         case TOKEN_I32: return type_create(TYPE_I32);
         case TOKEN_I64: return type_create(TYPE_I64);
+        case TOKEN_I128: return type_create(TYPE_I128);
         case TOKEN_U8: return type_create(TYPE_U8);
         case TOKEN_U16: return type_create(TYPE_U16);
         case TOKEN_U32: return type_create(TYPE_U32);
         case TOKEN_U64: return type_create(TYPE_U64);
+        case TOKEN_U128: return type_create(TYPE_U128);
+        case TOKEN_F16: return type_create(TYPE_F16);
+        case TOKEN_BF16: return type_create(TYPE_BF16);
         case TOKEN_F32: return type_create(TYPE_F32);
         case TOKEN_F64: return type_create(TYPE_F64);
         case TOKEN_BOOL: return type_create(TYPE_BOOL);
@@ -10,10 +10,14 @@ typedef enum {
     TYPE_I16,
     TYPE_I32,
     TYPE_I64,
+    TYPE_I128,
     TYPE_U8,
     TYPE_U16,
     TYPE_U32,
     TYPE_U64,
+    TYPE_U128,
+    TYPE_F16,       // IEEE binary16
+    TYPE_BF16,      // bfloat16: f32 with the low 16 mantissa bits dropped
     TYPE_F32,
     TYPE_F64,
     TYPE_BOOL,
@@ -24,6 +28,9 @@ typedef enum {
     TYPE_POINTER,
     TYPE_REFERENCE,
     TYPE_STRUCT,
+    TYPE_FUNCTION,
+    TYPE_OPTION,
+    TYPE_RESULT,
     TYPE_UNKNOWN,
 } TypeKind;
 
@@ -48,7 +55,24 @@ typedef struct Type {
         struct {
             char* name;
         } struct_type;
+        
+        struct {
+            struct Type** param_types;
+            size_t param_count;
+            struct Type* return_type;   // NULL for no return value
+        } function;
+        
+        struct {
+            struct Type* value_type;    // NULL for a None not yet matched to an Option
+        } option;
+        
+        struct {
+            struct Type* ok_type;       // NULL in the type of Err(e)
+            struct Type* err_type;      // NULL in the type of Ok(v)
+        } result;
     } data;
+    
+    char* spelling;     // Source spelling of an array, pointer or reference type, built on first use
 } Type;
 
 Type* type_create(TypeKind kind);
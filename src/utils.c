@@ -66,4 +66,42 @@ char* string_n_duplicate(const char* str, size_t n) {
         copy[n] = '\0';
     }
     return copy;
+}
+
+/**
+ * Formats a string into a newly allocated buffer of exactly the needed size.
+ * 
+ * @param format Printf-style format string
+ * @param args Format arguments (left unconsumed)
+ * @return Newly allocated formatted string, or NULL on error
+ */
+char* string_vformat(const char* format, va_list args) {
+    va_list copy;
+    va_copy(copy, args);
+    int len = vsnprintf(NULL, 0, format, copy);
+    va_end(copy);
+    if (len < 0) return NULL;
+    
+    char* result = malloc((size_t)len + 1);
+    if (result) {
+        va_copy(copy, args);
+        vsnprintf(result, (size_t)len + 1, format, copy);
+        va_end(copy);
+    }
+    return result;
+}
+
+/**
+ * Formats a string into a newly allocated buffer of exactly the needed size.
+ * 
+ * @param format Printf-style format string
+ * @param ... Format arguments
+ * @return Newly allocated formatted string, or NULL on error
+ */
+char* string_format(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    char* result = string_vformat(format, args);
+    va_end(args);
+    return result;
 }
\ No newline at end of file
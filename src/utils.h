@@ -1,10 +1,13 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <stdarg.h>
 #include <stddef.h>
 
 char* read_file(const char* path);
 char* string_duplicate(const char* str);
 char* string_n_duplicate(const char* str, size_t n);
+char* string_format(const char* format, ...);
+char* string_vformat(const char* format, va_list args);
 
 #endif
\ No newline at end of file
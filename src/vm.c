@@ -0,0 +1,839 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  // RTLD_DEFAULT
+#endif
+#include "vm.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+
+// Extern fns are called through one shim type per return class. It relies
+// on calling conventions that assign integer and floating-point arguments
+// to separate register files and let a callee ignore surplus arguments
+// (System V x86-64, AAPCS64); elsewhere programs with externs are compiled.
+#if (defined(__x86_64__) && !defined(_WIN32)) || defined(__aarch64__)
+#define VM_EXTERN_SHIMS
+#include <dlfcn.h>
+#endif
+
+// Dispatch with computed goto where the compiler supports it
+#ifdef __GNUC__
+#define VM_COMPUTED_GOTO
+#endif
+
+// Limits of the VM stacks: registers, call frames and array storage
+#define VM_STACK_REGISTERS (1u << 22)
+#define VM_STACK_FRAMES (1u << 20)
+#define VM_STACK_MEMORY (8u << 20)
+
+// Bytecode operations. Integers are canonical 64-bit values as in the IR;
+// *_S / *_U are signed / unsigned, F* operate on doubles. BR_* and
+// LOAD_ADD_* are superinstructions for compare-and-branch and for adding an
+// array element to a value.
+#define VM_OPCODES(X) \
+    X(CONST) X(MOVE) X(STRING) X(FRAME) \
+    X(ADD) X(SUB) X(MUL) X(ADD_I32) X(SUB_I32) X(MUL_I32) \
+    X(DIV_S) X(DIV_U) X(REM_S) X(REM_U) X(AND) X(OR) X(XOR) X(SHL) X(SHR_S) X(SHR_U) X(NEG) X(NOT) \
+    X(FADD) X(FSUB) X(FMUL) X(FDIV) X(FNEG) X(SQRT) X(ROUND_F32) \
+    X(EXT_I8) X(EXT_U8) X(EXT_I16) X(EXT_U16) X(EXT_I32) X(EXT_U32) \
+    X(EQ) X(NE) X(LT_S) X(LE_S) X(GT_S) X(GE_S) X(LT_U) X(LE_U) X(GT_U) X(GE_U) \
+    X(FEQ) X(FNE) X(FLT) X(FLE) X(FGT) X(FGE) \
+    X(I2F) X(U2F) X(I2F32) X(U2F32) X(F2I) X(F2U) X(F2BOOL) X(I2BOOL) \
+    X(LOAD_I8) X(LOAD_U8) X(LOAD_I16) X(LOAD_U16) X(LOAD_I32) X(LOAD_U32) X(LOAD_64) X(LOAD_F32) \
+    X(STORE_8) X(STORE_16) X(STORE_32) X(STORE_64) X(STORE_F32) \
+    X(JUMP) X(JUMP_IF) X(JUMP_UNLESS) \
+    X(BR_EQ) X(BR_NE) X(BR_LT_S) X(BR_LE_S) X(BR_GT_S) X(BR_GE_S) X(BR_LT_U) X(BR_LE_U) X(BR_GT_U) X(BR_GE_U) \
+    X(LOAD_ADD_I32) X(LOAD_ADD_I64) X(LOAD_ADD_F64) \
+    X(CALL) X(CALL_EXTERN) X(RETURN) X(PRINT)
+
+#define VM_ENUM(name) VM_##name,
+typedef enum {
+    VM_OPCODES(VM_ENUM)
+} VmOpcode;
+#undef VM_ENUM
+
+typedef union {
+    int64_t i;
+    uint64_t u;
+    double f;
+    const char* p;
+} VmValue;
+
+// One instruction: dst = a op b (c is the third operand of stores and
+// LOAD_ADD). imm holds constants, jump targets (instruction indexes),
+// function / extern / string indexes and frame offsets.
+typedef struct {
+    const void* handler;   // Dispatch label, filled in before the first run
+    VmOpcode op;
+    int dst;
+    int a;
+    int b;
+    int c;
+    int64_t imm;
+} VmInstr;
+
+typedef struct {
+    VmInstr* code;
+    size_t count;
+    size_t capacity;
+    size_t register_count;
+    size_t frame_size;     // Bytes of array storage
+} VmFunction;
+
+typedef struct {
+    void* address;
+    IrType* param_types;
+    size_t param_count;
+    IrType return_type;
+} VmExtern;
+
+struct VmProgram {
+    VmFunction* functions;
+    size_t function_count;
+    size_t main_index;
+    VmExtern* externs;
+    size_t extern_count;
+    char** strings;
+    size_t string_count;
+    int* call_args;        // Argument registers of all calls, indexed by CALL's a
+    size_t call_arg_count;
+    size_t call_arg_capacity;
+    bool threaded;
+    void* libm;            // libm opened to resolve externs, closed with the program
+};
+
+typedef struct {
+    const VmFunction* function;
+    const VmInstr* return_pc;
+    VmValue* registers;
+    char* memory;
+    int dst;
+} VmFrame;
+
+#ifdef VM_EXTERN_SHIMS
+typedef uint64_t (*VmIntShim)(uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t,
+                              double, double, double, double, double, double, double, double);
+typedef double (*VmFloatShim)(uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t,
+                              double, double, double, double, double, double, double, double);
+
+/**
+ * Looks up an extern fn in the running process, then in libm, which the
+ * generated C always links. The program holds its own libm handle, so
+ * programs compiled on different threads share no state.
+ */
+static void* resolve_symbol(VmProgram* program, const char* name) {
+    void* address = dlsym(RTLD_DEFAULT, name);
+    if (!address && !program->libm) {
+        program->libm = dlopen("libm.so.6", RTLD_LAZY);
+        if (!program->libm) program->libm = dlopen("libm.so", RTLD_LAZY);
+    }
+    if (!address && program->libm) address = dlsym(program->libm, name);
+    return address;
+}
+#endif
+
+static VmInstr* emit(VmFunction* f, VmOpcode op, int dst, int a, int b) {
+    if (f->count >= f->capacity) {
+        f->capacity = f->capacity ? f->capacity * 2 : 64;
+        f->code = realloc(f->code, sizeof(VmInstr) * f->capacity);
+    }
+    VmInstr* instr = &f->code[f->count++];
+    *instr = (VmInstr){ NULL, op, dst, a, b, -1, 0 };
+    return instr;
+}
+
+/**
+ * Emits the sign or zero extension that makes an integer of the given type
+ * canonical again, if it is narrower than 64 bits.
+ */
+static void emit_extend(VmFunction* f, IrType type, int reg) {
+    switch (type) {
+        case IR_I8:   emit(f, VM_EXT_I8, reg, reg, -1); break;
+        case IR_U8:
+        case IR_BOOL: emit(f, VM_EXT_U8, reg, reg, -1); break;
+        case IR_I16:  emit(f, VM_EXT_I16, reg, reg, -1); break;
+        case IR_U16:  emit(f, VM_EXT_U16, reg, reg, -1); break;
+        case IR_I32:  emit(f, VM_EXT_I32, reg, reg, -1); break;
+        case IR_U32:  emit(f, VM_EXT_U32, reg, reg, -1); break;
+        default: break;
+    }
+}
+
+static VmOpcode compare_opcode(IrOpcode op, IrType type) {
+    bool is_signed = ir_type_is_signed(type);
+    if (ir_type_is_float(type)) {
+        switch (op) {
+            case IR_EQ: return VM_FEQ;
+            case IR_NE: return VM_FNE;
+            case IR_LT: return VM_FLT;
+            case IR_LE: return VM_FLE;
+            case IR_GT: return VM_FGT;
+            default:    return VM_FGE;
+        }
+    }
+    switch (op) {
+        case IR_EQ: return VM_EQ;
+        case IR_NE: return VM_NE;
+        case IR_LT: return is_signed ? VM_LT_S : VM_LT_U;
+        case IR_LE: return is_signed ? VM_LE_S : VM_LE_U;
+        case IR_GT: return is_signed ? VM_GT_S : VM_GT_U;
+        default:    return is_signed ? VM_GE_S : VM_GE_U;
+    }
+}
+
+/**
+ * Maps an integer comparison to its compare-and-branch superinstruction,
+ * negated for branches taken when the comparison is false.
+ */
+static VmOpcode branch_opcode(VmOpcode compare, bool negate) {
+    static const VmOpcode branches[][2] = {
+        [VM_EQ] = { VM_BR_EQ, VM_BR_NE },     [VM_NE] = { VM_BR_NE, VM_BR_EQ },
+        [VM_LT_S] = { VM_BR_LT_S, VM_BR_GE_S }, [VM_LE_S] = { VM_BR_LE_S, VM_BR_GT_S },
+        [VM_GT_S] = { VM_BR_GT_S, VM_BR_LE_S }, [VM_GE_S] = { VM_BR_GE_S, VM_BR_LT_S },
+        [VM_LT_U] = { VM_BR_LT_U, VM_BR_GE_U }, [VM_LE_U] = { VM_BR_LE_U, VM_BR_GT_U },
+        [VM_GT_U] = { VM_BR_GT_U, VM_BR_LE_U }, [VM_GE_U] = { VM_BR_GE_U, VM_BR_LT_U },
+    };
+    return branches[compare][negate ? 1 : 0];
+}
+
+static VmOpcode load_opcode(IrType type) {
+    switch (type) {
+        case IR_I8:   return VM_LOAD_I8;
+        case IR_U8:
+        case IR_BOOL: return VM_LOAD_U8;
+        case IR_I16:  return VM_LOAD_I16;
+        case IR_U16:  return VM_LOAD_U16;
+        case IR_I32:  return VM_LOAD_I32;
+        case IR_U32:  return VM_LOAD_U32;
+        case IR_F32:  return VM_LOAD_F32;
+        default:      return VM_LOAD_64;
+    }
+}
+
+static VmOpcode store_opcode(IrType type) {
+    switch (ir_type_size(type)) {
+        case 1:  return VM_STORE_8;
+        case 2:  return VM_STORE_16;
+        case 4:  return type == IR_F32 ? VM_STORE_F32 : VM_STORE_32;
+        default: return VM_STORE_64;
+    }
+}
+
+/**
+ * Translates an IR conversion with the semantics of a C cast.
+ */
+static void translate_convert(VmFunction* f, const IrInstr* instr) {
+    IrType from = instr->from;
+    IrType to = instr->type;
+
+    if (ir_type_is_float(from) && ir_type_is_float(to)) {
+        emit(f, to == IR_F32 ? VM_ROUND_F32 : VM_MOVE, instr->dst, instr->a, -1);
+    } else if (ir_type_is_float(from)) {
+        if (to == IR_BOOL) {
+            emit(f, VM_F2BOOL, instr->dst, instr->a, -1);
+        } else {
+            emit(f, to == IR_U64 ? VM_F2U : VM_F2I, instr->dst, instr->a, -1);
+            emit_extend(f, to, instr->dst);
+        }
+    } else if (ir_type_is_float(to)) {
+        VmOpcode op = from == IR_U64 ? (to == IR_F32 ? VM_U2F32 : VM_U2F) : (to == IR_F32 ? VM_I2F32 : VM_I2F);
+        emit(f, op, instr->dst, instr->a, -1);
+    } else if (to == IR_BOOL) {
+        emit(f, VM_I2BOOL, instr->dst, instr->a, -1);
+    } else {
+        emit(f, VM_MOVE, instr->dst, instr->a, -1);
+        emit_extend(f, to, instr->dst);
+    }
+}
+
+/**
+ * Translates integer and floating-point arithmetic, extending narrow
+ * integer results back to canonical form.
+ */
+static void translate_arithmetic(VmFunction* f, const IrInstr* instr) {
+    IrType type = instr->type;
+    bool is_signed = ir_type_is_signed(type);
+
+    if (ir_type_is_float(type)) {
+        VmOpcode op = instr->op == IR_ADD ? VM_FADD : instr->op == IR_SUB ? VM_FSUB
+                    : instr->op == IR_MUL ? VM_FMUL : instr->op == IR_DIV ? VM_FDIV : VM_FNEG;
+        emit(f, op, instr->dst, instr->a, instr->b);
+        if (type == IR_F32) emit(f, VM_ROUND_F32, instr->dst, instr->dst, -1);
+        return;
+    }
+
+    if (type == IR_I32 && (instr->op == IR_ADD || instr->op == IR_SUB || instr->op == IR_MUL)) {
+        VmOpcode op = instr->op == IR_ADD ? VM_ADD_I32 : instr->op == IR_SUB ? VM_SUB_I32 : VM_MUL_I32;
+        emit(f, op, instr->dst, instr->a, instr->b);
+        return;
+    }
+
+    VmOpcode op;
+    bool extend = true;
+    switch (instr->op) {
+        case IR_ADD: op = VM_ADD; break;
+        case IR_SUB: op = VM_SUB; break;
+        case IR_MUL: op = VM_MUL; break;
+        case IR_DIV: op = is_signed ? VM_DIV_S : VM_DIV_U; break;
+        case IR_REM: op = is_signed ? VM_REM_S : VM_REM_U; break;
+        case IR_SHL: op = VM_SHL; break;
+        case IR_SHR: op = is_signed ? VM_SHR_S : VM_SHR_U; break;
+        case IR_NEG: op = VM_NEG; break;
+        case IR_NOT: op = VM_NOT; break;
+        // Canonical operands give canonical results
+        case IR_AND: op = VM_AND; extend = false; break;
+        case IR_OR:  op = VM_OR; extend = false; break;
+        default:     op = VM_XOR; extend = false; break;
+    }
+    emit(f, op, instr->dst, instr->a, instr->b);
+    if (extend) emit_extend(f, type, instr->dst);
+}
+
+static int add_call_args(VmProgram* program, const IrInstr* instr) {
+    if (program->call_arg_count + instr->arg_count > program->call_arg_capacity) {
+        while (program->call_arg_count + instr->arg_count > program->call_arg_capacity) {
+            program->call_arg_capacity = program->call_arg_capacity ? program->call_arg_capacity * 2 : 64;
+        }
+        program->call_args = realloc(program->call_args, sizeof(int) * program->call_arg_capacity);
+    }
+    int first = (int)program->call_arg_count;
+    for (size_t i = 0; i < instr->arg_count; i++) {
+        program->call_args[program->call_arg_count++] = instr->args[i];
+    }
+    return first;
+}
+
+/**
+ * Translates one IR function to bytecode. Integer comparisons feeding only a
+ * branch become compare-and-branch instructions, an element load feeding
+ * only an addition becomes a load-index-add, and a result that is only
+ * moved into a variable is written to the variable directly.
+ */
+static void translate_function(VmProgram* program, const IrFunction* source, VmFunction* f) {
+    size_t* uses = calloc(source->vreg_count + 1, sizeof(size_t));
+    size_t* defs = calloc(source->vreg_count + 1, sizeof(size_t));
+    size_t* label_pcs = calloc(source->label_count + 1, sizeof(size_t));
+    int operands[8];
+    for (size_t i = 0; i < source->count; i++) {
+        const IrInstr* instr = &source->code[i];
+        size_t count = ir_operands(instr, operands, 8);
+        for (size_t k = 0; k < count; k++) uses[k < 8 ? operands[k] : instr->args[k]]++;
+        if (instr->dst >= 0) defs[instr->dst]++;
+    }
+
+    // Array storage, 16-byte aligned like a C stack frame
+    size_t* frame_offsets = malloc(sizeof(size_t) * (source->frame_count + 1));
+    f->frame_size = 0;
+    for (size_t k = 0; k < source->frame_count; k++) {
+        frame_offsets[k] = f->frame_size;
+        f->frame_size = (f->frame_size + source->frame[k].size + 15) / 16 * 16;
+    }
+    f->register_count = source->vreg_count;
+
+    for (size_t i = 0; i < source->count; i++) {
+        const IrInstr* instr = &source->code[i];
+        const IrInstr* next = i + 1 < source->count ? &source->code[i + 1] : NULL;
+        size_t group = f->count;
+        size_t consumed = 1;
+
+        switch (instr->op) {
+            case IR_LABEL:
+                label_pcs[instr->imm] = f->count;
+                break;
+
+            case IR_CONST:
+                emit(f, VM_CONST, instr->dst, -1, -1)->imm = instr->imm;
+                break;
+
+            case IR_FCONST: {
+                VmValue value = { .f = instr->fimm };
+                emit(f, VM_CONST, instr->dst, -1, -1)->imm = value.i;
+                break;
+            }
+
+            case IR_STRING:
+                emit(f, VM_STRING, instr->dst, -1, -1)->imm = instr->imm;
+                break;
+
+            case IR_FRAME:
+                emit(f, VM_FRAME, instr->dst, -1, -1)->imm = (int64_t)frame_offsets[instr->imm];
+                break;
+
+            case IR_MOVE:
+                emit(f, VM_MOVE, instr->dst, instr->a, -1);
+                break;
+
+            case IR_SQRT:
+                emit(f, VM_SQRT, instr->dst, instr->a, -1);
+                break;
+
+            case IR_EQ:
+            case IR_NE:
+            case IR_LT:
+            case IR_LE:
+            case IR_GT:
+            case IR_GE: {
+                VmOpcode op = compare_opcode(instr->op, instr->type);
+                if (!ir_type_is_float(instr->type) && next && uses[instr->dst] == 1 &&
+                    (next->op == IR_JUMP_IF || next->op == IR_JUMP_UNLESS) && next->a == instr->dst) {
+                    emit(f, branch_opcode(op, next->op == IR_JUMP_UNLESS), -1, instr->a, instr->b)->imm = next->imm;
+                    consumed = 2;
+                } else {
+                    emit(f, op, instr->dst, instr->a, instr->b);
+                }
+                break;
+            }
+
+            case IR_CONVERT:
+                translate_convert(f, instr);
+                break;
+
+            case IR_LOAD: {
+                VmOpcode fused = instr->type == IR_I32 ? VM_LOAD_ADD_I32 : instr->type == IR_I64 ? VM_LOAD_ADD_I64
+                               : instr->type == IR_F64 ? VM_LOAD_ADD_F64 : VM_LOAD_64;
+                if (fused != VM_LOAD_64 && next && next->op == IR_ADD && next->type == instr->type &&
+                    uses[instr->dst] == 1 && (next->a == instr->dst) != (next->b == instr->dst)) {
+                    VmInstr* add = emit(f, fused, next->dst, instr->a, instr->b);
+                    add->c = next->a == instr->dst ? next->b : next->a;
+                    instr = next;
+                    consumed = 2;
+                } else {
+                    emit(f, load_opcode(instr->type), instr->dst, instr->a, instr->b);
+                }
+                break;
+            }
+
+            case IR_STORE:
+                emit(f, store_opcode(instr->type), -1, instr->a, instr->b)->c = instr->c;
+                break;
+
+            case IR_JUMP:
+            case IR_JUMP_IF:
+            case IR_JUMP_UNLESS: {
+                VmOpcode op = instr->op == IR_JUMP ? VM_JUMP : instr->op == IR_JUMP_IF ? VM_JUMP_IF : VM_JUMP_UNLESS;
+                emit(f, op, -1, instr->a, -1)->imm = instr->imm;
+                break;
+            }
+
+            case IR_CALL: {
+                VmInstr* call = emit(f, instr->external ? VM_CALL_EXTERN : VM_CALL, instr->dst,
+                                     add_call_args(program, instr), (int)instr->arg_count);
+                call->imm = instr->imm;
+                break;
+            }
+
+            case IR_PRINT: {
+                VmInstr* print = emit(f, VM_PRINT, -1, instr->a, (int)instr->type);
+                print->imm = instr->imm;
+                break;
+            }
+
+            case IR_RETURN:
+                emit(f, VM_RETURN, -1, instr->a, -1);
+                break;
+
+            default:
+                translate_arithmetic(f, instr);
+                break;
+        }
+
+        // t = ...; x = t  ->  x = ...
+        const IrInstr* after = i + consumed < source->count ? &source->code[i + consumed] : NULL;
+        int temp = instr->dst;
+        if (after && after->op == IR_MOVE && temp >= 0 && after->a == temp && uses[temp] == 1 && defs[temp] == 1 &&
+            f->count > group) {
+            for (size_t k = group; k < f->count; k++) {
+                VmInstr* emitted = &f->code[k];
+                if (emitted->dst == temp) emitted->dst = after->dst;
+                bool a_is_register = emitted->op != VM_CALL && emitted->op != VM_CALL_EXTERN;
+                if (a_is_register && emitted->a == temp) emitted->a = after->dst;
+            }
+            consumed++;
+        }
+        i += consumed - 1;
+    }
+
+    for (size_t k = 0; k < f->count; k++) {
+        VmInstr* instr = &f->code[k];
+        if (instr->op == VM_JUMP || instr->op == VM_JUMP_IF || instr->op == VM_JUMP_UNLESS ||
+            (instr->op >= VM_BR_EQ && instr->op <= VM_BR_GE_U)) {
+            instr->imm = (int64_t)label_pcs[instr->imm];
+        }
+    }
+
+    free(frame_offsets);
+    free(label_pcs);
+    free(defs);
+    free(uses);
+}
+
+/**
+ * Translates an IR module to bytecode and resolves its extern fns in the
+ * running process.
+ *
+ * @param module The module (see ir_lower())
+ * @param unsupported_construct Set to why the program cannot run on the VM (caller frees)
+ * @return The program, or NULL if an extern fn cannot be called from the VM
+ */
+VmProgram* vm_compile(IrModule* module, char** unsupported_construct) {
+    VmProgram* program = calloc(1, sizeof(VmProgram));
+    program->main_index = module->main_index;
+
+    program->externs = calloc(module->extern_count + 1, sizeof(VmExtern));
+    program->extern_count = module->extern_count;
+    for (size_t i = 0; i < module->extern_count; i++) {
+        IrExtern* source = &module->externs[i];
+        VmExtern* target = &program->externs[i];
+#ifdef VM_EXTERN_SHIMS
+        target->address = resolve_symbol(program, source->name);
+#endif
+        if (!target->address) {
+            *unsupported_construct = string_format("extern fn %s, which is not loaded in the compiler", source->name);
+            vm_destroy(program);
+            return NULL;
+        }
+        target->param_types = malloc(sizeof(IrType) * (source->param_count + 1));
+        memcpy(target->param_types, source->param_types, sizeof(IrType) * source->param_count);
+        target->param_count = source->param_count;
+        target->return_type = source->return_type;
+    }
+
+    program->strings = malloc(sizeof(char*) * (module->string_count + 1));
+    program->string_count = module->string_count;
+    for (size_t i = 0; i < module->string_count; i++) {
+        program->strings[i] = string_n_duplicate(module->strings[i], module->string_lengths[i]);
+    }
+
+    program->functions = calloc(module->function_count + 1, sizeof(VmFunction));
+    program->function_count = module->function_count;
+    for (size_t i = 0; i < module->function_count; i++) {
+        translate_function(program, &module->functions[i], &program->functions[i]);
+    }
+    return program;
+}
+
+#ifdef VM_EXTERN_SHIMS
+static int64_t canonical(IrType type, uint64_t value) {
+    switch (type) {
+        case IR_I8:   return (int8_t)value;
+        case IR_U8:
+        case IR_BOOL: return (uint8_t)value;
+        case IR_I16:  return (int16_t)value;
+        case IR_U16:  return (uint16_t)value;
+        case IR_I32:  return (int32_t)value;
+        case IR_U32:  return (uint32_t)value;
+        default:      return (int64_t)value;
+    }
+}
+
+/**
+ * Calls an extern fn: integer and pointer arguments go in the integer
+ * argument registers, floating-point ones in the vector registers (an f32
+ * in the low half, as the callee reads it).
+ */
+static VmValue call_extern(const VmExtern* fn, const VmValue* registers, const int* args) {
+    uint64_t ints[IR_MAX_INT_ARGS] = { 0 };
+    double floats[IR_MAX_FLOAT_ARGS] = { 0 };
+    size_t int_count = 0, float_count = 0;
+
+    for (size_t i = 0; i < fn->param_count; i++) {
+        VmValue value = registers[args[i]];
+        if (fn->param_types[i] == IR_F32) {
+            float narrow = (float)value.f;
+            uint64_t bits = 0;
+            memcpy(&bits, &narrow, sizeof(narrow));
+            memcpy(&floats[float_count++], &bits, sizeof(bits));
+        } else if (ir_type_is_float(fn->param_types[i])) {
+            floats[float_count++] = value.f;
+        } else {
+            ints[int_count++] = value.u;
+        }
+    }
+
+    VmValue result;
+    if (ir_type_is_float(fn->return_type)) {
+        double returned = ((VmFloatShim)fn->address)(ints[0], ints[1], ints[2], ints[3], ints[4], ints[5],
+                                                     floats[0], floats[1], floats[2], floats[3],
+                                                     floats[4], floats[5], floats[6], floats[7]);
+        if (fn->return_type == IR_F32) {
+            float narrow;
+            memcpy(&narrow, &returned, sizeof(narrow));
+            returned = narrow;
+        }
+        result.f = returned;
+    } else {
+        uint64_t returned = ((VmIntShim)fn->address)(ints[0], ints[1], ints[2], ints[3], ints[4], ints[5],
+                                                     floats[0], floats[1], floats[2], floats[3],
+                                                     floats[4], floats[5], floats[6], floats[7]);
+        result.i = canonical(fn->return_type, returned);
+    }
+    return result;
+}
+#endif
+
+static void print_value(VmValue value, IrType type, bool newline) {
+    switch (type) {
+        case IR_PTR:  printf(newline ? "%s\n" : "%s", value.p); break;
+        case IR_I64:  printf(newline ? "%lld\n" : "%lld", (long long)value.i); break;
+        case IR_U64:  printf(newline ? "%llu\n" : "%llu", (unsigned long long)value.u); break;
+        case IR_F64:  printf(newline ? "%f\n" : "%f", value.f); break;
+        case IR_BOOL: printf(newline ? "%s\n" : "%s", value.i ? "true" : "false"); break;
+        case IR_I8:   printf(newline ? "%c\n" : "%c", (int)value.i); break;
+        default:      if (newline) printf("\n"); break;
+    }
+}
+
+/**
+ * Runs a program from main() to its return.
+ *
+ * @param program The program (see vm_compile())
+ * @return The exit status: main's return value, or 128 + the signal a
+ *         compiled program would have died of on a runtime error
+ */
+int vm_run(VmProgram* program) {
+#ifdef VM_COMPUTED_GOTO
+    #define VM_LABEL(name) &&op_##name,
+    static const void* const labels[] = { VM_OPCODES(VM_LABEL) };
+    #undef VM_LABEL
+    if (!program->threaded) {
+        for (size_t i = 0; i < program->function_count; i++) {
+            for (size_t k = 0; k < program->functions[i].count; k++) {
+                program->functions[i].code[k].handler = labels[program->functions[i].code[k].op];
+            }
+        }
+        program->threaded = true;
+    }
+    #define CASE(name) op_##name:
+    #define DISPATCH() goto *pc->handler
+#else
+    #define CASE(name) case VM_##name:
+    #define DISPATCH() goto dispatch
+#endif
+    #define NEXT() do { pc++; DISPATCH(); } while (0)
+    #define BRANCH(condition) do { pc = (condition) ? function->code + pc->imm : pc + 1; DISPATCH(); } while (0)
+    #define ELEMENT(type) (((type*)r[pc->a].p)[r[pc->b].i])
+
+    VmValue* register_stack = malloc(sizeof(VmValue) * VM_STACK_REGISTERS);
+    VmFrame* frames = malloc(sizeof(VmFrame) * VM_STACK_FRAMES);
+    char* memory_stack = malloc(VM_STACK_MEMORY);
+    size_t frame_count = 0;
+    int exit_code = 0;
+
+    const VmFunction* function = &program->functions[program->main_index];
+    VmValue* r = register_stack;
+    char* memory = memory_stack;
+    const VmInstr* pc = function->code;
+    if (function->register_count > VM_STACK_REGISTERS || function->frame_size > VM_STACK_MEMORY) goto stack_overflow;
+
+#ifdef VM_COMPUTED_GOTO
+    DISPATCH();
+#else
+dispatch:
+    switch (pc->op) {
+#endif
+    CASE(CONST)     r[pc->dst].i = pc->imm; NEXT();
+    CASE(MOVE)      r[pc->dst] = r[pc->a]; NEXT();
+    CASE(STRING)    r[pc->dst].p = program->strings[pc->imm]; NEXT();
+    CASE(FRAME)     r[pc->dst].p = memory + pc->imm; NEXT();
+
+    CASE(ADD)       r[pc->dst].u = r[pc->a].u + r[pc->b].u; NEXT();
+    CASE(SUB)       r[pc->dst].u = r[pc->a].u - r[pc->b].u; NEXT();
+    CASE(MUL)       r[pc->dst].u = r[pc->a].u * r[pc->b].u; NEXT();
+    CASE(ADD_I32)   r[pc->dst].i = (int32_t)(uint32_t)(r[pc->a].u + r[pc->b].u); NEXT();
+    CASE(SUB_I32)   r[pc->dst].i = (int32_t)(uint32_t)(r[pc->a].u - r[pc->b].u); NEXT();
+    CASE(MUL_I32)   r[pc->dst].i = (int32_t)(uint32_t)(r[pc->a].u * r[pc->b].u); NEXT();
+    CASE(DIV_S)
+        if (r[pc->b].i == 0) goto division_by_zero;
+        r[pc->dst].i = r[pc->b].i == -1 ? (int64_t)(0 - r[pc->a].u) : r[pc->a].i / r[pc->b].i;
+        NEXT();
+    CASE(DIV_U)
+        if (r[pc->b].u == 0) goto division_by_zero;
+        r[pc->dst].u = r[pc->a].u / r[pc->b].u;
+        NEXT();
+    CASE(REM_S)
+        if (r[pc->b].i == 0) goto division_by_zero;
+        r[pc->dst].i = r[pc->b].i == -1 ? 0 : r[pc->a].i % r[pc->b].i;
+        NEXT();
+    CASE(REM_U)
+        if (r[pc->b].u == 0) goto division_by_zero;
+        r[pc->dst].u = r[pc->a].u % r[pc->b].u;
+        NEXT();
+    CASE(AND)       r[pc->dst].u = r[pc->a].u & r[pc->b].u; NEXT();
+    CASE(OR)        r[pc->dst].u = r[pc->a].u | r[pc->b].u; NEXT();
+    CASE(XOR)       r[pc->dst].u = r[pc->a].u ^ r[pc->b].u; NEXT();
+    CASE(SHL)       r[pc->dst].u = r[pc->a].u << (r[pc->b].u & 63); NEXT();
+    CASE(SHR_S)     r[pc->dst].i = r[pc->a].i >> (r[pc->b].u & 63); NEXT();
+    CASE(SHR_U)     r[pc->dst].u = r[pc->a].u >> (r[pc->b].u & 63); NEXT();
+    CASE(NEG)       r[pc->dst].u = 0 - r[pc->a].u; NEXT();
+    CASE(NOT)       r[pc->dst].u = ~r[pc->a].u; NEXT();
+
+    CASE(FADD)      r[pc->dst].f = r[pc->a].f + r[pc->b].f; NEXT();
+    CASE(FSUB)      r[pc->dst].f = r[pc->a].f - r[pc->b].f; NEXT();
+    CASE(FMUL)      r[pc->dst].f = r[pc->a].f * r[pc->b].f; NEXT();
+    CASE(FDIV)      r[pc->dst].f = r[pc->a].f / r[pc->b].f; NEXT();
+    CASE(FNEG)      r[pc->dst].f = -r[pc->a].f; NEXT();
+    CASE(SQRT)      r[pc->dst].f = sqrt(r[pc->a].f); NEXT();
+    CASE(ROUND_F32) r[pc->dst].f = (float)r[pc->a].f; NEXT();
+
+    CASE(EXT_I8)    r[pc->dst].i = (int8_t)r[pc->a].u; NEXT();
+    CASE(EXT_U8)    r[pc->dst].i = (uint8_t)r[pc->a].u; NEXT();
+    CASE(EXT_I16)   r[pc->dst].i = (int16_t)r[pc->a].u; NEXT();
+    CASE(EXT_U16)   r[pc->dst].i = (uint16_t)r[pc->a].u; NEXT();
+    CASE(EXT_I32)   r[pc->dst].i = (int32_t)r[pc->a].u; NEXT();
+    CASE(EXT_U32)   r[pc->dst].i = (uint32_t)r[pc->a].u; NEXT();
+
+    CASE(EQ)        r[pc->dst].i = r[pc->a].u == r[pc->b].u; NEXT();
+    CASE(NE)        r[pc->dst].i = r[pc->a].u != r[pc->b].u; NEXT();
+    CASE(LT_S)      r[pc->dst].i = r[pc->a].i < r[pc->b].i; NEXT();
+    CASE(LE_S)      r[pc->dst].i = r[pc->a].i <= r[pc->b].i; NEXT();
+    CASE(GT_S)      r[pc->dst].i = r[pc->a].i > r[pc->b].i; NEXT();
+    CASE(GE_S)      r[pc->dst].i = r[pc->a].i >= r[pc->b].i; NEXT();
+    CASE(LT_U)      r[pc->dst].i = r[pc->a].u < r[pc->b].u; NEXT();
+    CASE(LE_U)      r[pc->dst].i = r[pc->a].u <= r[pc->b].u; NEXT();
+    CASE(GT_U)      r[pc->dst].i = r[pc->a].u > r[pc->b].u; NEXT();
+    CASE(GE_U)      r[pc->dst].i = r[pc->a].u >= r[pc->b].u; NEXT();
+    CASE(FEQ)       r[pc->dst].i = r[pc->a].f == r[pc->b].f; NEXT();
+    CASE(FNE)       r[pc->dst].i = r[pc->a].f != r[pc->b].f; NEXT();
+    CASE(FLT)       r[pc->dst].i = r[pc->a].f < r[pc->b].f; NEXT();
+    CASE(FLE)       r[pc->dst].i = r[pc->a].f <= r[pc->b].f; NEXT();
+    CASE(FGT)       r[pc->dst].i = r[pc->a].f > r[pc->b].f; NEXT();
+    CASE(FGE)       r[pc->dst].i = r[pc->a].f >= r[pc->b].f; NEXT();
+
+    CASE(I2F)       r[pc->dst].f = (double)r[pc->a].i; NEXT();
+    CASE(U2F)       r[pc->dst].f = (double)r[pc->a].u; NEXT();
+    CASE(I2F32)     r[pc->dst].f = (float)r[pc->a].i; NEXT();
+    CASE(U2F32)     r[pc->dst].f = (float)r[pc->a].u; NEXT();
+    CASE(F2I)       r[pc->dst].i = (int64_t)r[pc->a].f; NEXT();
+    CASE(F2U)       r[pc->dst].u = (uint64_t)r[pc->a].f; NEXT();
+    CASE(F2BOOL)    r[pc->dst].i = r[pc->a].f != 0.0; NEXT();
+    CASE(I2BOOL)    r[pc->dst].i = r[pc->a].u != 0; NEXT();
+
+    CASE(LOAD_I8)   r[pc->dst].i = ELEMENT(int8_t); NEXT();
+    CASE(LOAD_U8)   r[pc->dst].i = ELEMENT(uint8_t); NEXT();
+    CASE(LOAD_I16)  r[pc->dst].i = ELEMENT(int16_t); NEXT();
+    CASE(LOAD_U16)  r[pc->dst].i = ELEMENT(uint16_t); NEXT();
+    CASE(LOAD_I32)  r[pc->dst].i = ELEMENT(int32_t); NEXT();
+    CASE(LOAD_U32)  r[pc->dst].i = ELEMENT(uint32_t); NEXT();
+    CASE(LOAD_64)   r[pc->dst].u = ELEMENT(uint64_t); NEXT();
+    CASE(LOAD_F32)  r[pc->dst].f = ELEMENT(float); NEXT();
+    CASE(STORE_8)   ELEMENT(uint8_t) = (uint8_t)r[pc->c].u; NEXT();
+    CASE(STORE_16)  ELEMENT(uint16_t) = (uint16_t)r[pc->c].u; NEXT();
+    CASE(STORE_32)  ELEMENT(uint32_t) = (uint32_t)r[pc->c].u; NEXT();
+    CASE(STORE_64)  ELEMENT(uint64_t) = r[pc->c].u; NEXT();
+    CASE(STORE_F32) ELEMENT(float) = (float)r[pc->c].f; NEXT();
+
+    CASE(JUMP)        pc = function->code + pc->imm; DISPATCH();
+    CASE(JUMP_IF)     BRANCH(r[pc->a].u != 0);
+    CASE(JUMP_UNLESS) BRANCH(r[pc->a].u == 0);
+    CASE(BR_EQ)       BRANCH(r[pc->a].u == r[pc->b].u);
+    CASE(BR_NE)       BRANCH(r[pc->a].u != r[pc->b].u);
+    CASE(BR_LT_S)     BRANCH(r[pc->a].i < r[pc->b].i);
+    CASE(BR_LE_S)     BRANCH(r[pc->a].i <= r[pc->b].i);
+    CASE(BR_GT_S)     BRANCH(r[pc->a].i > r[pc->b].i);
+    CASE(BR_GE_S)     BRANCH(r[pc->a].i >= r[pc->b].i);
+    CASE(BR_LT_U)     BRANCH(r[pc->a].u < r[pc->b].u);
+    CASE(BR_LE_U)     BRANCH(r[pc->a].u <= r[pc->b].u);
+    CASE(BR_GT_U)     BRANCH(r[pc->a].u > r[pc->b].u);
+    CASE(BR_GE_U)     BRANCH(r[pc->a].u >= r[pc->b].u);
+
+    CASE(LOAD_ADD_I32) r[pc->dst].i = (int32_t)(uint32_t)(r[pc->c].u + (uint64_t)(int64_t)ELEMENT(int32_t)); NEXT();
+    CASE(LOAD_ADD_I64) r[pc->dst].u = r[pc->c].u + ELEMENT(uint64_t); NEXT();
+    CASE(LOAD_ADD_F64) r[pc->dst].f = r[pc->c].f + ELEMENT(double); NEXT();
+
+    CASE(CALL) {
+        const VmFunction* callee = &program->functions[pc->imm];
+        VmValue* callee_registers = r + function->register_count;
+        char* callee_memory = memory + function->frame_size;
+        if (frame_count >= VM_STACK_FRAMES ||
+            (size_t)(callee_registers - register_stack) + callee->register_count > VM_STACK_REGISTERS ||
+            (size_t)(callee_memory - memory_stack) + callee->frame_size > VM_STACK_MEMORY) {
+            goto stack_overflow;
+        }
+        const int* args = program->call_args + pc->a;
+        for (int i = 0; i < pc->b; i++) callee_registers[i] = r[args[i]];
+
+        frames[frame_count++] = (VmFrame){ function, pc + 1, r, memory, pc->dst };
+        function = callee;
+        r = callee_registers;
+        memory = callee_memory;
+        pc = callee->code;
+        DISPATCH();
+    }
+
+    CASE(CALL_EXTERN) {
+#ifdef VM_EXTERN_SHIMS
+        VmValue result = call_extern(&program->externs[pc->imm], r, program->call_args + pc->a);
+        if (pc->dst >= 0) r[pc->dst] = result;
+#endif
+        NEXT();
+    }
+
+    CASE(RETURN) {
+        VmValue result = { .i = 0 };
+        if (pc->a >= 0) result = r[pc->a];
+        if (frame_count == 0) {
+            exit_code = (int)result.i;
+            goto done;
+        }
+        VmFrame* frame = &frames[--frame_count];
+        function = frame->function;
+        r = frame->registers;
+        memory = frame->memory;
+        pc = frame->return_pc;
+        if (frame->dst >= 0) r[frame->dst] = result;
+        DISPATCH();
+    }
+
+    CASE(PRINT)
+        print_value(pc->a >= 0 ? r[pc->a] : (VmValue){ .i = 0 }, (IrType)pc->b, pc->imm != 0);
+        NEXT();
+#ifndef VM_COMPUTED_GOTO
+    }
+#endif
+
+division_by_zero:
+    fflush(stdout);
+    fprintf(stderr, "Runtime error: integer division by zero\n");
+    exit_code = 128 + 8;    // SIGFPE
+    goto done;
+
+stack_overflow:
+    fflush(stdout);
+    fprintf(stderr, "Runtime error: stack overflow\n");
+    exit_code = 128 + 11;   // SIGSEGV
+
+done:
+    fflush(stdout);
+    free(memory_stack);
+    free(frames);
+    free(register_stack);
+    return exit_code;
+
+    #undef CASE
+    #undef DISPATCH
+    #undef NEXT
+    #undef BRANCH
+    #undef ELEMENT
+}
+
+void vm_destroy(VmProgram* program) {
+    if (!program) return;
+    for (size_t i = 0; i < program->function_count; i++) {
+        free(program->functions[i].code);
+    }
+    for (size_t i = 0; i < program->extern_count; i++) {
+        free(program->externs[i].param_types);
+    }
+    for (size_t i = 0; i < program->string_count; i++) {
+        free(program->strings[i]);
+    }
+    free(program->functions);
+    free(program->externs);
+    free(program->strings);
+    free(program->call_args);
+#ifdef VM_EXTERN_SHIMS
+    if (program->libm) dlclose(program->libm);
+#endif
+    free(program);
+}
@@ -0,0 +1,15 @@
+#ifndef VM_H
+#define VM_H
+
+#include "ir.h"
+
+// Register-based bytecode interpreter used by 'jfmc run': the IR of a
+// program is translated to bytecode and executed in-process, so running a
+// program does not wait for a C compiler
+typedef struct VmProgram VmProgram;
+
+VmProgram* vm_compile(IrModule* module, char** unsupported_construct);
+int vm_run(VmProgram* program);
+void vm_destroy(VmProgram* program);
+
+#endif
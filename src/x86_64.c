@@ -0,0 +1,1393 @@
+#include "x86_64.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// General-purpose and SSE registers, numbered as in the instruction encoding
+enum {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15,
+};
+enum {
+    XMM0, XMM1,
+};
+
+// Condition codes of Jcc / SETcc / CMOVcc
+enum {
+    CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_BE = 0x6, CC_A = 0x7,
+    CC_P = 0xA, CC_NP = 0xB, CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF,
+};
+
+// ELF constants used by the object writer
+#define ELF_SHT_PROGBITS 1
+#define ELF_SHT_SYMTAB 2
+#define ELF_SHT_STRTAB 3
+#define ELF_SHT_RELA 4
+#define ELF_SHF_ALLOC 0x2
+#define ELF_SHF_EXECINSTR 0x4
+#define ELF_SHF_INFO_LINK 0x40
+#define ELF_R_X86_64_PC32 2
+#define ELF_R_X86_64_PLT32 4
+
+// Sections of the object file, by index
+enum {
+    SECTION_NULL, SECTION_TEXT, SECTION_RODATA, SECTION_SYMTAB, SECTION_STRTAB, SECTION_RELA_TEXT,
+    SECTION_SHSTRTAB, SECTION_NOTE_STACK, SECTION_COUNT,
+};
+
+// Registers a value may be allocated to, in order of preference. Values
+// live across a call need a callee-saved register; values in use at a call
+// (its arguments and result) stay out of the argument registers, so moving
+// arguments into place never overwrites another argument. rax, rcx, rdx,
+// r11, xmm0 and xmm1 are scratch registers for instruction sequences.
+static const int free_registers[] = { RSI, RDI, R8, R9, R10, RBX, R12, R13, R14, R15 };
+static const int call_registers[] = { R10, RBX, R12, R13, R14, R15 };
+static const int saved_registers[] = { RBX, R12, R13, R14, R15 };
+static const int float_registers[] = { 8, 9, 10, 11, 12, 13 };
+static const int int_arg_registers[IR_MAX_INT_ARGS] = { RDI, RSI, RDX, RCX, R8, R9 };
+
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+} Buffer;
+
+// ModRM operand: a register, [base + index * scale + disp] or [rip + disp]
+typedef struct {
+    bool is_register;
+    int reg;
+    int base;
+    int index;              // -1 for none
+    int scale;
+    int32_t disp;
+    bool rip;
+} Operand;
+
+// Where a virtual register lives for its whole interval
+typedef struct {
+    bool is_register;
+    int reg;
+    int32_t offset;         // Stack slot, relative to rbp
+} Placement;
+
+typedef struct {
+    size_t offset;          // Of the 32-bit field in .text
+    uint32_t type;
+    bool to_rodata;         // Otherwise an undefined symbol
+    size_t symbol;          // Index into the undefined symbols
+    int64_t addend;
+} Relocation;
+
+typedef struct {
+    size_t offset;          // Of the rel32 field
+    size_t target;          // Label or function index
+} Fixup;
+
+// Live range of a virtual register, in instruction positions (0 is entry)
+typedef struct {
+    int vreg;
+    int start;
+    int end;
+} Interval;
+
+typedef struct {
+    IrModule* module;
+    Buffer text;
+    Buffer rodata;
+    Relocation* relocations;
+    size_t relocation_count;
+    size_t relocation_capacity;
+    size_t* function_offsets;
+    Fixup* calls;
+    size_t call_count;
+    size_t call_capacity;
+    size_t* string_offsets;
+    char** symbols;         // Undefined symbols: the extern fns, then printf
+    size_t symbol_count;
+    size_t printf_symbol;
+
+    // Current function
+    IrFunction* function;
+    Placement* locations;
+    size_t* label_offsets;
+    Fixup* jumps;
+    size_t jump_count;
+    size_t jump_capacity;
+    int saved[5];
+    size_t saved_count;
+    size_t frame_size;
+    int32_t* frame_offsets;
+} Assembler;
+
+static void emit_byte(Buffer* b, uint8_t byte) {
+    if (b->size >= b->capacity) {
+        b->capacity = b->capacity ? b->capacity * 2 : 4096;
+        b->data = realloc(b->data, b->capacity);
+    }
+    b->data[b->size++] = byte;
+}
+
+static void emit_u32(Buffer* b, uint32_t value) {
+    for (int i = 0; i < 4; i++) emit_byte(b, (uint8_t)(value >> (8 * i)));
+}
+
+static void emit_u64(Buffer* b, uint64_t value) {
+    for (int i = 0; i < 8; i++) emit_byte(b, (uint8_t)(value >> (8 * i)));
+}
+
+static void emit_bytes(Buffer* b, const void* data, size_t size) {
+    for (size_t i = 0; i < size; i++) emit_byte(b, ((const uint8_t*)data)[i]);
+}
+
+static void patch_u32(Buffer* b, size_t offset, uint32_t value) {
+    for (int i = 0; i < 4; i++) b->data[offset + i] = (uint8_t)(value >> (8 * i));
+}
+
+static Operand reg_operand(int reg) {
+    return (Operand){ .is_register = true, .reg = reg, .index = -1 };
+}
+
+static Operand mem_operand(int base, int32_t disp) {
+    return (Operand){ .base = base, .index = -1, .disp = disp };
+}
+
+static Operand indexed_operand(int base, int index, int scale) {
+    return (Operand){ .base = base, .index = index, .scale = scale };
+}
+
+static Operand rip_operand(void) {
+    return (Operand){ .rip = true, .index = -1 };
+}
+
+/**
+ * Encodes one instruction: legacy prefix, REX, opcode and ModRM / SIB /
+ * displacement. Immediates are appended by the caller.
+ *
+ * @param b The code buffer
+ * @param prefix 0x66, 0xF2 or 0xF3, or 0 for none
+ * @param wide Whether REX.W (64-bit operand size) is set
+ * @param opcode One to three opcode bytes, most significant first
+ * @param reg Register or opcode extension in ModRM.reg
+ * @param rm The register or memory operand
+ * @param byte_regs Whether 8-bit registers are used, so spl..dil need a REX prefix
+ */
+static void encode(Buffer* b, uint8_t prefix, bool wide, uint32_t opcode, int reg, Operand rm, bool byte_regs) {
+    if (prefix) emit_byte(b, prefix);
+
+    uint8_t rex = 0x40;
+    if (wide) rex |= 0x08;
+    if (reg & 8) rex |= 0x04;
+    if (!rm.is_register && !rm.rip && rm.index >= 0 && (rm.index & 8)) rex |= 0x02;
+    if (rm.is_register ? (rm.reg & 8) : (!rm.rip && (rm.base & 8))) rex |= 0x01;
+    bool low_byte = byte_regs && ((reg >= 4 && reg < 8) || (rm.is_register && rm.reg >= 4 && rm.reg < 8));
+    if (rex != 0x40 || low_byte) emit_byte(b, rex);
+
+    if (opcode > 0xFFFF) emit_byte(b, (uint8_t)(opcode >> 16));
+    if (opcode > 0xFF) emit_byte(b, (uint8_t)(opcode >> 8));
+    emit_byte(b, (uint8_t)opcode);
+
+    uint8_t reg_bits = (uint8_t)((reg & 7) << 3);
+    if (rm.is_register) {
+        emit_byte(b, (uint8_t)(0xC0 | reg_bits | (rm.reg & 7)));
+        return;
+    }
+    if (rm.rip) {
+        emit_byte(b, (uint8_t)(reg_bits | 5));
+        emit_u32(b, (uint32_t)rm.disp);
+        return;
+    }
+
+    uint8_t mod;
+    if (rm.disp == 0 && (rm.base & 7) != RBP) {
+        mod = 0x00;
+    } else if (rm.disp >= -128 && rm.disp <= 127) {
+        mod = 0x40;
+    } else {
+        mod = 0x80;
+    }
+
+    if (rm.index >= 0 || (rm.base & 7) == RSP) {
+        uint8_t scale_bits = rm.scale == 8 ? 3 : rm.scale == 4 ? 2 : rm.scale == 2 ? 1 : 0;
+        emit_byte(b, (uint8_t)(mod | reg_bits | 4));
+        emit_byte(b, (uint8_t)((scale_bits << 6) | ((rm.index >= 0 ? rm.index & 7 : 4) << 3) | (rm.base & 7)));
+    } else {
+        emit_byte(b, (uint8_t)(mod | reg_bits | (rm.base & 7)));
+    }
+
+    if (mod == 0x40) {
+        emit_byte(b, (uint8_t)(int8_t)rm.disp);
+    } else if (mod == 0x80) {
+        emit_u32(b, (uint32_t)rm.disp);
+    }
+}
+
+// Shorthands for the instructions the backend uses
+
+static void mov_load(Assembler* as, int reg, Operand rm) {
+    if (rm.is_register && rm.reg == reg) return;
+    encode(&as->text, 0, true, 0x8B, reg, rm, false);
+}
+
+static void mov_store(Assembler* as, Operand rm, int reg) {
+    if (rm.is_register && rm.reg == reg) return;
+    encode(&as->text, 0, true, 0x89, reg, rm, false);
+}
+
+static void mov_immediate(Assembler* as, int reg, int64_t value) {
+    if (value >= INT32_MIN && value <= INT32_MAX) {
+        encode(&as->text, 0, true, 0xC7, 0, reg_operand(reg), false);
+        emit_u32(&as->text, (uint32_t)value);
+    } else {
+        emit_byte(&as->text, (uint8_t)(0x48 | (reg >> 3)));
+        emit_byte(&as->text, (uint8_t)(0xB8 + (reg & 7)));
+        emit_u64(&as->text, (uint64_t)value);
+    }
+}
+
+static void sse(Assembler* as, uint8_t prefix, bool wide, uint32_t opcode, int reg, Operand rm) {
+    encode(&as->text, prefix, wide, opcode, reg, rm, false);
+}
+
+static void set_condition(Assembler* as, int cc, int reg) {
+    encode(&as->text, 0, false, 0x0F90 | (uint32_t)cc, 0, reg_operand(reg), true);
+}
+
+// movzx eax, al
+static void zero_extend_al(Assembler* as) {
+    encode(&as->text, 0, false, 0x0FB6, RAX, reg_operand(RAX), true);
+}
+
+// cvtsd2ss xmm, xmm; cvtss2sd xmm, xmm: rounds a double to single precision
+static void round_to_float(Assembler* as, int xmm) {
+    sse(as, 0xF2, false, 0x0F5A, xmm, reg_operand(xmm));
+    sse(as, 0xF3, false, 0x0F5A, xmm, reg_operand(xmm));
+}
+
+static size_t jump_rel8(Assembler* as, uint8_t opcode) {
+    emit_byte(&as->text, opcode);
+    emit_byte(&as->text, 0);
+    return as->text.size - 1;
+}
+
+static void land_rel8(Assembler* as, size_t at) {
+    as->text.data[at] = (uint8_t)(as->text.size - (at + 1));
+}
+
+/**
+ * Re-establishes the canonical form of an integer of the given type in rax:
+ * sign- or zero-extended from its width to 64 bits.
+ */
+static void canonicalize(Assembler* as, IrType type) {
+    Operand al = reg_operand(RAX);
+    switch (type) {
+        case IR_I8:   encode(&as->text, 0, true, 0x0FBE, RAX, al, true); break;
+        case IR_U8:
+        case IR_BOOL: encode(&as->text, 0, false, 0x0FB6, RAX, al, true); break;
+        case IR_I16:  encode(&as->text, 0, true, 0x0FBF, RAX, al, false); break;
+        case IR_U16:  encode(&as->text, 0, false, 0x0FB7, RAX, al, false); break;
+        case IR_I32:  encode(&as->text, 0, true, 0x63, RAX, al, false); break;
+        case IR_U32:  encode(&as->text, 0, false, 0x89, RAX, al, false); break;
+        default: break;
+    }
+}
+
+static Operand location_operand(Assembler* as, int vreg) {
+    Placement* loc = &as->locations[vreg];
+    return loc->is_register ? reg_operand(loc->reg) : mem_operand(RBP, loc->offset);
+}
+
+static void load_int(Assembler* as, int reg, int vreg) {
+    mov_load(as, reg, location_operand(as, vreg));
+}
+
+static void store_int(Assembler* as, int vreg, int reg) {
+    mov_store(as, location_operand(as, vreg), reg);
+}
+
+// movsd xmm, xmm/m64
+static void load_float(Assembler* as, int xmm, int vreg) {
+    Operand source = location_operand(as, vreg);
+    if (source.is_register && source.reg == xmm) return;
+    sse(as, 0xF2, false, 0x0F10, xmm, source);
+}
+
+// movsd xmm/m64, xmm
+static void store_float(Assembler* as, int vreg, int xmm) {
+    Operand target = location_operand(as, vreg);
+    if (target.is_register && target.reg == xmm) return;
+    sse(as, 0xF2, false, 0x0F11, xmm, target);
+}
+
+static bool is_float(Assembler* as, int vreg) {
+    return ir_type_is_float(as->function->vreg_types[vreg]);
+}
+
+static void add_relocation(Assembler* as, size_t offset, uint32_t type, bool to_rodata, size_t symbol, int64_t addend) {
+    if (as->relocation_count >= as->relocation_capacity) {
+        as->relocation_capacity = as->relocation_capacity ? as->relocation_capacity * 2 : 64;
+        as->relocations = realloc(as->relocations, sizeof(Relocation) * as->relocation_capacity);
+    }
+    as->relocations[as->relocation_count++] = (Relocation){ offset, type, to_rodata, symbol, addend };
+}
+
+static void add_fixup(Fixup** fixups, size_t* count, size_t* capacity, size_t offset, size_t target) {
+    if (*count >= *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 64;
+        *fixups = realloc(*fixups, sizeof(Fixup) * *capacity);
+    }
+    (*fixups)[(*count)++] = (Fixup){ offset, target };
+}
+
+// lea reg, [rip + rodata + offset]
+static void load_rodata_address(Assembler* as, int reg, size_t offset) {
+    encode(&as->text, 0, true, 0x8D, reg, rip_operand(), false);
+    add_relocation(as, as->text.size - 4, ELF_R_X86_64_PC32, true, 0, (int64_t)offset - 4);
+}
+
+static void call_symbol(Assembler* as, size_t symbol) {
+    emit_byte(&as->text, 0xE8);
+    emit_u32(&as->text, 0);
+    add_relocation(as, as->text.size - 4, ELF_R_X86_64_PLT32, false, symbol, -4);
+}
+
+static void jump_to_label(Assembler* as, uint32_t opcode, size_t label) {
+    if (opcode > 0xFF) emit_byte(&as->text, (uint8_t)(opcode >> 8));
+    emit_byte(&as->text, (uint8_t)opcode);
+    emit_u32(&as->text, 0);
+    add_fixup(&as->jumps, &as->jump_count, &as->jump_capacity, as->text.size - 4, label);
+}
+
+/**
+ * Adds a NUL-terminated constant to .rodata.
+ *
+ * @return Its offset
+ */
+static size_t add_rodata(Assembler* as, const char* data, size_t length) {
+    size_t offset = as->rodata.size;
+    emit_bytes(&as->rodata, data, length);
+    emit_byte(&as->rodata, 0);
+    return offset;
+}
+
+// ---------------------------------------------------------------------------
+// Register allocation
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    size_t first;           // Instruction range [first, last]
+    size_t last;
+    size_t successors[2];
+    size_t successor_count;
+    uint64_t* use;          // Read before written in the block
+    uint64_t* def;
+    uint64_t* live_in;
+    uint64_t* live_out;
+} Block;
+
+static bool is_block_end(IrOpcode op) {
+    return op == IR_JUMP || op == IR_JUMP_IF || op == IR_JUMP_UNLESS || op == IR_RETURN;
+}
+
+static bool is_call(IrOpcode op) {
+    return op == IR_CALL || op == IR_PRINT;
+}
+
+/**
+ * Computes the live interval of every virtual register with a backward
+ * dataflow over the basic blocks. An interval spans from the first to the
+ * last position where the register is defined, used or live, holes included.
+ *
+ * @param f The function
+ * @param intervals Output, indexed by virtual register (start -1 if unused)
+ */
+static void compute_intervals(IrFunction* f, Interval* intervals) {
+    size_t words = (f->vreg_count + 63) / 64;
+    if (words == 0) words = 1;
+
+    // Split the code into basic blocks
+    size_t* block_of_label = malloc(sizeof(size_t) * (f->label_count + 1));
+    size_t block_count = 0;
+    bool* starts = calloc(f->count + 1, sizeof(bool));
+    for (size_t i = 0; i < f->count; i++) {
+        if (i == 0 || f->code[i].op == IR_LABEL || is_block_end(f->code[i - 1].op)) starts[i] = true;
+        if (starts[i]) block_count++;
+    }
+
+    Block* blocks = calloc(block_count + 1, sizeof(Block));
+    uint64_t* bits = calloc(words * 4 * (block_count + 1), sizeof(uint64_t));
+    for (size_t i = 0, b = 0; i < f->count; i++) {
+        if (starts[i]) {
+            if (b > 0) blocks[b - 1].last = i - 1;
+            blocks[b].first = i;
+            blocks[b].use = bits + words * (4 * b);
+            blocks[b].def = bits + words * (4 * b + 1);
+            blocks[b].live_in = bits + words * (4 * b + 2);
+            blocks[b].live_out = bits + words * (4 * b + 3);
+            b++;
+        }
+        if (f->code[i].op == IR_LABEL) block_of_label[f->code[i].imm] = b - 1;
+    }
+    if (block_count > 0) blocks[block_count - 1].last = f->count - 1;
+
+    int operands[8];
+    for (size_t b = 0; b < block_count; b++) {
+        Block* block = &blocks[b];
+        IrInstr* last = &f->code[block->last];
+        if (last->op == IR_JUMP || last->op == IR_JUMP_IF || last->op == IR_JUMP_UNLESS) {
+            block->successors[block->successor_count++] = block_of_label[last->imm];
+        }
+        if (last->op != IR_JUMP && last->op != IR_RETURN && b + 1 < block_count) {
+            block->successors[block->successor_count++] = b + 1;
+        }
+
+        for (size_t i = block->first; i <= block->last; i++) {
+            IrInstr* instr = &f->code[i];
+            size_t count = ir_operands(instr, operands, 8);
+            for (size_t k = 0; k < count; k++) {
+                int v = k < 8 ? operands[k] : instr->args[k];
+                if (!(block->def[v / 64] & (1ULL << (v % 64)))) block->use[v / 64] |= 1ULL << (v % 64);
+            }
+            if (instr->dst >= 0) block->def[instr->dst / 64] |= 1ULL << (instr->dst % 64);
+        }
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t b = block_count; b > 0; b--) {
+            Block* block = &blocks[b - 1];
+            for (size_t w = 0; w < words; w++) {
+                uint64_t out = 0;
+                for (size_t s = 0; s < block->successor_count; s++) out |= blocks[block->successors[s]].live_in[w];
+                uint64_t in = block->use[w] | (out & ~block->def[w]);
+                if (out != block->live_out[w] || in != block->live_in[w]) changed = true;
+                block->live_out[w] = out;
+                block->live_in[w] = in;
+            }
+        }
+    }
+
+    for (size_t v = 0; v < f->vreg_count; v++) {
+        intervals[v] = (Interval){ (int)v, -1, -1 };
+    }
+
+    #define EXTEND(v, position) do { \
+        Interval* it = &intervals[v]; \
+        if (it->start < 0 || (position) < it->start) it->start = (position); \
+        if ((position) > it->end) it->end = (position); \
+    } while (0)
+
+    for (size_t v = 0; v < f->param_count; v++) EXTEND(v, 0);
+
+    for (size_t b = 0; b < block_count; b++) {
+        Block* block = &blocks[b];
+        for (size_t v = 0; v < f->vreg_count; v++) {
+            if (block->live_in[v / 64] & (1ULL << (v % 64))) EXTEND(v, (int)block->first + 1);
+            if (block->live_out[v / 64] & (1ULL << (v % 64))) EXTEND(v, (int)block->last + 1);
+        }
+        for (size_t i = block->first; i <= block->last; i++) {
+            IrInstr* instr = &f->code[i];
+            size_t count = ir_operands(instr, operands, 8);
+            for (size_t k = 0; k < count; k++) {
+                int v = k < 8 ? operands[k] : instr->args[k];
+                EXTEND(v, (int)i + 1);
+            }
+            if (instr->dst >= 0) EXTEND(instr->dst, (int)i + 1);
+        }
+    }
+    #undef EXTEND
+
+    free(bits);
+    free(blocks);
+    free(starts);
+    free(block_of_label);
+}
+
+static int compare_intervals(const void* a, const void* b) {
+    const Interval* x = a;
+    const Interval* y = b;
+    if (x->start != y->start) return x->start < y->start ? -1 : 1;
+    return x->vreg < y->vreg ? -1 : x->vreg > y->vreg;
+}
+
+/**
+ * Finds whether a call happens in [from, to].
+ *
+ * @param calls Sorted call positions
+ * @param count Number of calls
+ */
+static bool call_between(const int* calls, size_t count, int from, int to) {
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (calls[mid] < from) lo = mid + 1; else hi = mid;
+    }
+    return lo < count && calls[lo] <= to;
+}
+
+/**
+ * Linear-scan register allocation (Poletto and Sarkar): intervals are
+ * visited by start, registers of expired intervals are reused, and when
+ * none is free the interval ending last is spilled to the stack.
+ *
+ * @param as The assembler; sets locations, saved registers and the frame size
+ */
+static void allocate_registers(Assembler* as) {
+    IrFunction* f = as->function;
+    Interval* intervals = malloc(sizeof(Interval) * (f->vreg_count + 1));
+    compute_intervals(f, intervals);
+
+    // Calls, with function entry counting as one so parameters stay out of argument registers
+    int* calls = malloc(sizeof(int) * (f->count + 1));
+    size_t call_count = 0;
+    calls[call_count++] = 0;
+    for (size_t i = 0; i < f->count; i++) {
+        if (is_call(f->code[i].op)) calls[call_count++] = (int)i + 1;
+    }
+
+    Interval* order = malloc(sizeof(Interval) * (f->vreg_count + 1));
+    size_t order_count = 0;
+    for (size_t v = 0; v < f->vreg_count; v++) {
+        if (intervals[v].start >= 0) order[order_count++] = intervals[v];
+    }
+    qsort(order, order_count, sizeof(Interval), compare_intervals);
+
+    int owner[32];              // Virtual register holding each register (xmm at 16+), or -1
+    for (int r = 0; r < 32; r++) owner[r] = -1;
+    bool* spilled = calloc(f->vreg_count + 1, sizeof(bool));
+    bool* allocated = calloc(f->vreg_count + 1, sizeof(bool));
+    memset(as->locations, 0, sizeof(Placement) * (f->vreg_count + 1));
+
+    for (size_t i = 0; i < order_count; i++) {
+        Interval* current = &order[i];
+        int v = current->vreg;
+
+        for (int r = 0; r < 32; r++) {
+            if (owner[r] >= 0 && intervals[owner[r]].end <= current->start) owner[r] = -1;
+        }
+
+        bool floating = ir_type_is_float(f->vreg_types[v]);
+        bool crosses = call_between(calls, call_count, current->start + 1, current->end - 1);
+        bool touches = call_between(calls, call_count, current->start, current->end);
+
+        const int* pool;
+        size_t pool_size;
+        if (floating) {
+            pool = float_registers;
+            pool_size = crosses ? 0 : sizeof(float_registers) / sizeof(int);
+        } else if (crosses) {
+            pool = saved_registers;
+            pool_size = sizeof(saved_registers) / sizeof(int);
+        } else if (touches) {
+            pool = call_registers;
+            pool_size = sizeof(call_registers) / sizeof(int);
+        } else {
+            pool = free_registers;
+            pool_size = sizeof(free_registers) / sizeof(int);
+        }
+        int bank = floating ? 16 : 0;
+
+        int chosen = -1;
+        for (size_t k = 0; k < pool_size && chosen < 0; k++) {
+            if (owner[bank + pool[k]] < 0) chosen = pool[k];
+        }
+
+        if (chosen < 0 && pool_size > 0) {
+            // Steal the register of the allocatable interval ending last, if it outlives this one
+            int victim = -1;
+            for (size_t k = 0; k < pool_size; k++) {
+                int holder = owner[bank + pool[k]];
+                if (holder >= 0 && (victim < 0 || intervals[holder].end > intervals[owner[bank + victim]].end)) {
+                    victim = pool[k];
+                }
+            }
+            if (victim >= 0 && intervals[owner[bank + victim]].end > current->end) {
+                int evicted = owner[bank + victim];
+                allocated[evicted] = false;
+                spilled[evicted] = true;
+                chosen = victim;
+            }
+        }
+
+        if (chosen >= 0) {
+            owner[bank + chosen] = v;
+            allocated[v] = true;
+            as->locations[v] = (Placement){ true, chosen, 0 };
+        } else {
+            spilled[v] = true;
+        }
+    }
+
+    // Callee-saved registers in use are pushed by the prologue
+    as->saved_count = 0;
+    for (size_t k = 0; k < sizeof(saved_registers) / sizeof(int); k++) {
+        bool used = false;
+        for (size_t v = 0; v < f->vreg_count && !used; v++) {
+            used = allocated[v] && !ir_type_is_float(f->vreg_types[v]) && as->locations[v].reg == saved_registers[k];
+        }
+        if (used) as->saved[as->saved_count++] = saved_registers[k];
+    }
+
+    // Below the saved registers: spill slots, then the frame objects
+    size_t cursor = 8 * as->saved_count;
+    for (size_t v = 0; v < f->vreg_count; v++) {
+        if (!spilled[v]) continue;
+        cursor += 8;
+        as->locations[v] = (Placement){ false, 0, -(int32_t)cursor };
+    }
+    for (size_t k = 0; k < f->frame_count; k++) {
+        cursor += f->frame[k].size;
+        cursor = (cursor + 15) / 16 * 16;
+        as->frame_offsets[k] = -(int32_t)cursor;
+    }
+    cursor = (cursor + 15) / 16 * 16;
+    as->frame_size = cursor - 8 * as->saved_count;
+
+    free(allocated);
+    free(spilled);
+    free(order);
+    free(calls);
+    free(intervals);
+}
+
+// ---------------------------------------------------------------------------
+// Instruction selection
+// ---------------------------------------------------------------------------
+
+static void generate_integer_binary(Assembler* as, IrInstr* instr) {
+    load_int(as, RAX, instr->a);
+    Operand right = location_operand(as, instr->b);
+
+    switch (instr->op) {
+        case IR_ADD: encode(&as->text, 0, true, 0x03, RAX, right, false); break;
+        case IR_SUB: encode(&as->text, 0, true, 0x2B, RAX, right, false); break;
+        case IR_AND: encode(&as->text, 0, true, 0x23, RAX, right, false); break;
+        case IR_OR:  encode(&as->text, 0, true, 0x0B, RAX, right, false); break;
+        case IR_XOR: encode(&as->text, 0, true, 0x33, RAX, right, false); break;
+        case IR_MUL: encode(&as->text, 0, true, 0x0FAF, RAX, right, false); break;
+        case IR_DIV:
+        case IR_REM:
+            load_int(as, RCX, instr->b);
+            if (ir_type_is_signed(instr->type)) {
+                emit_bytes(&as->text, "\x48\x99", 2);                      // cqo
+                encode(&as->text, 0, true, 0xF7, 7, reg_operand(RCX), false);   // idiv rcx
+            } else {
+                emit_bytes(&as->text, "\x31\xD2", 2);                      // xor edx, edx
+                encode(&as->text, 0, true, 0xF7, 6, reg_operand(RCX), false);   // div rcx
+            }
+            if (instr->op == IR_REM) mov_load(as, RAX, reg_operand(RDX));
+            break;
+        case IR_SHL:
+        case IR_SHR:
+            load_int(as, RCX, instr->b);
+            encode(&as->text, 0, true, 0xD3, instr->op == IR_SHL ? 4 : ir_type_is_signed(instr->type) ? 7 : 5,
+                   reg_operand(RAX), false);
+            break;
+        default:
+            break;
+    }
+
+    canonicalize(as, instr->type);
+    store_int(as, instr->dst, RAX);
+}
+
+static void generate_float_binary(Assembler* as, IrInstr* instr) {
+    static const uint32_t opcodes[] = { [IR_ADD] = 0x0F58, [IR_SUB] = 0x0F5C, [IR_MUL] = 0x0F59, [IR_DIV] = 0x0F5E };
+
+    load_float(as, XMM0, instr->a);
+    sse(as, 0xF2, false, opcodes[instr->op], XMM0, location_operand(as, instr->b));
+    if (instr->type == IR_F32) round_to_float(as, XMM0);
+    store_float(as, instr->dst, XMM0);
+}
+
+static void generate_compare(Assembler* as, IrInstr* instr) {
+    if (!ir_type_is_float(instr->type)) {
+        bool is_signed = ir_type_is_signed(instr->type);
+        int cc;
+        switch (instr->op) {
+            case IR_EQ: cc = CC_E; break;
+            case IR_NE: cc = CC_NE; break;
+            case IR_LT: cc = is_signed ? CC_L : CC_B; break;
+            case IR_LE: cc = is_signed ? CC_LE : CC_BE; break;
+            case IR_GT: cc = is_signed ? CC_G : CC_A; break;
+            default:    cc = is_signed ? CC_GE : CC_AE; break;
+        }
+        load_int(as, RAX, instr->a);
+        encode(&as->text, 0, true, 0x3B, RAX, location_operand(as, instr->b), false);
+        set_condition(as, cc, RAX);
+        zero_extend_al(as);
+        store_int(as, instr->dst, RAX);
+        return;
+    }
+
+    // ucomisd leaves a < b unordered with NaN as "below", so < and <= swap operands and use above
+    bool swap = instr->op == IR_LT || instr->op == IR_LE;
+    load_float(as, XMM0, swap ? instr->b : instr->a);
+    sse(as, 0x66, false, 0x0F2E, XMM0, location_operand(as, swap ? instr->a : instr->b));
+
+    switch (instr->op) {
+        case IR_EQ:
+            set_condition(as, CC_E, RAX);
+            set_condition(as, CC_NP, RCX);
+            emit_bytes(&as->text, "\x20\xC8", 2);   // and al, cl
+            break;
+        case IR_NE:
+            set_condition(as, CC_NE, RAX);
+            set_condition(as, CC_P, RCX);
+            emit_bytes(&as->text, "\x08\xC8", 2);   // or al, cl
+            break;
+        case IR_LT:
+        case IR_GT:
+            set_condition(as, CC_A, RAX);
+            break;
+        default:
+            set_condition(as, CC_AE, RAX);
+            break;
+    }
+    zero_extend_al(as);
+    store_int(as, instr->dst, RAX);
+}
+
+/**
+ * Converts between integer and floating-point types with the semantics of
+ * a C cast, including u64, which has no direct SSE conversion.
+ */
+static void generate_convert(Assembler* as, IrInstr* instr) {
+    IrType from = instr->from;
+    IrType to = instr->type;
+
+    if (ir_type_is_float(from) && ir_type_is_float(to)) {
+        load_float(as, XMM0, instr->a);
+        if (to == IR_F32) round_to_float(as, XMM0);
+        store_float(as, instr->dst, XMM0);
+        return;
+    }
+
+    if (ir_type_is_float(from)) {
+        load_float(as, XMM0, instr->a);
+        if (to == IR_BOOL) {
+            sse(as, 0x66, false, 0x0F57, XMM1, reg_operand(XMM1));      // xorpd xmm1, xmm1
+            sse(as, 0x66, false, 0x0F2E, XMM0, reg_operand(XMM1));      // ucomisd xmm0, xmm1
+            set_condition(as, CC_NE, RAX);
+            set_condition(as, CC_P, RCX);
+            emit_bytes(&as->text, "\x08\xC8", 2);                    // or al, cl
+            zero_extend_al(as);
+        } else if (to == IR_U64) {
+            // Values from 2^63 up are converted after subtracting 2^63
+            mov_immediate(as, RAX, 0x43E0000000000000LL);
+            sse(as, 0x66, true, 0x0F6E, XMM1, reg_operand(RAX));        // movq xmm1, rax
+            sse(as, 0x66, false, 0x0F2E, XMM0, reg_operand(XMM1));
+            size_t big = jump_rel8(as, 0x73);                          // jae
+            sse(as, 0xF2, true, 0x0F2C, RAX, reg_operand(XMM0));        // cvttsd2si rax, xmm0
+            size_t done = jump_rel8(as, 0xEB);
+            land_rel8(as, big);
+            sse(as, 0xF2, false, 0x0F5C, XMM0, reg_operand(XMM1));      // subsd xmm0, xmm1
+            sse(as, 0xF2, true, 0x0F2C, RAX, reg_operand(XMM0));
+            emit_bytes(&as->text, "\x48\x0F\xBA\xF8\x3F", 5);        // btc rax, 63
+            land_rel8(as, done);
+        } else {
+            sse(as, 0xF2, true, 0x0F2C, RAX, reg_operand(XMM0));
+            canonicalize(as, to);
+        }
+        store_int(as, instr->dst, RAX);
+        return;
+    }
+
+    if (ir_type_is_float(to)) {
+        // int -> f32 converts directly, so the value is rounded only once
+        uint8_t prefix = to == IR_F32 ? 0xF3 : 0xF2;
+        load_int(as, RAX, instr->a);
+        if (from == IR_U64) {
+            encode(&as->text, 0, true, 0x85, RAX, reg_operand(RAX), false);   // test rax, rax
+            size_t big = jump_rel8(as, 0x78);                                // js
+            sse(as, prefix, true, 0x0F2A, XMM0, reg_operand(RAX));
+            size_t done = jump_rel8(as, 0xEB);
+            land_rel8(as, big);
+            // Halve with the low bit kept for rounding, convert, then double
+            emit_bytes(&as->text, "\x48\x89\xC1", 3);                        // mov rcx, rax
+            emit_bytes(&as->text, "\x48\xD1\xE9", 3);                        // shr rcx, 1
+            emit_bytes(&as->text, "\x83\xE0\x01", 3);                        // and eax, 1
+            emit_bytes(&as->text, "\x48\x09\xC1", 3);                        // or rcx, rax
+            sse(as, prefix, true, 0x0F2A, XMM0, reg_operand(RCX));
+            sse(as, prefix, false, 0x0F58, XMM0, reg_operand(XMM0));
+            land_rel8(as, done);
+        } else {
+            sse(as, prefix, true, 0x0F2A, XMM0, reg_operand(RAX));
+        }
+        if (to == IR_F32) sse(as, 0xF3, false, 0x0F5A, XMM0, reg_operand(XMM0));
+        store_float(as, instr->dst, XMM0);
+        return;
+    }
+
+    load_int(as, RAX, instr->a);
+    if (to == IR_BOOL) {
+        encode(&as->text, 0, true, 0x85, RAX, reg_operand(RAX), false);
+        set_condition(as, CC_NE, RAX);
+        zero_extend_al(as);
+    } else {
+        canonicalize(as, to);
+    }
+    store_int(as, instr->dst, RAX);
+}
+
+static void generate_load(Assembler* as, IrInstr* instr) {
+    size_t size = ir_type_size(instr->type);
+    load_int(as, RAX, instr->a);
+    load_int(as, RCX, instr->b);
+    Operand element = indexed_operand(RAX, RCX, (int)size);
+
+    switch (instr->type) {
+        case IR_F32:
+            sse(as, 0xF3, false, 0x0F10, XMM0, element);
+            sse(as, 0xF3, false, 0x0F5A, XMM0, reg_operand(XMM0));
+            store_float(as, instr->dst, XMM0);
+            return;
+        case IR_F64:
+            sse(as, 0xF2, false, 0x0F10, XMM0, element);
+            store_float(as, instr->dst, XMM0);
+            return;
+        case IR_I8:  encode(&as->text, 0, true, 0x0FBE, RAX, element, false); break;
+        case IR_U8:
+        case IR_BOOL: encode(&as->text, 0, false, 0x0FB6, RAX, element, false); break;
+        case IR_I16: encode(&as->text, 0, true, 0x0FBF, RAX, element, false); break;
+        case IR_U16: encode(&as->text, 0, false, 0x0FB7, RAX, element, false); break;
+        case IR_I32: encode(&as->text, 0, true, 0x63, RAX, element, false); break;
+        case IR_U32: encode(&as->text, 0, false, 0x8B, RAX, element, false); break;
+        default:     encode(&as->text, 0, true, 0x8B, RAX, element, false); break;
+    }
+    store_int(as, instr->dst, RAX);
+}
+
+static void generate_store(Assembler* as, IrInstr* instr) {
+    size_t size = ir_type_size(instr->type);
+    load_int(as, RAX, instr->a);
+    load_int(as, RCX, instr->b);
+    Operand element = indexed_operand(RAX, RCX, (int)size);
+
+    if (ir_type_is_float(instr->type)) {
+        load_float(as, XMM0, instr->c);
+        if (instr->type == IR_F32) {
+            sse(as, 0xF2, false, 0x0F5A, XMM0, reg_operand(XMM0));   // cvtsd2ss
+            sse(as, 0xF3, false, 0x0F11, XMM0, element);             // movss
+        } else {
+            sse(as, 0xF2, false, 0x0F11, XMM0, element);
+        }
+        return;
+    }
+
+    load_int(as, RDX, instr->c);
+    switch (size) {
+        case 1:  encode(&as->text, 0, false, 0x88, RDX, element, true); break;
+        case 2:  encode(&as->text, 0x66, false, 0x89, RDX, element, false); break;
+        case 4:  encode(&as->text, 0, false, 0x89, RDX, element, false); break;
+        default: encode(&as->text, 0, true, 0x89, RDX, element, false); break;
+    }
+}
+
+static void generate_call(Assembler* as, IrInstr* instr) {
+    IrModule* module = as->module;
+    IrType* param_types = instr->external ? module->externs[instr->imm].param_types
+                                          : module->functions[instr->imm].param_types;
+
+    size_t ints = 0, floats = 0;
+    for (size_t i = 0; i < instr->arg_count; i++) {
+        if (ir_type_is_float(param_types[i])) {
+            load_float(as, (int)floats, instr->args[i]);
+            if (param_types[i] == IR_F32) sse(as, 0xF2, false, 0x0F5A, (int)floats, reg_operand((int)floats));
+            floats++;
+        } else {
+            load_int(as, int_arg_registers[ints++], instr->args[i]);
+        }
+    }
+
+    if (instr->external) {
+        call_symbol(as, (size_t)instr->imm);
+    } else {
+        emit_byte(&as->text, 0xE8);
+        emit_u32(&as->text, 0);
+        add_fixup(&as->calls, &as->call_count, &as->call_capacity, as->text.size - 4, (size_t)instr->imm);
+    }
+
+    if (instr->dst < 0) return;
+    if (ir_type_is_float(instr->type)) {
+        if (instr->type == IR_F32) sse(as, 0xF3, false, 0x0F5A, XMM0, reg_operand(XMM0));
+        store_float(as, instr->dst, XMM0);
+    } else {
+        canonicalize(as, instr->type);
+        store_int(as, instr->dst, RAX);
+    }
+}
+
+/**
+ * Prints a value with printf, using the formats of the generated C.
+ */
+static void generate_print(Assembler* as, IrInstr* instr, const size_t* formats) {
+    // formats[type * 2 + newline]; IR_VOID holds "" and "\n", the slot after IR_PTR "true" and "false"
+    load_rodata_address(as, RDI, formats[instr->type * 2 + (instr->imm ? 1 : 0)]);
+
+    if (instr->type == IR_F64) {
+        load_float(as, XMM0, instr->a);
+        emit_bytes(&as->text, "\xB8\x01\x00\x00\x00", 5);   // mov eax, 1: one vector register used
+    } else {
+        if (instr->type == IR_BOOL) {
+            load_int(as, RAX, instr->a);
+            load_rodata_address(as, RSI, formats[(IR_PTR + 1) * 2]);
+            load_rodata_address(as, RCX, formats[(IR_PTR + 1) * 2 + 1]);
+            encode(&as->text, 0, true, 0x85, RAX, reg_operand(RAX), false);
+            encode(&as->text, 0, true, 0x0F44, RSI, reg_operand(RCX), false);   // cmove rsi, rcx
+        } else if (instr->a >= 0) {
+            load_int(as, RSI, instr->a);
+        }
+        emit_bytes(&as->text, "\x31\xC0", 2);               // xor eax, eax
+    }
+    call_symbol(as, as->printf_symbol);
+}
+
+static void generate_instruction(Assembler* as, IrInstr* instr, bool last, const size_t* formats) {
+    switch (instr->op) {
+        case IR_LABEL:
+            as->label_offsets[instr->imm] = as->text.size;
+            break;
+
+        case IR_CONST: {
+            Operand target = location_operand(as, instr->dst);
+            if (target.is_register) {
+                mov_immediate(as, target.reg, instr->imm);
+            } else if (instr->imm >= INT32_MIN && instr->imm <= INT32_MAX) {
+                encode(&as->text, 0, true, 0xC7, 0, target, false);
+                emit_u32(&as->text, (uint32_t)instr->imm);
+            } else {
+                mov_immediate(as, RAX, instr->imm);
+                store_int(as, instr->dst, RAX);
+            }
+            break;
+        }
+
+        case IR_FCONST: {
+            int64_t bits;
+            memcpy(&bits, &instr->fimm, sizeof(bits));
+            mov_immediate(as, RAX, bits);
+            Operand target = location_operand(as, instr->dst);
+            if (target.is_register) {
+                sse(as, 0x66, true, 0x0F6E, target.reg, reg_operand(RAX));   // movq xmm, rax
+            } else {
+                mov_store(as, target, RAX);
+            }
+            break;
+        }
+
+        case IR_STRING:
+            load_rodata_address(as, RAX, as->string_offsets[instr->imm]);
+            store_int(as, instr->dst, RAX);
+            break;
+
+        case IR_FRAME:
+            encode(&as->text, 0, true, 0x8D, RAX, mem_operand(RBP, as->frame_offsets[instr->imm]), false);
+            store_int(as, instr->dst, RAX);
+            break;
+
+        case IR_MOVE:
+            if (is_float(as, instr->dst)) {
+                load_float(as, XMM0, instr->a);
+                store_float(as, instr->dst, XMM0);
+            } else if (as->locations[instr->dst].is_register) {
+                load_int(as, as->locations[instr->dst].reg, instr->a);
+            } else {
+                load_int(as, RAX, instr->a);
+                store_int(as, instr->dst, RAX);
+            }
+            break;
+
+        case IR_ADD:
+        case IR_SUB:
+        case IR_MUL:
+        case IR_DIV:
+            if (ir_type_is_float(instr->type)) {
+                generate_float_binary(as, instr);
+            } else {
+                generate_integer_binary(as, instr);
+            }
+            break;
+
+        case IR_REM:
+        case IR_AND:
+        case IR_OR:
+        case IR_XOR:
+        case IR_SHL:
+        case IR_SHR:
+            generate_integer_binary(as, instr);
+            break;
+
+        case IR_NEG:
+            if (ir_type_is_float(instr->type)) {
+                load_float(as, XMM0, instr->a);
+                mov_immediate(as, RAX, INT64_MIN);
+                sse(as, 0x66, true, 0x0F6E, XMM1, reg_operand(RAX));
+                sse(as, 0x66, false, 0x0F57, XMM0, reg_operand(XMM1));   // xorpd: flip the sign bit
+                store_float(as, instr->dst, XMM0);
+                break;
+            }
+            load_int(as, RAX, instr->a);
+            encode(&as->text, 0, true, 0xF7, 3, reg_operand(RAX), false);
+            canonicalize(as, instr->type);
+            store_int(as, instr->dst, RAX);
+            break;
+
+        case IR_NOT:
+            load_int(as, RAX, instr->a);
+            encode(&as->text, 0, true, 0xF7, 2, reg_operand(RAX), false);
+            canonicalize(as, instr->type);
+            store_int(as, instr->dst, RAX);
+            break;
+
+        case IR_SQRT:
+            sse(as, 0xF2, false, 0x0F51, XMM0, location_operand(as, instr->a));
+            store_float(as, instr->dst, XMM0);
+            break;
+
+        case IR_EQ:
+        case IR_NE:
+        case IR_LT:
+        case IR_LE:
+        case IR_GT:
+        case IR_GE:
+            generate_compare(as, instr);
+            break;
+
+        case IR_CONVERT:
+            generate_convert(as, instr);
+            break;
+
+        case IR_LOAD:
+            generate_load(as, instr);
+            break;
+
+        case IR_STORE:
+            generate_store(as, instr);
+            break;
+
+        case IR_JUMP:
+            jump_to_label(as, 0xE9, (size_t)instr->imm);
+            break;
+
+        case IR_JUMP_IF:
+        case IR_JUMP_UNLESS: {
+            Operand condition = location_operand(as, instr->a);
+            if (condition.is_register) {
+                encode(&as->text, 0, true, 0x85, condition.reg, condition, false);   // test r, r
+            } else {
+                encode(&as->text, 0, true, 0x83, 7, condition, false);               // cmp qword [m], 0
+                emit_byte(&as->text, 0);
+            }
+            jump_to_label(as, instr->op == IR_JUMP_IF ? 0x0F85 : 0x0F84, (size_t)instr->imm);
+            break;
+        }
+
+        case IR_CALL:
+            generate_call(as, instr);
+            break;
+
+        case IR_PRINT:
+            generate_print(as, instr, formats);
+            break;
+
+        case IR_RETURN:
+            if (instr->a >= 0) {
+                if (ir_type_is_float(instr->type)) {
+                    load_float(as, XMM0, instr->a);
+                    if (instr->type == IR_F32) sse(as, 0xF2, false, 0x0F5A, XMM0, reg_operand(XMM0));
+                } else {
+                    load_int(as, RAX, instr->a);
+                }
+            } else if (as->function == &as->module->functions[as->module->main_index]) {
+                emit_bytes(&as->text, "\x31\xC0", 2);    // A void main exits with 0
+            }
+            // The epilogue follows the last instruction
+            if (!last) jump_to_label(as, 0xE9, as->function->label_count);
+            break;
+    }
+}
+
+/**
+ * Generates one function: prologue, body and epilogue.
+ */
+static void generate_function(Assembler* as, size_t index, const size_t* formats) {
+    IrFunction* f = &as->module->functions[index];
+    as->function = f;
+    as->locations = malloc(sizeof(Placement) * (f->vreg_count + 1));
+    as->frame_offsets = malloc(sizeof(int32_t) * (f->frame_count + 1));
+    as->label_offsets = calloc(f->label_count + 1, sizeof(size_t));   // The extra label is the epilogue
+    as->jump_count = 0;
+    allocate_registers(as);
+
+    // Keep functions 16-byte aligned
+    while (as->text.size % 16 != 0) emit_byte(&as->text, 0x90);
+    as->function_offsets[index] = as->text.size;
+
+    emit_byte(&as->text, 0x55);                                   // push rbp
+    emit_bytes(&as->text, "\x48\x89\xE5", 3);                     // mov rbp, rsp
+    for (size_t i = 0; i < as->saved_count; i++) {
+        if (as->saved[i] & 8) emit_byte(&as->text, 0x41);
+        emit_byte(&as->text, (uint8_t)(0x50 + (as->saved[i] & 7)));
+    }
+    if (as->frame_size > 0) {
+        emit_bytes(&as->text, "\x48\x81\xEC", 3);                 // sub rsp, imm32
+        emit_u32(&as->text, (uint32_t)as->frame_size);
+    }
+
+    // Move the parameters from the argument registers to their locations
+    size_t ints = 0, floats = 0;
+    for (size_t i = 0; i < f->param_count; i++) {
+        bool used = as->locations[i].is_register || as->locations[i].offset != 0;
+        if (ir_type_is_float(f->param_types[i])) {
+            if (f->param_types[i] == IR_F32) sse(as, 0xF3, false, 0x0F5A, (int)floats, reg_operand((int)floats));
+            if (used) store_float(as, (int)i, (int)floats);
+            floats++;
+        } else {
+            if (used) store_int(as, (int)i, int_arg_registers[ints]);
+            ints++;
+        }
+    }
+
+    for (size_t i = 0; i < f->count; i++) {
+        generate_instruction(as, &f->code[i], i + 1 == f->count, formats);
+    }
+
+    as->label_offsets[f->label_count] = as->text.size;
+    encode(&as->text, 0, true, 0x8D, RSP, mem_operand(RBP, -(int32_t)(8 * as->saved_count)), false);
+    for (size_t i = as->saved_count; i > 0; i--) {
+        if (as->saved[i - 1] & 8) emit_byte(&as->text, 0x41);
+        emit_byte(&as->text, (uint8_t)(0x58 + (as->saved[i - 1] & 7)));
+    }
+    emit_byte(&as->text, 0x5D);                                   // pop rbp
+    emit_byte(&as->text, 0xC3);                                   // ret
+
+    for (size_t i = 0; i < as->jump_count; i++) {
+        Fixup* jump = &as->jumps[i];
+        patch_u32(&as->text, jump->offset, (uint32_t)(as->label_offsets[jump->target] - (jump->offset + 4)));
+    }
+
+    free(as->label_offsets);
+    free(as->frame_offsets);
+    free(as->locations);
+}
+
+// ---------------------------------------------------------------------------
+// ELF object file
+// ---------------------------------------------------------------------------
+
+static void emit_u16(Buffer* b, uint16_t value) {
+    emit_byte(b, (uint8_t)value);
+    emit_byte(b, (uint8_t)(value >> 8));
+}
+
+static void align_buffer(Buffer* b, size_t align) {
+    while (b->size % align != 0) emit_byte(b, 0);
+}
+
+static uint32_t add_name(Buffer* strings, const char* name) {
+    uint32_t offset = (uint32_t)strings->size;
+    emit_bytes(strings, name, strlen(name) + 1);
+    return offset;
+}
+
+static void emit_symbol(Buffer* symtab, uint32_t name, uint8_t info, uint16_t section, uint64_t value, uint64_t size) {
+    emit_u32(symtab, name);
+    emit_byte(symtab, info);
+    emit_byte(symtab, 0);
+    emit_u16(symtab, section);
+    emit_u64(symtab, value);
+    emit_u64(symtab, size);
+}
+
+static void emit_section_header(Buffer* b, uint32_t name, uint32_t type, uint64_t flags, uint64_t offset,
+                                uint64_t size, uint32_t link, uint32_t info, uint64_t align, uint64_t entry_size) {
+    emit_u32(b, name);
+    emit_u32(b, type);
+    emit_u64(b, flags);
+    emit_u64(b, 0);
+    emit_u64(b, offset);
+    emit_u64(b, size);
+    emit_u32(b, link);
+    emit_u32(b, info);
+    emit_u64(b, align);
+    emit_u64(b, entry_size);
+}
+
+/**
+ * Writes the relocatable object: .text and .rodata, a symbol table with
+ * main global and the other functions local, relocations for calls to
+ * undefined symbols and references to .rodata, and an empty
+ * .note.GNU-stack so the linker keeps the stack non-executable.
+ */
+static bool write_elf(Assembler* as, const char* path) {
+    IrModule* module = as->module;
+    Buffer strtab = { 0 }, symtab = { 0 }, rela = { 0 }, shstrtab = { 0 }, file = { 0 };
+
+    emit_byte(&strtab, 0);
+    emit_symbol(&symtab, 0, 0, 0, 0, 0);
+    emit_symbol(&symtab, 0, 0x03, SECTION_TEXT, 0, 0);     // STB_LOCAL, STT_SECTION
+    emit_symbol(&symtab, 0, 0x03, SECTION_RODATA, 0, 0);
+    size_t symbol_index = 3;
+
+    // Locals must precede globals
+    for (size_t i = 0; i < module->function_count; i++) {
+        if (i == module->main_index) continue;
+        uint64_t end = i + 1 < module->function_count ? as->function_offsets[i + 1] : as->text.size;
+        emit_symbol(&symtab, add_name(&strtab, module->functions[i].name), 0x02, SECTION_TEXT,
+                    as->function_offsets[i], end - as->function_offsets[i]);
+        symbol_index++;
+    }
+    size_t first_global = symbol_index;
+    emit_symbol(&symtab, add_name(&strtab, "main"), 0x12, SECTION_TEXT,   // STB_GLOBAL, STT_FUNC
+                as->function_offsets[module->main_index], 0);
+    symbol_index++;
+    size_t first_undefined = symbol_index;
+    for (size_t i = 0; i < as->symbol_count; i++) {
+        emit_symbol(&symtab, add_name(&strtab, as->symbols[i]), 0x10, 0, 0, 0);
+    }
+
+    for (size_t i = 0; i < as->relocation_count; i++) {
+        Relocation* r = &as->relocations[i];
+        uint64_t symbol = r->to_rodata ? 2 : first_undefined + r->symbol;
+        emit_u64(&rela, r->offset);
+        emit_u64(&rela, (symbol << 32) | r->type);
+        emit_u64(&rela, (uint64_t)r->addend);
+    }
+
+    emit_byte(&shstrtab, 0);
+    uint32_t names[SECTION_COUNT] = { 0 };
+    names[SECTION_TEXT] = add_name(&shstrtab, ".text");
+    names[SECTION_RODATA] = add_name(&shstrtab, ".rodata");
+    names[SECTION_SYMTAB] = add_name(&shstrtab, ".symtab");
+    names[SECTION_STRTAB] = add_name(&shstrtab, ".strtab");
+    names[SECTION_RELA_TEXT] = add_name(&shstrtab, ".rela.text");
+    names[SECTION_SHSTRTAB] = add_name(&shstrtab, ".shstrtab");
+    names[SECTION_NOTE_STACK] = add_name(&shstrtab, ".note.GNU-stack");
+
+    // Header, then the section contents, then the section header table
+    size_t offsets[SECTION_COUNT] = { 0 };
+    size_t layout = 64;
+    Buffer* contents[SECTION_COUNT] = { NULL, &as->text, &as->rodata, &symtab, &strtab, &rela, &shstrtab, NULL };
+    for (int s = SECTION_TEXT; s < SECTION_COUNT; s++) {
+        layout = (layout + 15) / 16 * 16;
+        offsets[s] = layout;
+        if (contents[s]) layout += contents[s]->size;
+    }
+    size_t header_table = (layout + 15) / 16 * 16;
+
+    emit_bytes(&file, "\x7F" "ELF\x02\x01\x01", 7);       // 64-bit, little-endian, version 1
+    while (file.size < 16) emit_byte(&file, 0);
+    emit_u16(&file, 1);                                      // ET_REL
+    emit_u16(&file, 62);                                     // EM_X86_64
+    emit_u32(&file, 1);
+    emit_u64(&file, 0);                                      // Entry
+    emit_u64(&file, 0);                                      // Program headers
+    emit_u64(&file, header_table);
+    emit_u32(&file, 0);
+    emit_u16(&file, 64);                                     // Header size
+    emit_u16(&file, 0);
+    emit_u16(&file, 0);
+    emit_u16(&file, 64);                                     // Section header size
+    emit_u16(&file, SECTION_COUNT);
+    emit_u16(&file, SECTION_SHSTRTAB);
+
+    for (int s = SECTION_TEXT; s < SECTION_COUNT; s++) {
+        align_buffer(&file, 16);
+        if (contents[s]) emit_bytes(&file, contents[s]->data, contents[s]->size);
+    }
+    align_buffer(&file, 16);
+
+    emit_section_header(&file, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    emit_section_header(&file, names[SECTION_TEXT], ELF_SHT_PROGBITS, ELF_SHF_ALLOC | ELF_SHF_EXECINSTR,
+                        offsets[SECTION_TEXT], as->text.size, 0, 0, 16, 0);
+    emit_section_header(&file, names[SECTION_RODATA], ELF_SHT_PROGBITS, ELF_SHF_ALLOC,
+                        offsets[SECTION_RODATA], as->rodata.size, 0, 0, 1, 0);
+    emit_section_header(&file, names[SECTION_SYMTAB], ELF_SHT_SYMTAB, 0, offsets[SECTION_SYMTAB], symtab.size,
+                        SECTION_STRTAB, (uint32_t)first_global, 8, 24);
+    emit_section_header(&file, names[SECTION_STRTAB], ELF_SHT_STRTAB, 0, offsets[SECTION_STRTAB], strtab.size,
+                        0, 0, 1, 0);
+    emit_section_header(&file, names[SECTION_RELA_TEXT], ELF_SHT_RELA, ELF_SHF_INFO_LINK,
+                        offsets[SECTION_RELA_TEXT], rela.size, SECTION_SYMTAB, SECTION_TEXT, 8, 24);
+    emit_section_header(&file, names[SECTION_SHSTRTAB], ELF_SHT_STRTAB, 0, offsets[SECTION_SHSTRTAB],
+                        shstrtab.size, 0, 0, 1, 0);
+    emit_section_header(&file, names[SECTION_NOTE_STACK], ELF_SHT_PROGBITS, 0, offsets[SECTION_NOTE_STACK],
+                        0, 0, 0, 1, 0);
+
+    FILE* out = fopen(path, "wb");
+    bool ok = out && fwrite(file.data, 1, file.size, out) == file.size;
+    if (out && fclose(out) != 0) ok = false;
+
+    free(strtab.data);
+    free(symtab.data);
+    free(rela.data);
+    free(shstrtab.data);
+    free(file.data);
+    return ok;
+}
+
+/**
+ * Compiles an IR module to an x86-64 ELF relocatable object. Each function
+ * gets linear-scan register allocation and a System V frame; values are
+ * computed in rax / xmm0 and kept in their allocated registers or stack
+ * slots between instructions. The object is linked by the system linker.
+ *
+ * @param module The module (see ir_lower())
+ * @param path The object file to write
+ * @return true on success, false if the file could not be written
+ */
+bool x86_64_write_object(IrModule* module, const char* path) {
+    Assembler as;
+    memset(&as, 0, sizeof(as));
+    as.module = module;
+    as.function_offsets = calloc(module->function_count + 1, sizeof(size_t));
+
+    // Undefined symbols: the extern fns, and printf unless one of them is printf
+    as.symbols = malloc(sizeof(char*) * (module->extern_count + 1));
+    as.printf_symbol = module->extern_count;
+    for (size_t i = 0; i < module->extern_count; i++) {
+        as.symbols[as.symbol_count++] = module->externs[i].name;
+        if (strcmp(module->externs[i].name, "printf") == 0) as.printf_symbol = i;
+    }
+    if (as.printf_symbol == module->extern_count) as.symbols[as.symbol_count++] = "printf";
+
+    as.string_offsets = malloc(sizeof(size_t) * (module->string_count + 1));
+    for (size_t i = 0; i < module->string_count; i++) {
+        as.string_offsets[i] = add_rodata(&as, module->strings[i], module->string_lengths[i]);
+    }
+
+    // printf formats by printed type and newline; bool also has its two words
+    static const char* format_text[][2] = {
+        [IR_VOID] = { "", "\n" }, [IR_PTR] = { "%s", "%s\n" }, [IR_I64] = { "%lld", "%lld\n" },
+        [IR_U64] = { "%llu", "%llu\n" }, [IR_F64] = { "%f", "%f\n" }, [IR_I8] = { "%c", "%c\n" },
+        [IR_BOOL] = { "%s", "%s\n" },
+    };
+    size_t formats[(IR_PTR + 2) * 2] = { 0 };
+    for (size_t t = 0; t <= IR_PTR; t++) {
+        for (size_t n = 0; n < 2; n++) {
+            if (format_text[t][n]) formats[t * 2 + n] = add_rodata(&as, format_text[t][n], strlen(format_text[t][n]));
+        }
+    }
+    formats[(IR_PTR + 1) * 2] = add_rodata(&as, "true", 4);
+    formats[(IR_PTR + 1) * 2 + 1] = add_rodata(&as, "false", 5);
+
+    for (size_t i = 0; i < module->function_count; i++) {
+        generate_function(&as, i, formats);
+    }
+    for (size_t i = 0; i < as.call_count; i++) {
+        Fixup* call = &as.calls[i];
+        patch_u32(&as.text, call->offset, (uint32_t)(as.function_offsets[call->target] - (call->offset + 4)));
+    }
+
+    bool ok = write_elf(&as, path);
+
+    free(as.text.data);
+    free(as.rodata.data);
+    free(as.relocations);
+    free(as.function_offsets);
+    free(as.calls);
+    free(as.jumps);
+    free(as.string_offsets);
+    free(as.symbols);
+    return ok;
+}
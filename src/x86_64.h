@@ -0,0 +1,12 @@
+#ifndef X86_64_H
+#define X86_64_H
+
+#include <stdbool.h>
+#include "ir.h"
+
+// Native backend: compiles the IR straight to an x86-64 ELF relocatable
+// object following the System V ABI, for the system linker to link with
+// libc and any extern fns
+bool x86_64_write_object(IrModule* module, const char* path);
+
+#endif
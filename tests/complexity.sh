@@ -0,0 +1,42 @@
+# Helpers shared by tests/scaling.sh and tests/stress.sh, sourced with ".".
+#
+# Both compile generated programs of growing size with "jfmc --time" and fit
+# a power law, t = c * n^k, to what each phase reports. The fitted exponent
+# k is 1 for linear growth, about 1.1 for n log n over the sizes used and 2
+# for quadratic growth.
+
+# Runs jfmc with --time on a program and prints one "phase ms kb" line per
+# phase it reached. A program that fails to compile still reports the
+# phases that ran, which is what the error patterns measure. Returns the
+# exit status of jfmc, above 128 if it crashed.
+#
+#   measure <jfmc> <program> [flags...]
+measure() {
+    _jfmc=$1
+    _program=$2
+    shift 2
+    "$_jfmc" --time "$@" "$_program" > /dev/null 2> "$_program.time"
+    _status=$?
+    awk '$1 == "[time]" { print $2, $3, $5 }' "$_program.time"
+    rm -f "$_program.time"
+    return $_status
+}
+
+# Reads "n value" lines and prints the exponent k of the least-squares fit
+# of log(value) against log(n). Values are clamped to 0.001 so that a phase
+# too fast to measure reads as constant rather than breaking the logarithm.
+fit_exponent() {
+    awk '{
+        x = log($1); y = log($2 > 0.001 ? $2 : 0.001)
+        n++; sx += x; sy += y; sxx += x * x; sxy += x * y
+    }
+    END {
+        d = n * sxx - sx * sx
+        printf "%.2f\n", (d > 0 ? (n * sxy - sx * sy) / d : 0)
+    }'
+}
+
+# Succeeds if exponent $1 is above limit $2
+exceeds() {
+    awk -v k="$1" -v limit="$2" 'BEGIN { exit !(k > limit) }'
+}
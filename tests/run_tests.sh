@@ -0,0 +1,115 @@
+#!/bin/sh
+# Runs the JFM test programs.
+#
+#   tests/programs/NAME.jfm  built with the C backend and with --backend=native,
+#                            and run on the bytecode VM; each must print exactly
+#                            tests/programs/NAME.out. native_*.jfm must not
+#                            fall back to the C backend.
+#   tests/errors/NAME.jfm    must fail to compile, printing the text of its
+#                            first-line "// error: <text>" comment.
+#   tests/compiler/NAME.jfm  "jfmc <flags> NAME.jfm", with the flags of its
+#                            first-line "// jfmc: <flags>" comment, run from
+#                            tests/compiler, must print exactly NAME.out.
+#
+# Usage: tests/run_tests.sh [path/to/jfmc]
+
+JFMC=${1:-./jfmc}
+DIR=$(dirname "$0")
+WORK=${TMPDIR:-/tmp}/jfm_tests.$$
+mkdir -p "$WORK"
+trap 'rm -rf "$WORK"' EXIT
+
+passed=0
+failed=0
+
+fail() {
+    echo "FAIL: $1"
+    failed=$((failed + 1))
+}
+
+# The native backend emits x86-64 ELF objects
+case "$(uname -s)-$(uname -m)" in
+    Linux-x86_64) backends="c native vm" ;;
+    *)            backends="c vm" ;;
+esac
+
+for program in "$DIR"/programs/*.jfm; do
+    [ -e "$program" ] || continue
+    name=$(basename "$program" .jfm)
+    expected="${program%.jfm}.out"
+
+    for backend in $backends; do
+        if [ $backend = vm ]; then
+            "$JFMC" run --backend=vm "$program" > "$WORK/actual" 2> "$WORK/build.log"
+        else
+            exe="$WORK/$name.$backend"
+            if ! "$JFMC" --backend=$backend -o "$exe" "$program" > "$WORK/build.log" 2>&1; then
+                fail "$name ($backend): does not compile"
+                cat "$WORK/build.log"
+                continue
+            fi
+            "$exe" > "$WORK/actual" 2>&1
+        fi
+        case "$name" in
+            native_*)
+                if grep -q "^note: .* does not support" "$WORK/build.log"; then
+                    fail "$name ($backend): fell back to the C backend"
+                    cat "$WORK/build.log"
+                    continue
+                fi ;;
+        esac
+        if cmp -s "$expected" "$WORK/actual"; then
+            passed=$((passed + 1))
+        else
+            fail "$name ($backend): output differs from $(basename "$expected")"
+            diff "$expected" "$WORK/actual" | head -20
+        fi
+    done
+done
+
+for program in "$DIR"/errors/*.jfm; do
+    [ -e "$program" ] || continue
+    name=$(basename "$program" .jfm)
+    message=$(sed -n '1s/^\/\/ error: //p' "$program")
+
+    "$JFMC" --check "$program" > "$WORK/check.log" 2>&1
+    status=$?
+    if [ $status -eq 0 ]; then
+        fail "$name: compiled, expected \"$message\""
+    elif [ $status -gt 1 ]; then
+        fail "$name: compiler crashed (status $status)"
+        cat "$WORK/check.log"
+    elif [ -n "$message" ] && ! grep -qF -- "$message" "$WORK/check.log"; then
+        fail "$name: expected \"$message\""
+        cat "$WORK/check.log"
+    else
+        passed=$((passed + 1))
+    fi
+done
+
+JFMC_PATH=$(cd "$(dirname "$JFMC")" && pwd)/$(basename "$JFMC")
+for program in "$DIR"/compiler/*.jfm; do
+    [ -e "$program" ] || continue
+    name=$(basename "$program" .jfm)
+    flags=$(sed -n '1s/^\/\/ jfmc: //p' "$program")
+
+    (cd "$DIR/compiler" && "$JFMC_PATH" $flags "$name.jfm") > "$WORK/actual" 2>&1
+    if cmp -s "${program%.jfm}.out" "$WORK/actual"; then
+        passed=$((passed + 1))
+    else
+        fail "$name: output of jfmc $flags differs from $name.out"
+        diff "${program%.jfm}.out" "$WORK/actual" | head -20
+    fi
+done
+
+# jfmc run must hand arguments to the program without going through a shell
+marker="$WORK/injected"
+"$JFMC" run "$DIR/programs/native_arith.jfm" "x\"; touch $marker; echo \"" > /dev/null 2>&1
+if [ -e "$marker" ]; then
+    fail "run: program arguments were interpreted by a shell"
+else
+    passed=$((passed + 1))
+fi
+
+echo "$passed passed, $failed failed"
+[ $failed -eq 0 ]
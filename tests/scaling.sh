@@ -0,0 +1,65 @@
+#!/bin/sh
+# Compiles generated programs of up to one million top-level declarations
+# and checks that the compiler has no size limits and scales linearly.
+#
+# Each program repeats a two-field struct, a function that builds it and
+# a function that returns an Option of it, whose wrapper typedef has to be
+# emitted after the struct.
+# It is translated with --c-only at each size; the fitted exponent of the
+# total compile time and of the peak memory must stay below LIMIT (1.0 is
+# linear; the slack absorbs timing noise).
+#
+# Usage: tests/scaling.sh [path/to/jfmc] [declaration counts...]
+# Run by "make scale". The default sizes need about 3 GB of memory.
+
+JFMC=${1:-./jfmc}
+[ $# -gt 0 ] && shift
+SIZES=${*:-250000 500000 1000000}
+LIMIT=1.2
+DIR=$(dirname "$0")
+WORK=${TMPDIR:-/tmp}/jfm_scaling.$$
+mkdir -p "$WORK"
+trap 'rm -rf "$WORK"' EXIT
+
+. "$DIR/complexity.sh"
+
+# Writes a program of $1 declarations: $1 / 3 structs and their functions
+generate() {
+    awk -v n="$1" 'BEGIN {
+        for (i = 0; i < n / 3; i++) {
+            printf "struct S%d {\n    a: i32,\n    b: i64,\n}\n\n", i
+            printf "fn make%d(x: i32) -> S%d {\n    return S%d { a: x, b: 1 };\n}\n\n", i, i, i
+            printf "fn find%d(x: i32) -> Option<S%d> {\n    return Some(make%d(x));\n}\n\n", i, i, i
+        }
+        print "fn main() -> i32 {\n    return 0;\n}"
+    }'
+}
+
+printf "%12s %12s %12s\n" declarations "time (ms)" "peak (KB)"
+for n in $SIZES; do
+    generate "$n" > "$WORK/program.jfm"
+    measure "$JFMC" "$WORK/program.jfm" --c-only -o "$WORK/program.c" > "$WORK/phases"
+    if [ "$(wc -l < "$WORK/phases")" -ne 4 ]; then
+        echo "FAIL: $n declarations do not compile"
+        "$JFMC" --c-only -o "$WORK/program.c" "$WORK/program.jfm" 2>&1 | head -5
+        exit 1
+    fi
+    totals=$(awk '{ ms += $2; if ($3 > kb) kb = $3 } END { printf "%.0f %d", ms, kb }' "$WORK/phases")
+    ms=${totals% *}
+    kb=${totals#* }
+    printf "%12d %12d %12d\n" "$n" "$ms" "$kb"
+    echo "$n $ms" >> "$WORK/time"
+    echo "$n $kb" >> "$WORK/memory"
+done
+
+status=0
+for quantity in time memory; do
+    k=$(fit_exponent < "$WORK/$quantity")
+    if exceeds "$k" $LIMIT; then
+        echo "FAIL: $quantity grows as n^$k (limit n^$LIMIT)"
+        status=1
+    else
+        echo "$quantity grows as n^$k"
+    fi
+done
+exit $status
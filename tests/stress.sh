@@ -0,0 +1,186 @@
+#!/bin/sh
+# Complexity regression harness: compiles generated pathological programs
+# of growing size and fails if any compiler phase grows faster than
+# n log n.
+#
+# Each pattern below builds a program of size n (nesting depth, chain
+# length, number of scopes or errors, identifier length) at four doubling
+# sizes. Every program is compiled RUNS times with --time --c-only, and a
+# power law is fitted to the fastest CPU time of each phase (lex, parse,
+# semantic, codegen) and to the peak memory. An exponent above LIMIT fails
+# the run: n log n fits to about 1.1 over these sizes and quadratic growth
+# to 2, and the margin in between absorbs timing noise. Phases that stay
+# under FLOOR ms at the largest size are too fast to fit and are not judged.
+#
+# Usage: tests/stress.sh [path/to/jfmc] [pattern...]
+# Run by "make stress".
+
+JFMC=${1:-./jfmc}
+[ $# -gt 0 ] && shift
+PATTERNS=${*:-nested_blocks nested_ifs nested_parens sibling_scopes many_locals \
+add_chain method_chain struct_literals option_structs many_calls semantic_errors parse_errors \
+long_identifier}
+LIMIT=1.4
+FLOOR=2
+RUNS=3
+DIR=$(dirname "$0")
+WORK=${TMPDIR:-/tmp}/jfm_stress.$$
+mkdir -p "$WORK"
+trap 'rm -rf "$WORK"' EXIT
+
+. "$DIR/complexity.sh"
+
+# Smallest size of each pattern. Nesting is kept under 16000 levels and
+# chains under 64000 terms, where the recursive descent parser would run
+# out of C stack.
+base_size() {
+    case $1 in
+        nested_*)        echo 1500 ;;
+        *_chain)         echo 4000 ;;
+        option_structs)  echo 5000 ;;
+        long_identifier) echo 100000 ;;
+        *)               echo 20000 ;;
+    esac
+}
+
+# Writes the program of pattern $1 at size $2
+generate() {
+    awk -v pattern="$1" -v n="$2" '
+    function main_start() { print "fn main() -> i32 {\nlet x: i32 = 1;\nlet ok: bool = true;" }
+    function main_end() { print "return 0;\n}" }
+    BEGIN {
+        if (pattern == "nested_blocks") {
+            # Every level looks up x, declared n scopes further out
+            main_start()
+            for (i = 0; i < n; i++) printf "{\nlet v%d: i32 = x;\n", i
+            for (i = 0; i < n; i++) print "}"
+            main_end()
+        } else if (pattern == "nested_ifs") {
+            main_start()
+            for (i = 0; i < n; i++) print "if (x > 0) {"
+            for (i = 0; i < n; i++) print "}"
+            main_end()
+        } else if (pattern == "nested_parens") {
+            main_start()
+            printf "let y: i32 = "
+            for (i = 0; i < n; i++) printf "("
+            printf "x"
+            for (i = 0; i < n; i++) printf ")"
+            print ";"
+            main_end()
+        } else if (pattern == "sibling_scopes") {
+            main_start()
+            for (i = 0; i < n; i++) print "{\nlet v: i32 = x;\n}"
+            main_end()
+        } else if (pattern == "many_locals") {
+            main_start()
+            print "let v0: i32 = x;"
+            for (i = 1; i < n; i++) printf "let v%d: i32 = v%d;\n", i, i - 1
+            main_end()
+        } else if (pattern == "add_chain") {
+            main_start()
+            printf "let y: i32 = x"
+            for (i = 1; i < n; i++) printf " + x"
+            print ";"
+            main_end()
+        } else if (pattern == "method_chain") {
+            print "struct C {\nv: i32,\n}\n"
+            print "impl C {\nfn next(self: C) -> C {\nreturn C { v: self.v + 1 };\n}\n}\n"
+            main_start()
+            printf "let c: C = C { v: 0 }"
+            for (i = 0; i < n; i++) printf ".next()"
+            print ";"
+            main_end()
+        } else if (pattern == "struct_literals") {
+            # Struct literals next to identifiers followed by a block, which
+            # primary has to tell apart
+            print "struct P {\nx: i32,\ny: i32,\n}\n"
+            main_start()
+            print "let mut count: i32 = 0;"
+            for (i = 0; i < n; i++) {
+                printf "let p%d: P = P { x: %d, y: x };\n", i, i
+                print "if (ok) {\ncount = count + p0.y;\n}"
+            }
+            main_end()
+        } else if (pattern == "option_structs") {
+            # Each Option typedef waits for the struct it holds
+            for (i = 0; i < n; i++) {
+                printf "struct S%d {\na: i32,\nb: i64,\n}\n", i
+                printf "fn find%d(x: i32) -> Option<S%d> {\nreturn Some(S%d { a: x, b: 1 });\n}\n", i, i, i
+            }
+            main_start()
+            main_end()
+        } else if (pattern == "many_calls") {
+            # Each call is resolved to its function definition by name
+            print "fn call0(x: i32) -> i32 {\nreturn x;\n}"
+            for (i = 1; i < n; i++) printf "fn call%d(x: i32) -> i32 {\nreturn call%d(x) + 1;\n}\n", i, i - 1
+            main_start()
+            main_end()
+        } else if (pattern == "semantic_errors") {
+            main_start()
+            for (i = 0; i < n; i++) printf "let v%d: i32 = undefined%d;\n", i, i
+            main_end()
+        } else if (pattern == "parse_errors") {
+            for (i = 0; i < n; i++) printf "fn bad%d() -> i32 {\nreturn 1 +;\n}\n", i
+            main_start()
+            main_end()
+        } else if (pattern == "long_identifier") {
+            name = "v"
+            while (length(name) < n) name = name name
+            name = substr(name, 1, n)
+            main_start()
+            printf "let %s: i32 = x;\nlet y: i32 = %s + %s;\n", name, name, name
+            main_end()
+        }
+    }'
+}
+
+status=0
+for pattern in $PATTERNS; do
+    n=$(base_size "$pattern")
+    rm -f "$WORK"/phase.*
+    for step in 1 2 3 4; do
+        generate "$pattern" "$n" > "$WORK/program.jfm"
+        : > "$WORK/phases"
+        run=0
+        while [ $run -lt $RUNS ]; do
+            measure "$JFMC" "$WORK/program.jfm" --c-only -o "$WORK/program.c" >> "$WORK/phases"
+            if [ $? -gt 128 ]; then
+                echo "FAIL: $pattern: jfmc crashed at size $n"
+                status=1
+                continue 3
+            fi
+            run=$((run + 1))
+        done
+        awk '!($1 in ms) || $2 < ms[$1] { ms[$1] = $2 } { if ($3 > kb) kb = $3 }
+             END { for (phase in ms) print phase, ms[phase]; print "memory", kb }' "$WORK/phases" |
+            while read -r phase value; do
+                echo "$n $value" >> "$WORK/phase.$phase"
+            done
+        n=$((n * 2))
+    done
+
+    line=$(printf "%-16s" "$pattern")
+    for phase in lex parse semantic codegen memory; do
+        file="$WORK/phase.$phase"
+        # Judge only phases reached at every size
+        if [ ! -f "$file" ] || [ "$(wc -l < "$file")" -ne 4 ]; then
+            continue
+        fi
+        k=$(fit_exponent < "$file")
+        if [ $phase != memory ] && awk -v floor=$FLOOR 'END { exit !($2 < floor) }' "$file"; then
+            line="$line $phase -"
+        elif exceeds "$k" $LIMIT; then
+            line="$line $phase n^$k (FAIL)"
+            status=1
+        else
+            line="$line $phase n^$k"
+        fi
+    done
+    echo "$line"
+done
+
+if [ $status -ne 0 ]; then
+    echo "FAIL: a phase grows faster than n^$LIMIT"
+fi
+exit $status